@@ -0,0 +1,73 @@
+/*
+ * Control flow graph over the IR of a single procedure.
+ */
+#ifndef IR_CFG_H
+#define IR_CFG_H
+
+#include "ir.h"
+
+/*
+ * BasicBlock
+ * A maximal run of IR nodes entered only at its first node and left only
+ * after its last. Every block begins with a LABEL node; CFG construction
+ * inserts one where a block would otherwise start without a label.
+ */
+struct BasicBlock {
+    int id;                         /* index into the CFG's blocks array  */
+    IrNode *first;                  /* the block's LABEL                   */
+    IrNode *last;                   /* last node, a jump if it has one     */
+    struct BasicBlock **succs;
+    int num_succs;
+    struct BasicBlock **preds;
+    int num_preds;
+    int rpo;                        /* reverse postorder, -1: unreachable  */
+    struct BasicBlock *idom;        /* immediate dominator                 */
+    struct BasicBlock **dom_children;
+    int num_dom_children;
+    struct BasicBlock **dom_frontier;
+    int num_dom_frontier;
+};
+typedef struct BasicBlock BasicBlock;
+
+/*
+ * ControlFlowGraph
+ * The blocks of the procedure between its BEGIN_PROC and END_PROC nodes,
+ * kept in IR list order. The entry block never has predecessors.
+ */
+struct ControlFlowGraph {
+    IrList *irl;
+    IrNode *begin_proc;
+    IrNode *end_proc;
+    BasicBlock **blocks;
+    int num_blocks;
+    BasicBlock **rpo;               /* reachable blocks in reverse postorder */
+    int num_rpo;
+    int num_regs;                   /* registers are numbered below this    */
+};
+typedef struct ControlFlowGraph ControlFlowGraph;
+
+/* iterate over the nodes of a block */
+#define FOR_EACH_BLOCK_NODE(irn, b) \
+    for ((irn) = (b)->first; (irn) != NULL; \
+            (irn) = (irn) == (b)->last ? NULL : (irn)->next)
+
+ControlFlowGraph *create_cfg(IrList *irl, IrNode *begin_proc);
+void free_cfg(ControlFlowGraph *cfg);
+void rebuild_cfg(ControlFlowGraph *cfg);
+IrNode *next_proc(IrNode *irn);
+void compute_dominators(ControlFlowGraph *cfg);
+void compute_dominance_frontiers(ControlFlowGraph *cfg);
+Boolean dominates(BasicBlock *a, BasicBlock *b);
+void renumber_registers(ControlFlowGraph *cfg);
+int new_reg(ControlFlowGraph *cfg);
+int remove_unreachable_blocks(ControlFlowGraph *cfg);
+IrNode *block_terminator(BasicBlock *b);
+IrNode *insert_before_terminator(BasicBlock *b, IrNode *irn,
+                                    ControlFlowGraph *cfg);
+IrNode *insert_at_block_start(BasicBlock *b, IrNode *irn,
+                                    ControlFlowGraph *cfg);
+void remove_block_node(IrNode *irn, ControlFlowGraph *cfg);
+int pred_index(BasicBlock *b, BasicBlock *pred);
+void print_cfg(FILE *out, ControlFlowGraph *cfg);
+
+#endif
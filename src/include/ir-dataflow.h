@@ -0,0 +1,121 @@
+/*
+ * Iterative bit vector dataflow analysis over the blocks of a procedure.
+ */
+#ifndef IR_DATAFLOW_H
+#define IR_DATAFLOW_H
+
+#include <stdint.h>
+
+#include "ir.h"
+#include "ir-cfg.h"
+
+/*
+ * BitSet
+ * A set of small integers below num_bits. Dense sets are arrays of 64 bit
+ * words; sparse sets are ascending arrays of their members, for universes
+ * too large to give every block a word per 64 members.
+ */
+struct BitSet {
+    int num_bits;
+    Boolean sparse;
+    uint64_t *words;                /* dense: bit i of word i / 64        */
+    int num_words;
+    int *members;                   /* sparse: ascending                  */
+    int num_members;
+    int capacity;
+};
+typedef struct BitSet BitSet;
+
+/* iterate over the members of a set in ascending order */
+#define FOR_EACH_BIT(i, set) \
+    for ((i) = bitset_next((set), 0); (i) != NO_ARG; \
+            (i) = bitset_next((set), (i) + 1))
+
+BitSet *new_bitset(int num_bits, Boolean sparse);
+void free_bitset(BitSet *set);
+void bitset_add(BitSet *set, int bit);
+void bitset_remove(BitSet *set, int bit);
+Boolean bitset_contains(BitSet *set, int bit);
+int bitset_next(BitSet *set, int bit);
+int bitset_count(BitSet *set);
+void bitset_clear(BitSet *set);
+void bitset_fill(BitSet *set);
+void bitset_copy(BitSet *dst, BitSet *src);
+Boolean bitset_equal(BitSet *a, BitSet *b);
+Boolean bitset_union(BitSet *dst, BitSet *src);
+Boolean bitset_intersect(BitSet *dst, BitSet *src);
+Boolean bitset_transfer(BitSet *out, BitSet *in, BitSet *gen, BitSet *kill);
+
+enum df_direction { DF_FORWARD, DF_BACKWARD };
+enum df_meet { DF_UNION, DF_INTERSECTION };
+enum df_representation { DF_AUTO, DF_DENSE, DF_SPARSE };
+
+/* how new problems store their sets; DF_AUTO picks by size */
+extern enum df_representation dataflow_representation;
+
+/*
+ * Dataflow
+ * A gen/kill problem over the blocks of a procedure and its solution. For
+ * a forward problem in[b] is the meet of the out sets of b's predecessors
+ * and out[b] = gen[b] | (in[b] - kill[b]); a backward problem swaps in and
+ * out and predecessors and successors. Sets are indexed by block id.
+ */
+struct Dataflow {
+    ControlFlowGraph *cfg;
+    enum df_direction direction;
+    enum df_meet meet;
+    int num_bits;
+    Boolean sparse;
+    BitSet **gen;
+    BitSet **kill;
+    BitSet **in;
+    BitSet **out;
+    int visits;                     /* blocks the solver evaluated        */
+};
+typedef struct Dataflow Dataflow;
+
+Dataflow *new_dataflow(ControlFlowGraph *cfg, enum df_direction direction,
+                        enum df_meet meet, int num_bits);
+void solve_dataflow(Dataflow *df);
+void free_dataflow(Dataflow *df);
+
+/* live registers: in and out are the registers live into and out of blocks */
+Dataflow *compute_liveness(ControlFlowGraph *cfg);
+void split_webs(ControlFlowGraph *cfg);
+
+/*
+ * ReachingDefs
+ * The definitions of registers reaching each block: bit i stands for the
+ * instruction defs[i].
+ */
+struct ReachingDefs {
+    Dataflow *df;
+    IrNode **defs;
+    int num_defs;
+};
+typedef struct ReachingDefs ReachingDefs;
+
+ReachingDefs *compute_reaching_defs(ControlFlowGraph *cfg);
+void free_reaching_defs(ReachingDefs *rd);
+
+/*
+ * AvailableExprs
+ * The expressions computed on every path to each block with none of their
+ * operands, or for loads memory, changed since: bit i stands for the
+ * expression computed by exprs[i] and by every instruction with the same
+ * operation and operands.
+ */
+struct AvailableExprs {
+    Dataflow *df;
+    IrNode **exprs;
+    int num_exprs;
+    int *buckets;                   /* hash chains of expression indices  */
+    int *chain;
+};
+typedef struct AvailableExprs AvailableExprs;
+
+AvailableExprs *compute_available_exprs(ControlFlowGraph *cfg);
+int find_expr(AvailableExprs *ae, IrNode *irn);
+void free_available_exprs(AvailableExprs *ae);
+
+#endif
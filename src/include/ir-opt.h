@@ -0,0 +1,126 @@
+/*
+ * Optimization passes over the IR.
+ */
+#ifndef IR_OPT_H
+#define IR_OPT_H
+
+#include "ir.h"
+#include "ir-cfg.h"
+
+/*
+ * CallGraph
+ * The procedures of a program, by their BEGIN_PROC nodes, and which of
+ * them call or take the address of which.
+ */
+struct CallGraph {
+    IrNode **procs;
+    int num_procs;
+    Boolean *calls;             /* num_procs * num_procs: i calls j         */
+    Boolean *address_taken;     /* per procedure: may be called indirectly  */
+    Boolean *reachable;         /* per procedure: reached from main         */
+    Boolean *changed;           /* per procedure: worth optimizing again    */
+    int *effects;               /* per procedure: CALL_CONST, CALL_PURE or
+                                   CALL_ANY_EFFECTS                         */
+};
+typedef struct CallGraph CallGraph;
+
+/*
+ * Loop
+ * A natural loop, by the blocks in it. The preheader is NULL when the loop
+ * has none.
+ */
+struct Loop {
+    BasicBlock *header;
+    BasicBlock *preheader;
+    BasicBlock *entry;          /* the only block entering, else NULL     */
+    Boolean *body;              /* per block: in the loop                 */
+    int size;
+};
+typedef struct Loop Loop;
+
+/* pipeline */
+extern FILE *opt_report;
+extern Boolean mips1;
+void optimize_ir(IrList *irl, int level);
+void report_pass(char *pass, ControlFlowGraph *cfg, int count, char *what);
+void report_program(char *pass, int count, char *what);
+int parse_opt_flags(int argc, char *argv[], Boolean *use_ssa, int *level);
+
+/* interprocedural optimization */
+CallGraph *build_call_graph(IrList *irl);
+void free_call_graph(CallGraph *cg);
+int procedure_index(CallGraph *cg, Symbol *s);
+void find_callees(CallGraph *cg, int proc);
+int add_procedure(CallGraph *cg, IrNode *begin);
+Boolean constant_register(IrNode *begin, int reg, int *value);
+IrNode *procedure_end(IrNode *begin);
+IrNode *call_result(IrNode *call);
+int remove_unreachable(CallGraph *cg, IrList *irl);
+int tag_call_effects(CallGraph *cg);
+int propagate_interprocedural_constants(CallGraph *cg);
+int reuse_pure_calls(ControlFlowGraph *cfg);
+
+/* inlining */
+extern int inline_limit;
+int inline_calls(CallGraph *cg, IrList *irl);
+int procedure_size(IrNode *begin);
+int map_labels(IrNode *begin, IrNode ***labels, IrNode ***copies);
+IrNode *clone_ir_node(IrNode *irn, int base);
+IrNode *copied_label(IrNode *label, IrNode **labels, IrNode **copies,
+                        int num);
+
+/* specialization */
+int specialize_procedures(CallGraph *cg, IrList *irl);
+
+/* constant folding and propagation */
+Boolean fold_binary_op(int instr, int a, int b, int *result);
+Boolean fold_unary_op(int instr, int a, int *result);
+Boolean fold_jump(int instr, int cond);
+int propagate_constants(ControlFlowGraph *cfg);
+
+/* value numbering */
+int number_values(ControlFlowGraph *cfg);
+Boolean writes_memory(IrNode *irn);
+
+/* redundant load and dead store elimination */
+int optimize_memory(ControlFlowGraph *cfg);
+Boolean is_global_symbol(Symbol *s);
+Boolean is_scalar_symbol(Symbol *s);
+Boolean is_memory_load(IrNode *irn);
+
+/* loop-invariant code motion and scalar promotion */
+int hoist_loop_invariants(ControlFlowGraph *cfg);
+int promote_globals(ControlFlowGraph *cfg);
+Loop *find_loops(ControlFlowGraph *cfg, int *num_loops);
+void free_loops(Loop *loops, int num_loops);
+int insert_preheaders(ControlFlowGraph *cfg);
+IrNode **register_defs(ControlFlowGraph *cfg, int **num_defs);
+
+/* induction variable strength reduction */
+int reduce_induction_variables(ControlFlowGraph *cfg);
+void sweep_dead_values(ControlFlowGraph *cfg);
+int mirrored_test(int instr);
+
+/* if-conversion */
+extern Boolean conditional_moves;
+int convert_branches(ControlFlowGraph *cfg);
+Boolean may_convert_branches(ControlFlowGraph *cfg);
+
+/* loop unrolling */
+extern int unroll_factor;
+int unroll_loops(ControlFlowGraph *cfg);
+Boolean may_unroll(ControlFlowGraph *cfg);
+
+/* multiplication and division by constants */
+int lower_constant_arithmetic(ControlFlowGraph *cfg);
+
+/* loop rotation and block layout */
+int rotate_loops(ControlFlowGraph *cfg);
+int layout_blocks(ControlFlowGraph *cfg);
+int thread_jumps(ControlFlowGraph *cfg);
+
+/* dead code elimination */
+Boolean has_side_effects(IrNode *irn);
+int eliminate_dead_code(ControlFlowGraph *cfg);
+
+#endif
@@ -0,0 +1,32 @@
+/*
+ * Static single assignment form for the IR.
+ */
+#ifndef IR_SSA_H
+#define IR_SSA_H
+
+#include "ir.h"
+#include "ir-cfg.h"
+
+/*
+ * DefUse
+ * Def-use chain of one register: the node defining it and every node
+ * reading it. In SSA form each register has exactly one definition.
+ */
+struct DefUse {
+    IrNode *def;
+    IrNode **uses;
+    int num_uses;
+};
+typedef struct DefUse DefUse;
+
+void convert_to_ssa(IrList *irl);
+void convert_from_ssa(IrList *irl);
+void construct_ssa(ControlFlowGraph *cfg);
+void destruct_ssa(ControlFlowGraph *cfg);
+Boolean is_promotable_symbol(Symbol *s);
+void update_phi_args(ControlFlowGraph *cfg);
+
+DefUse *compute_def_use(ControlFlowGraph *cfg);
+void free_def_use(DefUse *du, int num_regs);
+
+#endif
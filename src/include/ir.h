@@ -5,6 +5,16 @@
 
 #define MAX_REG_LEN 24
 #define NO_ARG -1
+/* most register operands read by a single (non-PHI) IR instruction */
+#define MAX_USES 3
+
+/*
+ * what a CALL may do besides computing its result, kept in its IMMVAL;
+ * each allows less than the one before
+ */
+#define CALL_ANY_EFFECTS NO_ARG
+#define CALL_PURE 1             /* reads memory but writes none           */
+#define CALL_CONST 2            /* does not even read memory              */
 
 #define CHAR_BYTES 1
 #define SHORT_BYTES 2
@@ -15,7 +25,9 @@ enum ir_instruction {
     NO_IR_INSTRUCTION,
     LOAD_ADDR,
     LOAD_BYTE_INDIRECT,
+    LOAD_UNSIGNED_BYTE_INDIRECT,
     LOAD_HALF_WORD_INDIRECT,
+    LOAD_UNSIGNED_HALF_WORD_INDIRECT,
     LOAD_WORD_INDIRECT,
     LOAD_WORD,
     LOAD_ADDRESS,
@@ -26,10 +38,14 @@ enum ir_instruction {
     PARAM,
     CALL,
     END_CALL,
+    TAIL_CALL,
     SYSCALL,
     RETURN_FROM_PROC,
     RETURNED_WORD,
+    RECEIVED_PARAM,
     STORE_WORD,
+    STORE_BYTE_INDIRECT,
+    STORE_HALF_WORD_INDIRECT,
     STORE_WORD_INDIRECT,
     ADD_CONST,
     JUMP,
@@ -43,8 +59,50 @@ enum ir_instruction {
     MULT,
     ADDU,
     SUBU,
-    LOG_OR
+    LOG_OR,
+    MOVE,
+    PHI,
+    SELECT,                     /* RDEST = RSRC != 0 ? OPRND1 : OPRND2 */
+    LOG_AND,
+    DIV,
+    REM,
+    DIVU,
+    REMU,
+    MULT_HIGH,
+    MULT_HIGH_UNSIGNED,
+    BIT_AND,
+    BIT_OR,
+    BIT_XOR,
+    SHIFT_LEFT,
+    SHIFT_RIGHT,
+    SHIFT_RIGHT_LOGICAL,
+    SET_LT,
+    SET_LE,
+    SET_GT,
+    SET_GE,
+    SET_LTU,
+    SET_LEU,
+    SET_GTU,
+    SET_GEU,
+    SET_EQ,
+    SET_NE,
+    NEGATE,
+    LOG_NOT,
+    BIT_NOT
+};
+
+/*
+ * PhiArg
+ * One incoming value of a PHI node: the register holding the value when
+ * control arrives from the predecessor block led by the LABEL node pred.
+ */
+struct PhiArg {
+    int reg;
+    struct IrNode *pred;
 };
+typedef struct PhiArg PhiArg;
+
+struct BasicBlock;
 
 struct IrNode {
     struct IrNode *prev;
@@ -59,6 +117,11 @@ struct IrNode {
     int RSRC;
     int LABIDX;
     Symbol *s;
+    /* PHI arguments, one per predecessor of the PHI's block */
+    PhiArg *phi_args;
+    int num_phi_args;
+    /* basic block containing this node, set by CFG construction */
+    struct BasicBlock *bb;
 };
 typedef struct IrNode IrNode;
 
@@ -80,13 +143,27 @@ IrNode *construct_ir_node(enum ir_instruction instr);
 IrList *create_ir_list(void);
 IrNode *append_ir_node(IrNode *irn, IrList *irl);
 IrNode *prepend_ir_node(IrNode *irn, IrList *irl);
+IrNode *insert_ir_node_before(IrNode *pos, IrNode *irn, IrList *irl);
+IrNode *insert_ir_node_after(IrNode *pos, IrNode *irn, IrList *irl);
+void remove_ir_node(IrNode *irn, IrList *irl);
+IrNode *new_label(void);
+IrNode *irn_jump(int instr, int src, IrNode *label);
+IrNode *irn_move(int dest, int src);
+int *ir_node_def(IrNode *irn);
+int ir_node_uses(IrNode *irn, int *uses[MAX_USES]);
+Boolean is_jump(IrNode *irn);
+IrNode *call_begin(IrNode *call);
+Boolean is_binary_op(IrNode *irn);
+Boolean is_unary_op(IrNode *irn);
 int instruction(IrNode *irn);
 Boolean is_statement(Node *n);
 Boolean node_is_lvalue(Node *n);
+int type_bytes(TypeNode *tn);
 
 
 void print_ir_list(FILE *out, IrList *irl);
 void print_ir_node(FILE *out, IrNode *irn);
 char *get_ir_name(enum ir_instruction instr);
+char *get_ir_opname(enum ir_instruction instr);
 
 #endif
@@ -1 +1,196 @@
+/*
+ * MIPS code generation.
+ */
+#ifndef MIPS_H
+#define MIPS_H
+
+#include <stdio.h>
+
+#include "ir.h"
+#include "ir-cfg.h"
+#include "symbol.h"
+
+/* MIPS register numbers */
+#define REG_ZERO 0
+#define REG_V0 2
+#define REG_V1 3
+#define REG_A0 4
+#define REG_T0 8
+#define REG_S0 16
+#define REG_T8 24
+#define REG_SP 29
+#define REG_FP 30
+#define REG_RA 31
+
+#define NUM_MIPS_REGS 32
+#define NUM_ARG_REGS 4
+#define NUM_SAVED_REGS 8
+/* most registers one MIPS instruction reads: movn and movz read rd too */
+#define MAX_MIPS_USES 3
+
+/*
+ * RegisterAssignment
+ * What register allocation left for the stack frame of a procedure to hold:
+ * the callee-saved registers it writes and the slots of spilled values.
+ */
+struct RegisterAssignment {
+    Boolean saved_used[NUM_SAVED_REGS];     /* $s0-$s7 written          */
+    int num_spill_slots;
+    int num_coalesced;                      /* moves that disappeared   */
+};
+typedef struct RegisterAssignment RegisterAssignment;
+
+/*
+ * FrameLayout
+ * Where the stack frame of a procedure keeps each thing, as offsets from
+ * $fp. $fp points at the saved $fp, the word at the top of the frame; the
+ * outgoing argument area is at the bottom, at $sp. Parameters are kept
+ * where they are passed, in the caller's outgoing argument area just above
+ * the frame, so their offsets are positive. A procedure with nothing to
+ * keep has no frame at all.
+ */
+struct FrameLayout {
+    int size;                               /* bytes, a multiple of 8   */
+    Boolean saves_ra;                       /* not a leaf procedure     */
+    int saved_offset[NUM_SAVED_REGS];       /* $s0-$s7, 0 if not saved  */
+    Symbol **locals;                        /* variables in the frame   */
+    int *local_offset;
+    int num_locals;
+    int *spill_offset;                      /* by spill slot            */
+    int num_spill_slots;
+    int num_spill_words;                    /* slots share words        */
+    int outgoing_bytes;
+};
+typedef struct FrameLayout FrameLayout;
+
+/* the MIPS instructions and assembler pseudo instructions emitted */
+enum mips_opcode {
+    MIPS_NONE,
+    MIPS_LABEL,                 /* a label, not an instruction */
+    MIPS_ADDU,
+    MIPS_SUBU,
+    MIPS_MUL,
+    MIPS_AND,
+    MIPS_OR,
+    MIPS_XOR,
+    MIPS_NOR,
+    MIPS_SLT,
+    MIPS_SLTU,
+    MIPS_SLLV,
+    MIPS_SRAV,
+    MIPS_SRLV,
+    MIPS_ADDIU,
+    MIPS_ANDI,
+    MIPS_ORI,
+    MIPS_XORI,
+    MIPS_SLTI,
+    MIPS_SLTIU,
+    MIPS_SLL,
+    MIPS_SRA,
+    MIPS_SRL,
+    MIPS_LUI,
+    MIPS_LI,
+    MIPS_LA,
+    MIPS_MOVE,
+    MIPS_MOVN,
+    MIPS_MOVZ,
+    MIPS_DIV,
+    MIPS_DIVU,
+    MIPS_MULT,
+    MIPS_MULTU,
+    MIPS_MFLO,
+    MIPS_MFHI,
+    MIPS_NOP,
+    MIPS_LB,
+    MIPS_LBU,
+    MIPS_LH,
+    MIPS_LHU,
+    MIPS_LW,
+    MIPS_SB,
+    MIPS_SH,
+    MIPS_SW,
+    MIPS_BEQ,
+    MIPS_BNE,
+    MIPS_BEQZ,
+    MIPS_BNEZ,
+    MIPS_BLEZ,
+    MIPS_BGEZ,
+    MIPS_BLTZ,
+    MIPS_BGTZ,
+    MIPS_J,
+    MIPS_JAL,
+    MIPS_JR
+};
+
+/*
+ * MipsInstr
+ * One instruction of a procedure's assembly, or a label. Registers are
+ * machine registers, NO_ARG where the instruction has none. A memory
+ * operand is imm(rs), or the global s plus imm. Branches and jumps go to
+ * LABEL_label, or to the procedure s.
+ */
+struct MipsInstr {
+    enum mips_opcode op;
+    int rd;                         /* written                          */
+    int rs;
+    int rt;                         /* also the value a store stores    */
+    int imm;
+    Symbol *s;
+    int label;
+    const char *comment;
+    struct MipsInstr *prev;
+    struct MipsInstr *next;
+};
+typedef struct MipsInstr MipsInstr;
+
+struct MipsList {
+    MipsInstr *head;
+    MipsInstr *tail;
+};
+typedef struct MipsList MipsList;
+
 void compute_mips_asm(FILE *output, SymbolTableContainer *stc, IrList *irl);
+
+/* instruction lists */
+MipsInstr *construct_mips_instr(enum mips_opcode op, int rd, int rs, int rt,
+                                int imm);
+void append_mips_instr(MipsInstr *mi, MipsList *ml);
+void insert_mips_instr_after(MipsInstr *pos, MipsInstr *mi, MipsList *ml);
+void unlink_mips_instr(MipsInstr *mi, MipsList *ml);
+void remove_mips_instr(MipsInstr *mi, MipsList *ml);
+int mips_instr_def(MipsInstr *mi);
+int mips_instr_uses(MipsInstr *mi, int uses[]);
+Boolean is_mips_load(MipsInstr *mi);
+Boolean is_mips_store(MipsInstr *mi);
+void print_mips_instr(FILE *out, MipsInstr *mi);
+void free_mips_list(MipsList *ml);
+
+/* register allocation */
+void allocate_registers(ControlFlowGraph *cfg, RegisterAssignment *ra);
+char *mips_reg_name(int reg);
+
+/* stack frame layout */
+void layout_frame(ControlFlowGraph *cfg, RegisterAssignment *ra,
+                    FrameLayout *fl);
+Boolean local_offset(FrameLayout *fl, Symbol *s, int *offset);
+int type_alignment(TypeNode *tn);
+void free_frame_layout(FrameLayout *fl);
+
+/* calls */
+int convert_tail_calls(ControlFlowGraph *cfg);
+
+/* instruction selection */
+int select_instructions(ControlFlowGraph *cfg, RegisterAssignment *ra,
+                        FrameLayout *fl, MipsList *ml);
+
+/* instruction scheduling */
+int schedule_instructions(MipsList *ml);
+int fill_delay_slots(MipsList *ml);
+int insert_hazard_nops(MipsList *ml);
+
+/* peephole optimization */
+#define NUM_PEEPHOLE_RULES 7
+int optimize_peephole(MipsList *ml, int hits[]);
+char *peephole_rule_name(int rule);
+
+#endif
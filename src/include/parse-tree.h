@@ -116,6 +116,7 @@ union NodeData {
 struct Expression {
     Boolean lvalue;
     int location;
+    enum data_type type;    /* type of a NUMBER_CONSTANT, or NO_DATA_TYPE */
 };
 
 /*
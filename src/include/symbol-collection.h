@@ -13,6 +13,17 @@
 #define NON_INTEGRAL_VALUE  -2147483645
 #define CAST_VALUE          -2147483644
 
+/*
+ * IntegerConstant
+ * The value of an integral constant expression. bits holds the value
+ * truncated to the width of type; signed values are sign extended to 32 bits.
+ */
+struct IntegerConstant {
+    unsigned long bits;
+    enum data_type type;
+};
+typedef struct IntegerConstant IntegerConstant;
+
 struct SymbolCreationData {
     SymbolTableContainer *stc;
     enum data_type current_base_type;
@@ -46,5 +57,20 @@ void validate_symbol(Symbol *s, SymbolCreationData *scd);
 void validate_function_symbol(Symbol *s, SymbolCreationData *scd);
 void validate_statement_labels(SymbolCreationData *scd);
 
+/* constant folding */
+void fold_constant_expressions(Node *n);
+IntegerConstant convert_integer_constant(IntegerConstant c,
+                                            enum data_type type);
+Boolean apply_binary_operator(int op, IntegerConstant c1, IntegerConstant c2,
+                                IntegerConstant *result);
+Boolean apply_unary_operator(int op, IntegerConstant c,
+                                IntegerConstant *result);
+long integer_constant_value(IntegerConstant c);
+
+/* integer types */
+enum data_type promoted_type(enum data_type type);
+enum data_type arithmetic_type(enum data_type t1, enum data_type t2);
+Boolean cast_target_type(Node *type_name, enum data_type *type);
+
 
 #endif
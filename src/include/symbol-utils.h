@@ -61,6 +61,7 @@ SymbolTable *create_function_prototypes();
 void append_function_prototype(SymbolTable *prototypes, Symbol *s);
 void append_symbol(SymbolTable *st, Symbol *s);
 void attach_symbol(SymbolTable *st, Symbol *s, Symbol *prev);
+void detach_symbol(SymbolTable *st, Symbol *s);
 Symbol *st_symbols(SymbolTable *st);
 int st_scope(SymbolTable *st);
 char *st_scope_name(SymbolTable *st);
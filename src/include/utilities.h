@@ -23,6 +23,7 @@ enum util_error {
 
 void util_handle_error(enum util_error e, char *data);
 void util_emalloc(void **ptr, size_t n);
+void util_erealloc(void **ptr, size_t n);
 char *util_get_type_spec(int type);
 char *util_compose_numeric_message(char *fmt, long num);
 
@@ -0,0 +1,527 @@
+/*
+ * Control flow graph construction and dominance computations
+ * for the IR of a single procedure.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/symbol-utils.h"
+#include "../include/utilities.h"
+
+/* file helper functions */
+void build_blocks(ControlFlowGraph *cfg);
+void free_blocks(ControlFlowGraph *cfg);
+void ensure_block_labels(ControlFlowGraph *cfg);
+void link_blocks(ControlFlowGraph *cfg);
+void add_edge(BasicBlock *from, BasicBlock *to);
+void compute_reverse_postorder(ControlFlowGraph *cfg);
+void append_block(BasicBlock ***arr, int *n, BasicBlock *b);
+BasicBlock *intersect_dominators(BasicBlock *b1, BasicBlock *b2);
+int count_registers(ControlFlowGraph *cfg);
+
+
+/*
+ * create_cfg
+ * Purpose: build the control flow graph of one procedure
+ * Parameters:
+ *  irl - IrList * - the IR list holding the procedure
+ *  begin_proc - IrNode * - the procedure's BEGIN_PROC node
+ * Returns:
+ *  The CFG with reverse postorder, dominator tree and dominance frontiers
+ *  computed
+ * Side Effects:
+ *  May insert LABEL nodes into irl so that every block starts with one.
+ *  Sets the bb field of every node in the procedure. Allocates heap memory.
+ */
+ControlFlowGraph *create_cfg(IrList *irl, IrNode *begin_proc) {
+    ControlFlowGraph *cfg;
+    IrNode *irn;
+    util_emalloc((void **) &cfg, sizeof(ControlFlowGraph));
+    cfg->irl = irl;
+    cfg->begin_proc = begin_proc;
+    irn = begin_proc;
+    while (instruction(irn) != END_PROC) {
+        irn = irn->next;
+    }
+    cfg->end_proc = irn;
+    cfg->blocks = NULL;
+    cfg->num_blocks = 0;
+    cfg->rpo = NULL;
+    cfg->num_rpo = 0;
+    build_blocks(cfg);
+    cfg->num_regs = count_registers(cfg);
+    return cfg;
+}
+
+void free_cfg(ControlFlowGraph *cfg) {
+    free_blocks(cfg);
+    free(cfg);
+}
+
+/* the BEGIN_PROC node of the procedure following irn, or NULL */
+IrNode *next_proc(IrNode *irn) {
+    while (irn != NULL && instruction(irn) != BEGIN_PROC) {
+        irn = irn->next;
+    }
+    return irn;
+}
+
+/*
+ * rebuild the blocks after a pass has added or removed jumps or labels.
+ * nodes removed from the list keep stale bb pointers.
+ */
+void rebuild_cfg(ControlFlowGraph *cfg) {
+    build_blocks(cfg);
+}
+
+/* (re)compute blocks, edges, orderings and dominance from the IR list */
+void build_blocks(ControlFlowGraph *cfg) {
+    BasicBlock *b;
+    IrNode *irn;
+
+    free_blocks(cfg);
+    ensure_block_labels(cfg);
+
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = irn->next) {
+        if (instruction(irn) == LABEL) {
+            util_emalloc((void **) &b, sizeof(BasicBlock));
+            b->id = cfg->num_blocks;
+            b->first = irn;
+            b->succs = NULL;
+            b->num_succs = 0;
+            b->preds = NULL;
+            b->num_preds = 0;
+            b->rpo = -1;
+            b->idom = NULL;
+            b->dom_children = NULL;
+            b->num_dom_children = 0;
+            b->dom_frontier = NULL;
+            b->num_dom_frontier = 0;
+            append_block(&cfg->blocks, &cfg->num_blocks, b);
+        }
+        irn->bb = cfg->blocks[cfg->num_blocks - 1];
+        irn->bb->last = irn;
+    }
+    link_blocks(cfg);
+    compute_reverse_postorder(cfg);
+    compute_dominators(cfg);
+    compute_dominance_frontiers(cfg);
+}
+
+void free_blocks(ControlFlowGraph *cfg) {
+    BasicBlock *b;
+    int i;
+    for (i = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        free(b->succs);
+        free(b->preds);
+        free(b->dom_children);
+        free(b->dom_frontier);
+        free(b);
+    }
+    free(cfg->blocks);
+    free(cfg->rpo);
+    cfg->blocks = NULL;
+    cfg->num_blocks = 0;
+    cfg->rpo = NULL;
+    cfg->num_rpo = 0;
+}
+
+/*
+ * every block leader gets a LABEL: the first node of the procedure and
+ * every node following a jump. the entry block must not be a jump target
+ * so it gets a fresh label if the procedure starts at one.
+ */
+void ensure_block_labels(ControlFlowGraph *cfg) {
+    IrNode *irn, *first = cfg->begin_proc->next;
+    Boolean targeted = FALSE;
+
+    for (irn = first; irn != cfg->end_proc; irn = irn->next) {
+        if (is_jump(irn) && irn->branch == first) {
+            targeted = TRUE;
+        }
+    }
+    if (instruction(first) != LABEL || targeted) {
+        insert_ir_node_after(cfg->begin_proc, new_label(), cfg->irl);
+    }
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = irn->next) {
+        if (is_jump(irn) && irn->next != cfg->end_proc &&
+                instruction(irn->next) != LABEL) {
+            insert_ir_node_after(irn, new_label(), cfg->irl);
+        }
+    }
+}
+
+void link_blocks(ControlFlowGraph *cfg) {
+    BasicBlock *b, *fall;
+    IrNode *last;
+    int i;
+    for (i = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        last = b->last;
+        fall = i + 1 < cfg->num_blocks ? cfg->blocks[i + 1] : NULL;
+        switch (instruction(last)) {
+            case JUMP:
+            case RETURN_FROM_PROC:
+            case TAIL_CALL:
+                add_edge(b, last->branch->bb);
+                break;
+            case JUMP_EQZ:
+            case JUMP_NEZ:
+            case JUMP_LEZ:
+            case JUMP_GEZ:
+                if (fall != NULL) {
+                    add_edge(b, fall);
+                }
+                if (last->branch->bb != fall) {
+                    add_edge(b, last->branch->bb);
+                }
+                break;
+            default:
+                if (fall != NULL) {
+                    add_edge(b, fall);
+                }
+                break;
+        }
+    }
+}
+
+void add_edge(BasicBlock *from, BasicBlock *to) {
+    append_block(&from->succs, &from->num_succs, to);
+    append_block(&to->preds, &to->num_preds, from);
+}
+
+void append_block(BasicBlock ***arr, int *n, BasicBlock *b) {
+    util_erealloc((void **) arr, (*n + 1) * sizeof(BasicBlock *));
+    (*arr)[(*n)++] = b;
+}
+
+/* depth first search from the entry, recording blocks in reverse postorder */
+void compute_reverse_postorder(ControlFlowGraph *cfg) {
+    BasicBlock **stack, **post, *b;
+    int *next_succ;
+    int sp = 0, np = 0, i;
+
+    util_emalloc((void **) &stack, cfg->num_blocks * sizeof(BasicBlock *));
+    util_emalloc((void **) &post, cfg->num_blocks * sizeof(BasicBlock *));
+    util_emalloc((void **) &next_succ, cfg->num_blocks * sizeof(int));
+    for (i = 0; i < cfg->num_blocks; i++) {
+        next_succ[i] = 0;
+        cfg->blocks[i]->rpo = -1;
+    }
+    /* rpo doubles as the visited mark until the final numbering */
+    stack[sp++] = cfg->blocks[0];
+    cfg->blocks[0]->rpo = 0;
+    while (sp > 0) {
+        b = stack[sp - 1];
+        if (next_succ[b->id] < b->num_succs) {
+            BasicBlock *s = b->succs[next_succ[b->id]++];
+            if (s->rpo == -1) {
+                s->rpo = 0;
+                stack[sp++] = s;
+            }
+        } else {
+            post[np++] = b;
+            sp--;
+        }
+    }
+    cfg->num_rpo = np;
+    util_emalloc((void **) &cfg->rpo, np * sizeof(BasicBlock *));
+    for (i = 0; i < np; i++) {
+        cfg->rpo[i] = post[np - 1 - i];
+        cfg->rpo[i]->rpo = i;
+    }
+    free(stack);
+    free(post);
+    free(next_succ);
+}
+
+/*
+ * compute_dominators
+ * Purpose: compute the immediate dominator of each reachable block with
+ *          the iterative algorithm of Cooper, Harvey and Kennedy
+ * Parameters:
+ *  cfg - ControlFlowGraph * - graph with reverse postorder computed
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Sets idom and dom_children of each block. The entry's idom is NULL.
+ */
+void compute_dominators(ControlFlowGraph *cfg) {
+    BasicBlock *b, *new_idom, *p, *entry = cfg->rpo[0];
+    Boolean changed = TRUE;
+    int i, j;
+
+    for (i = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        b->idom = NULL;
+        free(b->dom_children);
+        b->dom_children = NULL;
+        b->num_dom_children = 0;
+    }
+    entry->idom = entry;
+    while (changed) {
+        changed = FALSE;
+        for (i = 1; i < cfg->num_rpo; i++) {
+            b = cfg->rpo[i];
+            new_idom = NULL;
+            for (j = 0; j < b->num_preds; j++) {
+                p = b->preds[j];
+                if (p->idom == NULL) {
+                    /* unreachable or not yet processed */
+                    continue;
+                }
+                new_idom = new_idom == NULL ? p :
+                                intersect_dominators(p, new_idom);
+            }
+            if (b->idom != new_idom) {
+                b->idom = new_idom;
+                changed = TRUE;
+            }
+        }
+    }
+    entry->idom = NULL;
+    for (i = 1; i < cfg->num_rpo; i++) {
+        b = cfg->rpo[i];
+        append_block(&b->idom->dom_children, &b->idom->num_dom_children, b);
+    }
+}
+
+BasicBlock *intersect_dominators(BasicBlock *b1, BasicBlock *b2) {
+    while (b1 != b2) {
+        while (b1->rpo > b2->rpo) {
+            b1 = b1->idom;
+        }
+        while (b2->rpo > b1->rpo) {
+            b2 = b2->idom;
+        }
+    }
+    return b1;
+}
+
+/* dominance frontiers of the reachable blocks, per Cooper et al. */
+void compute_dominance_frontiers(ControlFlowGraph *cfg) {
+    BasicBlock *b, *runner;
+    int i, j, k;
+    Boolean present;
+
+    for (i = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        free(b->dom_frontier);
+        b->dom_frontier = NULL;
+        b->num_dom_frontier = 0;
+    }
+    for (i = 0; i < cfg->num_rpo; i++) {
+        b = cfg->rpo[i];
+        if (b->num_preds < 2) {
+            continue;
+        }
+        for (j = 0; j < b->num_preds; j++) {
+            runner = b->preds[j];
+            if (runner->rpo == -1) {
+                continue;
+            }
+            while (runner != b->idom) {
+                present = FALSE;
+                for (k = 0; k < runner->num_dom_frontier; k++) {
+                    if (runner->dom_frontier[k] == b) {
+                        present = TRUE;
+                    }
+                }
+                if (!present) {
+                    append_block(&runner->dom_frontier,
+                                    &runner->num_dom_frontier, b);
+                }
+                runner = runner->idom;
+            }
+        }
+    }
+}
+
+/* does block a dominate block b? every block dominates itself */
+Boolean dominates(BasicBlock *a, BasicBlock *b) {
+    while (b != NULL) {
+        if (b == a) {
+            return TRUE;
+        }
+        b = b->idom;
+    }
+    return FALSE;
+}
+
+/*
+ * renumber_registers
+ * Purpose: close the gaps left in register numbering by deleted instructions
+ * Parameters:
+ *  cfg - ControlFlowGraph * - the procedure
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Registers are renumbered densely in order of first appearance.
+ *  Updates cfg->num_regs.
+ */
+void renumber_registers(ControlFlowGraph *cfg) {
+    int *map, *regs[MAX_USES + 1], *def;
+    int i, n, next = 0;
+    IrNode *irn;
+
+    util_emalloc((void **) &map, (cfg->num_regs + 1) * sizeof(int));
+    for (i = 0; i < cfg->num_regs; i++) {
+        map[i] = NO_ARG;
+    }
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = irn->next) {
+        n = ir_node_uses(irn, regs);
+        def = ir_node_def(irn);
+        if (def != NULL) {
+            regs[n++] = def;
+        }
+        for (i = 0; i < n; i++) {
+            if (*regs[i] == NO_ARG) {
+                continue;
+            }
+            if (map[*regs[i]] == NO_ARG) {
+                map[*regs[i]] = next++;
+            }
+            *regs[i] = map[*regs[i]];
+        }
+        for (i = 0; i < irn->num_phi_args; i++) {
+            if (map[irn->phi_args[i].reg] == NO_ARG) {
+                map[irn->phi_args[i].reg] = next++;
+            }
+            irn->phi_args[i].reg = map[irn->phi_args[i].reg];
+        }
+    }
+    free(map);
+    cfg->num_regs = next;
+}
+
+/* a register number not yet used in the procedure */
+int new_reg(ControlFlowGraph *cfg) {
+    return cfg->num_regs++;
+}
+
+int count_registers(ControlFlowGraph *cfg) {
+    int *uses[MAX_USES], *def;
+    int i, n, max = -1;
+    IrNode *irn;
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = irn->next) {
+        n = ir_node_uses(irn, uses);
+        for (i = 0; i < n; i++) {
+            max = *uses[i] > max ? *uses[i] : max;
+        }
+        for (i = 0; i < irn->num_phi_args; i++) {
+            max = irn->phi_args[i].reg > max ? irn->phi_args[i].reg : max;
+        }
+        def = ir_node_def(irn);
+        if (def != NULL) {
+            max = *def > max ? *def : max;
+        }
+    }
+    return max + 1;
+}
+
+/*
+ * remove_unreachable_blocks
+ * Purpose: delete blocks that cannot be reached from the procedure entry
+ * Parameters:
+ *  cfg - ControlFlowGraph * - the procedure
+ * Returns:
+ *  The number of IR nodes removed
+ * Side Effects:
+ *  Unlinks nodes from the IR list and rebuilds the CFG.
+ */
+int remove_unreachable_blocks(ControlFlowGraph *cfg) {
+    IrNode *irn, *next;
+    int removed = 0;
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = next) {
+        next = irn->next;
+        if (irn->bb->rpo == -1) {
+            remove_ir_node(irn, cfg->irl);
+            removed++;
+        }
+    }
+    if (removed > 0) {
+        build_blocks(cfg);
+    }
+    return removed;
+}
+
+/* the jump ending block b, or NULL if it falls through */
+IrNode *block_terminator(BasicBlock *b) {
+    return is_jump(b->last) ? b->last : NULL;
+}
+
+/* insert irn as the last node of b that executes before control leaves it */
+IrNode *insert_before_terminator(BasicBlock *b, IrNode *irn,
+                                    ControlFlowGraph *cfg) {
+    irn->bb = b;
+    if (block_terminator(b) != NULL) {
+        return insert_ir_node_before(b->last, irn, cfg->irl);
+    }
+    insert_ir_node_after(b->last, irn, cfg->irl);
+    b->last = irn;
+    return irn;
+}
+
+/* insert irn after the LABEL and any PHI nodes at the top of b */
+IrNode *insert_at_block_start(BasicBlock *b, IrNode *irn,
+                                    ControlFlowGraph *cfg) {
+    IrNode *pos = b->first;
+    while (pos != b->last && instruction(pos->next) == PHI) {
+        pos = pos->next;
+    }
+    irn->bb = b;
+    insert_ir_node_after(pos, irn, cfg->irl);
+    if (pos == b->last) {
+        b->last = irn;
+    }
+    return irn;
+}
+
+/* unlink a node other than the leading LABEL from its block */
+void remove_block_node(IrNode *irn, ControlFlowGraph *cfg) {
+    if (irn->bb->last == irn) {
+        irn->bb->last = irn->prev;
+    }
+    remove_ir_node(irn, cfg->irl);
+}
+
+/* position of pred among the predecessors of b, or -1 */
+int pred_index(BasicBlock *b, BasicBlock *pred) {
+    int i;
+    for (i = 0; i < b->num_preds; i++) {
+        if (b->preds[i] == pred) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void print_cfg(FILE *out, ControlFlowGraph *cfg) {
+    BasicBlock *b;
+    int i, j;
+    fprintf(out, "\n/*\n");
+    fprintf(out, " *** CFG \"%s\" ***\n", get_symbol_name(cfg->begin_proc->s));
+    for (i = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        fprintf(out, " * block %d (LABEL_%d)", b->id, b->first->LABIDX);
+        if (b->rpo == -1) {
+            fprintf(out, " unreachable");
+        } else if (b->idom != NULL) {
+            fprintf(out, " idom %d", b->idom->id);
+        }
+        fprintf(out, " succs:");
+        for (j = 0; j < b->num_succs; j++) {
+            fprintf(out, " %d", b->succs[j]->id);
+        }
+        fprintf(out, " df:");
+        for (j = 0; j < b->num_dom_frontier; j++) {
+            fprintf(out, " %d", b->dom_frontier[j]->id);
+        }
+        fprintf(out, "\n");
+    }
+    fprintf(out, " */\n");
+}
@@ -0,0 +1,951 @@
+/*
+ * Iterative bit vector dataflow analysis.
+ *
+ * A client describes its problem by a gen and a kill set for every block,
+ * a direction and a meet operation; the solver visits the blocks in reverse
+ * postorder (postorder for backward problems), re-evaluating only blocks
+ * whose inputs changed, until nothing changes.
+ *
+ * Dense sets operate a 64 bit word at a time, in plain loops the compiler
+ * can vectorize. When dense sets for every block of a procedure would take
+ * more memory than DF_DENSE_LIMIT bytes, as with hundreds of thousands of
+ * registers, the sets are kept sparse instead: most blocks see only a few
+ * of the registers.
+ *
+ * Liveness of registers, reaching definitions and available expressions
+ * are provided as clients, as is the splitting of registers into webs,
+ * which liveness drives.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-opt.h"
+#include "../include/ir-dataflow.h"
+#include "../include/utilities.h"
+
+#define BITS_PER_WORD 64
+#define DF_DENSE_LIMIT (16 * 1024 * 1024)
+#define EXPR_BUCKETS 1021
+
+enum df_representation dataflow_representation = DF_AUTO;
+
+/* file helper functions */
+int lowest_bit(uint64_t word);
+int count_bits(uint64_t word);
+int find_member(BitSet *set, int bit);
+void reserve_members(BitSet *set, int n);
+void set_members(BitSet *set, int *members, int n);
+BitSet **new_block_sets(Dataflow *df);
+void free_block_sets(Dataflow *df, BitSet **sets);
+void meet_into(Dataflow *df, BasicBlock *b, BitSet *target, Boolean *visited);
+unsigned int expr_hash(IrNode *irn);
+Boolean same_expr(IrNode *a, IrNode *b);
+Boolean is_expr(IrNode *irn);
+int add_expr(AvailableExprs *ae, IrNode *irn);
+int new_web(int **parent, int *num_webs);
+int find_web(int *parent, int web);
+
+
+/*
+ * new_bitset
+ * Purpose: create an empty set
+ * Parameters:
+ *  num_bits - int - members are below this
+ *  sparse - Boolean - keep a list of members instead of a bit per value
+ * Returns:
+ *  The set, to be freed with free_bitset
+ * Side Effects:
+ *  Allocates heap storage
+ */
+BitSet *new_bitset(int num_bits, Boolean sparse) {
+    BitSet *set;
+    util_emalloc((void **) &set, sizeof(BitSet));
+    set->num_bits = num_bits;
+    set->sparse = sparse;
+    set->words = NULL;
+    set->num_words = 0;
+    set->members = NULL;
+    set->num_members = 0;
+    set->capacity = 0;
+    if (!sparse) {
+        set->num_words = (num_bits + BITS_PER_WORD - 1) / BITS_PER_WORD;
+        util_emalloc((void **) &set->words,
+                        (set->num_words + 1) * sizeof(uint64_t));
+        bitset_clear(set);
+    }
+    return set;
+}
+
+void free_bitset(BitSet *set) {
+    free(set->words);
+    free(set->members);
+    free(set);
+}
+
+void bitset_add(BitSet *set, int bit) {
+    int i;
+    if (!set->sparse) {
+        set->words[bit / BITS_PER_WORD] |= (uint64_t) 1 << (bit % BITS_PER_WORD);
+        return;
+    }
+    i = find_member(set, bit);
+    if (i < set->num_members && set->members[i] == bit) {
+        return;
+    }
+    reserve_members(set, set->num_members + 1);
+    memmove(&set->members[i + 1], &set->members[i],
+            (set->num_members - i) * sizeof(int));
+    set->members[i] = bit;
+    set->num_members++;
+}
+
+void bitset_remove(BitSet *set, int bit) {
+    int i;
+    if (!set->sparse) {
+        set->words[bit / BITS_PER_WORD] &=
+                ~((uint64_t) 1 << (bit % BITS_PER_WORD));
+        return;
+    }
+    i = find_member(set, bit);
+    if (i < set->num_members && set->members[i] == bit) {
+        memmove(&set->members[i], &set->members[i + 1],
+                (set->num_members - i - 1) * sizeof(int));
+        set->num_members--;
+    }
+}
+
+Boolean bitset_contains(BitSet *set, int bit) {
+    int i;
+    if (bit < 0 || bit >= set->num_bits) {
+        return FALSE;
+    }
+    if (!set->sparse) {
+        return (set->words[bit / BITS_PER_WORD] >> (bit % BITS_PER_WORD)) & 1;
+    }
+    i = find_member(set, bit);
+    return i < set->num_members && set->members[i] == bit;
+}
+
+/* the least member of set not below bit, NO_ARG if there is none */
+int bitset_next(BitSet *set, int bit) {
+    int w;
+    uint64_t word;
+    if (bit >= set->num_bits) {
+        return NO_ARG;
+    }
+    if (set->sparse) {
+        w = find_member(set, bit);
+        return w < set->num_members ? set->members[w] : NO_ARG;
+    }
+    w = bit / BITS_PER_WORD;
+    word = set->words[w] & (~(uint64_t) 0 << (bit % BITS_PER_WORD));
+    while (word == 0) {
+        if (++w >= set->num_words) {
+            return NO_ARG;
+        }
+        word = set->words[w];
+    }
+    return w * BITS_PER_WORD + lowest_bit(word);
+}
+
+int bitset_count(BitSet *set) {
+    int i, n = 0;
+    if (set->sparse) {
+        return set->num_members;
+    }
+    for (i = 0; i < set->num_words; i++) {
+        n += count_bits(set->words[i]);
+    }
+    return n;
+}
+
+void bitset_clear(BitSet *set) {
+    int i;
+    for (i = 0; i < set->num_words; i++) {
+        set->words[i] = 0;
+    }
+    set->num_members = 0;
+}
+
+/* make every value below num_bits a member */
+void bitset_fill(BitSet *set) {
+    int i;
+    if (set->sparse) {
+        reserve_members(set, set->num_bits);
+        for (i = 0; i < set->num_bits; i++) {
+            set->members[i] = i;
+        }
+        set->num_members = set->num_bits;
+        return;
+    }
+    for (i = 0; i < set->num_words; i++) {
+        set->words[i] = ~(uint64_t) 0;
+    }
+    if (set->num_bits % BITS_PER_WORD != 0) {
+        set->words[set->num_words - 1] =
+                ((uint64_t) 1 << (set->num_bits % BITS_PER_WORD)) - 1;
+    }
+}
+
+/* the sets of the operations below must have the same representation */
+void bitset_copy(BitSet *dst, BitSet *src) {
+    int i;
+    if (dst->sparse) {
+        set_members(dst, src->members, src->num_members);
+        return;
+    }
+    for (i = 0; i < dst->num_words; i++) {
+        dst->words[i] = src->words[i];
+    }
+}
+
+Boolean bitset_equal(BitSet *a, BitSet *b) {
+    int i;
+    if (a->sparse) {
+        return a->num_members == b->num_members &&
+                !memcmp(a->members, b->members, a->num_members * sizeof(int));
+    }
+    for (i = 0; i < a->num_words; i++) {
+        if (a->words[i] != b->words[i]) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* dst |= src, TRUE if dst changed */
+Boolean bitset_union(BitSet *dst, BitSet *src) {
+    int i, j, n;
+    int *merged;
+    uint64_t word, diff = 0;
+
+    if (!dst->sparse) {
+        for (i = 0; i < dst->num_words; i++) {
+            word = dst->words[i] | src->words[i];
+            diff |= word ^ dst->words[i];
+            dst->words[i] = word;
+        }
+        return diff != 0;
+    }
+    util_emalloc((void **) &merged,
+                    (dst->num_members + src->num_members + 1) * sizeof(int));
+    for (i = 0, j = 0, n = 0; i < dst->num_members || j < src->num_members;) {
+        if (j == src->num_members || (i < dst->num_members &&
+                    dst->members[i] < src->members[j])) {
+            merged[n++] = dst->members[i++];
+        } else if (i == dst->num_members ||
+                    src->members[j] < dst->members[i]) {
+            merged[n++] = src->members[j++];
+        } else {
+            merged[n++] = dst->members[i++];
+            j++;
+        }
+    }
+    if (n == dst->num_members) {
+        free(merged);
+        return FALSE;
+    }
+    free(dst->members);
+    dst->members = merged;
+    dst->num_members = n;
+    dst->capacity = n;
+    return TRUE;
+}
+
+/* dst &= src, TRUE if dst changed */
+Boolean bitset_intersect(BitSet *dst, BitSet *src) {
+    int i, j, n;
+    uint64_t word, diff = 0;
+
+    if (!dst->sparse) {
+        for (i = 0; i < dst->num_words; i++) {
+            word = dst->words[i] & src->words[i];
+            diff |= word ^ dst->words[i];
+            dst->words[i] = word;
+        }
+        return diff != 0;
+    }
+    for (i = 0, j = 0, n = 0; i < dst->num_members; i++) {
+        while (j < src->num_members && src->members[j] < dst->members[i]) {
+            j++;
+        }
+        if (j < src->num_members && src->members[j] == dst->members[i]) {
+            dst->members[n++] = dst->members[i];
+        }
+    }
+    if (n == dst->num_members) {
+        return FALSE;
+    }
+    dst->num_members = n;
+    return TRUE;
+}
+
+/*
+ * bitset_transfer
+ * Purpose: apply a block's transfer function
+ * Parameters:
+ *  out - BitSet * - set to gen | (in - kill)
+ *  in, gen, kill - BitSet * - sets of the same representation as out
+ * Returns:
+ *  TRUE if out changed
+ */
+Boolean bitset_transfer(BitSet *out, BitSet *in, BitSet *gen, BitSet *kill) {
+    int i, j, k, n;
+    int *result;
+    uint64_t word, diff = 0;
+
+    if (!out->sparse) {
+        for (i = 0; i < out->num_words; i++) {
+            word = gen->words[i] | (in->words[i] & ~kill->words[i]);
+            diff |= word ^ out->words[i];
+            out->words[i] = word;
+        }
+        return diff != 0;
+    }
+
+    /* merge gen with the members of in missing from kill */
+    util_emalloc((void **) &result,
+                    (in->num_members + gen->num_members + 1) * sizeof(int));
+    for (i = 0, j = 0, k = 0, n = 0; i < in->num_members; i++) {
+        while (k < kill->num_members && kill->members[k] < in->members[i]) {
+            k++;
+        }
+        if (k < kill->num_members && kill->members[k] == in->members[i]) {
+            continue;
+        }
+        while (j < gen->num_members && gen->members[j] < in->members[i]) {
+            result[n++] = gen->members[j++];
+        }
+        if (j < gen->num_members && gen->members[j] == in->members[i]) {
+            j++;
+        }
+        result[n++] = in->members[i];
+    }
+    while (j < gen->num_members) {
+        result[n++] = gen->members[j++];
+    }
+    if (n == out->num_members &&
+            !memcmp(result, out->members, n * sizeof(int))) {
+        free(result);
+        return FALSE;
+    }
+    free(out->members);
+    out->members = result;
+    out->num_members = n;
+    out->capacity = in->num_members + gen->num_members + 1;
+    return TRUE;
+}
+
+int lowest_bit(uint64_t word) {
+#ifdef __GNUC__
+    return __builtin_ctzll(word);
+#else
+    int n = 0;
+    while (!(word & 1)) {
+        word >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+int count_bits(uint64_t word) {
+#ifdef __GNUC__
+    return __builtin_popcountll(word);
+#else
+    int n = 0;
+    for (; word != 0; word &= word - 1) {
+        n++;
+    }
+    return n;
+#endif
+}
+
+/* the index of the first member of a sparse set not below bit */
+int find_member(BitSet *set, int bit) {
+    int lo = 0, hi = set->num_members, mid;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (set->members[mid] < bit) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void reserve_members(BitSet *set, int n) {
+    if (n <= set->capacity) {
+        return;
+    }
+    set->capacity = n > 2 * set->capacity ? n : 2 * set->capacity;
+    util_erealloc((void **) &set->members, set->capacity * sizeof(int));
+}
+
+void set_members(BitSet *set, int *members, int n) {
+    reserve_members(set, n);
+    if (n > 0) {
+        memcpy(set->members, members, n * sizeof(int));
+    }
+    set->num_members = n;
+}
+
+/*
+ * new_dataflow
+ * Purpose: set up a dataflow problem with empty gen and kill sets
+ * Parameters:
+ *  cfg - ControlFlowGraph * - the procedure
+ *  direction - enum df_direction - which way facts flow along edges
+ *  meet - enum df_meet - DF_UNION where a fact holding on some path
+ *         holds, DF_INTERSECTION where it must hold on every path
+ *  num_bits - int - the number of facts
+ * Returns:
+ *  The problem, to be given gen and kill sets and solved
+ * Side Effects:
+ *  Allocates heap storage, freed with free_dataflow
+ */
+Dataflow *new_dataflow(ControlFlowGraph *cfg, enum df_direction direction,
+                        enum df_meet meet, int num_bits) {
+    Dataflow *df;
+    double dense_bytes;
+
+    util_emalloc((void **) &df, sizeof(Dataflow));
+    df->cfg = cfg;
+    df->direction = direction;
+    df->meet = meet;
+    df->num_bits = num_bits;
+    dense_bytes = 4.0 * cfg->num_blocks * (num_bits / 8 + 8);
+    df->sparse = dataflow_representation == DF_SPARSE ||
+                    (dataflow_representation == DF_AUTO &&
+                     dense_bytes > DF_DENSE_LIMIT);
+    df->gen = new_block_sets(df);
+    df->kill = new_block_sets(df);
+    df->in = new_block_sets(df);
+    df->out = new_block_sets(df);
+    df->visits = 0;
+    return df;
+}
+
+/*
+ * solve_dataflow
+ * Purpose: find the maximal fixed point of a dataflow problem
+ * Parameters:
+ *  df - Dataflow * - the problem, with its gen and kill sets filled in
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Sets the in and out sets of the reachable blocks. A block without
+ *  predecessors (successors, for a backward problem) meets to the empty
+ *  set. Unreachable blocks keep empty sets and are ignored by the meet,
+ *  as are blocks not yet visited: their sets would start out as the
+ *  identity of the meet, which for an intersection is every fact.
+ */
+void solve_dataflow(Dataflow *df) {
+    ControlFlowGraph *cfg = df->cfg;
+    Boolean *pending, *visited, any;
+    BasicBlock *b, **next;
+    BitSet *meet_set, *result;
+    int i, k, num_next;
+
+    util_emalloc((void **) &pending, (cfg->num_blocks + 1) * sizeof(Boolean));
+    util_emalloc((void **) &visited, (cfg->num_blocks + 1) * sizeof(Boolean));
+    for (i = 0; i < cfg->num_blocks; i++) {
+        pending[i] = cfg->blocks[i]->rpo != -1;
+        visited[i] = FALSE;
+    }
+
+    do {
+        any = FALSE;
+        for (k = 0; k < cfg->num_rpo; k++) {
+            b = cfg->rpo[df->direction == DF_FORWARD ? k : cfg->num_rpo - 1 - k];
+            if (!pending[b->id]) {
+                continue;
+            }
+            pending[b->id] = FALSE;
+            df->visits++;
+            if (df->direction == DF_FORWARD) {
+                meet_set = df->in[b->id];
+                result = df->out[b->id];
+                next = b->succs;
+                num_next = b->num_succs;
+            } else {
+                meet_set = df->out[b->id];
+                result = df->in[b->id];
+                next = b->preds;
+                num_next = b->num_preds;
+            }
+            meet_into(df, b, meet_set, visited);
+            visited[b->id] = TRUE;
+            if (bitset_transfer(result, meet_set, df->gen[b->id],
+                                df->kill[b->id])) {
+                for (i = 0; i < num_next; i++) {
+                    if (next[i]->rpo != -1) {
+                        pending[next[i]->id] = TRUE;
+                        any = TRUE;
+                    }
+                }
+            }
+        }
+    } while (any);
+    free(pending);
+    free(visited);
+}
+
+/* combine the sets flowing into b along its edges from visited blocks */
+void meet_into(Dataflow *df, BasicBlock *b, BitSet *target, Boolean *visited) {
+    BasicBlock **from;
+    BitSet **sets;
+    int i, n;
+    Boolean first = TRUE;
+
+    if (df->direction == DF_FORWARD) {
+        from = b->preds;
+        n = b->num_preds;
+        sets = df->out;
+    } else {
+        from = b->succs;
+        n = b->num_succs;
+        sets = df->in;
+    }
+    for (i = 0; i < n; i++) {
+        if (from[i]->rpo == -1 || !visited[from[i]->id]) {
+            continue;
+        }
+        if (first) {
+            bitset_copy(target, sets[from[i]->id]);
+            first = FALSE;
+        } else if (df->meet == DF_UNION) {
+            bitset_union(target, sets[from[i]->id]);
+        } else {
+            bitset_intersect(target, sets[from[i]->id]);
+        }
+    }
+    if (first) {
+        bitset_clear(target);
+    }
+}
+
+void free_dataflow(Dataflow *df) {
+    free_block_sets(df, df->gen);
+    free_block_sets(df, df->kill);
+    free_block_sets(df, df->in);
+    free_block_sets(df, df->out);
+    free(df);
+}
+
+/* an empty set for each block of the problem */
+BitSet **new_block_sets(Dataflow *df) {
+    BitSet **sets;
+    int i;
+    util_emalloc((void **) &sets, (df->cfg->num_blocks + 1) * sizeof(BitSet *));
+    for (i = 0; i < df->cfg->num_blocks; i++) {
+        sets[i] = new_bitset(df->num_bits, df->sparse);
+    }
+    return sets;
+}
+
+void free_block_sets(Dataflow *df, BitSet **sets) {
+    int i;
+    for (i = 0; i < df->cfg->num_blocks; i++) {
+        free_bitset(sets[i]);
+    }
+    free(sets);
+}
+
+/*
+ * compute_liveness
+ * Purpose: find the registers live on entry to and exit from each block
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure not in SSA form
+ * Returns:
+ *  The solved problem: in and out are the registers live into and out of
+ *  each block. Free with free_dataflow.
+ * Side Effects:
+ *  Allocates heap storage
+ */
+Dataflow *compute_liveness(ControlFlowGraph *cfg) {
+    Dataflow *df = new_dataflow(cfg, DF_BACKWARD, DF_UNION, cfg->num_regs);
+    BasicBlock *b;
+    IrNode *irn;
+    int *uses[MAX_USES], *def;
+    int i, j, n;
+
+    /* gen: read in the block before any write; kill: written */
+    for (i = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        FOR_EACH_BLOCK_NODE(irn, b) {
+            n = ir_node_uses(irn, uses);
+            for (j = 0; j < n; j++) {
+                if (*uses[j] != NO_ARG && !bitset_contains(df->kill[i], *uses[j])) {
+                    bitset_add(df->gen[i], *uses[j]);
+                }
+            }
+            def = ir_node_def(irn);
+            if (def != NULL && *def != NO_ARG) {
+                bitset_add(df->kill[i], *def);
+            }
+        }
+    }
+    solve_dataflow(df);
+    return df;
+}
+
+/*
+ * split_webs
+ * Purpose: give each web, the definitions and uses of a register linked
+ *          through the blocks where it is live, a register of its own
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure not in SSA form
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Renumbers the registers of the procedure densely. A register reused for
+ *  unrelated values gets one per value, while one defined on each path into
+ *  a block where it is live keeps a single register for all of them.
+ */
+void split_webs(ControlFlowGraph *cfg) {
+    Dataflow *lv = compute_liveness(cfg);
+    int **in_web, *cur, *parent = NULL, num_webs = 0;
+    int *uses[MAX_USES + 1], *def;  /* and the def */
+    int i, j, k, r, n;
+    BasicBlock *b, *s;
+    IrNode *irn;
+
+    util_emalloc((void **) &in_web, (cfg->num_blocks + 1) * sizeof(int *));
+    util_emalloc((void **) &cur, (cfg->num_regs + 1) * sizeof(int));
+    for (i = 0; i < cfg->num_blocks; i++) {
+        util_emalloc((void **) &in_web[i], (cfg->num_regs + 1) * sizeof(int));
+        for (r = 0; r < cfg->num_regs; r++) {
+            in_web[i][r] = NO_ARG;
+        }
+        FOR_EACH_BIT(r, lv->in[i]) {
+            in_web[i][r] = new_web(&parent, &num_webs);
+        }
+    }
+
+    /* registers are overwritten with web numbers, joined at block edges */
+    for (i = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        for (r = 0; r < cfg->num_regs; r++) {
+            cur[r] = in_web[i][r];
+        }
+        FOR_EACH_BLOCK_NODE(irn, b) {
+            n = ir_node_uses(irn, uses);
+            for (j = 0; j < n; j++) {
+                if (*uses[j] == NO_ARG) {
+                    continue;
+                }
+                if (cur[*uses[j]] == NO_ARG) {
+                    cur[*uses[j]] = new_web(&parent, &num_webs);
+                }
+                *uses[j] = cur[*uses[j]];
+            }
+            def = ir_node_def(irn);
+            if (def != NULL && *def != NO_ARG) {
+                cur[*def] = new_web(&parent, &num_webs);
+                *def = cur[*def];
+            }
+        }
+        for (j = 0; j < b->num_succs; j++) {
+            s = b->succs[j];
+            FOR_EACH_BIT(r, lv->in[s->id]) {
+                if (cur[r] != NO_ARG) {
+                    k = find_web(parent, cur[r]);
+                    parent[k] = find_web(parent, in_web[s->id][r]);
+                }
+            }
+        }
+    }
+
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = irn->next) {
+        n = ir_node_uses(irn, uses);
+        def = ir_node_def(irn);
+        if (def != NULL) {
+            uses[n++] = def;
+        }
+        for (j = 0; j < n; j++) {
+            if (*uses[j] != NO_ARG) {
+                *uses[j] = find_web(parent, *uses[j]);
+            }
+        }
+    }
+    for (i = 0; i < cfg->num_blocks; i++) {
+        free(in_web[i]);
+    }
+    free(in_web);
+    free(cur);
+    free(parent);
+    free_dataflow(lv);
+    cfg->num_regs = num_webs;
+    renumber_registers(cfg);
+}
+
+int new_web(int **parent, int *num_webs) {
+    util_erealloc((void **) parent, (*num_webs + 1) * sizeof(int));
+    (*parent)[*num_webs] = *num_webs;
+    return (*num_webs)++;
+}
+
+int find_web(int *parent, int web) {
+    while (parent[web] != web) {
+        parent[web] = parent[parent[web]];
+        web = parent[web];
+    }
+    return web;
+}
+
+/*
+ * compute_reaching_defs
+ * Purpose: find the register definitions that may reach each block
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure not in SSA form
+ * Returns:
+ *  The definitions and the solved problem, whose in and out sets hold the
+ *  definitions reaching the start and end of each block. Free with
+ *  free_reaching_defs.
+ * Side Effects:
+ *  Allocates heap storage
+ */
+ReachingDefs *compute_reaching_defs(ControlFlowGraph *cfg) {
+    ReachingDefs *rd;
+    IrNode *irn;
+    BasicBlock *b;
+    int **defs_of, *num_defs_of, *last, *def;
+    int i, j, r;
+
+    util_emalloc((void **) &rd, sizeof(ReachingDefs));
+    rd->defs = NULL;
+    rd->num_defs = 0;
+    util_emalloc((void **) &num_defs_of, (cfg->num_regs + 1) * sizeof(int));
+    util_emalloc((void **) &defs_of, (cfg->num_regs + 1) * sizeof(int *));
+    util_emalloc((void **) &last, (cfg->num_regs + 1) * sizeof(int));
+    for (r = 0; r < cfg->num_regs; r++) {
+        num_defs_of[r] = 0;
+        defs_of[r] = NULL;
+        last[r] = NO_ARG;
+    }
+    for (i = 0; i < cfg->num_blocks; i++) {
+        FOR_EACH_BLOCK_NODE(irn, cfg->blocks[i]) {
+            def = ir_node_def(irn);
+            if (def == NULL || *def == NO_ARG) {
+                continue;
+            }
+            util_erealloc((void **) &rd->defs,
+                            (rd->num_defs + 1) * sizeof(IrNode *));
+            util_erealloc((void **) &defs_of[*def],
+                            (num_defs_of[*def] + 1) * sizeof(int));
+            defs_of[*def][num_defs_of[*def]++] = rd->num_defs;
+            rd->defs[rd->num_defs++] = irn;
+        }
+    }
+
+    /* gen: the last definition of each register in the block; kill: all
+     * definitions of the registers the block defines */
+    rd->df = new_dataflow(cfg, DF_FORWARD, DF_UNION, rd->num_defs);
+    for (i = 0, j = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        FOR_EACH_BLOCK_NODE(irn, b) {
+            def = ir_node_def(irn);
+            if (def == NULL || *def == NO_ARG) {
+                continue;
+            }
+            if (last[*def] == NO_ARG) {
+                for (r = 0; r < num_defs_of[*def]; r++) {
+                    bitset_add(rd->df->kill[i], defs_of[*def][r]);
+                }
+            } else {
+                bitset_remove(rd->df->gen[i], last[*def]);
+            }
+            last[*def] = j;
+            bitset_add(rd->df->gen[i], j++);
+        }
+        FOR_EACH_BLOCK_NODE(irn, b) {
+            def = ir_node_def(irn);
+            if (def != NULL && *def != NO_ARG) {
+                last[*def] = NO_ARG;
+            }
+        }
+    }
+    solve_dataflow(rd->df);
+
+    for (r = 0; r < cfg->num_regs; r++) {
+        free(defs_of[r]);
+    }
+    free(defs_of);
+    free(num_defs_of);
+    free(last);
+    return rd;
+}
+
+void free_reaching_defs(ReachingDefs *rd) {
+    free_dataflow(rd->df);
+    free(rd->defs);
+    free(rd);
+}
+
+/*
+ * compute_available_exprs
+ * Purpose: find the expressions available on entry to and exit from each
+ *          block
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure not in SSA form
+ * Returns:
+ *  The expressions and the solved problem. Free with free_available_exprs.
+ * Side Effects:
+ *  Allocates heap storage
+ */
+AvailableExprs *compute_available_exprs(ControlFlowGraph *cfg) {
+    AvailableExprs *ae;
+    BasicBlock *b;
+    IrNode *irn;
+    int **users, *num_users, *loads = NULL, num_loads = 0;
+    int *uses[MAX_USES], *def;
+    int i, j, e, n;
+
+    util_emalloc((void **) &ae, sizeof(AvailableExprs));
+    ae->exprs = NULL;
+    ae->num_exprs = 0;
+    ae->chain = NULL;
+    util_emalloc((void **) &ae->buckets, EXPR_BUCKETS * sizeof(int));
+    for (i = 0; i < EXPR_BUCKETS; i++) {
+        ae->buckets[i] = NO_ARG;
+    }
+
+    /* number the expressions, noting those reading each register */
+    util_emalloc((void **) &users, (cfg->num_regs + 1) * sizeof(int *));
+    util_emalloc((void **) &num_users, (cfg->num_regs + 1) * sizeof(int));
+    for (i = 0; i < cfg->num_regs; i++) {
+        users[i] = NULL;
+        num_users[i] = 0;
+    }
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = irn->next) {
+        if (!is_expr(irn) || find_expr(ae, irn) != NO_ARG) {
+            continue;
+        }
+        e = add_expr(ae, irn);
+        n = ir_node_uses(irn, uses);
+        for (j = 0; j < n; j++) {
+            if (*uses[j] == NO_ARG ||
+                    (j == 1 && *uses[1] == *uses[0])) {
+                continue;
+            }
+            util_erealloc((void **) &users[*uses[j]],
+                            (num_users[*uses[j]] + 1) * sizeof(int));
+            users[*uses[j]][num_users[*uses[j]]++] = e;
+        }
+        if (!is_binary_op(irn) && !is_unary_op(irn) &&
+                instruction(irn) != ADD_CONST) {
+            util_erealloc((void **) &loads, (num_loads + 1) * sizeof(int));
+            loads[num_loads++] = e;
+        }
+    }
+
+    /* gen: computed and not killed after; kill: an operand or memory is
+     * written */
+    ae->df = new_dataflow(cfg, DF_FORWARD, DF_INTERSECTION, ae->num_exprs);
+    for (i = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        FOR_EACH_BLOCK_NODE(irn, b) {
+            if (is_expr(irn)) {
+                bitset_add(ae->df->gen[i], find_expr(ae, irn));
+            }
+            def = ir_node_def(irn);
+            if (def != NULL && *def != NO_ARG) {
+                for (j = 0; j < num_users[*def]; j++) {
+                    bitset_remove(ae->df->gen[i], users[*def][j]);
+                    bitset_add(ae->df->kill[i], users[*def][j]);
+                }
+            }
+            if (writes_memory(irn)) {
+                for (j = 0; j < num_loads; j++) {
+                    bitset_remove(ae->df->gen[i], loads[j]);
+                    bitset_add(ae->df->kill[i], loads[j]);
+                }
+            }
+        }
+    }
+    solve_dataflow(ae->df);
+
+    for (i = 0; i < cfg->num_regs; i++) {
+        free(users[i]);
+    }
+    free(users);
+    free(num_users);
+    free(loads);
+    return ae;
+}
+
+/* the number of the expression irn computes, NO_ARG if it computes none */
+int find_expr(AvailableExprs *ae, IrNode *irn) {
+    int e;
+    if (!is_expr(irn)) {
+        return NO_ARG;
+    }
+    for (e = ae->buckets[expr_hash(irn) % EXPR_BUCKETS]; e != NO_ARG;
+            e = ae->chain[e]) {
+        if (same_expr(ae->exprs[e], irn)) {
+            return e;
+        }
+    }
+    return NO_ARG;
+}
+
+void free_available_exprs(AvailableExprs *ae) {
+    free_dataflow(ae->df);
+    free(ae->exprs);
+    free(ae->buckets);
+    free(ae->chain);
+    free(ae);
+}
+
+int add_expr(AvailableExprs *ae, IrNode *irn) {
+    unsigned int bucket = expr_hash(irn) % EXPR_BUCKETS;
+    util_erealloc((void **) &ae->exprs, (ae->num_exprs + 1) * sizeof(IrNode *));
+    util_erealloc((void **) &ae->chain, (ae->num_exprs + 1) * sizeof(int));
+    ae->exprs[ae->num_exprs] = irn;
+    ae->chain[ae->num_exprs] = ae->buckets[bucket];
+    ae->buckets[bucket] = ae->num_exprs;
+    return ae->num_exprs++;
+}
+
+/* instructions computing a value from registers alone, or loads */
+Boolean is_expr(IrNode *irn) {
+    switch (instruction(irn)) {
+        case ADD_CONST:
+        case LOAD_BYTE_INDIRECT:
+        case LOAD_UNSIGNED_BYTE_INDIRECT:
+        case LOAD_HALF_WORD_INDIRECT:
+        case LOAD_UNSIGNED_HALF_WORD_INDIRECT:
+        case LOAD_WORD_INDIRECT:
+            return TRUE;
+        default:
+            return is_binary_op(irn) || is_unary_op(irn);
+    }
+}
+
+unsigned int expr_hash(IrNode *irn) {
+    unsigned int h = instruction(irn);
+    if (is_binary_op(irn)) {
+        h = h * 31 + (unsigned int) irn->OPRND1;
+        h = h * 31 + (unsigned int) irn->OPRND2;
+    } else {
+        h = h * 31 + (unsigned int) irn->RSRC;
+        h = h * 31 + (unsigned int) irn->IMMVAL;
+    }
+    return h;
+}
+
+Boolean same_expr(IrNode *a, IrNode *b) {
+    if (instruction(a) != instruction(b)) {
+        return FALSE;
+    }
+    if (is_binary_op(a)) {
+        return a->OPRND1 == b->OPRND1 && a->OPRND2 == b->OPRND2;
+    }
+    return a->RSRC == b->RSRC &&
+            (instruction(a) != ADD_CONST || a->IMMVAL == b->IMMVAL);
+}
@@ -0,0 +1,114 @@
+/*
+ * Liveness-driven dead code elimination over a procedure outside SSA form.
+ *
+ * An instruction whose only effect is to define a register is dead when the
+ * register is not live after it. Removing one dead instruction can kill the
+ * instructions computing its operands, so the pass repeats until nothing
+ * more is removed. Blocks no longer reachable from the entry, such as code
+ * following a return, are removed first.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-opt.h"
+#include "../include/ir-dataflow.h"
+#include "../include/utilities.h"
+
+/* file helper functions */
+int sweep_block(Dataflow *lv, BasicBlock *b);
+
+
+/*
+ * eliminate_dead_code
+ * Purpose: remove unreachable blocks and instructions whose results are
+ *          never used
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure not in SSA form
+ * Returns:
+ *  The number of IR nodes removed
+ * Side Effects:
+ *  Unlinks nodes from the IR list and rebuilds the CFG if any were removed.
+ */
+int eliminate_dead_code(ControlFlowGraph *cfg) {
+    Dataflow *lv;
+    int i, swept, removed;
+
+    removed = remove_unreachable_blocks(cfg);
+    do {
+        lv = compute_liveness(cfg);
+        swept = 0;
+        for (i = 0; i < cfg->num_rpo; i++) {
+            swept += sweep_block(lv, cfg->rpo[i]);
+        }
+        free_dataflow(lv);
+        removed += swept;
+    } while (swept > 0);
+    return removed;
+}
+
+/*
+ * has_side_effects
+ * Purpose: tell whether an instruction does more than define a register
+ * Parameters:
+ *  irn - IrNode * - the instruction
+ * Returns:
+ *  TRUE for stores, calls and their arguments, control flow and procedure
+ *  markers; FALSE for instructions that may be deleted when their result
+ *  is unused
+ */
+Boolean has_side_effects(IrNode *irn) {
+    switch (instruction(irn)) {
+        case LOAD_ADDRESS:
+        case LOAD_CONSTANT:
+        case LOAD_BYTE_INDIRECT:
+        case LOAD_UNSIGNED_BYTE_INDIRECT:
+        case LOAD_HALF_WORD_INDIRECT:
+        case LOAD_UNSIGNED_HALF_WORD_INDIRECT:
+        case LOAD_WORD_INDIRECT:
+        case LOAD_WORD:
+        case RETURNED_WORD:
+        case RECEIVED_PARAM:
+        case ADD_CONST:
+        case MOVE:
+        case SELECT:
+            return FALSE;
+        default:
+            return !(is_binary_op(irn) || is_unary_op(irn));
+    }
+}
+
+/* delete the dead instructions of b, walking backward from its live out */
+int sweep_block(Dataflow *lv, BasicBlock *b) {
+    int *uses[MAX_USES], *def;
+    BitSet *live = new_bitset(lv->num_bits, lv->sparse);
+    IrNode *irn, *prev;
+    int i, n, removed = 0;
+
+    bitset_copy(live, lv->out[b->id]);
+    for (irn = b->last; irn != b->first; irn = prev) {
+        prev = irn->prev;
+        def = ir_node_def(irn);
+        if (def != NULL && *def == NO_ARG) {
+            def = NULL;
+        }
+        if (def != NULL && !bitset_contains(live, *def) &&
+                !has_side_effects(irn)) {
+            remove_block_node(irn, lv->cfg);
+            removed++;
+            continue;
+        }
+        if (def != NULL) {
+            bitset_remove(live, *def);
+        }
+        n = ir_node_uses(irn, uses);
+        for (i = 0; i < n; i++) {
+            if (*uses[i] != NO_ARG) {
+                bitset_add(live, *uses[i]);
+            }
+        }
+    }
+    free_bitset(live);
+    return removed;
+}
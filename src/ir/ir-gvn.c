@@ -0,0 +1,302 @@
+/*
+ * Dominator-scoped value numbering over a procedure in SSA form.
+ *
+ * Each instruction computing a value is hashed on its operation and the
+ * value numbers of its operands. Walking the dominator tree, an instruction
+ * whose key is already in the table recomputes a value held in a register
+ * defined in a dominating block, so its uses are redirected to that register
+ * and it is deleted. Entries made in a block are dropped when the walk
+ * leaves the block's subtree.
+ *
+ * Memory is not in SSA form, so loads are numbered only within a block and
+ * only until the next store or call: their keys carry a memory generation
+ * that changes at every block entry and at every instruction that may
+ * write memory.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-opt.h"
+#include "../include/utilities.h"
+
+#define GVN_BUCKETS 211
+
+/*
+ * the key of a value computed by an instruction, and the register holding
+ * it. registers in the key are value numbers, i.e. already substituted.
+ */
+struct ValueEntry {
+    enum ir_instruction instr;
+    int op1;
+    int op2;
+    int imm;
+    Symbol *s;
+    int mem;                    /* memory generation, loads only */
+    int reg;
+    struct ValueEntry *next;    /* hash chain */
+};
+typedef struct ValueEntry ValueEntry;
+
+struct ValueTable {
+    ControlFlowGraph *cfg;
+    ValueEntry *buckets[GVN_BUCKETS];
+    ValueEntry **scope;         /* entries in insertion order */
+    int num_scope;
+    int *subst;                 /* register -> register holding its value */
+    int mem;
+    int removed;
+};
+typedef struct ValueTable ValueTable;
+
+/* file helper functions */
+void number_block(ValueTable *vt, BasicBlock *b);
+Boolean value_key(ValueTable *vt, IrNode *irn, ValueEntry *key);
+unsigned int value_hash(ValueEntry *key);
+ValueEntry *find_value(ValueTable *vt, ValueEntry *key);
+void add_value(ValueTable *vt, ValueEntry *key);
+int value_number(ValueTable *vt, int reg);
+Boolean is_commutative(enum ir_instruction instr);
+void substitute_uses(ValueTable *vt);
+
+
+/*
+ * number_values
+ * Purpose: remove instructions that recompute a value already available in
+ *          a register
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure in SSA form
+ * Returns:
+ *  The number of instructions removed
+ * Side Effects:
+ *  Uses of the registers defined by removed instructions, including PHI
+ *  arguments, are rewritten to the registers holding the same values.
+ *  Copies between registers are propagated and removed as well.
+ */
+int number_values(ControlFlowGraph *cfg) {
+    ValueTable vt;
+    int i;
+
+    vt.cfg = cfg;
+    for (i = 0; i < GVN_BUCKETS; i++) {
+        vt.buckets[i] = NULL;
+    }
+    vt.scope = NULL;
+    vt.num_scope = 0;
+    util_emalloc((void **) &vt.subst, (cfg->num_regs + 1) * sizeof(int));
+    for (i = 0; i < cfg->num_regs; i++) {
+        vt.subst[i] = i;
+    }
+    vt.mem = 0;
+    vt.removed = 0;
+
+    number_block(&vt, cfg->rpo[0]);
+    if (vt.removed > 0) {
+        substitute_uses(&vt);
+    }
+    free(vt.subst);
+    free(vt.scope);
+    return vt.removed;
+}
+
+/* number the values of b, then of the blocks it dominates */
+void number_block(ValueTable *vt, BasicBlock *b) {
+    ValueEntry key, *found;
+    IrNode *irn, *next;
+    int i, *uses[MAX_USES], n, scope_start = vt->num_scope;
+
+    vt->mem++;
+    for (irn = b->first; irn != NULL; irn = next) {
+        next = irn == b->last ? NULL : irn->next;
+        if (writes_memory(irn)) {
+            vt->mem++;
+        }
+        /* operands take the value numbers of the registers they read */
+        n = ir_node_uses(irn, uses);
+        for (i = 0; i < n; i++) {
+            *uses[i] = value_number(vt, *uses[i]);
+        }
+        if (ir_node_def(irn) == NULL || irn->RDEST == NO_ARG) {
+            continue;
+        }
+        if (instruction(irn) == MOVE) {
+            vt->subst[irn->RDEST] = irn->RSRC;
+            remove_block_node(irn, vt->cfg);
+            vt->removed++;
+            continue;
+        }
+        if (!value_key(vt, irn, &key)) {
+            continue;
+        }
+        found = find_value(vt, &key);
+        if (found != NULL) {
+            vt->subst[irn->RDEST] = found->reg;
+            remove_block_node(irn, vt->cfg);
+            vt->removed++;
+        } else {
+            key.reg = irn->RDEST;
+            add_value(vt, &key);
+        }
+    }
+
+    for (i = 0; i < b->num_dom_children; i++) {
+        number_block(vt, b->dom_children[i]);
+    }
+
+    /* entries are pushed at the heads of their chains, so pop in reverse */
+    while (vt->num_scope > scope_start) {
+        found = vt->scope[--vt->num_scope];
+        vt->buckets[value_hash(found) % GVN_BUCKETS] = found->next;
+        free(found);
+    }
+}
+
+/* fill in the key of the value irn computes, FALSE if it is not numbered */
+Boolean value_key(ValueTable *vt, IrNode *irn, ValueEntry *key) {
+    int t;
+    key->instr = instruction(irn);
+    key->op1 = NO_ARG;
+    key->op2 = NO_ARG;
+    key->imm = 0;
+    key->s = NULL;
+    key->mem = 0;
+    switch (instruction(irn)) {
+        case LOAD_CONSTANT:
+            key->imm = irn->IMMVAL;
+            return TRUE;
+        case LOAD_ADDRESS:
+            key->s = irn->s;
+            return TRUE;
+        case ADD_CONST:
+            key->op1 = irn->RSRC;
+            key->imm = irn->IMMVAL;
+            return TRUE;
+        case LOAD_BYTE_INDIRECT:
+        case LOAD_UNSIGNED_BYTE_INDIRECT:
+        case LOAD_HALF_WORD_INDIRECT:
+        case LOAD_UNSIGNED_HALF_WORD_INDIRECT:
+        case LOAD_WORD_INDIRECT:
+            key->op1 = irn->RSRC;
+            key->mem = vt->mem;
+            return TRUE;
+        default:
+            break;
+    }
+    if (is_unary_op(irn)) {
+        key->op1 = irn->RSRC;
+        return TRUE;
+    }
+    if (is_binary_op(irn)) {
+        key->op1 = irn->OPRND1;
+        key->op2 = irn->OPRND2;
+        if (is_commutative(key->instr) && key->op1 > key->op2) {
+            t = key->op1;
+            key->op1 = key->op2;
+            key->op2 = t;
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+unsigned int value_hash(ValueEntry *key) {
+    unsigned int h = key->instr;
+    h = h * 31 + (unsigned int) key->op1;
+    h = h * 31 + (unsigned int) key->op2;
+    h = h * 31 + (unsigned int) key->imm;
+    h = h * 31 + (unsigned int) key->mem;
+    h = h * 31 + (unsigned int) ((unsigned long) key->s >> 4);
+    return h;
+}
+
+ValueEntry *find_value(ValueTable *vt, ValueEntry *key) {
+    ValueEntry *e;
+    for (e = vt->buckets[value_hash(key) % GVN_BUCKETS]; e != NULL;
+            e = e->next) {
+        if (e->instr == key->instr && e->op1 == key->op1 &&
+                e->op2 == key->op2 && e->imm == key->imm &&
+                e->s == key->s && e->mem == key->mem) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+void add_value(ValueTable *vt, ValueEntry *key) {
+    ValueEntry *e;
+    unsigned int bucket = value_hash(key) % GVN_BUCKETS;
+    util_emalloc((void **) &e, sizeof(ValueEntry));
+    *e = *key;
+    e->next = vt->buckets[bucket];
+    vt->buckets[bucket] = e;
+    util_erealloc((void **) &vt->scope,
+                    (vt->num_scope + 1) * sizeof(ValueEntry *));
+    vt->scope[vt->num_scope++] = e;
+}
+
+/* the register first holding the value of reg */
+int value_number(ValueTable *vt, int reg) {
+    if (reg == NO_ARG) {
+        return reg;
+    }
+    while (vt->subst[reg] != reg) {
+        reg = vt->subst[reg];
+    }
+    return reg;
+}
+
+Boolean is_commutative(enum ir_instruction instr) {
+    switch (instr) {
+        case ADD:
+        case ADDU:
+        case MULT:
+        case MULT_HIGH:
+        case MULT_HIGH_UNSIGNED:
+        case LOG_OR:
+        case LOG_AND:
+        case BIT_AND:
+        case BIT_OR:
+        case BIT_XOR:
+        case SET_EQ:
+        case SET_NE:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/* instructions after which loads may see different values */
+Boolean writes_memory(IrNode *irn) {
+    switch (instruction(irn)) {
+        case STORE_WORD:
+        case STORE_BYTE_INDIRECT:
+        case STORE_HALF_WORD_INDIRECT:
+        case STORE_WORD_INDIRECT:
+        case SYSCALL:
+            return TRUE;
+        case CALL:
+            return irn->IMMVAL == CALL_ANY_EFFECTS ? TRUE : FALSE;
+        default:
+            return FALSE;
+    }
+}
+
+/*
+ * PHI arguments flow in from predecessors the walk may not have reached
+ * when it numbered the PHI, so they are rewritten once at the end
+ */
+void substitute_uses(ValueTable *vt) {
+    int i, n, *uses[MAX_USES];
+    IrNode *irn;
+    for (irn = vt->cfg->begin_proc->next; irn != vt->cfg->end_proc;
+            irn = irn->next) {
+        n = ir_node_uses(irn, uses);
+        for (i = 0; i < n; i++) {
+            *uses[i] = value_number(vt, *uses[i]);
+        }
+        for (i = 0; i < irn->num_phi_args; i++) {
+            irn->phi_args[i].reg = value_number(vt, irn->phi_args[i].reg);
+        }
+    }
+}
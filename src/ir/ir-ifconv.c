@@ -0,0 +1,428 @@
+/*
+ * If-conversion of short branches into selects, over a procedure in SSA
+ * form.
+ *
+ * c ? x : y, and if (c) x = y; once x is kept in a register, leave a branch
+ * on c around one or two short arms and a join whose PHIs choose what the
+ * way taken left. When the arms only compute values, with no loads, stores,
+ * calls or divides, both can run whatever c is: their instructions move up
+ * before the branch, each PHI becomes a SELECT of its two values by c, and
+ * the branch becomes a jump to the join, or nothing when the join follows.
+ * A triangle, one way going straight to the join, converts the same way
+ * with a single arm. A jump testing the sign of a register gets its test
+ * made a comparison first. The arms, the comparison and the selects may
+ * add at most MAX_CONVERTED_COST instructions ahead of the old branch, or
+ * MAX_MASKED_COST when selecting with masks.
+ *
+ * Instruction selection makes a SELECT a move and a movn or movz, which
+ * MIPS32 has and MIPS I does not. Without conditional_moves, each PHI
+ * instead picks the bits of one value or the other with a mask of the
+ * condition, 0 or -1: y ^ ((x ^ y) & -(c != 0)), the comparison with 0 an
+ * sltu left out when c is already 0 or 1.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-opt.h"
+#include "../include/utilities.h"
+
+/* the most instructions a conversion may add before the branch it removes */
+#define MAX_CONVERTED_COST 6
+/* and with masks, as MIPS I branches cost no more than their delay slots */
+#define MAX_MASKED_COST 4
+/* instructions a SELECT becomes: a move and a movn */
+#define SELECT_COST 2
+/* instructions a mask selection takes: two xors and an and, and the mask */
+#define MASK_COST 4
+
+/* select with movn and movz; FALSE for MIPS I, set by -mips1 */
+Boolean conditional_moves = TRUE;
+
+/* a branch to convert and the blocks it chooses between */
+struct Conversion {
+    BasicBlock *head;           /* ends in the branch                   */
+    BasicBlock *nonzero;        /* the arm run when the test is nonzero */
+    BasicBlock *zero;           /* and when it is zero; NULL for none   */
+    BasicBlock *join;
+    int cond;                   /* the register the branch tests        */
+    int compare;                /* the comparison a sign test becomes   */
+};
+typedef struct Conversion Conversion;
+
+/* file helper functions */
+Boolean find_conversion(BasicBlock *b, Boolean *touched, Conversion *cv);
+Boolean find_arms(BasicBlock *b, BasicBlock **taken, BasicBlock **fall,
+                    BasicBlock **join);
+Boolean is_arm(BasicBlock *head, BasicBlock *a);
+Boolean is_speculable(IrNode *irn);
+int conversion_cost(Conversion *cv);
+int arm_size(BasicBlock *a);
+Boolean is_truth_value(BasicBlock *b, int reg);
+IrNode *convert_branch(ControlFlowGraph *cfg, Conversion *cv);
+void hoist_arm(ControlFlowGraph *cfg, BasicBlock *a, BasicBlock *head);
+int phi_value(IrNode *phi, BasicBlock *pred);
+int emit_before_branch(ControlFlowGraph *cfg, BasicBlock *b, int instr,
+                        int a, int c);
+
+
+/*
+ * convert_branches
+ * Purpose: replace branches choosing between short arms that compute
+ *          values with selects of those values
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure in SSA form
+ * Returns:
+ *  The number of branches removed
+ * Side Effects:
+ *  Moves the instructions of each converted arm before its branch, which
+ *  becomes a jump to the join, or nothing; the PHIs at the join become
+ *  SELECTs there, or mask sequences without conditional_moves. Removes
+ *  the arms, and rebuilds the CFG.
+ */
+int convert_branches(ControlFlowGraph *cfg) {
+    Conversion cv;
+    Boolean *touched;
+    IrNode **jumps;
+    int converted = 0, num_jumps, i;
+
+    do {
+        util_emalloc((void **) &touched, cfg->num_blocks * sizeof(Boolean));
+        util_emalloc((void **) &jumps, cfg->num_blocks * sizeof(IrNode *));
+        for (i = 0; i < cfg->num_blocks; i++) {
+            touched[i] = FALSE;
+        }
+        /* a branch whose blocks another one changed waits for the next */
+        num_jumps = 0;
+        for (i = 0; i < cfg->num_blocks; i++) {
+            if (find_conversion(cfg->blocks[i], touched, &cv)) {
+                jumps[num_jumps++] = convert_branch(cfg, &cv);
+            }
+        }
+        free(touched);
+        if (num_jumps > 0) {
+            rebuild_cfg(cfg);
+            remove_unreachable_blocks(cfg);
+            for (i = 0; i < num_jumps; i++) {
+                if (jumps[i]->next == jumps[i]->branch) {
+                    remove_block_node(jumps[i], cfg);
+                }
+            }
+            rebuild_cfg(cfg);
+        }
+        free(jumps);
+        converted += num_jumps;
+    } while (num_jumps > 0);
+    return converted;
+}
+
+/*
+ * may_convert_branches
+ * Purpose: tell whether convert_branches could convert any branch of a
+ *          procedure, before the procedure is taken into SSA form
+ * Parameters:
+ *  cfg - ControlFlowGraph * - the procedure
+ * Returns:
+ *  TRUE if some branch goes around short arms that only compute values,
+ *  else FALSE. What they cost is only known in SSA form.
+ * Side Effects:
+ *  None
+ */
+Boolean may_convert_branches(ControlFlowGraph *cfg) {
+    BasicBlock *taken, *fall, *join;
+    int i;
+
+    for (i = 0; i < cfg->num_blocks; i++) {
+        if (find_arms(cfg->blocks[i], &taken, &fall, &join)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * does b end in a branch to convert? cv gets its blocks and the blocks are
+ * marked touched
+ */
+Boolean find_conversion(BasicBlock *b, Boolean *touched, Conversion *cv) {
+    IrNode *test = block_terminator(b);
+    BasicBlock *taken, *fall;
+
+    if (!find_arms(b, &taken, &fall, &cv->join) || touched[b->id] ||
+            touched[cv->join->id]) {
+        return FALSE;
+    }
+    cv->head = b;
+    cv->cond = test->RSRC;
+    cv->compare = NO_IR_INSTRUCTION;
+    switch (instruction(test)) {
+        case JUMP_NEZ:
+            cv->nonzero = taken;
+            cv->zero = fall;
+            break;
+        case JUMP_LEZ:
+            /* goes on when c > 0 */
+            cv->compare = SET_GT;
+            cv->nonzero = fall;
+            cv->zero = taken;
+            break;
+        case JUMP_GEZ:
+            cv->compare = SET_LT;
+            cv->nonzero = fall;
+            cv->zero = taken;
+            break;
+        default:
+            cv->nonzero = fall;
+            cv->zero = taken;
+            break;
+    }
+    if (conversion_cost(cv) > (conditional_moves ? MAX_CONVERTED_COST :
+                                MAX_MASKED_COST)) {
+        return FALSE;
+    }
+    touched[b->id] = touched[cv->join->id] = TRUE;
+    return TRUE;
+}
+
+/*
+ * does b branch around one or two arms to a join only they lead to? taken
+ * and fall get the arms on the ways the branch takes and falls through,
+ * NULL for a way going straight to the join
+ */
+Boolean find_arms(BasicBlock *b, BasicBlock **taken, BasicBlock **fall,
+                    BasicBlock **join) {
+    IrNode *test = block_terminator(b);
+
+    if (test == NULL || b->num_succs != 2 || instruction(test) == JUMP ||
+            instruction(test) == RETURN_FROM_PROC ||
+            instruction(test) == TAIL_CALL) {
+        return FALSE;
+    }
+    *taken = test->branch->bb;
+    *fall = b->succs[b->succs[0] == *taken ? 1 : 0];
+    if (*taken == *fall) {
+        return FALSE;
+    }
+    if (is_arm(b, *taken) && is_arm(b, *fall) &&
+            (*taken)->succs[0] == (*fall)->succs[0]) {
+        *join = (*taken)->succs[0];
+    } else if (is_arm(b, *fall) && (*fall)->succs[0] == *taken) {
+        *join = *taken;
+        *taken = NULL;
+    } else if (is_arm(b, *taken) && (*taken)->succs[0] == *fall) {
+        *join = *fall;
+        *fall = NULL;
+    } else {
+        return FALSE;
+    }
+    return *join != b && (*join)->num_preds == 2 ? TRUE : FALSE;
+}
+
+/*
+ * is a a block only head leads to, going on to one other block, that can
+ * run whether or not head's branch goes to it?
+ */
+Boolean is_arm(BasicBlock *head, BasicBlock *a) {
+    IrNode *irn;
+
+    if (a->num_preds != 1 || a->preds[0] != head || a->num_succs != 1 ||
+            a->succs[0] == head) {
+        return FALSE;
+    }
+    for (irn = a->first->next; irn != a->last->next; irn = irn->next) {
+        if (!is_speculable(irn) && !(irn == a->last &&
+                    instruction(irn) == JUMP)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * instructions that can run when their result is not wanted: they neither
+ * touch memory nor fault, and are cheap
+ */
+Boolean is_speculable(IrNode *irn) {
+    switch (instruction(irn)) {
+        case LOAD_CONSTANT:
+        case LOAD_ADDRESS:
+        case ADD_CONST:
+        case MOVE:
+            return TRUE;
+        case DIV:
+        case REM:
+        case DIVU:
+        case REMU:
+        case MULT:
+        case MULT_HIGH:
+        case MULT_HIGH_UNSIGNED:
+            return FALSE;
+        default:
+            return is_binary_op(irn) || is_unary_op(irn);
+    }
+}
+
+/* the instructions converting cv adds ahead of the branch */
+int conversion_cost(Conversion *cv) {
+    IrNode *irn;
+    int cost = arm_size(cv->nonzero) + arm_size(cv->zero);
+    Boolean truth = cv->compare != NO_IR_INSTRUCTION ||
+                    is_truth_value(cv->head, cv->cond);
+
+    if (cv->compare != NO_IR_INSTRUCTION) {
+        cost++;
+    }
+    if (!conditional_moves && !truth) {
+        cost++;
+    }
+    for (irn = cv->join->first->next; irn != cv->join->last->next &&
+            instruction(irn) == PHI; irn = irn->next) {
+        cost += conditional_moves ? SELECT_COST : MASK_COST;
+    }
+    return cost;
+}
+
+/* the instructions of arm a moved before the branch, 0 for no arm */
+int arm_size(BasicBlock *a) {
+    IrNode *irn;
+    int size = 0;
+
+    if (a == NULL) {
+        return 0;
+    }
+    for (irn = a->first->next; irn != a->last->next; irn = irn->next) {
+        size += instruction(irn) != JUMP;
+    }
+    return size;
+}
+
+/* is reg, if b computes it, a comparison's result, 0 or 1? */
+Boolean is_truth_value(BasicBlock *b, int reg) {
+    IrNode *irn;
+    int *def;
+
+    for (irn = b->last; irn != b->first; irn = irn->prev) {
+        def = ir_node_def(irn);
+        if (def == NULL || *def != reg) {
+            continue;
+        }
+        switch (instruction(irn)) {
+            case SET_LT:
+            case SET_LE:
+            case SET_GT:
+            case SET_GE:
+            case SET_LTU:
+            case SET_LEU:
+            case SET_GTU:
+            case SET_GEU:
+            case SET_EQ:
+            case SET_NE:
+            case LOG_NOT:
+                return TRUE;
+            default:
+                return FALSE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * move the arms of cv before its branch, select the values of the PHIs at
+ * its join there, and make the branch a jump to the join, returned
+ */
+IrNode *convert_branch(ControlFlowGraph *cfg, Conversion *cv) {
+    IrNode *test = block_terminator(cv->head), *phi, *next;
+    int cond = cv->cond, zero, mask = NO_ARG, x, y, diff;
+
+    hoist_arm(cfg, cv->nonzero, cv->head);
+    hoist_arm(cfg, cv->zero, cv->head);
+    if (cv->compare != NO_IR_INSTRUCTION) {
+        zero = emit_before_branch(cfg, cv->head, LOAD_CONSTANT, 0, NO_ARG);
+        cond = emit_before_branch(cfg, cv->head, cv->compare, cond, zero);
+    } else if (!conditional_moves && !is_truth_value(cv->head, cond)) {
+        zero = emit_before_branch(cfg, cv->head, LOAD_CONSTANT, 0, NO_ARG);
+        cond = emit_before_branch(cfg, cv->head, SET_NE, cond, zero);
+    }
+    if (!conditional_moves) {
+        mask = emit_before_branch(cfg, cv->head, NEGATE, cond, NO_ARG);
+    }
+    for (phi = cv->join->first->next; phi != NULL &&
+            instruction(phi) == PHI; phi = next) {
+        next = phi == cv->join->last ? NULL : phi->next;
+        x = phi_value(phi, cv->nonzero != NULL ? cv->nonzero : cv->head);
+        y = phi_value(phi, cv->zero != NULL ? cv->zero : cv->head);
+        remove_block_node(phi, cfg);
+        free(phi->phi_args);
+        phi->phi_args = NULL;
+        phi->num_phi_args = 0;
+        phi->s = NULL;
+        if (conditional_moves) {
+            phi->instruction = SELECT;
+            phi->RSRC = cond;
+            phi->OPRND1 = x;
+            phi->OPRND2 = y;
+        } else {
+            diff = emit_before_branch(cfg, cv->head, BIT_XOR, x, y);
+            diff = emit_before_branch(cfg, cv->head, BIT_AND, diff, mask);
+            phi->instruction = BIT_XOR;
+            phi->OPRND1 = diff;
+            phi->OPRND2 = y;
+        }
+        insert_before_terminator(cv->head, phi, cfg);
+    }
+    test->instruction = JUMP;
+    test->RSRC = NO_ARG;
+    test->branch = cv->join->first;
+    return test;
+}
+
+/* move the instructions of arm a, if any, before the branch ending head */
+void hoist_arm(ControlFlowGraph *cfg, BasicBlock *a, BasicBlock *head) {
+    IrNode *irn, *next, *stop;
+
+    if (a == NULL) {
+        return;
+    }
+    stop = a->last->next;
+    for (irn = a->first->next; irn != stop; irn = next) {
+        next = irn->next;
+        if (instruction(irn) != JUMP) {
+            remove_block_node(irn, cfg);
+            insert_before_terminator(head, irn, cfg);
+        }
+    }
+}
+
+/* the register phi takes when control comes from pred */
+int phi_value(IrNode *phi, BasicBlock *pred) {
+    int i;
+
+    for (i = 0; i < phi->num_phi_args; i++) {
+        if (phi->phi_args[i].pred->bb == pred) {
+            return phi->phi_args[i].reg;
+        }
+    }
+    return NO_ARG;
+}
+
+/*
+ * insert instr on a and c before the branch ending b, into a new register
+ * returned; a is the value of a LOAD_CONSTANT
+ */
+int emit_before_branch(ControlFlowGraph *cfg, BasicBlock *b, int instr,
+                        int a, int c) {
+    IrNode *irn = construct_ir_node(instr);
+
+    irn->RDEST = new_reg(cfg);
+    if (instr == LOAD_CONSTANT) {
+        irn->IMMVAL = a;
+    } else if (is_unary_op(irn)) {
+        irn->RSRC = a;
+    } else {
+        irn->OPRND1 = a;
+        irn->OPRND2 = c;
+    }
+    insert_before_terminator(b, irn, cfg);
+    return irn->RDEST;
+}
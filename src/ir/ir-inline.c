@@ -0,0 +1,414 @@
+/*
+ * Inlining.
+ *
+ * A call is replaced by a copy of the body of the procedure it calls. The
+ * copy's registers are numbered above those of the caller and its labels
+ * are new, each argument is moved into the register the procedure received
+ * it in, and each return moves the result into the register the caller
+ * read it from and jumps past the end of the copy. The original procedure
+ * stays for its other calls; one no longer called is removed as unreachable
+ * afterwards.
+ *
+ * Procedures are visited callees first, so that what they inline is part
+ * of them when they are themselves inlined. Whether a call is inlined is
+ * decided by its cost: the instructions the copy adds, less those of the
+ * call it replaces, and less all of them when it is the only call to a
+ * procedure that can then be removed. A call is inlined when its cost is at
+ * most inline_limit. Recursive procedures are never inlined, nor are those
+ * with variables in memory, which the caller's frame has no room for.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/ir.h"
+#include "../include/ir-opt.h"
+#include "../include/symbol-utils.h"
+#include "../include/utilities.h"
+
+/* instructions of a call besides its arguments: BEGIN_CALL to the result */
+#define CALL_OVERHEAD 4
+/* the size past which nothing more is inlined into a procedure */
+#define MAX_INLINE_CALLER_SIZE 1000
+
+/* the most a call may cost to be inlined, set by -inline-limit= */
+int inline_limit = 10;
+
+/* file helper functions */
+void callees_first(CallGraph *cg, int proc, Boolean *visited, int *order,
+                    int *num);
+Boolean should_inline(CallGraph *cg, IrNode *call, int caller, int callee);
+Boolean is_recursive(CallGraph *cg, int proc);
+Boolean reaches(CallGraph *cg, int from, int to, Boolean *visited);
+Boolean has_frame_locals(IrNode *begin);
+Boolean arguments_match(IrNode *call, IrNode *begin);
+int call_sites(CallGraph *cg, Symbol *s);
+int registers_used(IrNode *begin);
+IrNode *inline_call(IrNode *call, IrNode *begin, int base, IrList *irl);
+void remark(IrNode *caller, IrNode *callee, char *decision);
+
+
+/*
+ * inline_calls
+ * Purpose: inline the calls the cost model finds worth it
+ * Parameters:
+ *  cg - CallGraph * - the call graph of the program
+ *  irl - IrList * - the IR of the program
+ * Returns:
+ *  The number of calls inlined
+ * Side Effects:
+ *  Replaces the calls by copies of the procedures called, and updates the
+ *  call graph edges of the callers and marks them changed. Prints a remark
+ *  for each call to a procedure of the program to opt_report.
+ */
+int inline_calls(CallGraph *cg, IrList *irl) {
+    IrNode *irn, *next;
+    Boolean *visited;
+    int *order, num = 0, i, caller, callee, inlined = 0;
+
+    util_emalloc((void **) &visited, (cg->num_procs + 1) * sizeof(Boolean));
+    util_emalloc((void **) &order, (cg->num_procs + 1) * sizeof(int));
+    for (i = 0; i < cg->num_procs; i++) {
+        visited[i] = FALSE;
+    }
+    for (i = 0; i < cg->num_procs; i++) {
+        if (!visited[i]) {
+            callees_first(cg, i, visited, order, &num);
+        }
+    }
+
+    for (i = 0; i < num; i++) {
+        caller = order[i];
+        for (irn = cg->procs[caller]->next; instruction(irn) != END_PROC;
+                irn = next) {
+            next = irn->next;
+            if (instruction(irn) != CALL) {
+                continue;
+            }
+            callee = procedure_index(cg, irn->s);
+            if (callee == NO_ARG || !should_inline(cg, irn, caller, callee)) {
+                continue;
+            }
+            next = inline_call(irn, cg->procs[callee],
+                        registers_used(cg->procs[caller]), irl);
+            cg->changed[caller] = TRUE;
+            inlined++;
+        }
+        find_callees(cg, caller);
+    }
+    free(visited);
+    free(order);
+    return inlined;
+}
+
+/* append proc to order after the procedures it calls, unless in a cycle */
+void callees_first(CallGraph *cg, int proc, Boolean *visited, int *order,
+                    int *num) {
+    int j;
+    visited[proc] = TRUE;
+    for (j = 0; j < cg->num_procs; j++) {
+        if (cg->calls[proc * cg->num_procs + j] && !visited[j]) {
+            callees_first(cg, j, visited, order, num);
+        }
+    }
+    order[(*num)++] = proc;
+}
+
+/* decide whether to inline call, the reason given as a remark */
+Boolean should_inline(CallGraph *cg, IrNode *call, int caller, int callee) {
+    IrNode *begin = cg->procs[callee];
+    int size = procedure_size(begin), cost;
+    char decision[64];
+
+    if (is_recursive(cg, callee)) {
+        remark(cg->procs[caller], begin, "not inlined, recursive");
+        return FALSE;
+    }
+    if (has_frame_locals(begin)) {
+        remark(cg->procs[caller], begin, "not inlined, variables in memory");
+        return FALSE;
+    }
+    if (!arguments_match(call, begin)) {
+        remark(cg->procs[caller], begin, "not inlined, arguments missing");
+        return FALSE;
+    }
+    if (procedure_size(cg->procs[caller]) + size > MAX_INLINE_CALLER_SIZE) {
+        remark(cg->procs[caller], begin, "not inlined, caller too large");
+        return FALSE;
+    }
+    cost = size - CALL_OVERHEAD;
+    for (call = call->prev; instruction(call) == PARAM; call = call->prev) {
+        cost--;
+    }
+    if (call_sites(cg, begin->s) == 1 && !cg->address_taken[callee] &&
+            strcmp(get_symbol_name(begin->s), "main")) {
+        /* the original goes once this call is inlined */
+        cost -= size;
+    }
+    sprintf(decision, "%s, cost %d, limit %d",
+            cost > inline_limit ? "not inlined" : "inlined", cost,
+            inline_limit);
+    remark(cg->procs[caller], begin, decision);
+    return cost > inline_limit ? FALSE : TRUE;
+}
+
+/* does proc call itself, directly or not? */
+Boolean is_recursive(CallGraph *cg, int proc) {
+    Boolean *visited, found;
+    int i;
+
+    util_emalloc((void **) &visited, (cg->num_procs + 1) * sizeof(Boolean));
+    for (i = 0; i < cg->num_procs; i++) {
+        visited[i] = FALSE;
+    }
+    found = FALSE;
+    for (i = 0; i < cg->num_procs && !found; i++) {
+        if (cg->calls[proc * cg->num_procs + i]) {
+            found = reaches(cg, i, proc, visited);
+        }
+    }
+    free(visited);
+    return found;
+}
+
+/* is to reached from from along call graph edges not yet visited? */
+Boolean reaches(CallGraph *cg, int from, int to, Boolean *visited) {
+    int j;
+    if (from == to) {
+        return TRUE;
+    }
+    visited[from] = TRUE;
+    for (j = 0; j < cg->num_procs; j++) {
+        if (cg->calls[from * cg->num_procs + j] && !visited[j] &&
+                reaches(cg, j, to, visited)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* does the procedure take the address of any variable but a global? */
+Boolean has_frame_locals(IrNode *begin) {
+    IrNode *irn;
+    for (irn = begin; instruction(irn) != END_PROC; irn = irn->next) {
+        if (instruction(irn) == LOAD_ADDRESS && irn->s != NULL &&
+                symbol_outer_type(irn->s) != FUNCTION &&
+                !is_global_symbol(irn->s)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* does call pass every parameter the procedure begin receives? */
+Boolean arguments_match(IrNode *call, IrNode *begin) {
+    IrNode *irn;
+    int num_args = 0;
+
+    for (irn = call->prev; instruction(irn) == PARAM; irn = irn->prev) {
+        num_args++;
+    }
+    for (irn = begin; instruction(irn) != END_PROC; irn = irn->next) {
+        if (instruction(irn) == RECEIVED_PARAM && irn->IMMVAL >= num_args) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* the instructions of a procedure other than labels */
+int procedure_size(IrNode *begin) {
+    IrNode *irn;
+    int size = 0;
+    for (irn = begin->next; instruction(irn) != END_PROC; irn = irn->next) {
+        if (instruction(irn) != LABEL) {
+            size++;
+        }
+    }
+    return size;
+}
+
+/* the number of calls to s in the program */
+int call_sites(CallGraph *cg, Symbol *s) {
+    IrNode *irn;
+    int i, n = 0;
+    for (i = 0; i < cg->num_procs; i++) {
+        for (irn = cg->procs[i]; instruction(irn) != END_PROC;
+                irn = irn->next) {
+            if (instruction(irn) == CALL && irn->s == s) {
+                n++;
+            }
+        }
+    }
+    return n;
+}
+
+/* one more than the highest register the procedure uses */
+int registers_used(IrNode *begin) {
+    IrNode *irn;
+    int *uses[MAX_USES], *def;
+    int i, n, max = -1;
+
+    for (irn = begin->next; instruction(irn) != END_PROC; irn = irn->next) {
+        n = ir_node_uses(irn, uses);
+        for (i = 0; i < n; i++) {
+            max = *uses[i] > max ? *uses[i] : max;
+        }
+        def = ir_node_def(irn);
+        if (def != NULL) {
+            max = *def > max ? *def : max;
+        }
+    }
+    return max + 1;
+}
+
+/*
+ * inline_call
+ * Purpose: replace a call by a copy of the procedure it calls
+ * Parameters:
+ *  call - IrNode * - the CALL
+ *  begin - IrNode * - the BEGIN_PROC of the procedure called
+ *  base - int - added to the registers of the copy, above any the caller
+ *         uses
+ *  irl - IrList * - the IR of the program
+ * Returns:
+ *  The node after the copy
+ * Side Effects:
+ *  The PARAMs become moves into the registers RECEIVED_PARAM defined, and
+ *  each return a move into the register RETURNED_WORD defined and a jump
+ *  to the copy of the label ending the procedure. The BEGIN_CALL, CALL,
+ *  END_CALL and RETURNED_WORD are unlinked.
+ */
+IrNode *inline_call(IrNode *call, IrNode *begin, int base, IrList *irl) {
+    IrNode *irn, *pos, *resume, *result = call_result(call), **args = NULL;
+    IrNode **old_labels, **new_labels;
+    int num_args = 0, num_labels;
+
+    for (irn = call->prev; instruction(irn) == PARAM; irn = irn->prev) {
+        num_args++;
+    }
+    util_emalloc((void **) &args, (num_args + 1) * sizeof(IrNode *));
+    for (irn = call->prev; instruction(irn) == PARAM; irn = irn->prev) {
+        args[irn->RDEST] = irn;
+    }
+    num_labels = map_labels(begin, &old_labels, &new_labels);
+
+    pos = result != NULL ? result : call->next;
+    resume = pos->next;
+    for (irn = begin->next; instruction(irn) != END_PROC; irn = irn->next) {
+        switch (instruction(irn)) {
+            case LABEL:
+                pos = insert_ir_node_after(pos,
+                        copied_label(irn, old_labels, new_labels, num_labels),
+                        irl);
+                break;
+            case RECEIVED_PARAM:
+                pos = insert_ir_node_after(pos, irn_move(irn->RDEST + base,
+                        args[irn->IMMVAL]->RSRC), irl);
+                break;
+            case RETURN_FROM_PROC:
+                if (result != NULL && irn->RSRC != NO_ARG) {
+                    pos = insert_ir_node_after(pos,
+                            irn_move(result->RDEST, irn->RSRC + base), irl);
+                }
+                if (irn->next != irn->branch) {
+                    pos = insert_ir_node_after(pos, irn_jump(JUMP, NO_ARG,
+                            copied_label(irn->branch, old_labels, new_labels,
+                                num_labels)), irl);
+                }
+                break;
+            default:
+                pos = insert_ir_node_after(pos, clone_ir_node(irn, base), irl);
+                if (pos->branch != NULL) {
+                    pos->branch = copied_label(pos->branch, old_labels,
+                                    new_labels, num_labels);
+                }
+                break;
+        }
+    }
+
+    if (result != NULL) {
+        remove_ir_node(result, irl);
+    }
+    remove_ir_node(call->next, irl);
+    while (instruction(call->prev) == PARAM) {
+        remove_ir_node(call->prev, irl);
+    }
+    irn = call_begin(call);
+    if (irn != NULL) {
+        remove_ir_node(irn, irl);
+    }
+    remove_ir_node(call, irl);
+    free(args);
+    free(old_labels);
+    free(new_labels);
+    return resume;
+}
+
+/*
+ * map_labels
+ * Purpose: make a new label for each label of a procedure, for a copy
+ * Parameters:
+ *  begin - IrNode * - the BEGIN_PROC of the procedure
+ *  labels - IrNode *** - set to the labels of the procedure
+ *  copies - IrNode *** - set to the labels standing for them in the copy
+ * Returns:
+ *  The number of labels
+ * Side Effects:
+ *  Allocates heap memory for both arrays
+ */
+int map_labels(IrNode *begin, IrNode ***labels, IrNode ***copies) {
+    IrNode *irn;
+    int num = 0;
+
+    *labels = NULL;
+    *copies = NULL;
+    for (irn = begin; instruction(irn) != END_PROC; irn = irn->next) {
+        if (instruction(irn) == LABEL) {
+            util_erealloc((void **) labels, (num + 1) * sizeof(IrNode *));
+            util_erealloc((void **) copies, (num + 1) * sizeof(IrNode *));
+            (*labels)[num] = irn;
+            (*copies)[num++] = new_label();
+        }
+    }
+    return num;
+}
+
+/* a copy of irn with base added to its registers */
+IrNode *clone_ir_node(IrNode *irn, int base) {
+    IrNode *copy = construct_ir_node(instruction(irn));
+    int *uses[MAX_USES], *def;
+    int i, n;
+
+    *copy = *irn;
+    copy->prev = copy->next = NULL;
+    copy->bb = NULL;
+    n = ir_node_uses(copy, uses);
+    for (i = 0; i < n; i++) {
+        if (*uses[i] != NO_ARG) {
+            *uses[i] += base;
+        }
+    }
+    def = ir_node_def(copy);
+    if (def != NULL && *def != NO_ARG) {
+        *def += base;
+    }
+    return copy;
+}
+
+/* the label standing for label in the copy */
+IrNode *copied_label(IrNode *label, IrNode **labels, IrNode **copies,
+                        int num) {
+    int i;
+    for (i = 0; i < num && labels[i] != label; i++)
+        ;
+    return copies[i];
+}
+
+/* print why a call from caller to callee was inlined or not */
+void remark(IrNode *caller, IrNode *callee, char *decision) {
+    if (opt_report != NULL) {
+        fprintf(opt_report, "inline: %s: %s %s\n", get_symbol_name(caller->s),
+                get_symbol_name(callee->s), decision);
+    }
+}
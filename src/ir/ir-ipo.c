@@ -0,0 +1,664 @@
+/*
+ * Interprocedural optimization over the whole program.
+ *
+ * The call graph has an edge from each procedure to each procedure it
+ * calls or takes the address of. A call made through a prototype names
+ * the prototype's symbol, so calls and addresses are first made to name
+ * the symbol of the procedure's definition. Procedures not reached from main along
+ * its edges are removed, and so are the globals none of the remaining
+ * procedures refer to. A program without main is left whole.
+ *
+ * A procedure whose address is never taken is called only where the call
+ * graph says. When every call passes the same constant for a parameter,
+ * the procedure loads that constant instead of receiving the argument; when
+ * every return of a procedure returns the same constant, its callers load
+ * the constant instead of reading the result.
+ *
+ * Each procedure is then tagged with what calls to it may do: one neither
+ * reading nor writing memory, nor calling anything that does, is const;
+ * one that reads memory but writes none is pure. Procedures calling each
+ * other are assumed const until shown otherwise. The tag is copied to the
+ * IMMVAL of every CALL, so that passes over a single procedure can let
+ * loads be reused across calls that write no memory, and remove calls whose
+ * result is unused or was computed by an identical call before.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-opt.h"
+#include "../include/symbol-utils.h"
+#include "../include/utilities.h"
+
+/* file helper functions */
+void link_definitions(CallGraph *cg, IrList *irl);
+void add_callee(CallGraph *cg, int caller, Symbol *callee);
+void mark_reachable(CallGraph *cg, int proc);
+void remove_procedure(IrList *irl, IrNode *begin);
+Boolean global_referenced(CallGraph *cg, Symbol *s);
+int procedure_effects(CallGraph *cg, int proc);
+int propagate_arguments(CallGraph *cg, int proc);
+int propagate_result(CallGraph *cg, int proc);
+Boolean constant_argument(CallGraph *cg, int proc, int param, int *value);
+Boolean same_arguments(IrNode *call1, IrNode *call2);
+void remove_call(IrNode *call, ControlFlowGraph *cfg);
+int *register_use_counts(ControlFlowGraph *cfg);
+
+
+/*
+ * build_call_graph
+ * Purpose: find the procedures of the program and which call which
+ * Parameters:
+ *  irl - IrList * - the IR of the whole program
+ * Returns:
+ *  The call graph, every procedure reachable and none changed
+ * Side Effects:
+ *  Allocates heap memory, freed by free_call_graph
+ */
+CallGraph *build_call_graph(IrList *irl) {
+    CallGraph *cg;
+    IrNode *proc;
+    int i;
+
+    util_emalloc((void **) &cg, sizeof(CallGraph));
+    cg->procs = NULL;
+    cg->num_procs = 0;
+    for (proc = next_proc(irl->head); proc != NULL;
+            proc = next_proc(procedure_end(proc))) {
+        util_erealloc((void **) &cg->procs,
+                        (cg->num_procs + 1) * sizeof(IrNode *));
+        cg->procs[cg->num_procs++] = proc;
+    }
+    util_emalloc((void **) &cg->calls,
+                    (cg->num_procs * cg->num_procs + 1) * sizeof(Boolean));
+    util_emalloc((void **) &cg->address_taken,
+                    (cg->num_procs + 1) * sizeof(Boolean));
+    util_emalloc((void **) &cg->reachable,
+                    (cg->num_procs + 1) * sizeof(Boolean));
+    util_emalloc((void **) &cg->changed,
+                    (cg->num_procs + 1) * sizeof(Boolean));
+    util_emalloc((void **) &cg->effects, (cg->num_procs + 1) * sizeof(int));
+    for (i = 0; i < cg->num_procs; i++) {
+        cg->address_taken[i] = FALSE;
+        cg->reachable[i] = TRUE;
+        cg->changed[i] = FALSE;
+        cg->effects[i] = CALL_ANY_EFFECTS;
+    }
+
+    link_definitions(cg, irl);
+    for (i = 0; i < cg->num_procs; i++) {
+        find_callees(cg, i);
+    }
+    return cg;
+}
+
+/*
+ * make each call, or address taken, of a procedure declared by a prototype
+ * name the symbol of its definition, which has the same name. An address
+ * may be of a variable with the name of a procedure, which stays
+ */
+void link_definitions(CallGraph *cg, IrList *irl) {
+    IrNode *irn;
+    int i;
+
+    for (irn = irl->head; irn != NULL; irn = irn->next) {
+        if ((instruction(irn) != CALL && instruction(irn) != LOAD_ADDRESS) ||
+                irn->s == NULL || procedure_index(cg, irn->s) != NO_ARG ||
+                (instruction(irn) == LOAD_ADDRESS &&
+                 symbol_outer_type(irn->s) != FUNCTION)) {
+            continue;
+        }
+        for (i = 0; i < cg->num_procs; i++) {
+            if (!strcmp(get_symbol_name(cg->procs[i]->s),
+                        get_symbol_name(irn->s))) {
+                irn->s = cg->procs[i]->s;
+                break;
+            }
+        }
+    }
+}
+
+/* set the edges from proc to what it calls or takes the address of now */
+void find_callees(CallGraph *cg, int proc) {
+    IrNode *irn;
+    int j;
+
+    for (j = 0; j < cg->num_procs; j++) {
+        cg->calls[proc * cg->num_procs + j] = FALSE;
+    }
+    for (irn = cg->procs[proc]->next; instruction(irn) != END_PROC;
+            irn = irn->next) {
+        if (instruction(irn) == CALL) {
+            add_callee(cg, proc, irn->s);
+        } else if (instruction(irn) == LOAD_ADDRESS &&
+                    procedure_index(cg, irn->s) != NO_ARG) {
+            add_callee(cg, proc, irn->s);
+            cg->address_taken[procedure_index(cg, irn->s)] = TRUE;
+        }
+    }
+}
+
+/*
+ * add_procedure
+ * Purpose: add a procedure made after the call graph was built, such as a
+ *          copy of another
+ * Parameters:
+ *  cg - CallGraph * - the call graph
+ *  begin - IrNode * - the BEGIN_PROC of the procedure
+ * Returns:
+ *  The index of the procedure
+ * Side Effects:
+ *  Grows the arrays of cg. The procedure is reachable, unchanged and has
+ *  edges to what it calls; none lead to it.
+ */
+int add_procedure(CallGraph *cg, IrNode *begin) {
+    Boolean *calls;
+    int i, j, n = cg->num_procs + 1;
+
+    util_erealloc((void **) &cg->procs, n * sizeof(IrNode *));
+    util_erealloc((void **) &cg->address_taken, (n + 1) * sizeof(Boolean));
+    util_erealloc((void **) &cg->reachable, (n + 1) * sizeof(Boolean));
+    util_erealloc((void **) &cg->changed, (n + 1) * sizeof(Boolean));
+    util_erealloc((void **) &cg->effects, (n + 1) * sizeof(int));
+    util_emalloc((void **) &calls, (n * n + 1) * sizeof(Boolean));
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {
+            calls[i * n + j] = i < n - 1 && j < n - 1 ?
+                                cg->calls[i * (n - 1) + j] : FALSE;
+        }
+    }
+    free(cg->calls);
+    cg->calls = calls;
+    cg->procs[n - 1] = begin;
+    cg->address_taken[n - 1] = FALSE;
+    cg->reachable[n - 1] = TRUE;
+    cg->changed[n - 1] = FALSE;
+    cg->effects[n - 1] = CALL_ANY_EFFECTS;
+    cg->num_procs = n;
+    find_callees(cg, n - 1);
+    return n - 1;
+}
+
+void free_call_graph(CallGraph *cg) {
+    free(cg->procs);
+    free(cg->calls);
+    free(cg->address_taken);
+    free(cg->reachable);
+    free(cg->changed);
+    free(cg->effects);
+    free(cg);
+}
+
+/* the index of the procedure s in the call graph, NO_ARG if not defined */
+int procedure_index(CallGraph *cg, Symbol *s) {
+    int i;
+    for (i = 0; i < cg->num_procs; i++) {
+        if (cg->procs[i]->s == s) {
+            return i;
+        }
+    }
+    return NO_ARG;
+}
+
+void add_callee(CallGraph *cg, int caller, Symbol *callee) {
+    int j = procedure_index(cg, callee);
+    if (j != NO_ARG) {
+        cg->calls[caller * cg->num_procs + j] = TRUE;
+    }
+}
+
+/*
+ * remove_unreachable
+ * Purpose: remove the procedures main never calls, directly or not, and
+ *          the globals the rest do not refer to
+ * Parameters:
+ *  cg - CallGraph * - the call graph of the program
+ *  irl - IrList * - the IR of the program
+ * Returns:
+ *  The number of procedures and globals removed
+ * Side Effects:
+ *  Unlinks the IR of the procedures removed and marks them unreachable.
+ *  Removes the globals from the file scope symbol table, so that no storage
+ *  is laid out for them.
+ */
+int remove_unreachable(CallGraph *cg, IrList *irl) {
+    SymbolTable *file_st;
+    Symbol *s, *next;
+    int i, main_proc = NO_ARG, removed = 0;
+
+    for (i = 0; i < cg->num_procs; i++) {
+        if (!strcmp(get_symbol_name(cg->procs[i]->s), "main")) {
+            main_proc = i;
+        }
+    }
+    if (main_proc == NO_ARG) {
+        return 0;
+    }
+    for (i = 0; i < cg->num_procs; i++) {
+        cg->reachable[i] = FALSE;
+    }
+    mark_reachable(cg, main_proc);
+    for (i = 0; i < cg->num_procs; i++) {
+        if (!cg->reachable[i]) {
+            remove_procedure(irl, cg->procs[i]);
+            removed++;
+        }
+    }
+
+    file_st = get_symbol_table(cg->procs[main_proc]->s);
+    for (s = st_symbols(file_st); s != NULL; s = next) {
+        next = s->next;
+        if (symbol_outer_type(s) != FUNCTION && !global_referenced(cg, s)) {
+            detach_symbol(file_st, s);
+            removed++;
+        }
+    }
+    return removed;
+}
+
+void mark_reachable(CallGraph *cg, int proc) {
+    int j;
+    cg->reachable[proc] = TRUE;
+    for (j = 0; j < cg->num_procs; j++) {
+        if (cg->calls[proc * cg->num_procs + j] && !cg->reachable[j]) {
+            mark_reachable(cg, j);
+        }
+    }
+}
+
+/* unlink the nodes of a procedure from the IR list */
+void remove_procedure(IrList *irl, IrNode *begin) {
+    IrNode *irn, *next, *stop = procedure_end(begin)->next;
+    for (irn = begin; irn != stop; irn = next) {
+        next = irn->next;
+        remove_ir_node(irn, irl);
+    }
+}
+
+/* is the address of global s loaded by a procedure still reachable? */
+Boolean global_referenced(CallGraph *cg, Symbol *s) {
+    IrNode *irn;
+    int i;
+    for (i = 0; i < cg->num_procs; i++) {
+        if (!cg->reachable[i]) {
+            continue;
+        }
+        for (irn = cg->procs[i]; instruction(irn) != END_PROC;
+                irn = irn->next) {
+            if (instruction(irn) == LOAD_ADDRESS && irn->s == s) {
+                return TRUE;
+            }
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * tag_call_effects
+ * Purpose: find which procedures are const or pure, and tag the calls to
+ *          them
+ * Parameters:
+ *  cg - CallGraph * - the call graph of the program
+ * Returns:
+ *  The number of procedures found const or pure
+ * Side Effects:
+ *  Sets the effects of each procedure, and the IMMVAL of each CALL to
+ *  CALL_CONST, CALL_PURE or CALL_ANY_EFFECTS. Marks the procedures with
+ *  calls whose tag changed changed.
+ */
+int tag_call_effects(CallGraph *cg) {
+    IrNode *irn;
+    Boolean changed = TRUE;
+    int i, effects, callee, tagged = 0;
+
+    for (i = 0; i < cg->num_procs; i++) {
+        cg->effects[i] = cg->reachable[i] ? CALL_CONST : CALL_ANY_EFFECTS;
+    }
+    /* the effects only ever decrease, so this ends */
+    while (changed) {
+        changed = FALSE;
+        for (i = 0; i < cg->num_procs; i++) {
+            if (!cg->reachable[i]) {
+                continue;
+            }
+            effects = procedure_effects(cg, i);
+            if (effects != cg->effects[i]) {
+                cg->effects[i] = effects;
+                changed = TRUE;
+            }
+        }
+    }
+
+    for (i = 0; i < cg->num_procs; i++) {
+        if (!cg->reachable[i]) {
+            continue;
+        }
+        if (cg->effects[i] != CALL_ANY_EFFECTS) {
+            tagged++;
+        }
+        for (irn = cg->procs[i]; instruction(irn) != END_PROC;
+                irn = irn->next) {
+            if (instruction(irn) != CALL) {
+                continue;
+            }
+            callee = procedure_index(cg, irn->s);
+            effects = callee == NO_ARG ? CALL_ANY_EFFECTS : cg->effects[callee];
+            if (irn->IMMVAL != effects) {
+                irn->IMMVAL = effects;
+                cg->changed[i] = TRUE;
+            }
+        }
+    }
+    return tagged;
+}
+
+/* the least a procedure may do, given what the ones it calls may do */
+int procedure_effects(CallGraph *cg, int proc) {
+    IrNode *irn;
+    int effects = CALL_CONST, callee;
+
+    for (irn = cg->procs[proc]; instruction(irn) != END_PROC;
+            irn = irn->next) {
+        switch (instruction(irn)) {
+            case LOAD_BYTE_INDIRECT:
+            case LOAD_UNSIGNED_BYTE_INDIRECT:
+            case LOAD_HALF_WORD_INDIRECT:
+            case LOAD_UNSIGNED_HALF_WORD_INDIRECT:
+            case LOAD_WORD_INDIRECT:
+                if (effects > CALL_PURE) {
+                    effects = CALL_PURE;
+                }
+                break;
+            case CALL:
+                callee = procedure_index(cg, irn->s);
+                if (callee == NO_ARG) {
+                    return CALL_ANY_EFFECTS;
+                }
+                if (cg->effects[callee] < effects) {
+                    effects = cg->effects[callee];
+                }
+                break;
+            case STORE_BYTE_INDIRECT:
+            case STORE_HALF_WORD_INDIRECT:
+            case STORE_WORD_INDIRECT:
+            case STORE_WORD:
+            case SYSCALL:
+                return CALL_ANY_EFFECTS;
+            default:
+                break;
+        }
+    }
+    return effects;
+}
+
+/*
+ * propagate_interprocedural_constants
+ * Purpose: put the constants passed to and returned by procedures in
+ *          place of their parameters and results
+ * Parameters:
+ *  cg - CallGraph * - the call graph of the program
+ * Returns:
+ *  The number of parameters and results replaced
+ * Side Effects:
+ *  A RECEIVED_PARAM of a parameter every call passes the same constant
+ *  becomes a LOAD_CONSTANT of it, as does the RETURNED_WORD after each call
+ *  to a procedure always returning the same constant. Marks the procedures
+ *  changed.
+ */
+int propagate_interprocedural_constants(CallGraph *cg) {
+    int i, propagated = 0;
+    for (i = 0; i < cg->num_procs; i++) {
+        if (cg->reachable[i] && !cg->address_taken[i]) {
+            propagated += propagate_arguments(cg, i);
+            propagated += propagate_result(cg, i);
+        }
+    }
+    return propagated;
+}
+
+int propagate_arguments(CallGraph *cg, int proc) {
+    IrNode *irn;
+    int value, propagated = 0;
+
+    for (irn = cg->procs[proc]; instruction(irn) != END_PROC;
+            irn = irn->next) {
+        if (instruction(irn) == RECEIVED_PARAM &&
+                constant_argument(cg, proc, irn->IMMVAL, &value)) {
+            irn->instruction = LOAD_CONSTANT;
+            irn->IMMVAL = value;
+            cg->changed[proc] = TRUE;
+            propagated++;
+        }
+    }
+    return propagated;
+}
+
+/* is the same constant passed as the param-th argument by every call? */
+Boolean constant_argument(CallGraph *cg, int proc, int param, int *value) {
+    IrNode *irn, *arg;
+    Boolean called = FALSE;
+    int i, v;
+
+    for (i = 0; i < cg->num_procs; i++) {
+        if (!cg->reachable[i] || !cg->calls[i * cg->num_procs + proc]) {
+            continue;
+        }
+        for (irn = cg->procs[i]; instruction(irn) != END_PROC;
+                irn = irn->next) {
+            if (instruction(irn) != CALL || irn->s != cg->procs[proc]->s) {
+                continue;
+            }
+            /* the arguments are passed just before the call */
+            for (arg = irn->prev; instruction(arg) == PARAM &&
+                    arg->RDEST != param; arg = arg->prev)
+                ;
+            if (instruction(arg) != PARAM ||
+                    !constant_register(cg->procs[i], arg->RSRC, &v) ||
+                    (called && v != *value)) {
+                return FALSE;
+            }
+            *value = v;
+            called = TRUE;
+        }
+    }
+    return called;
+}
+
+int propagate_result(CallGraph *cg, int proc) {
+    IrNode *irn, *result;
+    Boolean returns = FALSE;
+    int i, v, value = 0, propagated = 0;
+
+    for (irn = cg->procs[proc]; instruction(irn) != END_PROC;
+            irn = irn->next) {
+        if (instruction(irn) != RETURN_FROM_PROC) {
+            continue;
+        }
+        if (irn->RSRC == NO_ARG ||
+                !constant_register(cg->procs[proc], irn->RSRC, &v) ||
+                (returns && v != value)) {
+            return 0;
+        }
+        value = v;
+        returns = TRUE;
+    }
+    if (!returns) {
+        return 0;
+    }
+    for (i = 0; i < cg->num_procs; i++) {
+        if (!cg->reachable[i] || !cg->calls[i * cg->num_procs + proc]) {
+            continue;
+        }
+        for (irn = cg->procs[i]; instruction(irn) != END_PROC;
+                irn = irn->next) {
+            if (instruction(irn) != CALL || irn->s != cg->procs[proc]->s ||
+                    (result = call_result(irn)) == NULL) {
+                continue;
+            }
+            result->instruction = LOAD_CONSTANT;
+            result->IMMVAL = value;
+            cg->changed[i] = TRUE;
+            propagated++;
+        }
+    }
+    return propagated;
+}
+
+/* is reg defined once in the procedure, by loading a constant? */
+Boolean constant_register(IrNode *begin, int reg, int *value) {
+    IrNode *irn, *def = NULL;
+    int *d;
+
+    for (irn = begin; instruction(irn) != END_PROC; irn = irn->next) {
+        d = ir_node_def(irn);
+        if (d != NULL && *d == reg) {
+            if (def != NULL) {
+                return FALSE;
+            }
+            def = irn;
+        }
+    }
+    if (def == NULL || instruction(def) != LOAD_CONSTANT) {
+        return FALSE;
+    }
+    *value = def->IMMVAL;
+    return TRUE;
+}
+
+/* the END_PROC of the procedure begin starts */
+IrNode *procedure_end(IrNode *begin) {
+    IrNode *irn = begin;
+    while (instruction(irn) != END_PROC) {
+        irn = irn->next;
+    }
+    return irn;
+}
+
+/* the RETURNED_WORD reading the result of call, NULL if it is not read */
+IrNode *call_result(IrNode *call) {
+    IrNode *irn = call->next->next;
+    return irn != NULL && instruction(irn) == RETURNED_WORD ? irn : NULL;
+}
+
+/*
+ * reuse_pure_calls
+ * Purpose: remove calls to const and pure procedures whose result is
+ *          unused, or was computed by the same call earlier in the block
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure in SSA form, its calls tagged by
+ *        tag_call_effects
+ * Returns:
+ *  The number of calls removed
+ * Side Effects:
+ *  The result of a repeated call becomes a copy of the earlier result. A
+ *  call to a pure procedure is not reused past an instruction that may
+ *  write memory.
+ */
+int reuse_pure_calls(ControlFlowGraph *cfg) {
+    IrNode *irn, *next, **seen = NULL, *result, *tail;
+    BasicBlock *b;
+    int i, j, k, num_seen, *use_counts, removed = 0;
+
+    use_counts = register_use_counts(cfg);
+    util_emalloc((void **) &seen, (cfg->num_regs + 1) * sizeof(IrNode *));
+    for (i = 0; i < cfg->num_rpo; i++) {
+        b = cfg->rpo[i];
+        num_seen = 0;
+        for (irn = b->first; irn != NULL; irn = next) {
+            next = irn == b->last ? NULL : irn->next;
+            if (instruction(irn) != CALL || irn->IMMVAL == CALL_ANY_EFFECTS) {
+                if (writes_memory(irn)) {
+                    /* only the const calls are still known to give the same */
+                    for (j = k = 0; j < num_seen; j++) {
+                        if (seen[j]->IMMVAL == CALL_CONST) {
+                            seen[k++] = seen[j];
+                        }
+                    }
+                    num_seen = k;
+                }
+                continue;
+            }
+            result = call_result(irn);
+            if (result == NULL || use_counts[result->RDEST] == 0) {
+                tail = result == NULL ? irn->next : result;
+                next = tail == b->last ? NULL : tail->next;
+                remove_call(irn, cfg);
+                if (result != NULL) {
+                    remove_block_node(result, cfg);
+                }
+                removed++;
+                continue;
+            }
+            for (j = 0; j < num_seen && !(seen[j]->s == irn->s &&
+                    same_arguments(seen[j], irn)); j++)
+                ;
+            if (j == num_seen) {
+                seen[num_seen++] = irn;
+                continue;
+            }
+            result->instruction = MOVE;
+            result->RSRC = call_result(seen[j])->RDEST;
+            next = result;
+            remove_call(irn, cfg);
+            removed++;
+        }
+    }
+    free(seen);
+    free(use_counts);
+    return removed;
+}
+
+/* do the two calls pass the same registers? */
+Boolean same_arguments(IrNode *call1, IrNode *call2) {
+    IrNode *a = call1->prev, *b = call2->prev;
+    while (instruction(a) == PARAM && instruction(b) == PARAM) {
+        if (a->RDEST != b->RDEST || a->RSRC != b->RSRC) {
+            return FALSE;
+        }
+        a = a->prev;
+        b = b->prev;
+    }
+    return instruction(a) != PARAM && instruction(b) != PARAM ? TRUE : FALSE;
+}
+
+/* unlink a call from its BEGIN_CALL through its END_CALL, arguments aside */
+void remove_call(IrNode *call, ControlFlowGraph *cfg) {
+    IrNode *begin = call_begin(call), *end = call->next;
+    while (instruction(call->prev) == PARAM) {
+        remove_block_node(call->prev, cfg);
+    }
+    remove_block_node(call, cfg);
+    remove_block_node(end, cfg);
+    if (begin != NULL) {
+        remove_block_node(begin, cfg);
+    }
+}
+
+/* the number of reads of each register, in PHI arguments too */
+int *register_use_counts(ControlFlowGraph *cfg) {
+    IrNode *irn;
+    int *uses[MAX_USES], *counts;
+    int i, n;
+
+    util_emalloc((void **) &counts, (cfg->num_regs + 1) * sizeof(int));
+    for (i = 0; i < cfg->num_regs; i++) {
+        counts[i] = 0;
+    }
+    for (irn = cfg->begin_proc; irn != cfg->end_proc; irn = irn->next) {
+        /* NO_ARG stands for a value never computed */
+        n = ir_node_uses(irn, uses);
+        for (i = 0; i < n; i++) {
+            if (*uses[i] != NO_ARG) {
+                counts[*uses[i]]++;
+            }
+        }
+        for (i = 0; i < irn->num_phi_args; i++) {
+            if (irn->phi_args[i].reg != NO_ARG) {
+                counts[irn->phi_args[i].reg]++;
+            }
+        }
+    }
+    return counts;
+}
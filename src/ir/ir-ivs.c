@@ -0,0 +1,767 @@
+/*
+ * Induction variable strength reduction over the natural loops of a
+ * procedure in SSA form.
+ *
+ * A basic induction variable is a PHI of a loop header that starts from a
+ * value entering from the preheader and comes back around the loop as
+ * itself plus a constant step. A value the loop computes as
+ * base + offset + scale * i, for a basic induction variable i, an invariant
+ * base and constants offset and scale, is a derived induction variable: the
+ * address of a[i] is one, with the address of a for its base and the size
+ * of an element for its scale. A multiply or shift of i by a constant, and
+ * an address adding an invariant to a multiple of i, is replaced by a
+ * recurrence of its own: a new PHI in the header that starts from the
+ * derived value of the initial i and steps by scale times i's step wherever
+ * i steps. The multiply and add per iteration become one add.
+ *
+ * When all that is left of i is its step and the test that ends the loop,
+ * comparing it with a constant, the test is rewritten to compare one of the
+ * recurrences with the derived value of the constant instead (linear-
+ * function test replacement). i, its step and whatever else the rewriting
+ * leaves unused are then deleted, dead cycles around the loop included. The
+ * recurrence compared must not overflow where i does not: it either has no
+ * base and stays within a word, or is offset from a global's address by
+ * less than the gap between the data and the ends of the address space.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-opt.h"
+#include "../include/utilities.h"
+
+/* the furthest a compared recurrence may get from a global's address */
+#define TEST_RANGE 0x1000000
+/* the largest scale or step a compared recurrence may have */
+#define TEST_STEP 0x10000
+#define WORD_LIMIT 2147483647.0
+
+/*
+ * Induction
+ * A basic induction variable: its header PHI, the instruction adding its
+ * step around the loop, the register it starts from and the step
+ */
+struct Induction {
+    IrNode *phi;
+    IrNode *step;
+    int init;
+    int increment;
+};
+typedef struct Induction Induction;
+
+/*
+ * Affine
+ * A register's value as base + offset + scale * i, for the value of the
+ * induction variable i in the same iteration
+ */
+struct Affine {
+    int iv;                     /* index of i, NO_ARG if not derived      */
+    int base;                   /* an invariant register, or NO_ARG       */
+    int offset;
+    int scale;
+};
+typedef struct Affine Affine;
+
+/* a recurrence added for a derived induction variable */
+struct Recurrence {
+    Affine value;
+    int reg;                    /* its header PHI's register              */
+    int next;                   /* its value for the next iteration       */
+};
+typedef struct Recurrence Recurrence;
+
+struct IvState {
+    ControlFlowGraph *cfg;
+    Loop *loop;
+    IrNode **defs;              /* per register: its definition           */
+    int *num_defs;
+    int num_regs;               /* registers defs and affine cover        */
+    Induction *ivs;
+    int num_ivs;
+    Affine *affine;             /* per register: its value, if derived    */
+    Recurrence *recs;
+    int num_recs;
+    int reduced;
+};
+typedef struct IvState IvState;
+
+/* file helper functions */
+void reduce_loop(IvState *is);
+void find_inductions(IvState *is);
+Boolean step_increment(IvState *is, IrNode *step, int reg, int *increment);
+void derive_value(IvState *is, IrNode *irn);
+Affine *derived_value(IvState *is, int reg);
+IrNode *single_def(IvState *is, int reg);
+Boolean iv_constant(IvState *is, int reg, int *value);
+Boolean iv_invariant(IvState *is, int reg);
+Boolean is_loop_address(IvState *is, int reg);
+Recurrence *recurrence_for(IvState *is, Affine *a);
+int initial_value(IvState *is, Affine *a);
+int emit_constant(IvState *is, BasicBlock *b, int value);
+int emit_binary(IvState *is, BasicBlock *b, int instr, int a, int b_reg);
+void insert_node_after(ControlFlowGraph *cfg, IrNode *pos, IrNode *irn);
+void replace_loop_tests(IvState *is);
+IrNode *loop_test(IvState *is, Induction *iv);
+Recurrence *comparable_recurrence(IvState *is, Induction *iv, int limit);
+void replace_test(IvState *is, Recurrence *rec, IrNode *test, int limit);
+int register_uses(ControlFlowGraph *cfg, int reg);
+
+
+/*
+ * reduce_induction_variables
+ * Purpose: turn the multiplies by constants a loop does with its induction
+ *          variables, such as scaling array indices, into additions
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure in SSA form
+ * Returns:
+ *  The number of instructions reduced and loop tests replaced
+ * Side Effects:
+ *  Adds preheaders to loops that need one and rebuilds the CFG if it does.
+ *  Adds PHIs, their starting values and steps; reduced instructions become
+ *  copies. Deletes the induction variables and other values left unused.
+ */
+int reduce_induction_variables(ControlFlowGraph *cfg) {
+    IvState is;
+    Loop *loops;
+    int num_loops, i;
+
+    insert_preheaders(cfg);
+    loops = find_loops(cfg, &num_loops);
+    is.cfg = cfg;
+    is.reduced = 0;
+    for (i = 0; i < num_loops; i++) {
+        if (loops[i].preheader != NULL && loops[i].header->num_preds == 2) {
+            is.loop = &loops[i];
+            reduce_loop(&is);
+        }
+    }
+    free_loops(loops, num_loops);
+    return is.reduced;
+}
+
+/* reduce the derived induction variables of is->loop, then its test */
+void reduce_loop(IvState *is) {
+    ControlFlowGraph *cfg = is->cfg;
+    BasicBlock *b;
+    IrNode *irn;
+    int i, reduced = is->reduced;
+
+    is->defs = register_defs(cfg, &is->num_defs);
+    is->num_regs = cfg->num_regs;
+    util_emalloc((void **) &is->affine, (is->num_regs + 1) * sizeof(Affine));
+    for (i = 0; i < is->num_regs; i++) {
+        is->affine[i].iv = NO_ARG;
+    }
+    is->ivs = NULL;
+    is->num_ivs = 0;
+    is->recs = NULL;
+    is->num_recs = 0;
+    find_inductions(is);
+    /* in reverse postorder, operands are seen before what reads them */
+    for (i = 0; i < cfg->num_rpo && is->num_ivs > 0; i++) {
+        b = cfg->rpo[i];
+        if (!is->loop->body[b->id] || b->first == b->last) {
+            continue;
+        }
+        for (irn = b->first->next; irn != NULL;
+                irn = irn == b->last ? NULL : irn->next) {
+            derive_value(is, irn);
+        }
+    }
+    if (is->reduced > reduced) {
+        sweep_dead_values(cfg);
+        replace_loop_tests(is);
+    }
+    free(is->defs);
+    free(is->num_defs);
+    free(is->affine);
+    free(is->ivs);
+    free(is->recs);
+}
+
+/* find the basic induction variables among the PHIs of the loop header */
+void find_inductions(IvState *is) {
+    BasicBlock *h = is->loop->header;
+    IrNode *irn, *step;
+    Induction *iv;
+    int back, increment;
+
+    for (irn = h->first == h->last ? NULL : h->first->next;
+            irn != NULL && instruction(irn) == PHI;
+            irn = irn == h->last ? NULL : irn->next) {
+        /* the header has the preheader and one block of the loop entering */
+        back = is->loop->body[irn->phi_args[0].pred->bb->id] ? 0 : 1;
+        step = single_def(is, irn->phi_args[back].reg);
+        if (single_def(is, irn->RDEST) != irn || step == NULL ||
+                !is->loop->body[step->bb->id] ||
+                !step_increment(is, step, irn->RDEST, &increment)) {
+            continue;
+        }
+        util_erealloc((void **) &is->ivs,
+                        (is->num_ivs + 1) * sizeof(Induction));
+        iv = &is->ivs[is->num_ivs];
+        iv->phi = irn;
+        iv->step = step;
+        iv->init = irn->phi_args[1 - back].reg;
+        iv->increment = increment;
+        is->affine[irn->RDEST].iv = is->num_ivs++;
+        is->affine[irn->RDEST].base = NO_ARG;
+        is->affine[irn->RDEST].offset = 0;
+        is->affine[irn->RDEST].scale = 1;
+    }
+}
+
+/* does step add a constant to reg? increment is set to the constant */
+Boolean step_increment(IvState *is, IrNode *step, int reg, int *increment) {
+    switch (instruction(step)) {
+        case ADD_CONST:
+            *increment = step->IMMVAL;
+            return step->RSRC == reg ? TRUE : FALSE;
+        case ADD:
+            return (step->OPRND1 == reg &&
+                        iv_constant(is, step->OPRND2, increment)) ||
+                    (step->OPRND2 == reg &&
+                        iv_constant(is, step->OPRND1, increment)) ?
+                    TRUE : FALSE;
+        case SUB:
+            if (step->OPRND1 != reg ||
+                    !iv_constant(is, step->OPRND2, increment)) {
+                return FALSE;
+            }
+            fold_binary_op(SUB, 0, *increment, increment);
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/*
+ * record the derived induction variable irn computes, if it does, and
+ * replace irn by a copy of a recurrence if that saves a multiply or an add
+ */
+void derive_value(IvState *is, IrNode *irn) {
+    Affine a, *x;
+    Recurrence *rec;
+    Boolean reduce = FALSE;
+    int instr = instruction(irn), other, value;
+
+    if (single_def(is, irn->RDEST) != irn) {
+        return;
+    }
+    switch (instr) {
+        case MOVE:
+        case ADD_CONST:
+            if ((x = derived_value(is, irn->RSRC)) == NULL) {
+                return;
+            }
+            a = *x;
+            if (instr == ADD_CONST) {
+                fold_binary_op(ADD, a.offset, irn->IMMVAL, &a.offset);
+            }
+            break;
+        case ADD:
+        case SUB:
+            x = derived_value(is, irn->OPRND1);
+            other = irn->OPRND2;
+            if (x == NULL && instr == ADD) {
+                x = derived_value(is, irn->OPRND2);
+                other = irn->OPRND1;
+            }
+            if (x == NULL) {
+                return;
+            }
+            a = *x;
+            if (iv_constant(is, other, &value)) {
+                fold_binary_op(instr, a.offset, value, &a.offset);
+            } else if (instr == ADD && a.base == NO_ARG &&
+                        iv_invariant(is, other)) {
+                a.base = other;
+                reduce = a.scale != 1 || is_loop_address(is, irn->RDEST);
+            } else {
+                return;
+            }
+            break;
+        case MULT:
+        case SHIFT_LEFT:
+            x = derived_value(is, irn->OPRND1);
+            other = irn->OPRND2;
+            if (x == NULL && instr == MULT) {
+                x = derived_value(is, irn->OPRND2);
+                other = irn->OPRND1;
+            }
+            if (x == NULL || !iv_constant(is, other, &value)) {
+                return;
+            }
+            if (instr == SHIFT_LEFT) {
+                fold_binary_op(SHIFT_LEFT, 1, value, &value);
+            }
+            a = *x;
+            fold_binary_op(MULT, a.scale, value, &a.scale);
+            fold_binary_op(MULT, a.offset, value, &a.offset);
+            if (a.scale == 0) {
+                return;
+            }
+            if (a.base != NO_ARG) {
+                /* the invariant part is scaled once, before the loop */
+                a.base = emit_binary(is, is->loop->preheader, MULT, a.base,
+                            emit_constant(is, is->loop->preheader, value));
+            }
+            reduce = TRUE;
+            break;
+        default:
+            return;
+    }
+    is->affine[irn->RDEST] = a;
+    if (reduce) {
+        rec = recurrence_for(is, &a);
+        irn->instruction = MOVE;
+        irn->RSRC = rec->reg;
+        irn->OPRND1 = NO_ARG;
+        irn->OPRND2 = NO_ARG;
+        is->reduced++;
+    }
+}
+
+/* the value of reg as a derived induction variable, NULL if it is not one */
+Affine *derived_value(IvState *is, int reg) {
+    if (reg < 0 || reg >= is->num_regs || is->affine[reg].iv == NO_ARG) {
+        return NULL;
+    }
+    return &is->affine[reg];
+}
+
+/* the instruction setting reg, NULL unless there is exactly one */
+IrNode *single_def(IvState *is, int reg) {
+    if (reg < 0 || reg >= is->num_regs || is->num_defs[reg] != 1) {
+        return NULL;
+    }
+    return is->defs[reg];
+}
+
+/* is reg only ever set to a constant? value is set to the constant */
+Boolean iv_constant(IvState *is, int reg, int *value) {
+    IrNode *def = single_def(is, reg);
+    if (def == NULL || instruction(def) != LOAD_CONSTANT) {
+        return FALSE;
+    }
+    *value = def->IMMVAL;
+    return TRUE;
+}
+
+/* is reg set once, outside the loop? */
+Boolean iv_invariant(IvState *is, int reg) {
+    IrNode *def = single_def(is, reg);
+    return def != NULL && !is->loop->body[def->bb->id] ? TRUE : FALSE;
+}
+
+/* does the loop load or store through the address in reg? */
+Boolean is_loop_address(IvState *is, int reg) {
+    ControlFlowGraph *cfg = is->cfg;
+    IrNode *irn;
+    int i;
+
+    for (i = 0; i < cfg->num_blocks; i++) {
+        if (!is->loop->body[i]) {
+            continue;
+        }
+        FOR_EACH_BLOCK_NODE(irn, cfg->blocks[i]) {
+            switch (instruction(irn)) {
+                case STORE_BYTE_INDIRECT:
+                case STORE_HALF_WORD_INDIRECT:
+                case STORE_WORD_INDIRECT:
+                    if (irn->RDEST == reg) {
+                        return TRUE;
+                    }
+                    break;
+                default:
+                    if (is_memory_load(irn) && irn->RSRC == reg) {
+                        return TRUE;
+                    }
+                    break;
+            }
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * the recurrence computing a, added to the loop if there is none yet: a PHI
+ * in the header starting from a's value for the initial induction variable
+ * and stepping right after the induction variable does
+ */
+Recurrence *recurrence_for(IvState *is, Affine *a) {
+    ControlFlowGraph *cfg = is->cfg;
+    BasicBlock *h = is->loop->header, *b;
+    Induction *iv = &is->ivs[a->iv];
+    Recurrence *rec;
+    IrNode *phi, *step, *k;
+    int i, start, increment;
+
+    for (i = 0; i < is->num_recs; i++) {
+        rec = &is->recs[i];
+        if (rec->value.iv == a->iv && rec->value.base == a->base &&
+                rec->value.offset == a->offset &&
+                rec->value.scale == a->scale) {
+            return rec;
+        }
+    }
+    start = initial_value(is, a);
+    util_erealloc((void **) &is->recs,
+                    (is->num_recs + 1) * sizeof(Recurrence));
+    rec = &is->recs[is->num_recs++];
+    rec->value = *a;
+    rec->reg = new_reg(cfg);
+    rec->next = new_reg(cfg);
+
+    phi = construct_ir_node(PHI);
+    phi->RDEST = rec->reg;
+    phi->num_phi_args = h->num_preds;
+    util_emalloc((void **) &phi->phi_args, h->num_preds * sizeof(PhiArg));
+    for (i = 0; i < h->num_preds; i++) {
+        b = h->preds[i];
+        phi->phi_args[i].reg = is->loop->body[b->id] ? rec->next : start;
+        phi->phi_args[i].pred = b->first;
+    }
+    insert_at_block_start(h, phi, cfg);
+
+    /* the constant goes in the step's block, to be read as an immediate */
+    fold_binary_op(MULT, a->scale, iv->increment, &increment);
+    k = construct_ir_node(LOAD_CONSTANT);
+    k->RDEST = new_reg(cfg);
+    k->IMMVAL = increment;
+    insert_node_after(cfg, iv->step, k);
+    step = construct_ir_node(ADD);
+    step->RDEST = rec->next;
+    step->OPRND1 = rec->reg;
+    step->OPRND2 = k->RDEST;
+    insert_node_after(cfg, k, step);
+    return rec;
+}
+
+/* compute, in the preheader, the value of a for the initial induction var */
+int initial_value(IvState *is, Affine *a) {
+    BasicBlock *preheader = is->loop->preheader;
+    int init = is->ivs[a->iv].init, value, start;
+
+    if (iv_constant(is, init, &value)) {
+        fold_binary_op(MULT, a->scale, value, &value);
+        fold_binary_op(ADD, a->offset, value, &value);
+        if (a->base != NO_ARG && value == 0) {
+            return a->base;
+        }
+        start = emit_constant(is, preheader, value);
+    } else {
+        start = init;
+        if (a->scale != 1) {
+            start = emit_binary(is, preheader, MULT, start,
+                                emit_constant(is, preheader, a->scale));
+        }
+        if (a->offset != 0) {
+            start = emit_binary(is, preheader, ADD, start,
+                                emit_constant(is, preheader, a->offset));
+        }
+    }
+    if (a->base != NO_ARG) {
+        start = emit_binary(is, preheader, ADD, a->base, start);
+    }
+    return start;
+}
+
+/* load value into a new register at the end of b */
+int emit_constant(IvState *is, BasicBlock *b, int value) {
+    IrNode *irn = construct_ir_node(LOAD_CONSTANT);
+    irn->RDEST = new_reg(is->cfg);
+    irn->IMMVAL = value;
+    insert_before_terminator(b, irn, is->cfg);
+    return irn->RDEST;
+}
+
+/* compute a instr b_reg into a new register at the end of b */
+int emit_binary(IvState *is, BasicBlock *b, int instr, int a, int b_reg) {
+    IrNode *irn = construct_ir_node(instr);
+    irn->RDEST = new_reg(is->cfg);
+    irn->OPRND1 = a;
+    irn->OPRND2 = b_reg;
+    insert_before_terminator(b, irn, is->cfg);
+    return irn->RDEST;
+}
+
+/* insert irn after pos, in pos's block */
+void insert_node_after(ControlFlowGraph *cfg, IrNode *pos, IrNode *irn) {
+    irn->bb = pos->bb;
+    insert_ir_node_after(pos, irn, cfg->irl);
+    if (pos->bb->last == pos) {
+        pos->bb->last = irn;
+    }
+}
+
+/*
+ * compare a recurrence instead of each induction variable that is left
+ * only for the test ending the loop, and delete the variables
+ */
+void replace_loop_tests(IvState *is) {
+    Induction *iv;
+    IrNode *test;
+    Recurrence *rec;
+    int i, limit, replaced = 0;
+
+    /* the sweep deleted some definitions, and recurrences may be among them */
+    free(is->defs);
+    free(is->num_defs);
+    is->defs = register_defs(is->cfg, &is->num_defs);
+    for (i = 0; i < is->num_ivs; i++) {
+        iv = &is->ivs[i];
+        if (is->defs[iv->phi->RDEST] != iv->phi ||
+                is->defs[iv->step->RDEST] != iv->step) {
+            continue;
+        }
+        test = loop_test(is, iv);
+        if (test == NULL) {
+            continue;
+        }
+        iv_constant(is, test->OPRND2, &limit);
+        rec = comparable_recurrence(is, iv, limit);
+        if (rec != NULL) {
+            replace_test(is, rec, test, limit);
+            replaced++;
+        }
+    }
+    if (replaced > 0) {
+        sweep_dead_values(is->cfg);
+        is->reduced += replaced;
+    }
+}
+
+/*
+ * the comparison of iv with a constant that ends the loop, if iv has no
+ * other use but its step: one in the header or in the block going back to
+ * it, so every iteration runs it, whose failing leaves the loop while iv
+ * steps toward the constant. The comparison is turned around to put iv on
+ * the left. NULL if there is no such comparison.
+ */
+IrNode *loop_test(IvState *is, Induction *iv) {
+    ControlFlowGraph *cfg = is->cfg;
+    BasicBlock *b;
+    IrNode *test = NULL, *irn, *jump;
+    Boolean continues;
+    int phi = iv->phi->RDEST, next = iv->step->RDEST, instr, value, tmp, i;
+
+    /* the step and the PHI are two of the uses */
+    if (register_uses(cfg, phi) + register_uses(cfg, next) != 3) {
+        return NULL;
+    }
+    for (i = 0; i < cfg->num_blocks && test == NULL; i++) {
+        if (!is->loop->body[i]) {
+            continue;
+        }
+        FOR_EACH_BLOCK_NODE(irn, cfg->blocks[i]) {
+            if (irn != iv->step && instruction(irn) != PHI &&
+                    (irn->OPRND1 == phi || irn->OPRND1 == next ||
+                     irn->OPRND2 == phi || irn->OPRND2 == next)) {
+                test = irn;
+                break;
+            }
+        }
+    }
+    if (test == NULL) {
+        return NULL;
+    }
+    instr = instruction(test);
+    if (instr != SET_LT && instr != SET_LE && instr != SET_GT &&
+            instr != SET_GE) {
+        return NULL;
+    }
+    if (test->OPRND2 == phi || test->OPRND2 == next) {
+        tmp = test->OPRND1;
+        test->OPRND1 = test->OPRND2;
+        test->OPRND2 = tmp;
+        test->instruction = mirrored_test(instr);
+    }
+    b = test->bb;
+    jump = block_terminator(b);
+    if (!iv_constant(is, test->OPRND2, &value) ||
+            (b != is->loop->header && pred_index(is->loop->header, b) == -1) ||
+            jump == NULL || jump->RSRC != test->RDEST ||
+            (instruction(jump) != JUMP_EQZ && instruction(jump) != JUMP_NEZ) ||
+            register_uses(cfg, test->RDEST) != 1 || b->num_succs != 2 ||
+            is->loop->body[b->succs[0]->id] ==
+                is->loop->body[b->succs[1]->id]) {
+        return NULL;
+    }
+    /* does the loop go on when the comparison holds? */
+    continues = (instruction(jump) == JUMP_EQZ) ==
+                    !is->loop->body[jump->branch->bb->id] ? TRUE : FALSE;
+    instr = instruction(test);
+    if (!continues) {
+        instr = instr == SET_LT ? SET_GE : instr == SET_LE ? SET_GT :
+                instr == SET_GT ? SET_LE : SET_LT;
+    }
+    if (iv->increment > 0 ? instr != SET_LT && instr != SET_LE :
+                            instr != SET_GT && instr != SET_GE) {
+        return NULL;
+    }
+    return test;
+}
+
+/*
+ * a recurrence of iv that stays in range over the values test compares: a
+ * word, or near enough to the global it is offset from not to wrap
+ */
+Recurrence *comparable_recurrence(IvState *is, Induction *iv, int limit) {
+    Recurrence *rec;
+    IrNode *base;
+    double lo, hi, step, bound;
+    int i, init;
+
+    if (!iv_constant(is, iv->init, &init) || iv->increment >= TEST_STEP ||
+            iv->increment <= -TEST_STEP) {
+        return NULL;
+    }
+    /* test sees iv or its next value, between the start and the limit */
+    step = iv->increment < 0 ? -2.0 * iv->increment : 2.0 * iv->increment;
+    lo = (init < limit ? init : limit) - step;
+    hi = (init < limit ? limit : init) + step;
+    for (i = 0; i < is->num_recs; i++) {
+        rec = &is->recs[i];
+        if (rec->value.iv != iv - is->ivs || is->defs[rec->reg] == NULL ||
+                rec->value.scale >= TEST_STEP ||
+                rec->value.scale <= -TEST_STEP) {
+            continue;
+        }
+        bound = WORD_LIMIT;
+        if (rec->value.base != NO_ARG) {
+            base = is->defs[rec->value.base];
+            if (base == NULL || instruction(base) != LOAD_ADDRESS ||
+                    !is_global_symbol(base->s)) {
+                continue;
+            }
+            bound = (double) TEST_RANGE;
+        }
+        if (rec->value.scale * lo + rec->value.offset < bound &&
+                rec->value.scale * lo + rec->value.offset > -bound &&
+                rec->value.scale * hi + rec->value.offset < bound &&
+                rec->value.scale * hi + rec->value.offset > -bound) {
+            return rec;
+        }
+    }
+    return NULL;
+}
+
+/* compare rec, in place of its induction variable, with limit's value */
+void replace_test(IvState *is, Recurrence *rec, IrNode *test, int limit) {
+    IrNode *k;
+    int value;
+
+    test->OPRND1 = test->OPRND1 == is->ivs[rec->value.iv].phi->RDEST ?
+                    rec->reg : rec->next;
+    fold_binary_op(MULT, rec->value.scale, limit, &value);
+    fold_binary_op(ADD, rec->value.offset, value, &value);
+    if (rec->value.base == NO_ARG) {
+        /* in the test's block, to be read as an immediate */
+        k = construct_ir_node(LOAD_CONSTANT);
+        k->RDEST = new_reg(is->cfg);
+        k->IMMVAL = value;
+        k->bb = test->bb;
+        insert_ir_node_before(test, k, is->cfg->irl);
+        test->OPRND2 = k->RDEST;
+    } else {
+        test->OPRND2 = emit_binary(is, is->loop->preheader, ADD,
+                            rec->value.base,
+                            emit_constant(is, is->loop->preheader, value));
+    }
+    if (rec->value.scale < 0) {
+        test->instruction = mirrored_test(instruction(test));
+    }
+}
+
+/*
+ * mirrored_test
+ * Purpose: give the comparison that holds with its operands swapped
+ * Parameters:
+ *  instr - int - SET_LT, SET_LE, SET_GT or SET_GE, or any other
+ *          instruction
+ * Returns:
+ *  The comparison that holds of b and a when instr holds of a and b;
+ *  instr itself when the order does not matter or it is no comparison
+ * Side Effects:
+ *  None
+ */
+int mirrored_test(int instr) {
+    switch (instr) {
+        case SET_LT: return SET_GT;
+        case SET_LE: return SET_GE;
+        case SET_GT: return SET_LT;
+        case SET_GE: return SET_LE;
+        default: return instr;
+    }
+}
+
+/* how many times instructions and PHIs of the procedure read reg */
+int register_uses(ControlFlowGraph *cfg, int reg) {
+    IrNode *irn;
+    int *uses[MAX_USES], i, n, count = 0;
+
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = irn->next) {
+        n = ir_node_uses(irn, uses);
+        for (i = 0; i < n; i++) {
+            count += *uses[i] == reg ? 1 : 0;
+        }
+        for (i = 0; i < irn->num_phi_args; i++) {
+            count += irn->phi_args[i].reg == reg ? 1 : 0;
+        }
+    }
+    return count;
+}
+
+/*
+ * sweep_dead_values
+ * Purpose: delete the instructions without effects whose values nothing
+ *          with an effect needs, even through PHIs around a loop, which
+ *          liveness would keep
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure in SSA form
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Removes the instructions and PHIs found dead
+ */
+void sweep_dead_values(ControlFlowGraph *cfg) {
+    IrNode *irn, *next;
+    Boolean *needed, changed = TRUE;
+    int *uses[MAX_USES], *def, i, n;
+
+    util_emalloc((void **) &needed, (cfg->num_regs + 1) * sizeof(Boolean));
+    for (i = 0; i < cfg->num_regs; i++) {
+        needed[i] = FALSE;
+    }
+    /* backward, most values are needed by the time their operands are met */
+    while (changed) {
+        changed = FALSE;
+        for (irn = cfg->end_proc->prev; irn != cfg->begin_proc;
+                irn = irn->prev) {
+            def = ir_node_def(irn);
+            if (def != NULL && *def >= 0 && !needed[*def] &&
+                    (instruction(irn) == PHI || !has_side_effects(irn))) {
+                continue;
+            }
+            n = ir_node_uses(irn, uses);
+            for (i = 0; i < n + irn->num_phi_args; i++) {
+                def = i < n ? uses[i] : &irn->phi_args[i - n].reg;
+                if (*def >= 0 && !needed[*def]) {
+                    needed[*def] = TRUE;
+                    changed = TRUE;
+                }
+            }
+        }
+    }
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = next) {
+        next = irn->next;
+        def = ir_node_def(irn);
+        if (def != NULL && *def >= 0 && !needed[*def] &&
+                (instruction(irn) == PHI || !has_side_effects(irn))) {
+            remove_block_node(irn, cfg);
+        }
+    }
+    free(needed);
+}
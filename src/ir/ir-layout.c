@@ -0,0 +1,498 @@
+/*
+ * Loop rotation and static block layout over a procedure outside SSA form.
+ *
+ * compute_ir lays a loop out with its test at the top and a jump back to
+ * the test at the bottom, so every iteration takes two branches. Rotation
+ * copies the header to the end of the loop, its exit turned around into a
+ * branch back to the top of the body while the loop goes on. The header is
+ * left to guard the way in, and the loop runs as a do-while taking one
+ * branch an iteration. Only headers of at most MAX_ROTATED_HEADER
+ * instructions are copied, and only when their exit tests a register for
+ * zero, the one test that can be turned around.
+ *
+ * Blocks are then placed in chains, each followed by the successor it is
+ * most likely to go to, so that the likely way is a fall-through. With no
+ * profile, likelihood is guessed from the shape of the code: a branch back
+ * to a loop's header is taken, a branch leaving a loop is not, and a block
+ * returning early is cold when the other way from its branch does not
+ * return. A block is only pulled up to follow a block jumping to it when
+ * no other block falls into it. Cold blocks go to the end, before the
+ * return label, which stays last so that the epilogue follows it.
+ * Conditional jumps are turned around, and jumps added or dropped, to suit
+ * the new order.
+ *
+ * Last, a jump to a block that only jumps goes where that block goes, and
+ * a jump to a block that only returns returns instead.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-opt.h"
+#include "../include/utilities.h"
+
+/* the most instructions of a loop header copied to the end of the loop */
+#define MAX_ROTATED_HEADER 8
+
+struct Layout {
+    ControlFlowGraph *cfg;
+    Loop **innermost;           /* per block: the smallest loop holding it */
+    Boolean *cold;              /* per block: returns early                */
+    Boolean *placed;
+    BasicBlock **order;
+    int num_placed;
+};
+typedef struct Layout Layout;
+
+/* file helper functions */
+void join_blocks(ControlFlowGraph *cfg);
+Boolean rotate_loop(ControlFlowGraph *cfg, Loop *loop, Boolean *changed);
+Boolean is_conditional_jump(IrNode *irn);
+int turned_around(int instr);
+Boolean returns_early(ControlFlowGraph *cfg, BasicBlock *b);
+BasicBlock *likely_successor(Layout *ly, BasicBlock *b);
+BasicBlock *chain_successor(Layout *ly, BasicBlock *b);
+Boolean can_follow(Layout *ly, BasicBlock *b, BasicBlock *s);
+BasicBlock *fall_through(ControlFlowGraph *cfg, BasicBlock *b);
+void place_block(Layout *ly, BasicBlock *b);
+void fix_block_exit(ControlFlowGraph *cfg, BasicBlock *b, BasicBlock *next);
+void relink_blocks(Layout *ly);
+IrNode *lone_instruction(BasicBlock *b);
+
+
+/*
+ * rotate_loops
+ * Purpose: turn loops testing at the top into guarded loops testing at the
+ *          bottom
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure not in SSA form
+ * Returns:
+ *  The number of loops rotated
+ * Side Effects:
+ *  Joins blocks split by labels nothing jumps to. Copies the header of
+ *  each loop rotated before the jump back to it, which becomes a branch to
+ *  the top of the body followed by a jump out of the loop. Rebuilds the
+ *  CFG.
+ */
+int rotate_loops(ControlFlowGraph *cfg) {
+    Loop *loops;
+    Boolean *changed;
+    int num_loops, rotated = 0, i;
+
+    join_blocks(cfg);
+    loops = find_loops(cfg, &num_loops);
+    util_emalloc((void **) &changed, cfg->num_blocks * sizeof(Boolean));
+    for (i = 0; i < cfg->num_blocks; i++) {
+        changed[i] = FALSE;
+    }
+    for (i = 0; i < num_loops; i++) {
+        if (rotate_loop(cfg, &loops[i], changed)) {
+            rotated++;
+        }
+    }
+    free(changed);
+    free_loops(loops, num_loops);
+    rebuild_cfg(cfg);
+    return rotated;
+}
+
+/* remove the labels nothing jumps to, joining the blocks they split */
+void join_blocks(ControlFlowGraph *cfg) {
+    Boolean *targeted;
+    BasicBlock *b;
+    IrNode *irn;
+    int i;
+
+    util_emalloc((void **) &targeted, cfg->num_blocks * sizeof(Boolean));
+    for (i = 0; i < cfg->num_blocks; i++) {
+        targeted[i] = i == 0 ? TRUE : FALSE;
+    }
+    for (i = 0; i < cfg->num_blocks; i++) {
+        irn = block_terminator(cfg->blocks[i]);
+        if (irn != NULL) {
+            targeted[irn->branch->bb->id] = TRUE;
+        }
+    }
+    for (i = 1; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        if (!targeted[i] && !is_jump(cfg->blocks[i - 1]->last)) {
+            remove_ir_node(b->first, cfg->irl);
+        }
+    }
+    free(targeted);
+    rebuild_cfg(cfg);
+}
+
+/*
+ * rotate loop if its header leaves it by a test for zero and falls into
+ * it, and one block jumps back to it; changed marks the blocks an earlier
+ * rotation copied into or from
+ */
+Boolean rotate_loop(ControlFlowGraph *cfg, Loop *loop, Boolean *changed) {
+    BasicBlock *h = loop->header, *latch = NULL, *body, *out;
+    IrNode *test = block_terminator(h), *back, *irn;
+    int size = 0, i;
+
+    if (test == NULL || (instruction(test) != JUMP_EQZ &&
+            instruction(test) != JUMP_NEZ) || changed[h->id]) {
+        return FALSE;
+    }
+    body = fall_through(cfg, h);
+    out = test->branch->bb;
+    if (body == NULL || !loop->body[body->id] || loop->body[out->id]) {
+        return FALSE;
+    }
+    for (i = 0; i < h->num_preds; i++) {
+        if (loop->body[h->preds[i]->id]) {
+            if (latch != NULL) {
+                return FALSE;
+            }
+            latch = h->preds[i];
+        }
+    }
+    if (latch == NULL || latch == h || changed[latch->id] ||
+            instruction(latch->last) != JUMP) {
+        return FALSE;
+    }
+    FOR_EACH_BLOCK_NODE(irn, h) {
+        if (instruction(irn) != LABEL) {
+            size++;
+        }
+    }
+    if (size > MAX_ROTATED_HEADER) {
+        return FALSE;
+    }
+    back = latch->last;
+    FOR_EACH_BLOCK_NODE(irn, h) {
+        if (irn != h->first && irn != test) {
+            insert_ir_node_before(back, clone_ir_node(irn, 0), cfg->irl);
+        }
+    }
+    /* go on from the top of the body, else leave as the header did */
+    back->instruction = turned_around(instruction(test));
+    back->RSRC = test->RSRC;
+    back->branch = body->first;
+    if (back->next != out->first) {
+        insert_ir_node_after(back, irn_jump(JUMP, NO_ARG, out->first),
+                                cfg->irl);
+    }
+    changed[h->id] = changed[latch->id] = TRUE;
+    return TRUE;
+}
+
+/* does irn branch or fall through depending on a register? */
+Boolean is_conditional_jump(IrNode *irn) {
+    switch (instruction(irn)) {
+        case JUMP_EQZ:
+        case JUMP_NEZ:
+        case JUMP_LEZ:
+        case JUMP_GEZ:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/* the jump taken when instr is not, NO_IR_INSTRUCTION if there is none */
+int turned_around(int instr) {
+    switch (instr) {
+        case JUMP_EQZ:
+            return JUMP_NEZ;
+        case JUMP_NEZ:
+            return JUMP_EQZ;
+        default:
+            return NO_IR_INSTRUCTION;
+    }
+}
+
+/*
+ * layout_blocks
+ * Purpose: order the blocks of a procedure so that the successor each
+ *          block is most likely to go to follows it, and cold blocks come
+ *          last
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure not in SSA form
+ * Returns:
+ *  The number of blocks that no longer follow the block they followed
+ * Side Effects:
+ *  Relinks the IR list in the new order, turning conditional jumps around
+ *  and adding or removing jumps so that control goes where it did.
+ *  Rebuilds the CFG if any block moves.
+ */
+int layout_blocks(ControlFlowGraph *cfg) {
+    Layout ly;
+    Loop *loops;
+    BasicBlock *b, *last = cfg->blocks[cfg->num_blocks - 1];
+    int num_loops, moved = 0, i, j;
+
+    ly.cfg = cfg;
+    loops = find_loops(cfg, &num_loops);
+    util_emalloc((void **) &ly.innermost, cfg->num_blocks * sizeof(Loop *));
+    util_emalloc((void **) &ly.cold, cfg->num_blocks * sizeof(Boolean));
+    util_emalloc((void **) &ly.placed, cfg->num_blocks * sizeof(Boolean));
+    util_emalloc((void **) &ly.order,
+                    cfg->num_blocks * sizeof(BasicBlock *));
+    for (i = 0; i < cfg->num_blocks; i++) {
+        ly.innermost[i] = NULL;
+        /* loops come smallest first */
+        for (j = 0; j < num_loops && ly.innermost[i] == NULL; j++) {
+            if (loops[j].body[i]) {
+                ly.innermost[i] = &loops[j];
+            }
+        }
+        ly.cold[i] = returns_early(cfg, cfg->blocks[i]);
+        ly.placed[i] = FALSE;
+    }
+    ly.num_placed = 0;
+    ly.placed[last->id] = TRUE;
+
+    /* chains of warm blocks from the entry, then the cold ones */
+    b = cfg->blocks[0];
+    while (b != NULL) {
+        place_block(&ly, b);
+        b = chain_successor(&ly, b);
+        for (i = 0; b == NULL && i < cfg->num_blocks; i++) {
+            if (!ly.placed[i] && !ly.cold[i]) {
+                b = cfg->blocks[i];
+            }
+        }
+    }
+    for (i = 0; i < cfg->num_blocks; i++) {
+        if (!ly.placed[i]) {
+            place_block(&ly, cfg->blocks[i]);
+        }
+    }
+    if (last != cfg->blocks[0]) {
+        ly.order[ly.num_placed++] = last;
+    }
+
+    for (i = 1; i < ly.num_placed; i++) {
+        if (ly.order[i]->id != ly.order[i - 1]->id + 1) {
+            moved++;
+        }
+    }
+    if (moved > 0) {
+        relink_blocks(&ly);
+        rebuild_cfg(cfg);
+    }
+    free(ly.innermost);
+    free(ly.cold);
+    free(ly.placed);
+    free(ly.order);
+    free_loops(loops, num_loops);
+    return moved;
+}
+
+/*
+ * does b return on a way its predecessor branches to, when the other way
+ * from that branch goes on rather than returning too?
+ */
+Boolean returns_early(ControlFlowGraph *cfg, BasicBlock *b) {
+    BasicBlock *p, *other;
+
+    if (instruction(b->last) != RETURN_FROM_PROC || b->num_preds != 1) {
+        return FALSE;
+    }
+    p = b->preds[0];
+    if (!is_conditional_jump(p->last) || p->num_succs != 2) {
+        return FALSE;
+    }
+    other = p->succs[p->succs[0] == b ? 1 : 0];
+    return other != cfg->blocks[cfg->num_blocks - 1] &&
+            instruction(other->last) != RETURN_FROM_PROC ? TRUE : FALSE;
+}
+
+/* the successor b most likely goes to, NULL if it has none */
+BasicBlock *likely_successor(Layout *ly, BasicBlock *b) {
+    BasicBlock *fall, *taken;
+    Loop *loop = ly->innermost[b->id];
+
+    if (b->num_succs == 0) {
+        return NULL;
+    }
+    if (!is_conditional_jump(b->last)) {
+        return b->succs[0];
+    }
+    fall = fall_through(ly->cfg, b);
+    taken = b->last->branch->bb;
+    if (fall == NULL || taken == fall) {
+        return taken;
+    }
+    /* back edges are taken */
+    if (dominates(taken, b)) {
+        return taken;
+    }
+    if (dominates(fall, b)) {
+        return fall;
+    }
+    /* loop exits are not */
+    if (loop != NULL && loop->body[taken->id] != loop->body[fall->id]) {
+        return loop->body[taken->id] ? taken : fall;
+    }
+    /* nor are early returns */
+    if (ly->cold[taken->id] != ly->cold[fall->id]) {
+        return ly->cold[fall->id] ? taken : fall;
+    }
+    return fall;
+}
+
+/*
+ * the block to place after b: its likely successor, else what it fell
+ * into, NULL if neither can follow it
+ */
+BasicBlock *chain_successor(Layout *ly, BasicBlock *b) {
+    BasicBlock *s = likely_successor(ly, b);
+
+    /* a jump that cannot be turned around keeps what it falls into */
+    if (is_conditional_jump(b->last) &&
+            turned_around(instruction(b->last)) == NO_IR_INSTRUCTION) {
+        s = fall_through(ly->cfg, b);
+        return s != NULL && !ly->placed[s->id] ? s : NULL;
+    }
+    if (s != NULL && can_follow(ly, b, s)) {
+        return s;
+    }
+    s = fall_through(ly->cfg, b);
+    return s != NULL && can_follow(ly, b, s) ? s : NULL;
+}
+
+/*
+ * can s be placed after b? not once placed, not if cold while b is warm,
+ * and not taking the place of a block falling into it
+ */
+Boolean can_follow(Layout *ly, BasicBlock *b, BasicBlock *s) {
+    BasicBlock *before;
+
+    if (ly->placed[s->id] || (ly->cold[s->id] && !ly->cold[b->id])) {
+        return FALSE;
+    }
+    if (s->id == b->id + 1 || s->id == 0) {
+        return TRUE;
+    }
+    before = ly->cfg->blocks[s->id - 1];
+    return ly->placed[before->id] || fall_through(ly->cfg, before) != s ?
+            TRUE : FALSE;
+}
+
+/* the block b falls into when it does not jump, NULL if it always jumps */
+BasicBlock *fall_through(ControlFlowGraph *cfg, BasicBlock *b) {
+    switch (instruction(b->last)) {
+        case JUMP:
+        case RETURN_FROM_PROC:
+        case TAIL_CALL:
+            return NULL;
+        default:
+            return b->id + 1 < cfg->num_blocks ? cfg->blocks[b->id + 1] :
+                    NULL;
+    }
+}
+
+void place_block(Layout *ly, BasicBlock *b) {
+    ly->placed[b->id] = TRUE;
+    ly->order[ly->num_placed++] = b;
+}
+
+/* have b go where it went with next following it */
+void fix_block_exit(ControlFlowGraph *cfg, BasicBlock *b, BasicBlock *next) {
+    BasicBlock *fall = fall_through(cfg, b);
+    IrNode *last = b->last;
+
+    if (instruction(last) == JUMP && last->branch->bb == next) {
+        remove_block_node(last, cfg);
+        return;
+    }
+    if (fall == NULL || fall == next) {
+        return;
+    }
+    if (is_conditional_jump(last) && last->branch->bb == next &&
+            turned_around(instruction(last)) != NO_IR_INSTRUCTION) {
+        last->instruction = turned_around(instruction(last));
+        last->branch = fall->first;
+        return;
+    }
+    b->last = insert_ir_node_after(last, irn_jump(JUMP, NO_ARG, fall->first),
+                                    cfg->irl);
+}
+
+/* link the blocks into the IR list in the order placed */
+void relink_blocks(Layout *ly) {
+    ControlFlowGraph *cfg = ly->cfg;
+    IrNode *irn, **nodes;
+    int num_nodes = 0, i, n;
+
+    for (i = 0; i < ly->num_placed; i++) {
+        fix_block_exit(cfg, ly->order[i],
+                        i + 1 < ly->num_placed ? ly->order[i + 1] : NULL);
+        FOR_EACH_BLOCK_NODE(irn, ly->order[i]) {
+            num_nodes++;
+        }
+    }
+    util_emalloc((void **) &nodes, num_nodes * sizeof(IrNode *));
+    n = 0;
+    for (i = 0; i < ly->num_placed; i++) {
+        FOR_EACH_BLOCK_NODE(irn, ly->order[i]) {
+            nodes[n++] = irn;
+        }
+    }
+    for (i = 0; i < num_nodes; i++) {
+        remove_ir_node(nodes[i], cfg->irl);
+    }
+    for (i = 0; i < num_nodes; i++) {
+        insert_ir_node_before(cfg->end_proc, nodes[i], cfg->irl);
+    }
+    free(nodes);
+}
+
+/*
+ * thread_jumps
+ * Purpose: send jumps to blocks that only jump on to where those go, and
+ *          have jumps to blocks that only return return
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure not in SSA form
+ * Returns:
+ *  The number of jumps changed
+ * Side Effects:
+ *  Changes the targets of jumps, and jumps into returns. Removes the
+ *  blocks left unreachable and rebuilds the CFG if any jump changes.
+ */
+int thread_jumps(ControlFlowGraph *cfg) {
+    IrNode *jump, *to;
+    int threaded = 0, i, hops;
+
+    for (i = 0; i < cfg->num_blocks; i++) {
+        jump = block_terminator(cfg->blocks[i]);
+        if (jump == NULL || instruction(jump) == RETURN_FROM_PROC ||
+                instruction(jump) == TAIL_CALL) {
+            continue;
+        }
+        /* a cycle of jumps ends the chain once it has gone all the way */
+        for (hops = 0; hops < cfg->num_blocks; hops++) {
+            to = lone_instruction(jump->branch->bb);
+            if (to != NULL && instruction(to) == JUMP &&
+                    to->branch != jump->branch) {
+                jump->branch = to->branch;
+                threaded++;
+            } else {
+                break;
+            }
+        }
+        if (to != NULL && instruction(to) == RETURN_FROM_PROC &&
+                instruction(jump) == JUMP) {
+            jump->instruction = RETURN_FROM_PROC;
+            jump->RSRC = to->RSRC;
+            jump->branch = to->branch;
+            threaded++;
+        }
+    }
+    if (threaded > 0) {
+        rebuild_cfg(cfg);
+        remove_unreachable_blocks(cfg);
+    }
+    return threaded;
+}
+
+/* the only node of b after its label, NULL if it has none or more */
+IrNode *lone_instruction(BasicBlock *b) {
+    return b->first != b->last && b->first->next == b->last ? b->last : NULL;
+}
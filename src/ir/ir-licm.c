@@ -0,0 +1,778 @@
+/*
+ * Loop-invariant code motion and scalar promotion over the natural loops of
+ * a procedure.
+ *
+ * A natural loop is found from each back edge, an edge to a block that
+ * dominates its source: the loop is the header and every block that reaches
+ * the source without passing through the header. Loops with the same header
+ * are one loop. Loops are visited innermost first, so what leaves an inner
+ * loop may leave the loop around it too.
+ *
+ * Code is moved to the loop's preheader, the one block outside the loop
+ * that enters it and goes nowhere else. A loop entered by falling through
+ * from a block with other successors gets an empty preheader.
+ *
+ * In SSA form, an instruction whose operands are all defined outside the
+ * loop computes the same value on every iteration and is moved to the
+ * preheader. Constants stay where they are, since instruction selection
+ * reads them as immediates in their own block, and are loaded again in the
+ * preheader for the instructions moved there. A load moves when nothing in
+ * the loop may write what it reads. Instructions that may fault or may not
+ * terminate, division, loads through unknown addresses and calls, move only
+ * from blocks that execute whenever the loop is left.
+ *
+ * Outside SSA form, a scalar global that the loop reads and writes only as
+ * a whole word through its own address is kept in a register for the
+ * duration of the loop: it is loaded in the preheader, and stored once in
+ * each block the loop exits to. This needs a loop that makes no calls that
+ * may read memory and no accesses through unknown addresses.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-opt.h"
+#include "../include/utilities.h"
+
+struct LicmState {
+    ControlFlowGraph *cfg;
+    IrNode **defs;              /* per register: its definition           */
+    int num_defs;
+    int *constants;             /* per register: its copy in the
+                                   preheader, NO_ARG if none              */
+    Loop *loop;
+    BasicBlock **exiting;       /* blocks of the loop with a successor
+                                   outside it                             */
+    int num_exiting;
+    Boolean writes;             /* something in the loop may write memory */
+    int hoisted;
+};
+typedef struct LicmState LicmState;
+
+/* file helper functions */
+void find_loop_entry(Loop *loop);
+void hoist_loop(LicmState *ls);
+Boolean executes_on_exit(LicmState *ls, BasicBlock *b);
+Boolean is_hoistable(LicmState *ls, IrNode *irn, Boolean always);
+Boolean invariant_operand(LicmState *ls, int reg);
+Boolean invariant_load(LicmState *ls, IrNode *irn, Boolean always);
+Boolean loop_writes_symbol(LicmState *ls, Symbol *s);
+IrNode *register_def(LicmState *ls, int reg);
+IrNode *hoistable_call(LicmState *ls, IrNode *call, Boolean always);
+void hoist_node(LicmState *ls, IrNode *irn);
+int promote_loop(ControlFlowGraph *cfg, Loop *loop);
+Symbol *address_symbol(IrNode **defs, int *num_defs, int num_regs, int reg);
+Boolean exits_stay_in_loop(ControlFlowGraph *cfg, Loop *loop);
+void promote_symbol(ControlFlowGraph *cfg, Loop *loop, Symbol *s,
+                    IrNode **defs, int *num_defs, int num_regs);
+
+
+/*
+ * hoist_loop_invariants
+ * Purpose: move the instructions that compute the same value on every
+ *          iteration of a loop out of it
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure in SSA form
+ * Returns:
+ *  The number of instructions moved
+ * Side Effects:
+ *  Adds preheaders to loops that need one and rebuilds the CFG if it does.
+ *  Moves instructions to preheaders and adds the constants they read.
+ */
+int hoist_loop_invariants(ControlFlowGraph *cfg) {
+    LicmState ls;
+    Loop *loops;
+    int num_loops, i, j;
+
+    insert_preheaders(cfg);
+    loops = find_loops(cfg, &num_loops);
+    ls.cfg = cfg;
+    ls.defs = register_defs(cfg, NULL);
+    ls.num_defs = cfg->num_regs;
+    util_emalloc((void **) &ls.constants, (ls.num_defs + 1) * sizeof(int));
+    ls.hoisted = 0;
+    for (i = 0; i < num_loops; i++) {
+        if (loops[i].preheader == NULL) {
+            continue;
+        }
+        /* a constant copied to one preheader is not in the next */
+        for (j = 0; j < ls.num_defs; j++) {
+            ls.constants[j] = NO_ARG;
+        }
+        ls.loop = &loops[i];
+        hoist_loop(&ls);
+    }
+    free(ls.constants);
+    free(ls.defs);
+    free_loops(loops, num_loops);
+    return ls.hoisted;
+}
+
+/*
+ * promote_globals
+ * Purpose: keep the scalar globals a loop reads and writes in registers
+ *          while it runs
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure not in SSA form
+ * Returns:
+ *  The number of globals promoted, counted once per loop
+ * Side Effects:
+ *  Adds preheaders to loops that need one and rebuilds the CFG if it does.
+ *  Loads of a promoted global become copies from its register and stores
+ *  become copies to it; the global is loaded in the preheader and stored
+ *  at the start of each block the loop exits to.
+ */
+int promote_globals(ControlFlowGraph *cfg) {
+    Loop *loops;
+    int num_loops, i, promoted = 0;
+
+    insert_preheaders(cfg);
+    loops = find_loops(cfg, &num_loops);
+    for (i = 0; i < num_loops; i++) {
+        if (loops[i].preheader != NULL) {
+            promoted += promote_loop(cfg, &loops[i]);
+        }
+    }
+    free_loops(loops, num_loops);
+    return promoted;
+}
+
+/*
+ * find_loops
+ * Purpose: find the natural loops of a procedure
+ * Parameters:
+ *  cfg - ControlFlowGraph * - the procedure
+ *  num_loops - int * - set to the number of loops found
+ * Returns:
+ *  The loops, smallest first, so each comes before the loops containing it
+ * Side Effects:
+ *  None
+ */
+Loop *find_loops(ControlFlowGraph *cfg, int *num_loops) {
+    Loop *loops = NULL, *loop, tmp;
+    BasicBlock *h, *b, *p, **work;
+    int i, j, num_work;
+
+    *num_loops = 0;
+    util_emalloc((void **) &work, (cfg->num_blocks + 1) * sizeof(BasicBlock *));
+    for (i = 0; i < cfg->num_rpo; i++) {
+        h = cfg->rpo[i];
+        util_erealloc((void **) &loops, (*num_loops + 1) * sizeof(Loop));
+        loop = &loops[*num_loops];
+        loop->header = h;
+        loop->size = 1;
+        util_emalloc((void **) &loop->body, cfg->num_blocks * sizeof(Boolean));
+        for (j = 0; j < cfg->num_blocks; j++) {
+            loop->body[j] = FALSE;
+        }
+        loop->body[h->id] = TRUE;
+        /* walk back from the sources of the back edges to the header */
+        num_work = 0;
+        for (j = 0; j < h->num_preds; j++) {
+            p = h->preds[j];
+            if (p->rpo != -1 && dominates(h, p) && !loop->body[p->id]) {
+                loop->body[p->id] = TRUE;
+                loop->size++;
+                work[num_work++] = p;
+            }
+        }
+        if (num_work == 0 && pred_index(h, h) == -1) {
+            free(loop->body);
+            continue;
+        }
+        while (num_work > 0) {
+            b = work[--num_work];
+            for (j = 0; j < b->num_preds; j++) {
+                p = b->preds[j];
+                if (p->rpo != -1 && !loop->body[p->id]) {
+                    loop->body[p->id] = TRUE;
+                    loop->size++;
+                    work[num_work++] = p;
+                }
+            }
+        }
+        find_loop_entry(loop);
+        (*num_loops)++;
+    }
+    free(work);
+    for (i = 1; i < *num_loops; i++) {
+        for (j = i; j > 0 && loops[j].size < loops[j - 1].size; j--) {
+            tmp = loops[j];
+            loops[j] = loops[j - 1];
+            loops[j - 1] = tmp;
+        }
+    }
+    return loops;
+}
+
+/* find the block entering the loop, and whether it can be the preheader */
+void find_loop_entry(Loop *loop) {
+    BasicBlock *h = loop->header, *p;
+    int i, entries = 0;
+
+    loop->entry = NULL;
+    loop->preheader = NULL;
+    for (i = 0; i < h->num_preds; i++) {
+        p = h->preds[i];
+        if (!loop->body[p->id] && p->rpo != -1) {
+            loop->entry = p;
+            entries++;
+        }
+    }
+    if (entries != 1) {
+        loop->entry = NULL;
+    } else if (loop->entry->num_succs == 1) {
+        loop->preheader = loop->entry;
+    }
+}
+
+/*
+ * free_loops
+ * Purpose: release the loops find_loops returned
+ * Parameters:
+ *  loops - Loop * - the loops
+ *  num_loops - int - how many there are
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Frees heap storage
+ */
+void free_loops(Loop *loops, int num_loops) {
+    int i;
+    for (i = 0; i < num_loops; i++) {
+        free(loops[i].body);
+    }
+    free(loops);
+}
+
+/*
+ * insert_preheaders
+ * Purpose: give an empty preheader to each loop entered by falling through
+ *          from a block that may also branch elsewhere
+ * Parameters:
+ *  cfg - ControlFlowGraph * - the procedure
+ * Returns:
+ *  The number of preheaders added
+ * Side Effects:
+ *  Inserts labels before loop headers, retargets the header PHI arguments
+ *  from the entering block to them and rebuilds the CFG if any is added
+ */
+int insert_preheaders(ControlFlowGraph *cfg) {
+    Loop *loops;
+    BasicBlock *h, *p;
+    IrNode *label, *irn;
+    int num_loops, i, j, added = 0;
+
+    loops = find_loops(cfg, &num_loops);
+    for (i = 0; i < num_loops; i++) {
+        h = loops[i].header;
+        p = loops[i].entry;
+        if (loops[i].preheader != NULL || p == NULL ||
+                p->last->next != h->first ||
+                (block_terminator(p) != NULL && p->last->branch == h->first)) {
+            continue;
+        }
+        label = new_label();
+        insert_ir_node_before(h->first, label, cfg->irl);
+        /* the PHIs of the header now receive p's values from the label */
+        for (irn = h->first == h->last ? NULL : h->first->next;
+                irn != NULL && instruction(irn) == PHI;
+                irn = irn == h->last ? NULL : irn->next) {
+            for (j = 0; j < irn->num_phi_args; j++) {
+                if (irn->phi_args[j].pred == p->first) {
+                    irn->phi_args[j].pred = label;
+                }
+            }
+        }
+        added++;
+    }
+    free_loops(loops, num_loops);
+    if (added > 0) {
+        rebuild_cfg(cfg);
+    }
+    return added;
+}
+
+/*
+ * register_defs
+ * Purpose: find the instruction defining each register of a procedure
+ * Parameters:
+ *  cfg - ControlFlowGraph * - the procedure
+ *  num_defs - int ** - unless NULL, set to how many definitions each
+ *                      register has
+ * Returns:
+ *  Per register, its definition, the last one if there are several
+ * Side Effects:
+ *  Allocates the arrays returned
+ */
+IrNode **register_defs(ControlFlowGraph *cfg, int **num_defs) {
+    IrNode **defs, *irn;
+    int i, *def;
+
+    util_emalloc((void **) &defs, (cfg->num_regs + 1) * sizeof(IrNode *));
+    if (num_defs != NULL) {
+        util_emalloc((void **) num_defs, (cfg->num_regs + 1) * sizeof(int));
+    }
+    for (i = 0; i < cfg->num_regs; i++) {
+        defs[i] = NULL;
+        if (num_defs != NULL) {
+            (*num_defs)[i] = 0;
+        }
+    }
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = irn->next) {
+        def = ir_node_def(irn);
+        if (def != NULL && *def >= 0 && *def < cfg->num_regs) {
+            defs[*def] = irn;
+            if (num_defs != NULL) {
+                (*num_defs)[*def]++;
+            }
+        }
+    }
+    return defs;
+}
+
+/* move the invariant instructions of ls->loop to its preheader */
+void hoist_loop(LicmState *ls) {
+    ControlFlowGraph *cfg = ls->cfg;
+    Loop *loop = ls->loop;
+    BasicBlock *b;
+    IrNode *irn, *next, *last, *moved, *following;
+    Boolean always, done;
+    int i, j;
+
+    ls->exiting = NULL;
+    ls->num_exiting = 0;
+    ls->writes = FALSE;
+    for (i = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        if (!loop->body[b->id]) {
+            continue;
+        }
+        for (j = 0; j < b->num_succs; j++) {
+            if (!loop->body[b->succs[j]->id]) {
+                util_erealloc((void **) &ls->exiting,
+                                (ls->num_exiting + 1) * sizeof(BasicBlock *));
+                ls->exiting[ls->num_exiting++] = b;
+                break;
+            }
+        }
+        FOR_EACH_BLOCK_NODE(irn, b) {
+            if (writes_memory(irn)) {
+                ls->writes = TRUE;
+            }
+        }
+    }
+    /* in reverse postorder, operands are moved before what reads them */
+    for (i = 0; i < cfg->num_rpo; i++) {
+        b = cfg->rpo[i];
+        if (!loop->body[b->id]) {
+            continue;
+        }
+        always = executes_on_exit(ls, b);
+        for (irn = b->first == b->last ? NULL : b->first->next; irn != NULL;
+                irn = next) {
+            next = irn == b->last ? NULL : irn->next;
+            if (instruction(irn) == CALL) {
+                last = hoistable_call(ls, irn, always);
+                if (last == NULL) {
+                    continue;
+                }
+                next = last == b->last ? NULL : last->next;
+                done = FALSE;
+                for (moved = call_begin(irn); !done; moved = following) {
+                    done = moved == last ? TRUE : FALSE;
+                    following = moved->next;
+                    hoist_node(ls, moved);
+                }
+            } else if (is_hoistable(ls, irn, always)) {
+                hoist_node(ls, irn);
+            }
+        }
+    }
+    free(ls->exiting);
+}
+
+/*
+ * does b run on every iteration that leaves the loop? the header always
+ * runs first; other blocks must dominate every block the loop is left from
+ */
+Boolean executes_on_exit(LicmState *ls, BasicBlock *b) {
+    int i;
+    if (b == ls->loop->header) {
+        return TRUE;
+    }
+    if (ls->num_exiting == 0) {
+        return FALSE;
+    }
+    for (i = 0; i < ls->num_exiting; i++) {
+        if (!dominates(b, ls->exiting[i])) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * can irn, not a call, move to the preheader? always tells whether its block
+ * runs whenever the loop is left
+ */
+Boolean is_hoistable(LicmState *ls, IrNode *irn, Boolean always) {
+    int *uses[MAX_USES], i, n;
+
+    switch (instruction(irn)) {
+        case LOAD_ADDRESS:
+            return TRUE;
+        case LOAD_BYTE_INDIRECT:
+        case LOAD_UNSIGNED_BYTE_INDIRECT:
+        case LOAD_HALF_WORD_INDIRECT:
+        case LOAD_UNSIGNED_HALF_WORD_INDIRECT:
+        case LOAD_WORD_INDIRECT:
+            if (!invariant_load(ls, irn, always)) {
+                return FALSE;
+            }
+            break;
+        case DIV:
+        case REM:
+        case DIVU:
+        case REMU:
+            if (!always) {
+                return FALSE;
+            }
+            break;
+        case ADD_CONST:
+        case MOVE:
+            break;
+        default:
+            if (!is_binary_op(irn) && !is_unary_op(irn)) {
+                return FALSE;
+            }
+            break;
+    }
+    n = ir_node_uses(irn, uses);
+    for (i = 0; i < n; i++) {
+        if (!invariant_operand(ls, *uses[i])) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * is reg defined outside the loop, or by a constant that can be loaded
+ * again outside it?
+ */
+Boolean invariant_operand(LicmState *ls, int reg) {
+    IrNode *def;
+    int i;
+    if (reg == NO_ARG) {
+        return FALSE;
+    }
+    if (reg >= ls->num_defs) {
+        /*
+         * a constant copied to this loop's preheader; one an inner loop
+         * copied to its own preheader is in this loop
+         */
+        for (i = 0; i < ls->num_defs; i++) {
+            if (ls->constants[i] == reg) {
+                return TRUE;
+            }
+        }
+        return FALSE;
+    }
+    def = ls->defs[reg];
+    if (def == NULL) {
+        return FALSE;
+    }
+    return !ls->loop->body[def->bb->id] || instruction(def) == LOAD_CONSTANT;
+}
+
+/*
+ * does a load read the same value on every iteration? one from a variable's
+ * own address cannot fault, and only stores to that variable matter
+ */
+Boolean invariant_load(LicmState *ls, IrNode *irn, Boolean always) {
+    IrNode *addr = register_def(ls, irn->RSRC);
+    if (addr != NULL && instruction(addr) == LOAD_ADDRESS) {
+        return !loop_writes_symbol(ls, addr->s);
+    }
+    return always && !ls->writes;
+}
+
+/* may something in the loop write variable s? */
+Boolean loop_writes_symbol(LicmState *ls, Symbol *s) {
+    ControlFlowGraph *cfg = ls->cfg;
+    IrNode *irn, *addr;
+    int i;
+
+    if (!ls->writes) {
+        return FALSE;
+    }
+    for (i = 0; i < cfg->num_blocks; i++) {
+        if (!ls->loop->body[i]) {
+            continue;
+        }
+        FOR_EACH_BLOCK_NODE(irn, cfg->blocks[i]) {
+            if (!writes_memory(irn)) {
+                continue;
+            }
+            switch (instruction(irn)) {
+                case STORE_BYTE_INDIRECT:
+                case STORE_HALF_WORD_INDIRECT:
+                case STORE_WORD_INDIRECT:
+                    addr = register_def(ls, irn->RDEST);
+                    if (addr != NULL && instruction(addr) == LOAD_ADDRESS &&
+                            addr->s != s) {
+                        /* a store to another variable */
+                        break;
+                    }
+                    return TRUE;
+                default:
+                    return TRUE;
+            }
+        }
+    }
+    return FALSE;
+}
+
+IrNode *register_def(LicmState *ls, int reg) {
+    if (reg < 0 || reg >= ls->num_defs) {
+        return NULL;
+    }
+    return ls->defs[reg];
+}
+
+/*
+ * the last node of the call sequence ending at call, its END_CALL or
+ * RETURNED_WORD, if the whole sequence can move to the preheader: the call
+ * is const, or pure in a loop writing no memory, it runs whenever the loop
+ * is left, and between its BEGIN_CALL and it are only constants and the
+ * invariant arguments. NULL otherwise.
+ */
+IrNode *hoistable_call(LicmState *ls, IrNode *call, Boolean always) {
+    IrNode *begin = call_begin(call), *irn, *last;
+
+    if (!always || begin == NULL || begin->bb != call->bb ||
+            (call->IMMVAL != CALL_CONST &&
+             (call->IMMVAL != CALL_PURE || ls->writes))) {
+        return NULL;
+    }
+    for (irn = begin->next; irn != call; irn = irn->next) {
+        if (instruction(irn) == LOAD_CONSTANT) {
+            continue;
+        }
+        if (instruction(irn) != PARAM || !invariant_operand(ls, irn->RSRC)) {
+            return NULL;
+        }
+    }
+    last = call->next;
+    if (last == call->bb->last || instruction(last) != END_CALL) {
+        return NULL;
+    }
+    if (instruction(last->next) == RETURNED_WORD) {
+        last = last->next;
+    }
+    return last;
+}
+
+/*
+ * move irn to the end of the preheader, loading there the constants of the
+ * loop it reads
+ */
+void hoist_node(LicmState *ls, IrNode *irn) {
+    BasicBlock *preheader = ls->loop->preheader;
+    IrNode *def, *copy;
+    int *uses[MAX_USES], i, n;
+
+    n = ir_node_uses(irn, uses);
+    for (i = 0; i < n; i++) {
+        def = register_def(ls, *uses[i]);
+        if (def == NULL || !ls->loop->body[def->bb->id] ||
+                instruction(def) != LOAD_CONSTANT) {
+            continue;
+        }
+        if (ls->constants[*uses[i]] == NO_ARG) {
+            copy = clone_ir_node(def, 0);
+            copy->RDEST = new_reg(ls->cfg);
+            insert_before_terminator(preheader, copy, ls->cfg);
+            ls->constants[*uses[i]] = copy->RDEST;
+        }
+        *uses[i] = ls->constants[*uses[i]];
+    }
+    remove_block_node(irn, ls->cfg);
+    insert_before_terminator(preheader, irn, ls->cfg);
+    ls->hoisted++;
+}
+
+/* keep the globals loop reads and writes in registers; how many were */
+int promote_loop(ControlFlowGraph *cfg, Loop *loop) {
+    BasicBlock *b;
+    IrNode **defs, *irn;
+    Symbol **syms = NULL, *s;
+    Boolean *whole = NULL, *stored = NULL, safe = TRUE;
+    int *num_defs, num_regs = cfg->num_regs, num_syms = 0, promoted = 0;
+    int i, k, reg;
+
+    defs = register_defs(cfg, &num_defs);
+    for (i = 0; i < cfg->num_blocks && safe; i++) {
+        b = cfg->blocks[i];
+        if (!loop->body[b->id]) {
+            continue;
+        }
+        FOR_EACH_BLOCK_NODE(irn, b) {
+            switch (instruction(irn)) {
+                case CALL:
+                    /* a const call reads no memory */
+                    safe = safe && irn->IMMVAL == CALL_CONST;
+                    continue;
+                case SYSCALL:
+                case TAIL_CALL:
+                    safe = FALSE;
+                    continue;
+                case STORE_BYTE_INDIRECT:
+                case STORE_HALF_WORD_INDIRECT:
+                case STORE_WORD_INDIRECT:
+                    reg = irn->RDEST;
+                    break;
+                default:
+                    if (!is_memory_load(irn)) {
+                        continue;
+                    }
+                    reg = irn->RSRC;
+                    break;
+            }
+            s = address_symbol(defs, num_defs, num_regs, reg);
+            if (s == NULL) {
+                safe = FALSE;
+                continue;
+            }
+            for (k = 0; k < num_syms && syms[k] != s; k++) {
+                ;
+            }
+            if (k == num_syms) {
+                util_erealloc((void **) &syms, (k + 1) * sizeof(Symbol *));
+                util_erealloc((void **) &whole, (k + 1) * sizeof(Boolean));
+                util_erealloc((void **) &stored, (k + 1) * sizeof(Boolean));
+                syms[k] = s;
+                whole[k] = is_global_symbol(s) && is_scalar_symbol(s);
+                stored[k] = FALSE;
+                num_syms++;
+            }
+            if (instruction(irn) != LOAD_WORD_INDIRECT &&
+                    instruction(irn) != STORE_WORD_INDIRECT) {
+                whole[k] = FALSE;
+            }
+            if (instruction(irn) == STORE_WORD_INDIRECT) {
+                stored[k] = TRUE;
+            }
+        }
+    }
+    /* a global only read is hoisted with its loads already */
+    if (safe && exits_stay_in_loop(cfg, loop)) {
+        for (k = 0; k < num_syms; k++) {
+            if (whole[k] && stored[k]) {
+                promote_symbol(cfg, loop, syms[k], defs, num_defs, num_regs);
+                promoted++;
+            }
+        }
+    }
+    free(syms);
+    free(whole);
+    free(stored);
+    free(defs);
+    free(num_defs);
+    return promoted;
+}
+
+/* the variable reg holds the address of, if only its LOAD_ADDRESS sets it */
+Symbol *address_symbol(IrNode **defs, int *num_defs, int num_regs, int reg) {
+    if (reg < 0 || reg >= num_regs || num_defs[reg] != 1 ||
+            instruction(defs[reg]) != LOAD_ADDRESS) {
+        return NULL;
+    }
+    return defs[reg]->s;
+}
+
+/*
+ * is every block the loop exits to entered only from the loop, so a store
+ * at its start runs only after the loop?
+ */
+Boolean exits_stay_in_loop(ControlFlowGraph *cfg, Loop *loop) {
+    BasicBlock *b, *exit;
+    int i, j, k;
+
+    for (i = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        if (!loop->body[b->id]) {
+            continue;
+        }
+        for (j = 0; j < b->num_succs; j++) {
+            exit = b->succs[j];
+            if (loop->body[exit->id]) {
+                continue;
+            }
+            for (k = 0; k < exit->num_preds; k++) {
+                if (!loop->body[exit->preds[k]->id]) {
+                    return FALSE;
+                }
+            }
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * load s into a register in the preheader, use the register for the loads
+ * and stores of s in the loop, and store it where the loop exits to
+ */
+void promote_symbol(ControlFlowGraph *cfg, Loop *loop, Symbol *s,
+                    IrNode **defs, int *num_defs, int num_regs) {
+    BasicBlock *b, *exit;
+    IrNode *irn, *addr, *value, *store;
+    Boolean *stored;
+    int i, j, instr;
+
+    addr = construct_ir_node(LOAD_ADDRESS);
+    addr->RDEST = new_reg(cfg);
+    addr->s = s;
+    insert_before_terminator(loop->preheader, addr, cfg);
+    value = construct_ir_node(LOAD_WORD_INDIRECT);
+    value->RDEST = new_reg(cfg);
+    value->RSRC = addr->RDEST;
+    insert_before_terminator(loop->preheader, value, cfg);
+
+    util_emalloc((void **) &stored, cfg->num_blocks * sizeof(Boolean));
+    for (i = 0; i < cfg->num_blocks; i++) {
+        stored[i] = FALSE;
+    }
+    for (i = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        if (!loop->body[b->id]) {
+            continue;
+        }
+        FOR_EACH_BLOCK_NODE(irn, b) {
+            instr = instruction(irn);
+            if (instr == LOAD_WORD_INDIRECT && address_symbol(defs, num_defs,
+                        num_regs, irn->RSRC) == s) {
+                irn->instruction = MOVE;
+                irn->RSRC = value->RDEST;
+            } else if (instr == STORE_WORD_INDIRECT && address_symbol(defs,
+                        num_defs, num_regs, irn->RDEST) == s) {
+                irn->instruction = MOVE;
+                irn->RDEST = value->RDEST;
+            }
+        }
+        for (j = 0; j < b->num_succs; j++) {
+            exit = b->succs[j];
+            if (loop->body[exit->id] || stored[exit->id]) {
+                continue;
+            }
+            store = construct_ir_node(STORE_WORD_INDIRECT);
+            store->RSRC = value->RDEST;
+            store->RDEST = addr->RDEST;
+            insert_at_block_start(exit, store, cfg);
+            stored[exit->id] = TRUE;
+        }
+    }
+    free(stored);
+}
@@ -1,8 +1,11 @@
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "../include/ir.h"
+#include "../include/ir-ssa.h"
+#include "../include/ir-opt.h"
 
 #include "../include/cmpl.h"
 #include "../include/lexer.h"
@@ -21,11 +24,23 @@ int yyparse(void);
 
 FILE *input, *output;
 
+/* -ssa: print the IR in SSA form */
+Boolean use_ssa = FALSE;
+/* -O<n>: optimization level */
+int opt_level = 0;
+
 void test_print_ir(void);
 
 int main(int argc, char *argv[]) {
     extern FILE *yyin;
-    int rv;
+    int rv, flags;
+
+    flags = parse_opt_flags(argc, argv, &use_ssa, &opt_level);
+    if (flags == NO_ARG) {
+        return 1;
+    }
+    argc -= flags;
+    argv += flags;
 
     /* Figure out whether we're using stdin/stdout or file in/file out. */
     if (argc < 2 || !strcmp("-", argv[1])) {
@@ -122,9 +137,16 @@ void start_traversal(Node *n) {
         scd->outfile = output;
     }
     collect_symbol_data(n, scd);
+    if (opt_level >= 1) {
+        fold_constant_expressions(n);
+    }
 
     start_ir_computation();
     compute_ir(n, ir_list);
     IrNode *irn = ir_list->head;
+    optimize_ir(ir_list, opt_level);
+    if (use_ssa) {
+        convert_to_ssa(ir_list);
+    }
     print_ir_list(output, ir_list);
 }
@@ -0,0 +1,501 @@
+/*
+ * Redundant load and dead store elimination over a procedure in SSA form.
+ *
+ * Addresses are classified by the Symbol they are computed from: the
+ * LOAD_ADDRESS of a variable is an exact address of it, and adding an
+ * offset to one gives an address somewhere inside the same variable.
+ * Addresses loaded from memory are unknown and may point anywhere.
+ *
+ * A forward pass tracks, per variable, the register known to hold its
+ * value: the value last stored to it or loaded from it. A load whose value
+ * is available on every path is replaced by that register. A backward pass
+ * tracks which variables may still be read, and deletes stores to
+ * variables that are overwritten or go out of scope before any read.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-opt.h"
+#include "../include/scope-fsm.h"
+#include "../include/symbol-utils.h"
+#include "../include/utilities.h"
+
+/* what is known about the address held in a register */
+#define ADDR_UNKNOWN 0          /* may point anywhere                     */
+#define ADDR_EXACT 1            /* the address of variable sym            */
+#define ADDR_INSIDE 2           /* somewhere within variable sym          */
+
+struct AddressInfo {
+    int kind;
+    int sym;                    /* index into MemoryState's syms          */
+};
+typedef struct AddressInfo AddressInfo;
+
+/* the register holding a variable's value, and how it was accessed */
+struct AvailableValue {
+    int reg;                    /* NO_ARG: not available                  */
+    int instr;                  /* load instruction reading that value    */
+};
+typedef struct AvailableValue AvailableValue;
+
+struct MemoryState {
+    ControlFlowGraph *cfg;
+    Symbol **syms;              /* variables whose address is taken       */
+    int num_syms;
+    AddressInfo *addr;          /* per register                           */
+    AvailableValue **avail_out; /* per block, per variable                */
+    Boolean *visited;           /* per block: avail_out computed          */
+    int *subst;                 /* register -> register holding its value */
+    int removed;
+};
+typedef struct MemoryState MemoryState;
+
+/* file helper functions */
+void classify_addresses(MemoryState *ms);
+int symbol_index(MemoryState *ms, Symbol *s);
+AddressInfo address_of(MemoryState *ms, int reg);
+void forward_loads(MemoryState *ms);
+Boolean merge_available(MemoryState *ms, BasicBlock *b, AvailableValue *in);
+void forward_block(MemoryState *ms, BasicBlock *b, AvailableValue *avail,
+                    Boolean rewrite);
+void remove_dead_stores(MemoryState *ms);
+void live_out_symbols(MemoryState *ms, BasicBlock *b, Boolean **live_in,
+                        Boolean *live);
+void sweep_stores(MemoryState *ms, BasicBlock *b, Boolean *live,
+                    Boolean remove);
+int resolve_register(MemoryState *ms, int reg);
+
+
+/*
+ * optimize_memory
+ * Purpose: remove loads of values already in registers and stores that are
+ *          never read
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure in SSA form
+ * Returns:
+ *  The number of loads and stores removed
+ * Side Effects:
+ *  Uses of the registers defined by removed loads, including PHI arguments,
+ *  are rewritten to the registers holding the same values.
+ */
+int optimize_memory(ControlFlowGraph *cfg) {
+    MemoryState ms;
+
+    ms.cfg = cfg;
+    ms.syms = NULL;
+    ms.num_syms = 0;
+    ms.removed = 0;
+    classify_addresses(&ms);
+    if (ms.num_syms > 0) {
+        forward_loads(&ms);
+        remove_dead_stores(&ms);
+    }
+    free(ms.syms);
+    free(ms.addr);
+    return ms.removed;
+}
+
+/* note the variable, if any, that each register's address lies in */
+void classify_addresses(MemoryState *ms) {
+    ControlFlowGraph *cfg = ms->cfg;
+    AddressInfo a1, a2;
+    IrNode *irn;
+    int i, *def;
+
+    util_emalloc((void **) &ms->addr, (cfg->num_regs + 1) * sizeof(AddressInfo));
+    for (i = 0; i < cfg->num_regs; i++) {
+        ms->addr[i].kind = ADDR_UNKNOWN;
+        ms->addr[i].sym = NO_ARG;
+    }
+    /* in SSA form every register has one definition, and operands are
+     * defined before use except through PHIs, which stay unknown */
+    for (i = 0; i < cfg->num_rpo; i++) {
+        FOR_EACH_BLOCK_NODE(irn, cfg->rpo[i]) {
+            def = ir_node_def(irn);
+            if (def == NULL || *def == NO_ARG) {
+                continue;
+            }
+            switch (instruction(irn)) {
+                case LOAD_ADDRESS:
+                    ms->addr[*def].kind = ADDR_EXACT;
+                    ms->addr[*def].sym = symbol_index(ms, irn->s);
+                    break;
+                case MOVE:
+                    ms->addr[*def] = address_of(ms, irn->RSRC);
+                    break;
+                case ADD_CONST:
+                    a1 = address_of(ms, irn->RSRC);
+                    if (a1.kind != ADDR_UNKNOWN) {
+                        ms->addr[*def].kind = ADDR_INSIDE;
+                        ms->addr[*def].sym = a1.sym;
+                    }
+                    break;
+                case ADD:
+                case ADDU:
+                case SUB:
+                case SUBU:
+                    /* a pointer plus or minus an offset */
+                    a1 = address_of(ms, irn->OPRND1);
+                    a2 = address_of(ms, irn->OPRND2);
+                    if (a1.kind != ADDR_UNKNOWN && a2.kind == ADDR_UNKNOWN) {
+                        ms->addr[*def].kind = ADDR_INSIDE;
+                        ms->addr[*def].sym = a1.sym;
+                    } else if (a2.kind != ADDR_UNKNOWN &&
+                            a1.kind == ADDR_UNKNOWN &&
+                            (instruction(irn) == ADD ||
+                             instruction(irn) == ADDU)) {
+                        ms->addr[*def].kind = ADDR_INSIDE;
+                        ms->addr[*def].sym = a2.sym;
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+int symbol_index(MemoryState *ms, Symbol *s) {
+    int i;
+    for (i = 0; i < ms->num_syms; i++) {
+        if (ms->syms[i] == s) {
+            return i;
+        }
+    }
+    util_erealloc((void **) &ms->syms, (ms->num_syms + 1) * sizeof(Symbol *));
+    ms->syms[ms->num_syms] = s;
+    return ms->num_syms++;
+}
+
+AddressInfo address_of(MemoryState *ms, int reg) {
+    AddressInfo unknown;
+    if (reg < 0 || reg >= ms->cfg->num_regs) {
+        unknown.kind = ADDR_UNKNOWN;
+        unknown.sym = NO_ARG;
+        return unknown;
+    }
+    return ms->addr[reg];
+}
+
+/*
+ * iterate the available values to a fixed point over the reachable blocks,
+ * then walk each block once more replacing the loads found redundant
+ */
+void forward_loads(MemoryState *ms) {
+    ControlFlowGraph *cfg = ms->cfg;
+    AvailableValue *avail;
+    IrNode *irn;
+    Boolean changed;
+    int i, j, n, *uses[MAX_USES];
+
+    util_emalloc((void **) &ms->avail_out,
+                    (cfg->num_blocks + 1) * sizeof(AvailableValue *));
+    util_emalloc((void **) &ms->visited, (cfg->num_blocks + 1) * sizeof(Boolean));
+    for (i = 0; i < cfg->num_blocks; i++) {
+        util_emalloc((void **) &ms->avail_out[i],
+                        ms->num_syms * sizeof(AvailableValue));
+        ms->visited[i] = FALSE;
+    }
+    util_emalloc((void **) &avail, ms->num_syms * sizeof(AvailableValue));
+    util_emalloc((void **) &ms->subst, (cfg->num_regs + 1) * sizeof(int));
+    for (i = 0; i < cfg->num_regs; i++) {
+        ms->subst[i] = i;
+    }
+
+    do {
+        changed = FALSE;
+        for (i = 0; i < cfg->num_rpo; i++) {
+            merge_available(ms, cfg->rpo[i], avail);
+            forward_block(ms, cfg->rpo[i], avail, FALSE);
+            for (j = 0; j < ms->num_syms; j++) {
+                if (!ms->visited[cfg->rpo[i]->id] ||
+                        avail[j].reg != ms->avail_out[cfg->rpo[i]->id][j].reg ||
+                        avail[j].instr !=
+                            ms->avail_out[cfg->rpo[i]->id][j].instr) {
+                    ms->avail_out[cfg->rpo[i]->id][j] = avail[j];
+                    changed = TRUE;
+                }
+            }
+            ms->visited[cfg->rpo[i]->id] = TRUE;
+        }
+    } while (changed);
+
+    for (i = 0; i < cfg->num_rpo; i++) {
+        merge_available(ms, cfg->rpo[i], avail);
+        forward_block(ms, cfg->rpo[i], avail, TRUE);
+    }
+
+    /* redirect uses of the removed loads, including PHI arguments */
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = irn->next) {
+        n = ir_node_uses(irn, uses);
+        for (j = 0; j < n; j++) {
+            *uses[j] = resolve_register(ms, *uses[j]);
+        }
+        for (j = 0; j < irn->num_phi_args; j++) {
+            irn->phi_args[j].reg = resolve_register(ms, irn->phi_args[j].reg);
+        }
+    }
+
+    for (i = 0; i < cfg->num_blocks; i++) {
+        free(ms->avail_out[i]);
+    }
+    free(ms->avail_out);
+    free(ms->visited);
+    free(ms->subst);
+    free(avail);
+}
+
+/*
+ * a value is available on entry to b if every predecessor visited so far
+ * holds it in the same register. unvisited predecessors are back edges
+ * whose values are assumed to agree until the next iteration says otherwise.
+ */
+Boolean merge_available(MemoryState *ms, BasicBlock *b, AvailableValue *in) {
+    AvailableValue *out;
+    Boolean first = TRUE;
+    int i, j;
+
+    for (j = 0; j < ms->num_syms; j++) {
+        in[j].reg = NO_ARG;
+        in[j].instr = NO_IR_INSTRUCTION;
+    }
+    for (i = 0; i < b->num_preds; i++) {
+        if (b->preds[i]->rpo == -1 || !ms->visited[b->preds[i]->id]) {
+            continue;
+        }
+        out = ms->avail_out[b->preds[i]->id];
+        for (j = 0; j < ms->num_syms; j++) {
+            if (first) {
+                in[j] = out[j];
+            } else if (in[j].reg != out[j].reg ||
+                        in[j].instr != out[j].instr) {
+                in[j].reg = NO_ARG;
+                in[j].instr = NO_IR_INSTRUCTION;
+            }
+        }
+        first = FALSE;
+    }
+    return !first;
+}
+
+/* apply the instructions of b to the values available on entry */
+void forward_block(MemoryState *ms, BasicBlock *b, AvailableValue *avail,
+                    Boolean rewrite) {
+    AddressInfo a;
+    IrNode *irn, *next;
+    int i;
+
+    for (irn = b->first; irn != NULL; irn = next) {
+        next = irn == b->last ? NULL : irn->next;
+        if (is_memory_load(irn)) {
+            a = address_of(ms, resolve_register(ms, irn->RSRC));
+            if (a.kind != ADDR_EXACT) {
+                continue;
+            }
+            if (avail[a.sym].reg != NO_ARG &&
+                    avail[a.sym].instr == instruction(irn)) {
+                if (rewrite) {
+                    ms->subst[irn->RDEST] = avail[a.sym].reg;
+                    remove_block_node(irn, ms->cfg);
+                    ms->removed++;
+                }
+            } else {
+                avail[a.sym].reg = irn->RDEST;
+                avail[a.sym].instr = instruction(irn);
+            }
+            continue;
+        }
+        switch (instruction(irn)) {
+            case STORE_BYTE_INDIRECT:
+            case STORE_HALF_WORD_INDIRECT:
+            case STORE_WORD_INDIRECT:
+                a = address_of(ms, resolve_register(ms, irn->RDEST));
+                if (a.kind == ADDR_UNKNOWN) {
+                    for (i = 0; i < ms->num_syms; i++) {
+                        avail[i].reg = NO_ARG;
+                    }
+                } else if (a.kind == ADDR_EXACT &&
+                            instruction(irn) == STORE_WORD_INDIRECT) {
+                    avail[a.sym].reg = resolve_register(ms, irn->RSRC);
+                    avail[a.sym].instr = LOAD_WORD_INDIRECT;
+                } else {
+                    /* a narrow store keeps only the low bytes of RSRC */
+                    avail[a.sym].reg = NO_ARG;
+                }
+                break;
+            case CALL:
+                if (irn->IMMVAL != CALL_ANY_EFFECTS) {
+                    /* a const or pure call writes no memory */
+                    break;
+                }
+                /* falls through */
+            case STORE_WORD:
+            case SYSCALL:
+                for (i = 0; i < ms->num_syms; i++) {
+                    avail[i].reg = NO_ARG;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/*
+ * find the variables that may be read after each point, starting from the
+ * globals at the end of the procedure, and delete stores to dead variables
+ */
+void remove_dead_stores(MemoryState *ms) {
+    ControlFlowGraph *cfg = ms->cfg;
+    Boolean **live_in, *live, changed;
+    BasicBlock *b;
+    int i, j;
+
+    util_emalloc((void **) &live_in, (cfg->num_blocks + 1) * sizeof(Boolean *));
+    util_emalloc((void **) &live, (ms->num_syms + 1) * sizeof(Boolean));
+    for (i = 0; i < cfg->num_blocks; i++) {
+        util_emalloc((void **) &live_in[i],
+                        (ms->num_syms + 1) * sizeof(Boolean));
+        for (j = 0; j < ms->num_syms; j++) {
+            live_in[i][j] = FALSE;
+        }
+    }
+
+    do {
+        changed = FALSE;
+        for (i = cfg->num_rpo - 1; i >= 0; i--) {
+            b = cfg->rpo[i];
+            live_out_symbols(ms, b, live_in, live);
+            sweep_stores(ms, b, live, FALSE);
+            for (j = 0; j < ms->num_syms; j++) {
+                if (live[j] && !live_in[b->id][j]) {
+                    live_in[b->id][j] = TRUE;
+                    changed = TRUE;
+                }
+            }
+        }
+    } while (changed);
+
+    /* deleting a dead store makes nothing else live, so one sweep is enough */
+    for (i = 0; i < cfg->num_rpo; i++) {
+        live_out_symbols(ms, cfg->rpo[i], live_in, live);
+        sweep_stores(ms, cfg->rpo[i], live, TRUE);
+    }
+
+    for (i = 0; i < cfg->num_blocks; i++) {
+        free(live_in[i]);
+    }
+    free(live_in);
+    free(live);
+}
+
+/* variables that may be read after b: globals outlive the procedure */
+void live_out_symbols(MemoryState *ms, BasicBlock *b, Boolean **live_in,
+                        Boolean *live) {
+    int j, k;
+    for (j = 0; j < ms->num_syms; j++) {
+        live[j] = b->num_succs == 0 && is_global_symbol(ms->syms[j]);
+        for (k = 0; k < b->num_succs; k++) {
+            live[j] = live[j] || live_in[b->succs[k]->id][j];
+        }
+    }
+}
+
+/* walk b backward from the variables live after it */
+void sweep_stores(MemoryState *ms, BasicBlock *b, Boolean *live,
+                    Boolean remove) {
+    AddressInfo a;
+    IrNode *irn, *prev;
+    int i;
+
+    for (irn = b->last; irn != b->first; irn = prev) {
+        prev = irn->prev;
+        if (is_memory_load(irn)) {
+            a = address_of(ms, irn->RSRC);
+            if (a.kind == ADDR_UNKNOWN) {
+                for (i = 0; i < ms->num_syms; i++) {
+                    live[i] = TRUE;
+                }
+            } else {
+                live[a.sym] = TRUE;
+            }
+            continue;
+        }
+        switch (instruction(irn)) {
+            case STORE_BYTE_INDIRECT:
+            case STORE_HALF_WORD_INDIRECT:
+            case STORE_WORD_INDIRECT:
+                a = address_of(ms, irn->RDEST);
+                if (a.kind == ADDR_UNKNOWN) {
+                    break;
+                }
+                if (!live[a.sym]) {
+                    if (remove) {
+                        remove_block_node(irn, ms->cfg);
+                        ms->removed++;
+                    }
+                } else if (a.kind == ADDR_EXACT &&
+                            is_scalar_symbol(ms->syms[a.sym])) {
+                    /* the store overwrites the whole variable */
+                    live[a.sym] = FALSE;
+                }
+                break;
+            case CALL:
+                if (irn->IMMVAL == CALL_CONST) {
+                    /* a const call reads no memory */
+                    break;
+                }
+                /* falls through */
+            case STORE_WORD:
+            case SYSCALL:
+                for (i = 0; i < ms->num_syms; i++) {
+                    live[i] = TRUE;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+Boolean is_memory_load(IrNode *irn) {
+    switch (instruction(irn)) {
+        case LOAD_BYTE_INDIRECT:
+        case LOAD_UNSIGNED_BYTE_INDIRECT:
+        case LOAD_HALF_WORD_INDIRECT:
+        case LOAD_UNSIGNED_HALF_WORD_INDIRECT:
+        case LOAD_WORD_INDIRECT:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/* variables that live on after the procedure returns */
+Boolean is_global_symbol(Symbol *s) {
+    SymbolTable *st = get_symbol_table(s);
+    return st == NULL || st_scope(st) == TOP_LEVEL_SCOPE;
+}
+
+Boolean is_scalar_symbol(Symbol *s) {
+    switch (symbol_outer_type(s)) {
+        case ARRAY:
+        case FUNCTION:
+            return FALSE;
+        default:
+            return TRUE;
+    }
+}
+
+/* the register holding the value of reg after removed loads */
+int resolve_register(MemoryState *ms, int reg) {
+    if (reg == NO_ARG) {
+        return reg;
+    }
+    while (ms->subst[reg] != reg) {
+        reg = ms->subst[reg];
+    }
+    return reg;
+}
@@ -0,0 +1,393 @@
+/*
+ * Multiplication and division by constants.
+ *
+ * MIPS multiplies and divides in a unit of its own, taking many cycles and
+ * leaving its results in HI and LO. Once the other passes are done with a
+ * procedure, a multiply by a constant that one shift, or two shifts and an
+ * add or subtract, can do becomes those: x * 8 is x << 3, x * 10 is
+ * (x << 3) + (x << 1) and x * 7 is (x << 3) - x. Other multiplies are
+ * left alone.
+ *
+ * A division by a constant d becomes a multiply by a magic number close to
+ * 2^(32 + s) / d, keeping the high word of the product, and a shift right
+ * by s (Granlund and Montgomery; Warren, Hacker's Delight, chapter 10).
+ * Signed quotients are rounded toward zero by adding one to those that
+ * come out negative. An unsigned magic number that needs 33 bits is
+ * applied as its low 32 bits, the missing x added back with an average
+ * that cannot overflow. Dividing by a power of two is a shift, the signed
+ * dividend first biased by 2^k - 1 when it is negative. A remainder is the
+ * dividend less the quotient times d, that multiply lowered in turn, or a
+ * mask for an unsigned one by a power of two. Division by 0 is left alone.
+ *
+ * Whether a division is signed comes from its instruction: IR generation
+ * gives DIVU, REMU and logical right shifts to operands whose promoted
+ * type is unsigned int or unsigned long. char and short operands are
+ * promoted to int, and long is a word, so every other integer type divides
+ * as int does.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-opt.h"
+#include "../include/utilities.h"
+
+#define WORD_BITS 32
+#define WORD_MIN ((int) 0x80000000u)
+
+/* a division by a constant as a multiply-high and a shift right */
+struct Magic {
+    unsigned int multiplier;
+    int shift;
+    Boolean add;                /* unsigned: the multiplier has a 33rd bit */
+};
+typedef struct Magic Magic;
+
+/* the node being lowered; its replacement goes before it */
+struct Lowering {
+    ControlFlowGraph *cfg;
+    IrNode *pos;
+};
+typedef struct Lowering Lowering;
+
+/* file helper functions */
+int lower_node(Lowering *lw, IrNode **defs, int *num_defs);
+Boolean constant_operand(int reg, IrNode **defs, int *num_defs, int *value);
+int lower_multiply(Lowering *lw, int x, unsigned int c);
+int lower_signed_divide(Lowering *lw, int x, int d);
+int lower_unsigned_divide(Lowering *lw, int x, unsigned int d);
+int lower_remainder(Lowering *lw, int x, int q, unsigned int d);
+Magic signed_magic(int d);
+Magic unsigned_magic(unsigned int d);
+int exact_log2(unsigned int c);
+int emit_lowered(Lowering *lw, int instr, int a, int b);
+int emit_lowered_constant(Lowering *lw, int value);
+int emit_shift(Lowering *lw, int instr, int x, int count);
+
+
+/*
+ * lower_constant_arithmetic
+ * Purpose: replace multiplies and divides by constants with shifts, adds
+ *          and multiply-high instructions
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure not in SSA form
+ * Returns:
+ *  The number of instructions lowered
+ * Side Effects:
+ *  Inserts the replacing instructions, and the constants they read, before
+ *  each instruction lowered, which is removed or becomes a copy. The
+ *  constant a lowered instruction read may be left unused.
+ */
+int lower_constant_arithmetic(ControlFlowGraph *cfg) {
+    Lowering lw;
+    IrNode **defs, *irn, *next;
+    int *num_defs, i, lowered = 0;
+
+    defs = register_defs(cfg, &num_defs);
+    lw.cfg = cfg;
+    for (i = 0; i < cfg->num_blocks; i++) {
+        for (irn = cfg->blocks[i]->first; irn != NULL; irn = next) {
+            next = irn == cfg->blocks[i]->last ? NULL : irn->next;
+            lw.pos = irn;
+            lowered += lower_node(&lw, defs, num_defs);
+        }
+    }
+    free(defs);
+    free(num_defs);
+    return lowered;
+}
+
+/* lower lw->pos if it multiplies or divides by a constant: 1 if it does */
+int lower_node(Lowering *lw, IrNode **defs, int *num_defs) {
+    IrNode *irn = lw->pos, *before = irn->prev;
+    int instr = instruction(irn), c, result;
+
+    switch (instr) {
+        case MULT:
+            if (constant_operand(irn->OPRND2, defs, num_defs, &c)) {
+                result = lower_multiply(lw, irn->OPRND1, (unsigned int) c);
+            } else if (constant_operand(irn->OPRND1, defs, num_defs, &c)) {
+                result = lower_multiply(lw, irn->OPRND2, (unsigned int) c);
+            } else {
+                return 0;
+            }
+            break;
+        case DIV:
+        case REM:
+        case DIVU:
+        case REMU:
+            if (!constant_operand(irn->OPRND2, defs, num_defs, &c) ||
+                    c == 0) {
+                return 0;
+            }
+            if (instr == REM && c < 0 && c != WORD_MIN) {
+                /* the remainder takes the sign of x alone */
+                c = -c;
+            }
+            if ((instr == REM || instr == REMU) && c == 1) {
+                result = emit_lowered_constant(lw, 0);
+            } else if (instr == REMU && exact_log2((unsigned int) c) > 0) {
+                result = emit_lowered(lw, BIT_AND, irn->OPRND1,
+                                        emit_lowered_constant(lw, c - 1));
+            } else {
+                result = instr == DIV || instr == REM ?
+                    lower_signed_divide(lw, irn->OPRND1, c) :
+                    lower_unsigned_divide(lw, irn->OPRND1, (unsigned int) c);
+                if (instr == REM || instr == REMU) {
+                    result = lower_remainder(lw, irn->OPRND1, result,
+                                                (unsigned int) c);
+                }
+            }
+            break;
+        default:
+            return 0;
+    }
+    if (result == NO_ARG) {
+        return 0;
+    }
+    if (irn->prev != before && irn->prev->RDEST == result) {
+        /* the last instruction inserted computes the result itself */
+        irn->prev->RDEST = irn->RDEST;
+        remove_block_node(irn, lw->cfg);
+    } else {
+        irn->instruction = MOVE;
+        irn->RSRC = result;
+        irn->OPRND1 = NO_ARG;
+        irn->OPRND2 = NO_ARG;
+    }
+    return 1;
+}
+
+/* is reg defined only by a LOAD_CONSTANT? value is then its constant */
+Boolean constant_operand(int reg, IrNode **defs, int *num_defs, int *value) {
+    if (reg == NO_ARG || num_defs[reg] != 1 ||
+            instruction(defs[reg]) != LOAD_CONSTANT) {
+        return FALSE;
+    }
+    *value = defs[reg]->IMMVAL;
+    return TRUE;
+}
+
+/*
+ * a register holding x * c computed with at most two shifts and an add or
+ * subtract, or a shift and a negate; NO_ARG if it takes more. c is taken
+ * as unsigned, which gives the same low word as signed multiplication
+ */
+int lower_multiply(Lowering *lw, int x, unsigned int c) {
+    unsigned int low, negated = 0u - c;
+    int k;
+
+    if (c == 0) {
+        return emit_lowered_constant(lw, 0);
+    }
+    k = exact_log2(c);
+    if (k >= 0) {
+        return emit_shift(lw, SHIFT_LEFT, x, k);
+    }
+    k = exact_log2(negated);
+    if (k >= 0) {
+        return emit_lowered(lw, NEGATE, emit_shift(lw, SHIFT_LEFT, x, k),
+                            NO_ARG);
+    }
+    low = c & negated;
+    if (exact_log2(c - low) >= 0) {
+        /* two bits set: (x << a) + (x << b) */
+        return emit_lowered(lw, ADD,
+                    emit_shift(lw, SHIFT_LEFT, x, exact_log2(c - low)),
+                    emit_shift(lw, SHIFT_LEFT, x, exact_log2(low)));
+    }
+    if (exact_log2(c + low) >= 0) {
+        /* a run of ones, 2^a - 2^b: (x << a) - (x << b) */
+        return emit_lowered(lw, SUB,
+                    emit_shift(lw, SHIFT_LEFT, x, exact_log2(c + low)),
+                    emit_shift(lw, SHIFT_LEFT, x, exact_log2(low)));
+    }
+    low = negated & c;
+    if (exact_log2(negated + low) >= 0) {
+        /* the negation of a run of ones: (x << b) - (x << a) */
+        return emit_lowered(lw, SUB,
+                    emit_shift(lw, SHIFT_LEFT, x, exact_log2(low)),
+                    emit_shift(lw, SHIFT_LEFT, x, exact_log2(negated + low)));
+    }
+    return NO_ARG;
+}
+
+/* a register holding x / d rounded toward zero, for a d other than 0 */
+int lower_signed_divide(Lowering *lw, int x, int d) {
+    unsigned int ad = d < 0 ? 0u - (unsigned int) d : (unsigned int) d;
+    int k = exact_log2(ad), q, t;
+    Magic m;
+
+    if (k >= 0) {
+        q = x;
+        if (k > 0) {
+            /* x >> (k - 1) has 2^k - 1 in its top k bits when x < 0 */
+            t = emit_shift(lw, SHIFT_RIGHT, x, k - 1);
+            t = emit_shift(lw, SHIFT_RIGHT_LOGICAL, t, WORD_BITS - k);
+            q = emit_shift(lw, SHIFT_RIGHT, emit_lowered(lw, ADD, x, t), k);
+        }
+        return d < 0 ? emit_lowered(lw, NEGATE, q, NO_ARG) : q;
+    }
+    m = signed_magic(d);
+    t = emit_lowered(lw, MULT_HIGH, x,
+                        emit_lowered_constant(lw, (int) m.multiplier));
+    if (d > 0 && (int) m.multiplier < 0) {
+        t = emit_lowered(lw, ADD, t, x);
+    } else if (d < 0 && (int) m.multiplier > 0) {
+        t = emit_lowered(lw, SUB, t, x);
+    }
+    t = emit_shift(lw, SHIFT_RIGHT, t, m.shift);
+    return emit_lowered(lw, ADD, t,
+                emit_shift(lw, SHIFT_RIGHT_LOGICAL, t, WORD_BITS - 1));
+}
+
+/* a register holding x / d for unsigned x and a d other than 0 */
+int lower_unsigned_divide(Lowering *lw, int x, unsigned int d) {
+    int k = exact_log2(d), t;
+    Magic m;
+
+    if (k >= 0) {
+        return emit_shift(lw, SHIFT_RIGHT_LOGICAL, x, k);
+    }
+    m = unsigned_magic(d);
+    t = emit_lowered(lw, MULT_HIGH_UNSIGNED, x,
+                        emit_lowered_constant(lw, (int) m.multiplier));
+    if (!m.add) {
+        return emit_shift(lw, SHIFT_RIGHT_LOGICAL, t, m.shift);
+    }
+    /* (x * 2^32 + x * multiplier) >> 32 is t + x, which may overflow */
+    t = emit_lowered(lw, ADD, t, emit_shift(lw, SHIFT_RIGHT_LOGICAL,
+                                    emit_lowered(lw, SUB, x, t), 1));
+    return emit_shift(lw, SHIFT_RIGHT_LOGICAL, t, m.shift - 1);
+}
+
+/* x less q times d, the remainder of x divided by d for its quotient q */
+int lower_remainder(Lowering *lw, int x, int q, unsigned int d) {
+    int product = lower_multiply(lw, q, d);
+    if (product == NO_ARG) {
+        product = emit_lowered(lw, MULT, q,
+                                emit_lowered_constant(lw, (int) d));
+    }
+    return emit_lowered(lw, SUB, x, product);
+}
+
+/*
+ * the magic number and shift dividing a signed word by d, for d other than
+ * 0, 1 and -1 (Hacker's Delight, figure 10-1)
+ */
+Magic signed_magic(int d) {
+    const unsigned int two31 = 0x80000000u;
+    unsigned int ad, t, anc, q1, r1, q2, r2, delta;
+    int p = WORD_BITS - 1;
+    Magic m;
+
+    ad = d < 0 ? 0u - (unsigned int) d : (unsigned int) d;
+    t = two31 + ((unsigned int) d >> (WORD_BITS - 1));
+    anc = t - 1 - t % ad;
+    q1 = two31 / anc;
+    r1 = two31 - q1 * anc;
+    q2 = two31 / ad;
+    r2 = two31 - q2 * ad;
+    do {
+        p++;
+        q1 = 2 * q1;
+        r1 = 2 * r1;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 = 2 * q2;
+        r2 = 2 * r2;
+        if (r2 >= ad) {
+            q2++;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    m.multiplier = d < 0 ? 0u - (q2 + 1) : q2 + 1;
+    m.shift = p - WORD_BITS;
+    m.add = FALSE;
+    return m;
+}
+
+/*
+ * the magic number and shift dividing an unsigned word by d, for d not a
+ * power of two (Hacker's Delight, figure 10-2)
+ */
+Magic unsigned_magic(unsigned int d) {
+    unsigned int q, r, delta, p32 = 0;
+    int p = WORD_BITS - 1;
+    Magic m;
+
+    m.add = FALSE;
+    q = 0x7FFFFFFFu / d;
+    r = 0x7FFFFFFFu - q * d;
+    do {
+        p++;
+        p32 = p == WORD_BITS ? 1 : 2 * p32;
+        if (r + 1 >= d - r) {
+            if (q >= 0x7FFFFFFFu) {
+                m.add = TRUE;
+            }
+            q = 2 * q + 1;
+            r = 2 * r + 1 - d;
+        } else {
+            if (q >= 0x80000000u) {
+                m.add = TRUE;
+            }
+            q = 2 * q;
+            r = 2 * r + 1;
+        }
+        delta = d - 1 - r;
+    } while (p < 2 * WORD_BITS && p32 < delta);
+    m.multiplier = q + 1;
+    m.shift = p - WORD_BITS;
+    return m;
+}
+
+/* k if c is 2^k, else -1 */
+int exact_log2(unsigned int c) {
+    int k = 0;
+    if (c == 0 || (c & (c - 1)) != 0) {
+        return -1;
+    }
+    while (c > 1) {
+        c >>= 1;
+        k++;
+    }
+    return k;
+}
+
+/* insert a instr b, or instr a for a unary one, into a new register */
+int emit_lowered(Lowering *lw, int instr, int a, int b) {
+    IrNode *irn = construct_ir_node(instr);
+    irn->RDEST = new_reg(lw->cfg);
+    if (is_unary_op(irn)) {
+        irn->RSRC = a;
+    } else {
+        irn->OPRND1 = a;
+        irn->OPRND2 = b;
+    }
+    irn->bb = lw->pos->bb;
+    insert_ir_node_before(lw->pos, irn, lw->cfg->irl);
+    return irn->RDEST;
+}
+
+/* insert a load of a constant into a new register */
+int emit_lowered_constant(Lowering *lw, int value) {
+    IrNode *irn = construct_ir_node(LOAD_CONSTANT);
+    irn->RDEST = new_reg(lw->cfg);
+    irn->IMMVAL = value;
+    irn->bb = lw->pos->bb;
+    insert_ir_node_before(lw->pos, irn, lw->cfg->irl);
+    return irn->RDEST;
+}
+
+/* x shifted by count with instr, or x itself when count is 0 */
+int emit_shift(Lowering *lw, int instr, int x, int count) {
+    if (count == 0) {
+        return x;
+    }
+    return emit_lowered(lw, instr, x, emit_lowered_constant(lw, count));
+}
@@ -0,0 +1,267 @@
+/*
+ * The IR optimization pipeline.
+ *
+ * -O1 runs the passes of optimize_ir over IR generated from a parse tree
+ * whose constant expressions are already folded. With -report each pass
+ * prints a line to stderr for each procedure it ran over, and each pass
+ * over the whole program a line of its own, counting what it changed:
+ * dce: main: 4 instructions removed, or ipo: 2 unreachable functions and
+ * globals removed. The options are read by parse_opt_flags for both
+ * drivers, ir-main and mips-main.
+ */
+#include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-ssa.h"
+#include "../include/ir-opt.h"
+#include "../include/symbol-utils.h"
+
+/* the most times constants are propagated across calls */
+#define MAX_IPO_ROUNDS 4
+
+/* where passes report what they changed, NULL for no report */
+FILE *opt_report = NULL;
+
+/* generate MIPS I code, without the MIPS32 instructions; set by -mips1 */
+Boolean mips1 = FALSE;
+
+/* file helper functions */
+void optimize_procedures(IrList *irl, CallGraph *cg);
+void lower_procedures(IrList *irl);
+int positive_flag_value(char *arg, int prefix_length);
+
+/*
+ * optimize_ir
+ * Purpose: run the optimization passes for an optimization level over
+ *          every procedure in an IR list
+ * Parameters:
+ *  irl - IrList * - the IR list
+ *  level - int - 0 leaves the IR alone. 1 takes each procedure into SSA
+ *          form, propagates constants, removes redundant computations,
+ *          loads and stores, moves loop-invariant code out of loops,
+ *          turns multiplies by induction variables into additions,
+ *          takes it back out, keeps globals in registers across loops
+ *          and removes dead code.
+ *          Then the calls the cost model finds worth it are inlined,
+ *          procedures and globals main does not reach are removed,
+ *          procedures are copied for the constants some of their calls
+ *          pass, constants are propagated across calls, and the procedures
+ *          this or the calls found const or pure change are optimized
+ *          again, which may make more constants to propagate.
+ *          Last, short branches choosing values become selects, counted
+ *          loops are unrolled, multiplies and divides by constants become
+ *          shifts, adds and multiply-highs, loops are rotated to test at
+ *          the bottom and blocks are laid out so that likely successors
+ *          follow them and cold blocks come last.
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Rewrites the IR list in place. May remove globals from the file scope
+ *  symbol table.
+ */
+void optimize_ir(IrList *irl, int level) {
+    CallGraph *cg;
+    int round, propagated, i;
+
+    if (level < 1) {
+        return;
+    }
+    optimize_procedures(irl, NULL);
+    cg = build_call_graph(irl);
+    report_program("inline", inline_calls(cg, irl), "calls inlined");
+    report_program("ipo", remove_unreachable(cg, irl),
+                    "unreachable functions and globals removed");
+    report_program("specialize", specialize_procedures(cg, irl),
+                    "functions copied for constant arguments");
+    for (round = 0; round < MAX_IPO_ROUNDS; round++) {
+        propagated = propagate_interprocedural_constants(cg);
+        report_program("ipcp", propagated,
+                        "constant arguments and results propagated");
+        report_program("effects", tag_call_effects(cg),
+                        "functions found const or pure");
+        if (round > 0 && propagated == 0) {
+            break;
+        }
+        optimize_procedures(irl, cg);
+        for (i = 0; i < cg->num_procs; i++) {
+            cg->changed[i] = FALSE;
+        }
+    }
+    free_call_graph(cg);
+    lower_procedures(irl);
+}
+
+/* run the passes over each procedure, or only those cg marks changed */
+void optimize_procedures(IrList *irl, CallGraph *cg) {
+    ControlFlowGraph *cfg;
+    IrNode *proc;
+
+    proc = next_proc(irl->head);
+    while (proc != NULL) {
+        cfg = create_cfg(irl, proc);
+        if (cg == NULL || cg->changed[procedure_index(cg, proc->s)]) {
+            construct_ssa(cfg);
+            propagate_constants(cfg);
+            report_pass("calls", cfg, reuse_pure_calls(cfg),
+                        "pure calls removed");
+            report_pass("gvn", cfg, number_values(cfg), "instructions removed");
+            report_pass("mem", cfg, optimize_memory(cfg),
+                        "loads and stores removed");
+            report_pass("licm", cfg, hoist_loop_invariants(cfg),
+                        "instructions hoisted");
+            report_pass("ivs", cfg, reduce_induction_variables(cfg),
+                        "induction variable computations reduced");
+            destruct_ssa(cfg);
+            report_pass("promote", cfg, promote_globals(cfg),
+                        "globals promoted to registers");
+            report_pass("dce", cfg, eliminate_dead_code(cfg),
+                        "instructions removed");
+            renumber_registers(cfg);
+        }
+        proc = next_proc(cfg->end_proc);
+        free_cfg(cfg);
+    }
+}
+
+/*
+ * turn short branches computing values into selects, then
+ * unroll the loops of each procedure, folding what the copies compute with
+ * constants, then lower multiplies and divides by constants, once no pass
+ * is left to look for them, and remove the constants they no longer read.
+ * Last, loops are rotated and the blocks laid out for the code generator.
+ * A procedure with no branch to convert and no loop to unroll is not taken
+ * into SSA form for them.
+ */
+void lower_procedures(IrList *irl) {
+    ControlFlowGraph *cfg;
+    IrNode *proc;
+    int converted, unrolled;
+
+    proc = next_proc(irl->head);
+    while (proc != NULL) {
+        cfg = create_cfg(irl, proc);
+        converted = unrolled = 0;
+        if (may_convert_branches(cfg) || may_unroll(cfg)) {
+            construct_ssa(cfg);
+            propagate_constants(cfg);
+            number_values(cfg);
+            converted = convert_branches(cfg);
+            unrolled = unroll_loops(cfg);
+        }
+        report_pass("ifconv", cfg, converted, "branches made selects");
+        report_pass("unroll", cfg, unrolled, "loops unrolled");
+        if (unrolled > 0) {
+            construct_ssa(cfg);
+            propagate_constants(cfg);
+            number_values(cfg);
+            sweep_dead_values(cfg);
+            destruct_ssa(cfg);
+        }
+        report_pass("muldiv", cfg, lower_constant_arithmetic(cfg),
+                    "multiplies and divides by constants lowered");
+        eliminate_dead_code(cfg);
+        report_pass("rotate", cfg, rotate_loops(cfg), "loops rotated");
+        report_pass("layout", cfg, layout_blocks(cfg), "blocks moved");
+        report_pass("thread", cfg, thread_jumps(cfg), "jumps threaded");
+        renumber_registers(cfg);
+        proc = next_proc(cfg->end_proc);
+        free_cfg(cfg);
+    }
+}
+
+/*
+ * report_pass
+ * Purpose: print one line of statistics for a pass over a procedure
+ * Parameters:
+ *  pass - char * - short name of the pass
+ *  cfg - ControlFlowGraph * - the procedure
+ *  count - int - what the pass counted
+ *  what - char * - what count counts
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Writes to opt_report unless it is NULL
+ */
+void report_pass(char *pass, ControlFlowGraph *cfg, int count, char *what) {
+    if (opt_report != NULL) {
+        fprintf(opt_report, "%s: %s: %d %s\n", pass,
+                get_symbol_name(cfg->begin_proc->s), count, what);
+    }
+}
+
+/* print one line of statistics for a pass over the whole program */
+void report_program(char *pass, int count, char *what) {
+    if (opt_report != NULL) {
+        fprintf(opt_report, "%s: %d %s\n", pass, count, what);
+    }
+}
+
+/*
+ * parse_opt_flags
+ * Purpose: read the options at the start of a command line, before the
+ *          input and output files
+ * Parameters:
+ *  argc - int - the number of arguments, the program name included
+ *  argv - char ** - the arguments
+ *  use_ssa - Boolean * - set by -ssa
+ *  level - int * - the optimization level, set by -O0 and -O1
+ * Returns:
+ *  The number of options read, or NO_ARG for an option that is unknown or
+ *  whose N is not a positive number
+ * Side Effects:
+ *  Sets opt_report, inline_limit, unroll_factor, mips1 and
+ *  conditional_moves from their options. Prints an error to stderr for a
+ *  bad option.
+ */
+int parse_opt_flags(int argc, char *argv[], Boolean *use_ssa, int *level) {
+    char *arg;
+    int i;
+
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+        arg = argv[i];
+        if (!strcmp("-ssa", arg)) {
+            *use_ssa = TRUE;
+        } else if (!strcmp("-report", arg)) {
+            opt_report = stderr;
+        } else if (!strcmp("-O0", arg) || !strcmp("-O1", arg)) {
+            *level = arg[2] - '0';
+        } else if (!strncmp("-inline-limit=", arg, 14)) {
+            inline_limit = positive_flag_value(arg, 14);
+            if (inline_limit == NO_ARG) {
+                return NO_ARG;
+            }
+        } else if (!strncmp("-unroll=", arg, 8)) {
+            unroll_factor = positive_flag_value(arg, 8);
+            if (unroll_factor == NO_ARG) {
+                return NO_ARG;
+            }
+        } else if (!strcmp("-mips1", arg)) {
+            mips1 = TRUE;
+            conditional_moves = FALSE;
+        } else if (!strcmp("-mips32", arg)) {
+            mips1 = FALSE;
+            conditional_moves = TRUE;
+        } else {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return NO_ARG;
+        }
+    }
+    return i - 1;
+}
+
+/* the N of an option -name=N, NO_ARG with an error unless it is above 0 */
+int positive_flag_value(char *arg, int prefix_length) {
+    char *end;
+    long value = strtol(arg + prefix_length, &end, 10);
+
+    if (end == arg + prefix_length || *end != '\0' || value < 1 ||
+            value > INT_MAX) {
+        fprintf(stderr, "%s: expected a positive number\n", arg);
+        return NO_ARG;
+    }
+    return (int) value;
+}
@@ -0,0 +1,550 @@
+/*
+ * Constant folding and sparse conditional constant propagation
+ * (Wegman and Zadeck) over a procedure in SSA form.
+ *
+ * Only the ways out of a branch that its condition allows are followed, so
+ * a branch whose condition is known leaves the other way unreachable, and
+ * the PHIs it joins see only the constants of the way taken. Values are
+ * folded as the 32 bit words the target computes.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-ssa.h"
+#include "../include/ir-opt.h"
+#include "../include/utilities.h"
+
+/* lattice states, ordered so that lowering a value increases its state */
+#define LATTICE_TOP 0           /* no value seen yet          */
+#define LATTICE_CONSTANT 1      /* always the value in value  */
+#define LATTICE_BOTTOM 2        /* not a known constant       */
+
+struct LatticeValue {
+    int state;
+    int value;
+};
+typedef struct LatticeValue LatticeValue;
+
+struct Sccp {
+    ControlFlowGraph *cfg;
+    DefUse *du;
+    LatticeValue *vals;         /* per register                         */
+    Boolean *block_exec;        /* per block                            */
+    Boolean **edge_exec;        /* per block, per predecessor index     */
+    BasicBlock **flow_from;     /* worklist of CFG edges                */
+    BasicBlock **flow_to;
+    int num_flow;
+    IrNode **ssa;               /* worklist of instructions to revisit  */
+    int num_ssa;
+};
+typedef struct Sccp Sccp;
+
+/* file helper functions */
+unsigned int high_product(unsigned int a, unsigned int b);
+void sccp_mark_edge(Sccp *sc, BasicBlock *from, BasicBlock *to);
+void sccp_visit_block(Sccp *sc, BasicBlock *b);
+void sccp_visit(Sccp *sc, IrNode *irn);
+void sccp_visit_jump(Sccp *sc, IrNode *irn);
+LatticeValue sccp_evaluate(Sccp *sc, IrNode *irn);
+LatticeValue sccp_evaluate_phi(Sccp *sc, IrNode *irn);
+int sccp_rewrite(Sccp *sc);
+BasicBlock *jump_fall_through(IrNode *irn);
+
+
+/*
+ * fold_binary_op
+ * Purpose: evaluate a binary IR instruction on constant operands
+ * Parameters:
+ *  instr - int - the instruction, one for which is_binary_op holds
+ *  a, b - int - values of OPRND1 and OPRND2
+ *  result - int * - set to the value of RDEST
+ * Returns:
+ *  FALSE when the instruction would trap or its result is undefined,
+ *  e.g. division by zero; result is then unchanged.
+ *  Arithmetic wraps at 32 bits and shift counts use their low five bits,
+ *  as the MIPS instructions do.
+ */
+Boolean fold_binary_op(int instr, int a, int b, int *result) {
+    unsigned int ua = (unsigned int) a, ub = (unsigned int) b;
+    switch (instr) {
+        case ADD:
+        case ADDU:
+            *result = (int) (ua + ub);
+            return TRUE;
+        case SUB:
+        case SUBU:
+            *result = (int) (ua - ub);
+            return TRUE;
+        case MULT:
+            *result = (int) (ua * ub);
+            return TRUE;
+        case DIV:
+        case REM:
+            if (b == 0 || (b == -1 && a == (int) 0x80000000u)) {
+                return FALSE;
+            }
+            *result = instr == DIV ? a / b : a % b;
+            return TRUE;
+        case DIVU:
+        case REMU:
+            if (b == 0) {
+                return FALSE;
+            }
+            *result = (int) (instr == DIVU ? ua / ub : ua % ub);
+            return TRUE;
+        case MULT_HIGH:
+            /* the signed product's high word, from the unsigned one */
+            *result = (int) (high_product(ua, ub) - (a < 0 ? ub : 0) -
+                                (b < 0 ? ua : 0));
+            return TRUE;
+        case MULT_HIGH_UNSIGNED:
+            *result = (int) high_product(ua, ub);
+            return TRUE;
+        case BIT_AND:
+            *result = a & b;
+            return TRUE;
+        case BIT_OR:
+            *result = a | b;
+            return TRUE;
+        case BIT_XOR:
+            *result = a ^ b;
+            return TRUE;
+        case SHIFT_LEFT:
+            *result = (int) (ua << (ub & 31));
+            return TRUE;
+        case SHIFT_RIGHT:
+            /* arithmetic shift, without relying on >> of negative values */
+            *result = a < 0 ? ~(~a >> (ub & 31)) : a >> (ub & 31);
+            return TRUE;
+        case SHIFT_RIGHT_LOGICAL:
+            *result = (int) (ua >> (ub & 31));
+            return TRUE;
+        case LOG_AND:
+            *result = a != 0 && b != 0;
+            return TRUE;
+        case LOG_OR:
+            *result = a != 0 || b != 0;
+            return TRUE;
+        case SET_LT:
+            *result = a < b;
+            return TRUE;
+        case SET_LE:
+            *result = a <= b;
+            return TRUE;
+        case SET_GT:
+            *result = a > b;
+            return TRUE;
+        case SET_GE:
+            *result = a >= b;
+            return TRUE;
+        case SET_LTU:
+            *result = ua < ub;
+            return TRUE;
+        case SET_LEU:
+            *result = ua <= ub;
+            return TRUE;
+        case SET_GTU:
+            *result = ua > ub;
+            return TRUE;
+        case SET_GEU:
+            *result = ua >= ub;
+            return TRUE;
+        case SET_EQ:
+            *result = a == b;
+            return TRUE;
+        case SET_NE:
+            *result = a != b;
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/* the high word of the 64-bit unsigned product a * b, from 16-bit halves */
+unsigned int high_product(unsigned int a, unsigned int b) {
+    unsigned int a0 = a & 0xFFFF, a1 = a >> 16, b0 = b & 0xFFFF, b1 = b >> 16;
+    unsigned int mid = a1 * b0 + ((a0 * b0) >> 16);
+    unsigned int low = a0 * b1 + (mid & 0xFFFF);
+    return a1 * b1 + (mid >> 16) + (low >> 16);
+}
+
+/* evaluate a unary IR instruction (or ADD_CONST's register part) */
+Boolean fold_unary_op(int instr, int a, int *result) {
+    switch (instr) {
+        case NEGATE:
+            *result = (int) (0u - (unsigned int) a);
+            return TRUE;
+        case LOG_NOT:
+            *result = a == 0;
+            return TRUE;
+        case BIT_NOT:
+            *result = ~a;
+            return TRUE;
+        case MOVE:
+            *result = a;
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/* would the conditional jump instr be taken when its register holds cond? */
+Boolean fold_jump(int instr, int cond) {
+    switch (instr) {
+        case JUMP_EQZ:
+            return cond == 0;
+        case JUMP_NEZ:
+            return cond != 0;
+        case JUMP_LEZ:
+            return cond <= 0;
+        case JUMP_GEZ:
+            return cond >= 0;
+        default:
+            return TRUE;
+    }
+}
+
+/*
+ * propagate_constants
+ * Purpose: find registers that hold the same constant on every executable
+ *          path and branches whose direction is known, and simplify them
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure in SSA form
+ * Returns:
+ *  The number of instructions replaced by constants, plus the number of
+ *  conditional jumps resolved
+ * Side Effects:
+ *  Instructions computing constants become LOAD_CONSTANT. Conditional jumps
+ *  on constants become JUMP or are deleted, and blocks no longer reachable
+ *  are removed along with their PHI arguments. Rebuilds the CFG.
+ */
+int propagate_constants(ControlFlowGraph *cfg) {
+    Sccp sc;
+    BasicBlock *from, *to;
+    IrNode *irn;
+    int i, j, changed;
+
+    sc.cfg = cfg;
+    sc.du = compute_def_use(cfg);
+    util_emalloc((void **) &sc.vals,
+                    (cfg->num_regs + 1) * sizeof(LatticeValue));
+    for (i = 0; i < cfg->num_regs; i++) {
+        /*
+         * a register nothing defines may hold anything: a branch on it
+         * keeps both of its edges
+         */
+        sc.vals[i].state = sc.du[i].def == NULL ? LATTICE_BOTTOM :
+                            LATTICE_TOP;
+        sc.vals[i].value = 0;
+    }
+    util_emalloc((void **) &sc.block_exec, cfg->num_blocks * sizeof(Boolean));
+    util_emalloc((void **) &sc.edge_exec, cfg->num_blocks * sizeof(Boolean *));
+    sc.num_flow = 0;
+    for (i = 0; i < cfg->num_blocks; i++) {
+        sc.block_exec[i] = FALSE;
+        sc.edge_exec[i] = NULL;
+        if (cfg->blocks[i]->num_preds > 0) {
+            util_emalloc((void **) &sc.edge_exec[i],
+                            cfg->blocks[i]->num_preds * sizeof(Boolean));
+        }
+        for (j = 0; j < cfg->blocks[i]->num_preds; j++) {
+            sc.edge_exec[i][j] = FALSE;
+        }
+        sc.num_flow += cfg->blocks[i]->num_succs;
+    }
+    /* each edge is queued at most once */
+    util_emalloc((void **) &sc.flow_from,
+                    (sc.num_flow + 1) * sizeof(BasicBlock *));
+    util_emalloc((void **) &sc.flow_to,
+                    (sc.num_flow + 1) * sizeof(BasicBlock *));
+    sc.num_flow = 0;
+    sc.ssa = NULL;
+    sc.num_ssa = 0;
+
+    sccp_visit_block(&sc, cfg->rpo[0]);
+    while (sc.num_flow > 0 || sc.num_ssa > 0) {
+        if (sc.num_flow > 0) {
+            sc.num_flow--;
+            from = sc.flow_from[sc.num_flow];
+            to = sc.flow_to[sc.num_flow];
+            sc.edge_exec[to->id][pred_index(to, from)] = TRUE;
+            if (!sc.block_exec[to->id]) {
+                sccp_visit_block(&sc, to);
+            } else {
+                /* only the PHIs see the newly executable edge */
+                for (irn = to->first->next; irn != to->last->next &&
+                            instruction(irn) == PHI; irn = irn->next) {
+                    sccp_visit(&sc, irn);
+                }
+            }
+        } else {
+            irn = sc.ssa[--sc.num_ssa];
+            if (sc.block_exec[irn->bb->id]) {
+                sccp_visit(&sc, irn);
+            }
+        }
+    }
+
+    changed = sccp_rewrite(&sc);
+
+    free_def_use(sc.du, cfg->num_regs);
+    free(sc.vals);
+    for (i = 0; i < cfg->num_blocks; i++) {
+        free(sc.edge_exec[i]);
+    }
+    free(sc.edge_exec);
+    free(sc.block_exec);
+    free(sc.flow_from);
+    free(sc.flow_to);
+    free(sc.ssa);
+
+    if (changed > 0) {
+        rebuild_cfg(cfg);
+        remove_unreachable_blocks(cfg);
+        update_phi_args(cfg);
+    }
+    return changed;
+}
+
+void sccp_mark_edge(Sccp *sc, BasicBlock *from, BasicBlock *to) {
+    int i;
+    if (sc->edge_exec[to->id][pred_index(to, from)]) {
+        return;
+    }
+    for (i = 0; i < sc->num_flow; i++) {
+        if (sc->flow_from[i] == from && sc->flow_to[i] == to) {
+            return;
+        }
+    }
+    sc->flow_from[sc->num_flow] = from;
+    sc->flow_to[sc->num_flow++] = to;
+}
+
+void sccp_visit_block(Sccp *sc, BasicBlock *b) {
+    IrNode *irn;
+    sc->block_exec[b->id] = TRUE;
+    FOR_EACH_BLOCK_NODE(irn, b) {
+        sccp_visit(sc, irn);
+    }
+}
+
+/* lower the value of the register irn defines, and follow its jumps */
+void sccp_visit(Sccp *sc, IrNode *irn) {
+    LatticeValue old, new;
+    int *def = ir_node_def(irn), i;
+    DefUse *du;
+
+    if (def != NULL && *def != NO_ARG) {
+        old = sc->vals[*def];
+        new = sccp_evaluate(sc, irn);
+        if (new.state > old.state ||
+                (new.state == LATTICE_CONSTANT && new.value != old.value)) {
+            if (old.state == LATTICE_CONSTANT) {
+                /* two different constants */
+                new.state = LATTICE_BOTTOM;
+            }
+            sc->vals[*def] = new;
+            du = &sc->du[*def];
+            for (i = 0; i < du->num_uses; i++) {
+                util_erealloc((void **) &sc->ssa,
+                                (sc->num_ssa + 1) * sizeof(IrNode *));
+                sc->ssa[sc->num_ssa++] = du->uses[i];
+            }
+        }
+    }
+    if (irn == irn->bb->last) {
+        sccp_visit_jump(sc, irn);
+    }
+}
+
+/* mark the out edges of a block that its last node irn can take */
+void sccp_visit_jump(Sccp *sc, IrNode *irn) {
+    BasicBlock *b = irn->bb, *fall;
+    LatticeValue cond;
+    int i;
+
+    switch (instruction(irn)) {
+        case JUMP_EQZ:
+        case JUMP_NEZ:
+        case JUMP_LEZ:
+        case JUMP_GEZ:
+            cond = sc->vals[irn->RSRC];
+            if (cond.state == LATTICE_TOP) {
+                return;
+            }
+            if (cond.state == LATTICE_CONSTANT) {
+                if (fold_jump(instruction(irn), cond.value)) {
+                    sccp_mark_edge(sc, b, irn->branch->bb);
+                } else if ((fall = jump_fall_through(irn)) != NULL) {
+                    sccp_mark_edge(sc, b, fall);
+                }
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+    for (i = 0; i < b->num_succs; i++) {
+        sccp_mark_edge(sc, b, b->succs[i]);
+    }
+}
+
+LatticeValue sccp_evaluate(Sccp *sc, IrNode *irn) {
+    LatticeValue v, a, b;
+    v.state = LATTICE_BOTTOM;
+    v.value = 0;
+
+    if (instruction(irn) == PHI) {
+        return sccp_evaluate_phi(sc, irn);
+    }
+    if (instruction(irn) == LOAD_CONSTANT) {
+        v.state = LATTICE_CONSTANT;
+        v.value = irn->IMMVAL;
+        return v;
+    }
+    if (instruction(irn) == ADD_CONST || instruction(irn) == MOVE ||
+            is_unary_op(irn)) {
+        a = sc->vals[irn->RSRC];
+        if (a.state != LATTICE_CONSTANT) {
+            v.state = a.state;
+        } else if (instruction(irn) == ADD_CONST) {
+            fold_binary_op(ADD, a.value, irn->IMMVAL, &v.value);
+            v.state = LATTICE_CONSTANT;
+        } else if (fold_unary_op(instruction(irn), a.value, &v.value)) {
+            v.state = LATTICE_CONSTANT;
+        }
+        return v;
+    }
+    if (instruction(irn) == SELECT) {
+        a = sc->vals[irn->RSRC];
+        if (a.state != LATTICE_CONSTANT) {
+            v.state = a.state;
+            return v;
+        }
+        return sc->vals[a.value != 0 ? irn->OPRND1 : irn->OPRND2];
+    }
+    if (is_binary_op(irn)) {
+        a = sc->vals[irn->OPRND1];
+        b = sc->vals[irn->OPRND2];
+        if (a.state == LATTICE_CONSTANT && b.state == LATTICE_CONSTANT) {
+            if (fold_binary_op(instruction(irn), a.value, b.value, &v.value)) {
+                v.state = LATTICE_CONSTANT;
+            }
+        } else if (a.state == LATTICE_TOP || b.state == LATTICE_TOP) {
+            v.state = LATTICE_TOP;
+        }
+        return v;
+    }
+    /* loads, call results: unknown */
+    return v;
+}
+
+/* meet of the PHI arguments flowing in along executable edges */
+LatticeValue sccp_evaluate_phi(Sccp *sc, IrNode *irn) {
+    BasicBlock *b = irn->bb;
+    LatticeValue v, a;
+    int i, j;
+
+    v.state = LATTICE_TOP;
+    v.value = 0;
+    for (i = 0; i < irn->num_phi_args; i++) {
+        for (j = 0; j < b->num_preds; j++) {
+            if (b->preds[j]->first == irn->phi_args[i].pred) {
+                break;
+            }
+        }
+        if (j == b->num_preds || !sc->edge_exec[b->id][j]) {
+            continue;
+        }
+        a = sc->vals[irn->phi_args[i].reg];
+        if (a.state == LATTICE_BOTTOM ||
+                (a.state == LATTICE_CONSTANT && v.state == LATTICE_CONSTANT &&
+                    a.value != v.value)) {
+            v.state = LATTICE_BOTTOM;
+            return v;
+        }
+        if (a.state == LATTICE_CONSTANT) {
+            v = a;
+        }
+    }
+    return v;
+}
+
+/* the block a conditional jump falls through to, or NULL */
+BasicBlock *jump_fall_through(IrNode *irn) {
+    BasicBlock *b = irn->bb;
+    int i;
+    for (i = 0; i < b->num_succs; i++) {
+        if (b->succs[i] != irn->branch->bb) {
+            return b->succs[i];
+        }
+    }
+    /* the jump targets the next block */
+    return b->num_succs > 0 ? b->succs[0] : NULL;
+}
+
+/* apply the solution to the IR, returning the number of changes */
+int sccp_rewrite(Sccp *sc) {
+    ControlFlowGraph *cfg = sc->cfg;
+    BasicBlock *b;
+    IrNode *irn, *next;
+    LatticeValue v;
+    int *def, i, changed = 0;
+    Boolean was_phi;
+
+    for (i = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        if (!sc->block_exec[b->id]) {
+            continue;
+        }
+        for (irn = b->first; irn != NULL; irn = next) {
+            next = irn == b->last ? NULL : irn->next;
+            def = ir_node_def(irn);
+            if (def != NULL && instruction(irn) != LOAD_CONSTANT &&
+                    sc->vals[*def].state == LATTICE_CONSTANT) {
+                v = sc->vals[*def];
+                was_phi = instruction(irn) == PHI;
+                if (was_phi) {
+                    /* keep the PHIs together at the top of the block */
+                    remove_block_node(irn, cfg);
+                    free(irn->phi_args);
+                    irn->phi_args = NULL;
+                    irn->num_phi_args = 0;
+                    irn->s = NULL;
+                }
+                irn->instruction = LOAD_CONSTANT;
+                irn->IMMVAL = v.value;
+                irn->RSRC = irn->OPRND1 = irn->OPRND2 = NO_ARG;
+                if (was_phi) {
+                    insert_at_block_start(b, irn, cfg);
+                }
+                changed++;
+                continue;
+            }
+            switch (instruction(irn)) {
+                case JUMP_EQZ:
+                case JUMP_NEZ:
+                case JUMP_LEZ:
+                case JUMP_GEZ:
+                    v = sc->vals[irn->RSRC];
+                    if (v.state != LATTICE_CONSTANT) {
+                        break;
+                    }
+                    if (fold_jump(instruction(irn), v.value) &&
+                            irn->branch != irn->next) {
+                        irn->instruction = JUMP;
+                        irn->RSRC = NO_ARG;
+                    } else {
+                        remove_block_node(irn, cfg);
+                    }
+                    changed++;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,347 @@
+/*
+ * Specialization of procedures for constant arguments.
+ *
+ * The calls to a procedure are grouped by the constants they pass: two
+ * calls are in a group when they pass the same constant for each parameter
+ * one of them passes a constant for, and a constant for the same
+ * parameters. For the groups with the most calls, the procedure is copied,
+ * the copy receives the group's constants as constants, and the calls of
+ * the group are redirected to it, where optimizing it again can fold them.
+ * The original stays for the other calls.
+ *
+ * When every call to a procedure whose address is not taken is in the same
+ * group, propagating constants across calls does the same without a copy,
+ * so nothing is copied. Each procedure gets at most MAX_SPECIALIZATIONS
+ * copies, and all the copies together add at most SPECIALIZE_GROWTH
+ * percent to the instructions of the program.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/ir.h"
+#include "../include/ir-opt.h"
+#include "../include/symbol-utils.h"
+#include "../include/utilities.h"
+
+/* the most copies of one procedure */
+#define MAX_SPECIALIZATIONS 3
+/* the most the copies may add to the size of the program, in percent */
+#define SPECIALIZE_GROWTH 50
+
+/*
+ * CallSite
+ * A call to the procedure being specialized and the constants it passes,
+ * one per parameter received.
+ */
+struct CallSite {
+    IrNode *call;
+    int caller;                 /* index in the call graph                */
+    Boolean *known;             /* per parameter: passed a constant       */
+    int *values;                /* per parameter: the constant, if known  */
+    Boolean grouped;            /* already redirected or left alone       */
+};
+typedef struct CallSite CallSite;
+
+/* file helper functions */
+int specialize_procedure(CallGraph *cg, int proc, IrList *irl, int *budget);
+int parameters_received(IrNode *begin);
+CallSite *find_call_sites(CallGraph *cg, int proc, int num_params,
+                            int *num_sites);
+Boolean same_constants(CallSite *a, CallSite *b, int num_params);
+Boolean passes_constant(CallSite *site, int num_params);
+int largest_group(CallSite *sites, int num_sites, int num_params, int *size);
+IrNode *copy_procedure(IrNode *begin, Symbol *s, IrList *irl);
+Symbol *specialized_symbol(CallGraph *cg, Symbol *s);
+void redirect_call(IrNode *call, Symbol *s);
+
+
+/*
+ * specialize_procedures
+ * Purpose: copy procedures for the constants their calls pass most often
+ * Parameters:
+ *  cg - CallGraph * - the call graph of the program
+ *  irl - IrList * - the IR of the program
+ * Returns:
+ *  The number of copies made
+ * Side Effects:
+ *  Adds each copy to the IR after the procedure copied and to the call
+ *  graph, and marks it changed. Prints a remark for each copy to
+ *  opt_report.
+ */
+int specialize_procedures(CallGraph *cg, IrList *irl) {
+    int i, n = cg->num_procs, budget = 0, copies = 0;
+
+    for (i = 0; i < n; i++) {
+        if (cg->reachable[i]) {
+            budget += procedure_size(cg->procs[i]);
+        }
+    }
+    budget = budget * SPECIALIZE_GROWTH / 100;
+    /* the copies made are not specialized again */
+    for (i = 0; i < n; i++) {
+        if (cg->reachable[i] &&
+                strcmp(get_symbol_name(cg->procs[i]->s), "main")) {
+            copies += specialize_procedure(cg, i, irl, &budget);
+        }
+    }
+    return copies;
+}
+
+/* copy a procedure for the largest groups of its calls, within budget */
+int specialize_procedure(CallGraph *cg, int proc, IrList *irl, int *budget) {
+    IrNode *begin = cg->procs[proc], *copy, *irn;
+    CallSite *sites;
+    Symbol *s;
+    int num_params, num_sites, remaining, folded, first, group, i;
+    int copies = 0;
+
+    num_params = parameters_received(begin);
+    if (num_params == 0) {
+        return 0;
+    }
+    sites = find_call_sites(cg, proc, num_params, &num_sites);
+    remaining = num_sites;
+    while (copies < MAX_SPECIALIZATIONS && *budget >= procedure_size(begin)) {
+        first = largest_group(sites, num_sites, num_params, &group);
+        if (first == NO_ARG ||
+                (group == remaining && !cg->address_taken[proc])) {
+            break;
+        }
+        s = specialized_symbol(cg, begin->s);
+        copy = copy_procedure(begin, s, irl);
+        folded = 0;
+        for (irn = copy; instruction(irn) != END_PROC; irn = irn->next) {
+            if (instruction(irn) == RECEIVED_PARAM &&
+                    sites[first].known[irn->IMMVAL]) {
+                irn->instruction = LOAD_CONSTANT;
+                irn->IMMVAL = sites[first].values[irn->IMMVAL];
+                folded++;
+            }
+        }
+        i = add_procedure(cg, copy);
+        cg->changed[i] = TRUE;
+        for (i = first; i < num_sites; i++) {
+            if (!sites[i].grouped &&
+                    same_constants(&sites[first], &sites[i], num_params)) {
+                redirect_call(sites[i].call, s);
+                sites[i].grouped = TRUE;
+                remaining--;
+                find_callees(cg, sites[i].caller);
+            }
+        }
+        *budget -= procedure_size(copy);
+        if (opt_report != NULL) {
+            fprintf(opt_report, "specialize: %s: %s with %d constant "
+                    "arguments for %d calls\n", get_symbol_name(s),
+                    get_symbol_name(begin->s), folded, group);
+        }
+        copies++;
+    }
+    for (i = 0; i < num_sites; i++) {
+        free(sites[i].known);
+        free(sites[i].values);
+    }
+    free(sites);
+    return copies;
+}
+
+/* one more than the highest index of a parameter the procedure receives */
+int parameters_received(IrNode *begin) {
+    IrNode *irn;
+    int n = 0;
+    for (irn = begin; instruction(irn) != END_PROC; irn = irn->next) {
+        if (instruction(irn) == RECEIVED_PARAM && irn->IMMVAL >= n) {
+            n = irn->IMMVAL + 1;
+        }
+    }
+    return n;
+}
+
+/*
+ * the calls to proc from other procedures, with the constants they pass;
+ * a call passing too few arguments is left out
+ */
+CallSite *find_call_sites(CallGraph *cg, int proc, int num_params,
+                            int *num_sites) {
+    CallSite *sites = NULL, *site;
+    IrNode *irn, *arg;
+    int i, k;
+
+    *num_sites = 0;
+    for (i = 0; i < cg->num_procs; i++) {
+        if (i == proc || !cg->reachable[i] ||
+                !cg->calls[i * cg->num_procs + proc]) {
+            continue;
+        }
+        for (irn = cg->procs[i]; instruction(irn) != END_PROC;
+                irn = irn->next) {
+            if (instruction(irn) != CALL || irn->s != cg->procs[proc]->s) {
+                continue;
+            }
+            util_erealloc((void **) &sites,
+                            (*num_sites + 1) * sizeof(CallSite));
+            site = &sites[*num_sites];
+            site->call = irn;
+            site->caller = i;
+            site->grouped = FALSE;
+            util_emalloc((void **) &site->known, num_params * sizeof(Boolean));
+            util_emalloc((void **) &site->values, num_params * sizeof(int));
+            for (k = 0; k < num_params; k++) {
+                site->known[k] = FALSE;
+            }
+            k = 0;
+            for (arg = irn->prev; instruction(arg) == PARAM; arg = arg->prev) {
+                if (arg->RDEST < num_params) {
+                    site->known[arg->RDEST] = constant_register(cg->procs[i],
+                            arg->RSRC, &site->values[arg->RDEST]);
+                }
+                k++;
+            }
+            if (k < num_params) {
+                free(site->known);
+                free(site->values);
+                continue;
+            }
+            (*num_sites)++;
+        }
+    }
+    return sites;
+}
+
+/* do the two calls pass the same constants for the same parameters? */
+Boolean same_constants(CallSite *a, CallSite *b, int num_params) {
+    int k;
+    for (k = 0; k < num_params; k++) {
+        if (a->known[k] != b->known[k] ||
+                (a->known[k] && a->values[k] != b->values[k])) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+Boolean passes_constant(CallSite *site, int num_params) {
+    int k;
+    for (k = 0; k < num_params; k++) {
+        if (site->known[k]) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * the first of the calls in the largest group not yet redirected that
+ * passes a constant, NO_ARG if there is none; size is set to its calls
+ */
+int largest_group(CallSite *sites, int num_sites, int num_params, int *size) {
+    int i, j, n, best = NO_ARG;
+
+    *size = 0;
+    for (i = 0; i < num_sites; i++) {
+        if (sites[i].grouped || !passes_constant(&sites[i], num_params)) {
+            continue;
+        }
+        n = 0;
+        for (j = i; j < num_sites; j++) {
+            if (!sites[j].grouped &&
+                    same_constants(&sites[i], &sites[j], num_params)) {
+                n++;
+            }
+        }
+        if (n > *size) {
+            best = i;
+            *size = n;
+        }
+    }
+    return best;
+}
+
+/*
+ * copy_procedure
+ * Purpose: make a copy of a procedure under another name
+ * Parameters:
+ *  begin - IrNode * - the BEGIN_PROC of the procedure
+ *  s - Symbol * - the name of the copy
+ *  irl - IrList * - the IR of the program
+ * Returns:
+ *  The BEGIN_PROC of the copy
+ * Side Effects:
+ *  Inserts the copy after the END_PROC of the procedure. The copy has the
+ *  same registers as the procedure, and labels of its own.
+ */
+IrNode *copy_procedure(IrNode *begin, Symbol *s, IrList *irl) {
+    IrNode *irn, *end = procedure_end(begin), *pos = end, *first = NULL;
+    IrNode **old_labels, **new_labels, *copy;
+    int num_labels = map_labels(begin, &old_labels, &new_labels);
+    Boolean done = FALSE;
+
+    /* the copy goes after end, so the nodes copied stop at end */
+    for (irn = begin; !done; irn = irn->next) {
+        done = irn == end ? TRUE : FALSE;
+        if (instruction(irn) == LABEL) {
+            copy = copied_label(irn, old_labels, new_labels, num_labels);
+        } else {
+            copy = clone_ir_node(irn, 0);
+            if (copy->branch != NULL) {
+                copy->branch = copied_label(copy->branch, old_labels,
+                                new_labels, num_labels);
+            }
+            if (instruction(copy) == BEGIN_PROC ||
+                    instruction(copy) == END_PROC) {
+                copy->s = s;
+            }
+        }
+        pos = insert_ir_node_after(pos, copy, irl);
+        if (first == NULL) {
+            first = copy;
+        }
+    }
+    free(old_labels);
+    free(new_labels);
+    return first;
+}
+
+/*
+ * a procedure like s named s_<n>, with n the first number giving a name no
+ * procedure or global has
+ */
+Symbol *specialized_symbol(CallGraph *cg, Symbol *s) {
+    Symbol *copy, *other;
+    char *name;
+    int n, i;
+    Boolean taken = TRUE;
+
+    util_emalloc((void **) &name, strlen(get_symbol_name(s)) + 16);
+    for (n = 1; taken; n++) {
+        sprintf(name, "%s_%d", get_symbol_name(s), n);
+        taken = FALSE;
+        for (i = 0; i < cg->num_procs; i++) {
+            if (!strcmp(get_symbol_name(cg->procs[i]->s), name)) {
+                taken = TRUE;
+            }
+        }
+        for (other = st_symbols(get_symbol_table(s)); other != NULL;
+                other = other->next) {
+            if (!strcmp(get_symbol_name(other), name)) {
+                taken = TRUE;
+            }
+        }
+    }
+    util_emalloc((void **) &copy, sizeof(Symbol));
+    *copy = *s;
+    copy->next = NULL;
+    set_symbol_name(copy, name);
+    return copy;
+}
+
+/* make call, from its BEGIN_CALL to its END_CALL, a call to s */
+void redirect_call(IrNode *call, Symbol *s) {
+    IrNode *begin = call_begin(call);
+    if (begin != NULL) {
+        begin->s = s;
+    }
+    call->next->s = s;
+    call->s = s;
+}
@@ -0,0 +1,663 @@
+/*
+ * Construction and destruction of static single assignment form.
+ *
+ * Local scalars whose address never escapes are promoted out of memory:
+ * their LOAD_ADDRESS / LOAD_WORD_INDIRECT / STORE_WORD_INDIRECT sequences
+ * are replaced by registers, with PHI nodes placed on the iterated
+ * dominance frontier of the blocks that store to them (Cytron et al.).
+ * chars and shorts stay in memory, where their narrow stores truncate.
+ * Registers compute_ir defines on more than one path, the values of &&, ||
+ * and ?:, are renamed the same way, each definition acting as a store.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-dataflow.h"
+#include "../include/ir-ssa.h"
+#include "../include/scope-fsm.h"
+#include "../include/symbol-utils.h"
+#include "../include/utilities.h"
+
+/*
+ * running data for the renaming walk over the dominator tree
+ */
+struct SsaBuilder {
+    ControlFlowGraph *cfg;
+    Symbol **vars;          /* promoted variables                          */
+    int num_vars;
+    int **stacks;           /* per variable: registers holding its value   */
+    int *stack_size;
+    int *addr_var;          /* register -> variable whose address it holds */
+    int *reg_var;           /* register -> variable it is, if defined twice */
+    int *subst;             /* register -> register that replaces it       */
+    int num_orig_regs;      /* size of addr_var and subst                  */
+    IrNode **undef;         /* per variable: zero used before any store    */
+};
+typedef struct SsaBuilder SsaBuilder;
+
+/* file helper functions */
+void find_promotable_vars(SsaBuilder *sb);
+void find_join_registers(SsaBuilder *sb);
+int register_var(SsaBuilder *sb, int reg);
+Boolean defines_var(SsaBuilder *sb, IrNode *irn, int v);
+int var_index(SsaBuilder *sb, Symbol *s);
+int address_var(SsaBuilder *sb, int reg);
+void place_phi_nodes(SsaBuilder *sb);
+IrNode *create_phi(Symbol *s, BasicBlock *b);
+void rename_block(SsaBuilder *sb, BasicBlock *b);
+int current_value(SsaBuilder *sb, int v);
+void push_value(SsaBuilder *sb, int v, int reg);
+void prune_dead_phis(SsaBuilder *sb);
+void append_use(DefUse *du, IrNode *irn);
+
+
+/* put every procedure of irl into SSA form */
+void convert_to_ssa(IrList *irl) {
+    ControlFlowGraph *cfg;
+    IrNode *proc = next_proc(irl->head);
+    while (proc != NULL) {
+        cfg = create_cfg(irl, proc);
+        construct_ssa(cfg);
+        proc = next_proc(cfg->end_proc);
+        free_cfg(cfg);
+    }
+}
+
+/* replace the PHI nodes of every procedure of irl with copies */
+void convert_from_ssa(IrList *irl) {
+    ControlFlowGraph *cfg;
+    IrNode *proc = next_proc(irl->head);
+    while (proc != NULL) {
+        cfg = create_cfg(irl, proc);
+        destruct_ssa(cfg);
+        renumber_registers(cfg);
+        proc = next_proc(cfg->end_proc);
+        free_cfg(cfg);
+    }
+}
+
+/*
+ * construct_ssa
+ * Purpose: put one procedure into SSA form
+ * Parameters:
+ *  cfg - ControlFlowGraph * - the procedure
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Renumbers registers, removes unreachable blocks, deletes the memory
+ *  accesses of promoted variables and inserts PHI nodes. Afterwards every
+ *  register has a single definition that dominates its uses.
+ */
+void construct_ssa(ControlFlowGraph *cfg) {
+    SsaBuilder sb;
+    int i;
+
+    /* compute_ir reuses register numbers from statement to statement */
+    split_webs(cfg);
+    remove_unreachable_blocks(cfg);
+
+    sb.cfg = cfg;
+    sb.num_orig_regs = cfg->num_regs;
+    util_emalloc((void **) &sb.addr_var, (sb.num_orig_regs + 1) * sizeof(int));
+    util_emalloc((void **) &sb.reg_var, (sb.num_orig_regs + 1) * sizeof(int));
+    util_emalloc((void **) &sb.subst, (sb.num_orig_regs + 1) * sizeof(int));
+    for (i = 0; i < sb.num_orig_regs; i++) {
+        sb.addr_var[i] = NO_ARG;
+        sb.reg_var[i] = NO_ARG;
+        sb.subst[i] = NO_ARG;
+    }
+    find_promotable_vars(&sb);
+    find_join_registers(&sb);
+    if (sb.num_vars > 0) {
+        util_emalloc((void **) &sb.stacks, sb.num_vars * sizeof(int *));
+        util_emalloc((void **) &sb.stack_size, sb.num_vars * sizeof(int));
+        util_emalloc((void **) &sb.undef, sb.num_vars * sizeof(IrNode *));
+        for (i = 0; i < sb.num_vars; i++) {
+            sb.stacks[i] = NULL;
+            sb.stack_size[i] = 0;
+            sb.undef[i] = NULL;
+        }
+        place_phi_nodes(&sb);
+        rename_block(&sb, cfg->rpo[0]);
+        prune_dead_phis(&sb);
+        for (i = 0; i < sb.num_vars; i++) {
+            free(sb.stacks[i]);
+        }
+        free(sb.stacks);
+        free(sb.stack_size);
+        free(sb.undef);
+    }
+    free(sb.vars);
+    free(sb.addr_var);
+    free(sb.reg_var);
+    free(sb.subst);
+}
+
+/*
+ * is_promotable_symbol
+ * Purpose: decide whether a variable may live in registers instead of memory
+ * Parameters:
+ *  s - Symbol * - the variable
+ * Returns:
+ *  TRUE for scalar locals, parameters included: each is stored from the
+ *  register it is received in at entry. The caller must still check that
+ *  the address of s is used only to load and store it.
+ */
+Boolean is_promotable_symbol(Symbol *s) {
+    SymbolTable *st = get_symbol_table(s);
+    if (st == NULL || st_scope(st) == TOP_LEVEL_SCOPE) {
+        return FALSE;
+    }
+    switch (symbol_outer_type(s)) {
+        case ARRAY:
+        case FUNCTION:
+            return FALSE;
+        default:
+            return TRUE;
+    }
+}
+
+/*
+ * collect the locals referenced by LOAD_ADDRESS, then drop any whose
+ * address is used as anything but the address of a word load or store
+ */
+void find_promotable_vars(SsaBuilder *sb) {
+    ControlFlowGraph *cfg = sb->cfg;
+    Boolean *escapes;
+    Symbol **cands = NULL;
+    int *uses[MAX_USES];
+    int num_cands = 0, i, n, v;
+    IrNode *irn;
+
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = irn->next) {
+        if (instruction(irn) != LOAD_ADDRESS ||
+                !is_promotable_symbol(irn->s)) {
+            continue;
+        }
+        for (v = 0; v < num_cands && cands[v] != irn->s; v++)
+            ;
+        if (v == num_cands) {
+            util_erealloc((void **) &cands, (num_cands + 1) * sizeof(Symbol *));
+            cands[num_cands++] = irn->s;
+        }
+        sb->addr_var[irn->RDEST] = v;
+    }
+
+    util_emalloc((void **) &escapes, (num_cands + 1) * sizeof(Boolean));
+    for (v = 0; v < num_cands; v++) {
+        escapes[v] = FALSE;
+    }
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = irn->next) {
+        n = ir_node_uses(irn, uses);
+        for (i = 0; i < n; i++) {
+            v = address_var(sb, *uses[i]);
+            if (v == NO_ARG) {
+                continue;
+            }
+            if (instruction(irn) == LOAD_WORD_INDIRECT) {
+                continue;
+            }
+            if (instruction(irn) == STORE_WORD_INDIRECT &&
+                    uses[i] == &irn->RDEST && irn->RSRC != irn->RDEST) {
+                continue;
+            }
+            escapes[v] = TRUE;
+        }
+    }
+
+    /* keep the survivors, renumbering the address map to match */
+    sb->vars = NULL;
+    sb->num_vars = 0;
+    for (v = 0; v < num_cands; v++) {
+        if (!escapes[v]) {
+            util_erealloc((void **) &sb->vars,
+                            (sb->num_vars + 1) * sizeof(Symbol *));
+            sb->vars[sb->num_vars++] = cands[v];
+        }
+    }
+    for (i = 0; i < sb->num_orig_regs; i++) {
+        if (sb->addr_var[i] != NO_ARG) {
+            v = sb->addr_var[i];
+            sb->addr_var[i] = escapes[v] ? NO_ARG : var_index(sb, cands[v]);
+        }
+    }
+    free(escapes);
+    free(cands);
+}
+
+/*
+ * make each register with more than one definition a variable, named by a
+ * symbol of its own that only its PHI nodes refer to
+ */
+void find_join_registers(SsaBuilder *sb) {
+    ControlFlowGraph *cfg = sb->cfg;
+    int *num_defs, *def, r;
+    IrNode *irn;
+
+    util_emalloc((void **) &num_defs, (sb->num_orig_regs + 1) * sizeof(int));
+    for (r = 0; r < sb->num_orig_regs; r++) {
+        num_defs[r] = 0;
+    }
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = irn->next) {
+        def = ir_node_def(irn);
+        if (def != NULL && *def != NO_ARG) {
+            num_defs[*def]++;
+        }
+    }
+    for (r = 0; r < sb->num_orig_regs; r++) {
+        if (num_defs[r] > 1) {
+            util_erealloc((void **) &sb->vars,
+                            (sb->num_vars + 1) * sizeof(Symbol *));
+            sb->vars[sb->num_vars] = create_symbol();
+            sb->reg_var[r] = sb->num_vars++;
+        }
+    }
+    free(num_defs);
+}
+
+int var_index(SsaBuilder *sb, Symbol *s) {
+    int v;
+    for (v = 0; v < sb->num_vars; v++) {
+        if (sb->vars[v] == s) {
+            return v;
+        }
+    }
+    return NO_ARG;
+}
+
+/* the promoted variable whose address reg holds, or NO_ARG */
+int address_var(SsaBuilder *sb, int reg) {
+    if (reg < 0 || reg >= sb->num_orig_regs) {
+        return NO_ARG;
+    }
+    return sb->addr_var[reg];
+}
+
+/* the variable register reg stands for, or NO_ARG */
+int register_var(SsaBuilder *sb, int reg) {
+    if (reg < 0 || reg >= sb->num_orig_regs) {
+        return NO_ARG;
+    }
+    return sb->reg_var[reg];
+}
+
+/* does irn give variable v a new value? */
+Boolean defines_var(SsaBuilder *sb, IrNode *irn, int v) {
+    int *def;
+    if (instruction(irn) == STORE_WORD_INDIRECT) {
+        return address_var(sb, irn->RDEST) == v ? TRUE : FALSE;
+    }
+    def = ir_node_def(irn);
+    return def != NULL && register_var(sb, *def) == v ? TRUE : FALSE;
+}
+
+/* insert PHI nodes on the iterated dominance frontier of each variable */
+void place_phi_nodes(SsaBuilder *sb) {
+    ControlFlowGraph *cfg = sb->cfg;
+    BasicBlock **worklist, *b, *df;
+    int *has_phi, *on_worklist;
+    int v, i, top;
+    IrNode *irn;
+
+    util_emalloc((void **) &worklist, cfg->num_blocks * sizeof(BasicBlock *));
+    util_emalloc((void **) &has_phi, cfg->num_blocks * sizeof(int));
+    util_emalloc((void **) &on_worklist, cfg->num_blocks * sizeof(int));
+    for (i = 0; i < cfg->num_blocks; i++) {
+        has_phi[i] = NO_ARG;
+        on_worklist[i] = NO_ARG;
+    }
+    for (v = 0; v < sb->num_vars; v++) {
+        top = 0;
+        for (i = 0; i < cfg->num_blocks; i++) {
+            b = cfg->blocks[i];
+            FOR_EACH_BLOCK_NODE(irn, b) {
+                if (defines_var(sb, irn, v)) {
+                    worklist[top++] = b;
+                    on_worklist[b->id] = v;
+                    break;
+                }
+            }
+        }
+        while (top > 0) {
+            b = worklist[--top];
+            for (i = 0; i < b->num_dom_frontier; i++) {
+                df = b->dom_frontier[i];
+                if (has_phi[df->id] == v) {
+                    continue;
+                }
+                insert_at_block_start(df, create_phi(sb->vars[v], df), cfg);
+                has_phi[df->id] = v;
+                if (on_worklist[df->id] != v) {
+                    on_worklist[df->id] = v;
+                    worklist[top++] = df;
+                }
+            }
+        }
+    }
+    free(worklist);
+    free(has_phi);
+    free(on_worklist);
+}
+
+IrNode *create_phi(Symbol *s, BasicBlock *b) {
+    IrNode *irn = construct_ir_node(PHI);
+    int i;
+    irn->s = s;
+    irn->num_phi_args = b->num_preds;
+    util_emalloc((void **) &irn->phi_args, b->num_preds * sizeof(PhiArg));
+    for (i = 0; i < b->num_preds; i++) {
+        irn->phi_args[i].reg = NO_ARG;
+        irn->phi_args[i].pred = b->preds[i]->first;
+    }
+    return irn;
+}
+
+/*
+ * rename_block
+ * Purpose: rename the variable accesses in b and in the blocks it dominates
+ * Parameters:
+ *  sb - SsaBuilder * - running renaming state
+ *  b - BasicBlock * - block to process
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Deletes promoted loads, stores and address computations. Loads are
+ *  replaced by substituting the variable's current register for the loaded
+ *  register in later uses. Each definition of a register standing for a
+ *  variable gets a new register, substituted the same way. Fills in the
+ *  PHI arguments of b's successors.
+ */
+void rename_block(SsaBuilder *sb, BasicBlock *b) {
+    ControlFlowGraph *cfg = sb->cfg;
+    int *saved_size, *uses[MAX_USES], *def;
+    int i, j, n, v;
+    IrNode *irn, *next;
+    BasicBlock *s;
+
+    util_emalloc((void **) &saved_size, sb->num_vars * sizeof(int));
+    for (v = 0; v < sb->num_vars; v++) {
+        saved_size[v] = sb->stack_size[v];
+    }
+
+    for (irn = b->first; irn != NULL; irn = next) {
+        next = irn == b->last ? NULL : irn->next;
+        if (instruction(irn) == PHI) {
+            irn->RDEST = new_reg(cfg);
+            push_value(sb, var_index(sb, irn->s), irn->RDEST);
+            continue;
+        }
+        n = ir_node_uses(irn, uses);
+        for (i = 0; i < n; i++) {
+            if (*uses[i] >= 0 && *uses[i] < sb->num_orig_regs &&
+                    sb->subst[*uses[i]] != NO_ARG) {
+                *uses[i] = sb->subst[*uses[i]];
+            } else if ((v = register_var(sb, *uses[i])) != NO_ARG) {
+                *uses[i] = current_value(sb, v);
+            }
+        }
+        def = ir_node_def(irn);
+        if (def != NULL && (v = register_var(sb, *def)) != NO_ARG) {
+            *def = new_reg(cfg);
+            push_value(sb, v, *def);
+        }
+        switch (instruction(irn)) {
+            case LOAD_ADDRESS:
+                if (sb->addr_var[irn->RDEST] != NO_ARG) {
+                    remove_block_node(irn, cfg);
+                }
+                break;
+            case LOAD_WORD_INDIRECT:
+                v = address_var(sb, irn->RSRC);
+                if (v != NO_ARG) {
+                    sb->subst[irn->RDEST] = current_value(sb, v);
+                    remove_block_node(irn, cfg);
+                }
+                break;
+            case STORE_WORD_INDIRECT:
+                v = address_var(sb, irn->RDEST);
+                if (v != NO_ARG) {
+                    push_value(sb, v, irn->RSRC);
+                    remove_block_node(irn, cfg);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    for (i = 0; i < b->num_succs; i++) {
+        s = b->succs[i];
+        for (irn = s->first->next; instruction(irn) == PHI; irn = irn->next) {
+            for (j = 0; j < irn->num_phi_args; j++) {
+                if (irn->phi_args[j].pred == b->first) {
+                    irn->phi_args[j].reg =
+                        current_value(sb, var_index(sb, irn->s));
+                }
+            }
+            if (irn == s->last) {
+                break;
+            }
+        }
+    }
+
+    for (i = 0; i < b->num_dom_children; i++) {
+        rename_block(sb, b->dom_children[i]);
+    }
+
+    for (v = 0; v < sb->num_vars; v++) {
+        sb->stack_size[v] = saved_size[v];
+    }
+    free(saved_size);
+}
+
+/*
+ * the register holding variable v at the current point of the walk.
+ * a variable read before any store gets the value zero.
+ */
+int current_value(SsaBuilder *sb, int v) {
+    if (sb->stack_size[v] > 0) {
+        return sb->stacks[v][sb->stack_size[v] - 1];
+    }
+    if (sb->undef[v] == NULL) {
+        sb->undef[v] = construct_ir_node(LOAD_CONSTANT);
+        sb->undef[v]->RDEST = new_reg(sb->cfg);
+        sb->undef[v]->IMMVAL = 0;
+        insert_at_block_start(sb->cfg->rpo[0], sb->undef[v], sb->cfg);
+    }
+    return sb->undef[v]->RDEST;
+}
+
+void push_value(SsaBuilder *sb, int v, int reg) {
+    util_erealloc((void **) &sb->stacks[v],
+                    (sb->stack_size[v] + 1) * sizeof(int));
+    sb->stacks[v][sb->stack_size[v]++] = reg;
+}
+
+/*
+ * remove PHI nodes (and zero constants created for uninitialized reads)
+ * whose result is never used, other than by the PHI itself
+ */
+void prune_dead_phis(SsaBuilder *sb) {
+    ControlFlowGraph *cfg = sb->cfg;
+    Boolean changed = TRUE;
+    DefUse *du;
+    IrNode *irn, *next;
+    int i, live;
+
+    while (changed) {
+        changed = FALSE;
+        du = compute_def_use(cfg);
+        for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = next) {
+            next = irn->next;
+            if (instruction(irn) != PHI && instruction(irn) != LOAD_CONSTANT) {
+                continue;
+            }
+            if (instruction(irn) == LOAD_CONSTANT) {
+                for (i = 0; i < sb->num_vars && sb->undef[i] != irn; i++)
+                    ;
+                if (i == sb->num_vars) {
+                    continue;
+                }
+            }
+            live = 0;
+            for (i = 0; i < du[irn->RDEST].num_uses; i++) {
+                if (du[irn->RDEST].uses[i] != irn) {
+                    live++;
+                }
+            }
+            if (live == 0) {
+                remove_block_node(irn, cfg);
+                changed = TRUE;
+            }
+        }
+        free_def_use(du, cfg->num_regs);
+    }
+}
+
+/*
+ * destruct_ssa
+ * Purpose: take one procedure out of SSA form for the backend
+ * Parameters:
+ *  cfg - ControlFlowGraph * - the procedure
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Each PHI gets a fresh register t: every predecessor copies its argument
+ *  into t just before leaving, and the PHI itself becomes a copy from t.
+ *  Routing through t keeps the copies of a block's PHIs independent of
+ *  each other, so the swap and lost-copy problems cannot arise and
+ *  critical edges need not be split.
+ */
+void destruct_ssa(ControlFlowGraph *cfg) {
+    BasicBlock *b;
+    IrNode *irn, *next;
+    int i, j, t;
+
+    for (i = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        for (irn = b->first->next; irn != NULL; irn = next) {
+            next = irn == b->last ? NULL : irn->next;
+            if (instruction(irn) != PHI) {
+                break;
+            }
+            t = new_reg(cfg);
+            for (j = 0; j < irn->num_phi_args; j++) {
+                insert_before_terminator(irn->phi_args[j].pred->bb,
+                                irn_move(t, irn->phi_args[j].reg), cfg);
+            }
+            irn->instruction = MOVE;
+            irn->RSRC = t;
+            irn->s = NULL;
+            free(irn->phi_args);
+            irn->phi_args = NULL;
+            irn->num_phi_args = 0;
+        }
+    }
+}
+
+/*
+ * update_phi_args
+ * Purpose: drop the PHI arguments of edges a pass has removed
+ * Parameters:
+ *  cfg - ControlFlowGraph * - the procedure, with blocks rebuilt
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Arguments whose predecessor is no longer a predecessor are deleted.
+ *  A PHI left with a single argument becomes a MOVE after the block's PHIs.
+ */
+void update_phi_args(ControlFlowGraph *cfg) {
+    BasicBlock *b;
+    IrNode *irn, *next;
+    int i, j, k, n;
+
+    for (i = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        for (irn = b->first->next; irn != b->last->next; irn = next) {
+            next = irn->next;
+            if (instruction(irn) != PHI) {
+                break;
+            }
+            n = 0;
+            for (j = 0; j < irn->num_phi_args; j++) {
+                for (k = 0; k < b->num_preds; k++) {
+                    if (b->preds[k]->first == irn->phi_args[j].pred) {
+                        irn->phi_args[n++] = irn->phi_args[j];
+                        break;
+                    }
+                }
+            }
+            irn->num_phi_args = n;
+            if (n == 1) {
+                remove_block_node(irn, cfg);
+                irn->instruction = MOVE;
+                irn->RSRC = irn->phi_args[0].reg;
+                irn->s = NULL;
+                free(irn->phi_args);
+                irn->phi_args = NULL;
+                irn->num_phi_args = 0;
+                insert_at_block_start(b, irn, cfg);
+            }
+        }
+    }
+}
+
+/*
+ * compute_def_use
+ * Purpose: build the def-use chains of a procedure
+ * Parameters:
+ *  cfg - ControlFlowGraph * - the procedure
+ * Returns:
+ *  Array indexed by register number, cfg->num_regs entries long
+ * Side Effects:
+ *  Allocates heap memory; release it with free_def_use
+ */
+DefUse *compute_def_use(ControlFlowGraph *cfg) {
+    DefUse *du;
+    int *uses[MAX_USES], *def;
+    int i, n;
+    IrNode *irn;
+
+    util_emalloc((void **) &du, (cfg->num_regs + 1) * sizeof(DefUse));
+    for (i = 0; i < cfg->num_regs; i++) {
+        du[i].def = NULL;
+        du[i].uses = NULL;
+        du[i].num_uses = 0;
+    }
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = irn->next) {
+        def = ir_node_def(irn);
+        if (def != NULL && *def != NO_ARG) {
+            du[*def].def = irn;
+        }
+        n = ir_node_uses(irn, uses);
+        for (i = 0; i < n; i++) {
+            if (*uses[i] != NO_ARG) {
+                append_use(&du[*uses[i]], irn);
+            }
+        }
+        for (i = 0; i < irn->num_phi_args; i++) {
+            if (irn->phi_args[i].reg != NO_ARG) {
+                append_use(&du[irn->phi_args[i].reg], irn);
+            }
+        }
+    }
+    return du;
+}
+
+void append_use(DefUse *du, IrNode *irn) {
+    if (du->num_uses > 0 && du->uses[du->num_uses - 1] == irn) {
+        return;
+    }
+    util_erealloc((void **) &du->uses, (du->num_uses + 1) * sizeof(IrNode *));
+    du->uses[du->num_uses++] = irn;
+}
+
+void free_def_use(DefUse *du, int num_regs) {
+    int i;
+    for (i = 0; i < num_regs; i++) {
+        free(du[i].uses);
+    }
+    free(du);
+}
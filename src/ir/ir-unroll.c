@@ -0,0 +1,633 @@
+/*
+ * Loop unrolling.
+ *
+ * A loop unrolls when it counts: its header compares a basic induction
+ * variable, a PHI stepping by a constant each time around, with a bound the
+ * loop does not change, and leaving from the header is the only way out.
+ * Only innermost loops whose blocks follow their header in the IR list are
+ * unrolled, so that they can be copied block for block.
+ *
+ * Loops are found in SSA form and copied out of it, where a copy needs no
+ * registers of its own: each copy of an iteration reads what the one before
+ * it left. A loop running a small constant number of iterations is unrolled
+ * completely, its iterations laid out one after the other without their
+ * tests, and the header that follows them leaves the loop. Other loops are
+ * unrolled by unroll_factor: a copy of the loop runs that many iterations
+ * at a time while the induction variable is far enough from the bound for
+ * all of them to run, and the loop itself follows for the iterations left.
+ * The bound, pulled in by the steps the extra iterations take, must not
+ * wrap around; that is checked on the way in unless the bound is a constant
+ * or an offset from a global's address.
+ *
+ * How far a loop unrolls is limited by the size of its copies, and the
+ * copies made in a procedure by a budget of instructions. Unrolling runs
+ * after the other loop passes, so that it copies the code they improved,
+ * and before code generation, so that instruction scheduling sees the
+ * longer blocks.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-ssa.h"
+#include "../include/ir-opt.h"
+#include "../include/utilities.h"
+
+/* the most iterations of a loop unrolled completely */
+#define MAX_FULL_UNROLL 16
+/* the most instructions the copies of one loop may have */
+#define MAX_UNROLLED_SIZE 64
+/* the most instructions unrolling may add to a procedure */
+#define MAX_UNROLL_GROWTH 256
+/* the furthest a bound may be from a global's address */
+#define BOUND_RANGE 0x1000000
+/* the largest step of an induction variable unrolled */
+#define MAX_STEP 0x10000
+#define WORD_LIMIT 2147483647.0
+
+/* iterations each copy of a loop runs, set by -unroll= */
+int unroll_factor = 4;
+
+/*
+ * CountedLoop
+ * A loop that goes on while its induction variable compares with a bound
+ * by relation, and how many iterations it runs when that is known
+ */
+struct CountedLoop {
+    Loop *loop;
+    BasicBlock *latch;          /* the block jumping back to the header   */
+    IrNode *exit;               /* the header's jump out of the loop      */
+    IrNode *test;               /* the comparison it reads, else exit     */
+    int iv;
+    int step;
+    int relation;               /* SET_LT, SET_LE, SET_GT, SET_GE, SET_EQ
+                                   or SET_NE                              */
+    int bound;                  /* an invariant register, or NO_ARG       */
+    int bound_value;            /* the bound when it is a constant        */
+    Boolean may_wrap;           /* the bound pulled in may wrap around    */
+    int trips;                  /* iterations, NO_ARG if not known        */
+};
+typedef struct CountedLoop CountedLoop;
+
+struct UnrollState {
+    ControlFlowGraph *cfg;
+    IrNode **defs;              /* per register: its definition, in SSA   */
+    Loop *loops;
+    int num_loops;
+    int growth;                 /* instructions the copies have added     */
+};
+typedef struct UnrollState UnrollState;
+
+/* file helper functions */
+Boolean find_counted_loop(UnrollState *us, Loop *loop, CountedLoop *cl);
+Boolean copyable_loop(UnrollState *us, Loop *loop);
+Boolean loop_relation(UnrollState *us, CountedLoop *cl, int *lhs, int *rhs);
+Boolean induction_step(UnrollState *us, Loop *loop, int reg, int *init,
+                        int *step);
+Boolean ssa_constant(UnrollState *us, int reg, int *value);
+Boolean global_offset(UnrollState *us, int reg, Symbol **base, int *offset);
+int count_iterations(CountedLoop *cl, int init, int bound);
+int negated_test(int instr);
+int loop_size(ControlFlowGraph *cfg, Loop *loop);
+Boolean unroll_loop(UnrollState *us, CountedLoop *cl);
+void unroll_completely(UnrollState *us, CountedLoop *cl);
+Boolean unroll_partially(UnrollState *us, CountedLoop *cl, int factor);
+void enter_copies(CountedLoop *cl, IrNode *label);
+int emit_before(UnrollState *us, IrNode *pos, int instr, int a, int b);
+void copy_iteration(UnrollState *us, CountedLoop *cl, IrNode *top,
+                    IrNode *next, Boolean falls, int limit, IrNode *split);
+
+
+/*
+ * unroll_loops
+ * Purpose: unroll the counted loops of a procedure, completely when they
+ *          run few enough iterations
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure in SSA form
+ * Returns:
+ *  The number of loops unrolled
+ * Side Effects:
+ *  Takes the procedure out of SSA form, adding preheaders to loops that
+ *  need one. Copies of loop iterations are inserted before
+ *  their headers; a loop unrolled completely is left by its header, and
+ *  the header of one unrolled partially gets a label before its test.
+ *  Rebuilds the CFG if any loop is unrolled.
+ */
+int unroll_loops(ControlFlowGraph *cfg) {
+    UnrollState us;
+    CountedLoop *counted;
+    int num_counted = 0, unrolled = 0, i;
+
+    if (unroll_factor < 2) {
+        destruct_ssa(cfg);
+        return 0;
+    }
+    insert_preheaders(cfg);
+    us.cfg = cfg;
+    us.growth = 0;
+    us.loops = find_loops(cfg, &us.num_loops);
+    us.defs = register_defs(cfg, NULL);
+    util_emalloc((void **) &counted,
+                    (us.num_loops + 1) * sizeof(CountedLoop));
+    for (i = 0; i < us.num_loops; i++) {
+        if (find_counted_loop(&us, &us.loops[i], &counted[num_counted])) {
+            num_counted++;
+        }
+    }
+    free(us.defs);
+    /* the blocks stay as they are, the PHIs becoming copies */
+    destruct_ssa(cfg);
+    for (i = 0; i < num_counted; i++) {
+        if (unroll_loop(&us, &counted[i])) {
+            unrolled++;
+        }
+    }
+    free(counted);
+    free_loops(us.loops, us.num_loops);
+    if (unrolled > 0) {
+        /* the body of a loop unrolled completely is left unreachable */
+        rebuild_cfg(cfg);
+        remove_unreachable_blocks(cfg);
+    }
+    return unrolled;
+}
+
+/*
+ * may_unroll
+ * Purpose: tell whether unroll_loops could unroll any loop of a procedure,
+ *          before the procedure is taken into SSA form to find out
+ * Parameters:
+ *  cfg - ControlFlowGraph * - the procedure
+ * Returns:
+ *  TRUE if unrolling is on and the procedure has a loop, else FALSE
+ * Side Effects:
+ *  None
+ */
+Boolean may_unroll(ControlFlowGraph *cfg) {
+    Loop *loops;
+    int num_loops;
+
+    if (unroll_factor < 2) {
+        return FALSE;
+    }
+    loops = find_loops(cfg, &num_loops);
+    free_loops(loops, num_loops);
+    return num_loops > 0 ? TRUE : FALSE;
+}
+
+/* is loop a counted loop that can be copied? cl describes it if so */
+Boolean find_counted_loop(UnrollState *us, Loop *loop, CountedLoop *cl) {
+    BasicBlock *h = loop->header;
+    Symbol *init_base, *bound_base;
+    int lhs, rhs, init, init_offset, bound_offset;
+
+    if (loop->preheader == NULL || h->num_preds != 2 ||
+            !copyable_loop(us, loop)) {
+        return FALSE;
+    }
+    cl->loop = loop;
+    cl->latch = h->preds[loop->body[h->preds[0]->id] ? 0 : 1];
+    cl->exit = block_terminator(h);
+    if (instruction(cl->latch->last) != JUMP || cl->exit == NULL ||
+            loop->body[cl->exit->branch->bb->id] ||
+            !loop_relation(us, cl, &lhs, &rhs)) {
+        return FALSE;
+    }
+    if (induction_step(us, loop, lhs, &init, &cl->step)) {
+        cl->iv = lhs;
+    } else if (rhs != NO_ARG &&
+                induction_step(us, loop, rhs, &init, &cl->step)) {
+        cl->iv = rhs;
+        rhs = lhs;
+        cl->relation = mirrored_test(cl->relation);
+    } else {
+        return FALSE;
+    }
+    if (cl->step == 0 || cl->step > MAX_STEP || cl->step < -MAX_STEP) {
+        return FALSE;
+    }
+
+    cl->bound = rhs;
+    cl->bound_value = 0;
+    cl->may_wrap = FALSE;
+    if (rhs == NO_ARG || ssa_constant(us, rhs, &cl->bound_value)) {
+        cl->bound = NO_ARG;
+    } else if (us->defs[rhs] == NULL || loop->body[us->defs[rhs]->bb->id]) {
+        return FALSE;
+    } else if (!global_offset(us, rhs, &bound_base, &bound_offset)) {
+        cl->may_wrap = TRUE;
+    }
+
+    cl->trips = NO_ARG;
+    if (cl->bound == NO_ARG && ssa_constant(us, init, &init_offset)) {
+        cl->trips = count_iterations(cl, init_offset, cl->bound_value);
+    } else if (cl->bound != NO_ARG && !cl->may_wrap &&
+                global_offset(us, init, &init_base, &init_offset) &&
+                init_base == bound_base) {
+        /* offsets from the same address compare as the addresses do */
+        cl->trips = count_iterations(cl, init_offset, bound_offset);
+    }
+    return TRUE;
+}
+
+/* is loop innermost, laid out from its header on and left only by it? */
+Boolean copyable_loop(UnrollState *us, Loop *loop) {
+    ControlFlowGraph *cfg = us->cfg;
+    BasicBlock *b;
+    int i, j, exits = 0;
+
+    for (i = 0; i < us->num_loops; i++) {
+        if (us->loops[i].header != loop->header &&
+                loop->body[us->loops[i].header->id]) {
+            return FALSE;
+        }
+    }
+    for (i = 0; i < loop->size; i++) {
+        if (loop->header->id + i >= cfg->num_blocks ||
+                !loop->body[loop->header->id + i]) {
+            return FALSE;
+        }
+        b = cfg->blocks[loop->header->id + i];
+        if (b->num_succs == 0) {
+            return FALSE;
+        }
+        for (j = 0; j < b->num_succs; j++) {
+            if (!loop->body[b->succs[j]->id]) {
+                if (b != loop->header) {
+                    return FALSE;
+                }
+                exits++;
+            }
+        }
+    }
+    return exits == 1 ? TRUE : FALSE;
+}
+
+/*
+ * the comparison the header's exit makes, as lhs relation rhs being true
+ * for the loop to go on; rhs is NO_ARG for a comparison with 0
+ */
+Boolean loop_relation(UnrollState *us, CountedLoop *cl, int *lhs, int *rhs) {
+    IrNode *cond;
+
+    cl->test = cl->exit;
+    *lhs = cl->exit->RSRC;
+    *rhs = NO_ARG;
+    switch (instruction(cl->exit)) {
+        case JUMP_LEZ:
+            cl->relation = SET_GT;
+            return TRUE;
+        case JUMP_GEZ:
+            cl->relation = SET_LT;
+            return TRUE;
+        case JUMP_EQZ:
+        case JUMP_NEZ:
+            cl->relation = SET_NE;
+            cond = us->defs[*lhs];
+            if (cond != NULL && cond->bb == cl->loop->header) {
+                switch (instruction(cond)) {
+                    case SET_LT:
+                    case SET_LE:
+                    case SET_GT:
+                    case SET_GE:
+                    case SET_EQ:
+                    case SET_NE:
+                        cl->relation = instruction(cond);
+                        /* falls through */
+                    case BIT_XOR:
+                    case SUB:
+                        cl->test = cond;
+                        *lhs = cond->OPRND1;
+                        *rhs = cond->OPRND2;
+                        break;
+                    default:
+                        break;
+                }
+            }
+            if (instruction(cl->exit) == JUMP_NEZ) {
+                cl->relation = negated_test(cl->relation);
+            }
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/*
+ * is reg a PHI of the loop's header adding a constant to itself around the
+ * loop? init is set to the register it starts from and step to the constant
+ */
+Boolean induction_step(UnrollState *us, Loop *loop, int reg, int *init,
+                        int *step) {
+    IrNode *phi = us->defs[reg], *next;
+    int back, value;
+
+    if (phi == NULL || instruction(phi) != PHI || phi->bb != loop->header ||
+            phi->num_phi_args != 2) {
+        return FALSE;
+    }
+    back = loop->body[phi->phi_args[0].pred->bb->id] ? 0 : 1;
+    *init = phi->phi_args[1 - back].reg;
+    next = us->defs[phi->phi_args[back].reg];
+    if (next == NULL || !loop->body[next->bb->id]) {
+        return FALSE;
+    }
+    switch (instruction(next)) {
+        case ADD_CONST:
+            *step = next->IMMVAL;
+            return next->RSRC == reg ? TRUE : FALSE;
+        case ADD:
+            return (next->OPRND1 == reg &&
+                        ssa_constant(us, next->OPRND2, step)) ||
+                    (next->OPRND2 == reg &&
+                        ssa_constant(us, next->OPRND1, step)) ?
+                    TRUE : FALSE;
+        case SUB:
+            if (next->OPRND1 != reg ||
+                    !ssa_constant(us, next->OPRND2, &value)) {
+                return FALSE;
+            }
+            fold_binary_op(SUB, 0, value, step);
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/* is reg loaded with a constant? value is set to it */
+Boolean ssa_constant(UnrollState *us, int reg, int *value) {
+    if (reg == NO_ARG || us->defs[reg] == NULL ||
+            instruction(us->defs[reg]) != LOAD_CONSTANT) {
+        return FALSE;
+    }
+    *value = us->defs[reg]->IMMVAL;
+    return TRUE;
+}
+
+/* is reg the address of a global plus offset, within BOUND_RANGE? */
+Boolean global_offset(UnrollState *us, int reg, Symbol **base, int *offset) {
+    IrNode *def;
+    int value;
+
+    *offset = 0;
+    while (*offset < BOUND_RANGE && *offset > -BOUND_RANGE) {
+        def = reg == NO_ARG ? NULL : us->defs[reg];
+        if (def == NULL) {
+            return FALSE;
+        }
+        switch (instruction(def)) {
+            case LOAD_ADDRESS:
+                *base = def->s;
+                return is_global_symbol(def->s);
+            case MOVE:
+                reg = def->RSRC;
+                continue;
+            case ADD_CONST:
+                value = def->IMMVAL;
+                reg = def->RSRC;
+                break;
+            case ADD:
+                if (ssa_constant(us, def->OPRND2, &value)) {
+                    reg = def->OPRND1;
+                } else if (ssa_constant(us, def->OPRND1, &value)) {
+                    reg = def->OPRND2;
+                } else {
+                    return FALSE;
+                }
+                break;
+            default:
+                return FALSE;
+        }
+        if (value >= BOUND_RANGE || value <= -BOUND_RANGE) {
+            return FALSE;
+        }
+        *offset += value;
+    }
+    return FALSE;
+}
+
+/* iterations of cl's loop from init to bound, NO_ARG if too many */
+int count_iterations(CountedLoop *cl, int init, int bound) {
+    int i, goes_on;
+
+    for (i = 0; i <= MAX_FULL_UNROLL; i++) {
+        fold_binary_op(cl->relation, init, bound, &goes_on);
+        if (!goes_on) {
+            return i;
+        }
+        init = (int) ((unsigned int) init + (unsigned int) cl->step);
+    }
+    return NO_ARG;
+}
+
+/* the comparison true exactly when instr is false */
+int negated_test(int instr) {
+    switch (instr) {
+        case SET_LT: return SET_GE;
+        case SET_LE: return SET_GT;
+        case SET_GT: return SET_LE;
+        case SET_GE: return SET_LT;
+        case SET_EQ: return SET_NE;
+        default: return SET_EQ;
+    }
+}
+
+/* the instructions of the blocks of loop, labels aside */
+int loop_size(ControlFlowGraph *cfg, Loop *loop) {
+    IrNode *irn;
+    int i, size = 0;
+
+    for (i = 0; i < loop->size; i++) {
+        FOR_EACH_BLOCK_NODE(irn, cfg->blocks[loop->header->id + i]) {
+            if (instruction(irn) != LABEL) {
+                size++;
+            }
+        }
+    }
+    return size;
+}
+
+/*
+ * unroll cl's loop completely if it runs few enough iterations, else by
+ * unroll_factor or as near to it as the size limits allow: TRUE if it is
+ */
+Boolean unroll_loop(UnrollState *us, CountedLoop *cl) {
+    int size = loop_size(us->cfg, cl->loop), factor;
+
+    if (cl->trips != NO_ARG && cl->trips > 0 &&
+            cl->trips * size <= MAX_UNROLLED_SIZE &&
+            us->growth + (cl->trips - 1) * size <= MAX_UNROLL_GROWTH) {
+        unroll_completely(us, cl);
+        us->growth += (cl->trips - 1) * size;
+        return TRUE;
+    }
+    /* pulling the bound in needs the variable stepping toward it */
+    if (((cl->relation == SET_LT || cl->relation == SET_LE) &&
+                cl->step < 0) ||
+            ((cl->relation == SET_GT || cl->relation == SET_GE) &&
+                cl->step > 0) ||
+            cl->relation == SET_EQ || cl->relation == SET_NE) {
+        return FALSE;
+    }
+    for (factor = unroll_factor; factor >= 2; factor--) {
+        if (factor * size <= MAX_UNROLLED_SIZE &&
+                us->growth + factor * size <= MAX_UNROLL_GROWTH) {
+            break;
+        }
+    }
+    if (factor < 2 || (cl->trips != NO_ARG && cl->trips < factor) ||
+            !unroll_partially(us, cl, factor)) {
+        return FALSE;
+    }
+    us->growth += factor * size;
+    return TRUE;
+}
+
+/* lay the iterations of cl's loop out before its header, which leaves it */
+void unroll_completely(UnrollState *us, CountedLoop *cl) {
+    IrNode *header = cl->loop->header->first, *top, *next;
+    int i;
+
+    top = new_label();
+    enter_copies(cl, top);
+    for (i = 0; i < cl->trips; i++) {
+        next = i == cl->trips - 1 ? header : new_label();
+        copy_iteration(us, cl, top, next, TRUE, NO_ARG, NULL);
+        top = next;
+    }
+    /* the test following the last iteration fails */
+    cl->exit->instruction = JUMP;
+    cl->exit->RSRC = NO_ARG;
+}
+
+/*
+ * put a loop running factor iterations of cl's loop at a time before it,
+ * for as long as all of them would run: TRUE unless the bound pulled in
+ * by the extra steps is a constant that wraps around
+ */
+Boolean unroll_partially(UnrollState *us, CountedLoop *cl, int factor) {
+    IrNode *header = cl->loop->header->first, *entry, *first, *top, *next;
+    IrNode *split;
+    double pull = (double) (factor - 1) * cl->step, limit_value = 0.0;
+    int limit, check, i;
+
+    if (cl->bound == NO_ARG) {
+        limit_value = cl->bound_value - pull;
+        if (limit_value > WORD_LIMIT || limit_value < -WORD_LIMIT - 1.0) {
+            return FALSE;
+        }
+    }
+    entry = new_label();
+    enter_copies(cl, entry);
+    insert_ir_node_before(header, entry, us->cfg->irl);
+    if (cl->bound == NO_ARG) {
+        limit = emit_before(us, header, LOAD_CONSTANT, (int) limit_value,
+                            NO_ARG);
+    } else {
+        if (cl->may_wrap) {
+            /* the loop alone runs when the bound is near the end it nears */
+            check = emit_before(us, header, LOAD_CONSTANT,
+                        (int) ((cl->step > 0 ? -WORD_LIMIT - 1.0 :
+                                WORD_LIMIT) + pull), NO_ARG);
+            check = emit_before(us, header,
+                        cl->step > 0 ? SET_GE : SET_LE, cl->bound, check);
+            insert_ir_node_before(header, irn_jump(JUMP_EQZ, check, header),
+                                    us->cfg->irl);
+        }
+        limit = emit_before(us, header, LOAD_CONSTANT, (int) -pull, NO_ARG);
+        limit = emit_before(us, header, ADD, cl->bound, limit);
+    }
+    split = new_label();
+    first = top = new_label();
+    for (i = 0; i < factor; i++) {
+        next = i < factor - 1 ? new_label() : first;
+        copy_iteration(us, cl, top, next, i < factor - 1,
+                        i == 0 ? limit : NO_ARG, split);
+        top = next;
+    }
+    /* the loop picks up from the test the copy left by */
+    insert_ir_node_before(cl->test, split, us->cfg->irl);
+    return TRUE;
+}
+
+/* have the preheader of cl's loop enter it at label instead */
+void enter_copies(CountedLoop *cl, IrNode *label) {
+    BasicBlock *pre = cl->loop->preheader;
+
+    if (block_terminator(pre) != NULL &&
+            pre->last->branch == cl->loop->header->first) {
+        pre->last->branch = label;
+    }
+}
+
+/*
+ * insert instr a b before pos into a new register, returned: a is the
+ * constant of a LOAD_CONSTANT
+ */
+int emit_before(UnrollState *us, IrNode *pos, int instr, int a, int b) {
+    IrNode *irn = construct_ir_node(instr);
+
+    irn->RDEST = new_reg(us->cfg);
+    if (instr == LOAD_CONSTANT) {
+        irn->IMMVAL = a;
+    } else {
+        irn->OPRND1 = a;
+        irn->OPRND2 = b;
+    }
+    insert_ir_node_before(pos, irn, us->cfg->irl);
+    return irn->RDEST;
+}
+
+/*
+ * insert a copy of an iteration of cl's loop before its header, from label
+ * top to a jump back to next, or falling through to it; the header's exit
+ * is left out. Unless limit is NO_ARG, the copy first leaves for split if
+ * the induction variable does not compare with limit as with the bound
+ */
+void copy_iteration(UnrollState *us, CountedLoop *cl, IrNode *top,
+                    IrNode *next, Boolean falls, int limit, IrNode *split) {
+    ControlFlowGraph *cfg = us->cfg;
+    Loop *loop = cl->loop;
+    BasicBlock *b;
+    IrNode *header = loop->header->first, **labels, **copies, *irn, *copy;
+    int i, check;
+
+    util_emalloc((void **) &labels, loop->size * sizeof(IrNode *));
+    util_emalloc((void **) &copies, loop->size * sizeof(IrNode *));
+    for (i = 0; i < loop->size; i++) {
+        labels[i] = cfg->blocks[loop->header->id + i]->first;
+        copies[i] = i == 0 ? next : new_label();
+    }
+    insert_ir_node_before(header, top, cfg->irl);
+    for (i = 0; i < loop->size; i++) {
+        b = cfg->blocks[loop->header->id + i];
+        FOR_EACH_BLOCK_NODE(irn, b) {
+            if (irn == b->first) {
+                if (i > 0) {
+                    insert_ir_node_before(header, copies[i], cfg->irl);
+                }
+                continue;
+            }
+            if (irn == cl->test && limit != NO_ARG) {
+                check = emit_before(us, header, cl->relation, cl->iv, limit);
+                insert_ir_node_before(header, irn_jump(JUMP_EQZ, check, split),
+                                        cfg->irl);
+            }
+            if (irn == cl->exit) {
+                continue;
+            }
+            if (falls && irn == cl->latch->last && i == loop->size - 1) {
+                continue;
+            }
+            copy = clone_ir_node(irn, 0);
+            if (copy->branch != NULL) {
+                copy->branch = copied_label(copy->branch, labels, copies,
+                                            loop->size);
+            }
+            insert_ir_node_before(header, copy, cfg->irl);
+        }
+    }
+    free(labels);
+    free(copies);
+}
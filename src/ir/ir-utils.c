@@ -1,5 +1,6 @@
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "../include/ir.h"
@@ -7,6 +8,7 @@
 #include "../../y.tab.h"
 #include "../include/parse-tree.h"
 #include "../include/symbol-utils.h"
+#include "../include/symbol-collection.h"
 
 FILE *output;
 
@@ -18,13 +20,47 @@ IrList *ir_list = NULL;
 static int reg_idx = 0;
 static int label_idx = 0;
 static Boolean is_function_def_spec = FALSE;
-static Boolean is_function_call = FALSE;
-static Boolean is_function_argument = FALSE;
 static IrNode *cur_end_proc_label;
-static Symbol *function_symbol;
+static IrNode *break_label = NULL;
+static IrNode *continue_label = NULL;
+/* the IR labels of the statement labels of the function being lowered */
+static Symbol **statement_symbols = NULL;
+static IrNode **statement_labels = NULL;
+static int num_statement_labels = 0;
 
 /* file helper functions */
 void compute_ir_pass_through(Node *n, IrList *irl);
+void compute_ir_conditional(Node *n, IrList *irl);
+void compute_ir_loop(Node *n, IrList *irl);
+void compute_ir_branch(Node *n, IrList *irl, Boolean jump_if, IrNode *target);
+Boolean compute_ir_compare_branch(Node *n, IrList *irl, Boolean jump_if,
+                                    IrNode *target);
+int zero_compare_jump(int op, Boolean jump_if);
+int unsigned_zero_compare_jump(int op, Boolean jump_if);
+int mirrored_comparison(int op);
+Boolean is_zero_constant(Node *n);
+void compute_ir_logical_value(Node *n, IrList *irl);
+void compute_ir_conditional_expr(Node *n, IrList *irl);
+void compute_ir_join_value(Node *n, IrList *irl, int dest);
+void compute_ir_call(Node *n, IrList *irl);
+void compute_ir_arguments(Node *n, IrList *irl, int **args, int *num_args);
+void compute_ir_parameters(Node *n, IrList *irl);
+void compute_ir_subscript(Node *n, IrList *irl);
+void compute_ir_cast(Node *n, IrList *irl);
+IrNode *statement_label(Symbol *s);
+void receive_parameters(Node *n, IrList *irl, Symbol ***params,
+                        int *num_params);
+Node *function_declarator(Node *n);
+Symbol *declarator_symbol(Node *n);
+int rvalue_location(Node *n, IrList *irl);
+TypeNode *expression_type(Node *n);
+int lvalue_type(Node *n);
+enum data_type expression_data_type(Node *n);
+int typed_ir_instruction(int instr, enum data_type t1, enum data_type t2);
+int load_instruction(int type);
+int store_instruction(int type);
+int binary_ir_instruction(int op);
+int assignment_ir_instruction(int op);
 IrNode *irn_load(int instr, int dest, int src, Symbol *global);
 IrNode *irn_store(int instr, int src, int dest);
 IrNode *irn_binary_expr(int instr, int dest, int oprnd1, int oprnd2);
@@ -54,7 +90,7 @@ void start_ir_computation(void) {
  *  Appends IrNodes to the master IrList. Allocates heap memory.
  */
 void compute_ir(Node *n, IrList *irl) {
-    IrNode *irn1, *irn2, *irn3;
+    IrNode *irn1, *irn2;
     Node *child1, *child2;
     if (n == NULL) {
         return;
@@ -78,12 +114,19 @@ void compute_ir(Node *n, IrList *irl) {
             /* it has the function symbol */
             cur_end_proc_label = irn_label(LABEL, label_idx++);
             irn2 = irn_function(END_PROC, ir_list->tail->s);
+            /* copy the arguments passed in to the parameters */
+            compute_ir_parameters(n->children.child1, irl);
             /* second child: compound statement */
             /* recurse over it to obtain IR nodes for the function body */
             compute_ir(n->children.child2, irl);
             /* finally end the proc */
             append_ir_node(cur_end_proc_label, irl);
             append_ir_node(irn2, irl);
+            free(statement_symbols);
+            free(statement_labels);
+            statement_symbols = NULL;
+            statement_labels = NULL;
+            num_statement_labels = 0;
             break;
         case FUNCTION_DEF_SPEC:
             is_function_def_spec = TRUE;
@@ -112,41 +155,133 @@ void compute_ir(Node *n, IrList *irl) {
             child2 = n->children.child2;
             compute_ir(child1, irl);
             compute_ir(child2, irl);
-            irn1 = irn_store(STORE_WORD_INDIRECT,
-                    child2->expr->location, child1->expr->location);
+            n->expr->lvalue = FALSE;
+            n->expr->location = rvalue_location(child2, irl);
+            if (n->data.attributes[OPERATOR] != ASSIGN) {
+                /* compound assignment: a op= b is a = a op b */
+                irn1 = irn_load(load_instruction(lvalue_type(child1)),
+                        reg_idx++, child1->expr->location, NULL);
+                append_ir_node(irn1, irl);
+                irn2 = irn_binary_expr(typed_ir_instruction(
+                        assignment_ir_instruction(n->data.attributes[OPERATOR]),
+                        promoted_type(lvalue_type(child1)),
+                        expression_data_type(child2)),
+                        reg_idx++, irn1->RDEST, n->expr->location);
+                append_ir_node(irn2, irl);
+                n->expr->location = irn2->RDEST;
+            }
+            irn1 = irn_store(store_instruction(lvalue_type(child1)),
+                    n->expr->location, child1->expr->location);
             append_ir_node(irn1, irl);
             break;
         case BINARY_EXPR:
+            if (n->data.attributes[OPERATOR] == LOGICAL_AND ||
+                    n->data.attributes[OPERATOR] == LOGICAL_OR) {
+                compute_ir_logical_value(n, irl);
+                break;
+            }
             child1 = n->children.child1;
             child2 = n->children.child2;
             compute_ir(child1, irl);
             compute_ir(child2, irl);
 
             n->expr->lvalue = FALSE;
-            n->expr->location = reg_idx++;
-            irn1 = irn_binary_expr(LOG_OR, n->expr->location,
-                                child2->expr->location, child1->expr->location);
+            if (n->data.attributes[OPERATOR] == COMMA) {
+                n->expr->location = rvalue_location(child2, irl);
+                break;
+            }
+            irn1 = irn_binary_expr(typed_ir_instruction(
+                        binary_ir_instruction(n->data.attributes[OPERATOR]),
+                        expression_data_type(child1),
+                        expression_data_type(child2)),
+                        NO_ARG, rvalue_location(child1, irl),
+                        rvalue_location(child2, irl));
+            n->expr->location = irn1->RDEST = reg_idx++;
             append_ir_node(irn1, irl);
             break;
+        case UNARY_EXPR:
+            child1 = n->children.child1;
+            compute_ir(child1, irl);
+            switch (n->data.attributes[OPERATOR]) {
+                case AMPERSAND:
+                    /* the address is the location of the operand */
+                    n->expr->lvalue = FALSE;
+                    n->expr->location = child1->expr->location;
+                    break;
+                case ASTERISK:
+                    n->expr->lvalue = TRUE;
+                    n->expr->location = rvalue_location(child1, irl);
+                    break;
+                case PLUS:
+                    n->expr->lvalue = FALSE;
+                    n->expr->location = rvalue_location(child1, irl);
+                    break;
+                default:
+                    irn1 = construct_ir_node(
+                            n->data.attributes[OPERATOR] == MINUS ? NEGATE :
+                            n->data.attributes[OPERATOR] == LOGICAL_NOT ?
+                                                        LOG_NOT : BIT_NOT);
+                    irn1->RSRC = rvalue_location(child1, irl);
+                    n->expr->lvalue = FALSE;
+                    n->expr->location = irn1->RDEST = reg_idx++;
+                    append_ir_node(irn1, irl);
+                    break;
+            }
+            break;
+        case PREFIX_EXPR:
+        case POSTFIX_EXPR:
+            child1 = n->children.child1;
+            compute_ir(child1, irl);
+            irn1 = irn_load(load_instruction(lvalue_type(child1)),
+                    reg_idx++, child1->expr->location, NULL);
+            append_ir_node(irn1, irl);
+            irn2 = construct_ir_node(ADD_CONST);
+            irn2->RDEST = reg_idx++;
+            irn2->RSRC = irn1->RDEST;
+            irn2->IMMVAL = n->data.attributes[OPERATOR] == INCREMENT ? 1 : -1;
+            append_ir_node(irn2, irl);
+            append_ir_node(irn_store(store_instruction(lvalue_type(child1)),
+                    irn2->RDEST, child1->expr->location), irl);
+            n->expr->lvalue = FALSE;
+            n->expr->location = n->n_type == PREFIX_EXPR ?
+                                    irn2->RDEST : irn1->RDEST;
+            break;
+        case CONDITIONAL_EXPR:
+            compute_ir_conditional_expr(n, irl);
+            break;
+        case IF_THEN:
+        case IF_THEN_ELSE:
+            compute_ir_conditional(n, irl);
+            break;
+        case WHILE_STATEMENT:
+        case DO_STATEMENT:
+        case FOR_STATEMENT:
+            compute_ir_loop(n, irl);
+            break;
+        case BREAK_STATEMENT:
+            if (break_label != NULL) {
+                append_ir_node(irn_jump(JUMP, NO_ARG, break_label), irl);
+            }
+            break;
+        case CONTINUE_STATEMENT:
+            if (continue_label != NULL) {
+                append_ir_node(irn_jump(JUMP, NO_ARG, continue_label), irl);
+            }
+            break;
+        case GOTO_STATEMENT:
+            append_ir_node(irn_jump(JUMP, NO_ARG,
+                    statement_label(n->children.child1->st_entry)), irl);
+            break;
+        case LABELED_STATEMENT:
+            append_ir_node(statement_label(n->children.child1->st_entry), irl);
+            compute_ir(n->children.child2, irl);
+            break;
         case IDENTIFIER_EXPR:
             n->expr->lvalue = TRUE;
             n->expr->location = reg_idx++;
-            if (is_function_call && !is_function_argument) {
-                irn1 = irn_function(BEGIN_CALL, n->st_entry);
-                append_ir_node(irn1, irl);
-            } else {
-                irn1 = irn_load(LOAD_ADDRESS,
-                        n->expr->location, NO_ARG, n->st_entry);
-                append_ir_node(irn1, irl);
-                if (is_function_argument) {
-                    /* TODO: support more than 1 argument */
-                    irn2 = irn_load(LOAD_WORD_INDIRECT,
-                                reg_idx, n->expr->location, NULL);
-                    irn3 = irn_param(PARAM, 0, reg_idx++);
-                    append_ir_node(irn2, irl);
-                    append_ir_node(irn3, irl);
-                }
-            }
+            irn1 = irn_load(LOAD_ADDRESS,
+                    n->expr->location, NO_ARG, n->st_entry);
+            append_ir_node(irn1, irl);
             break;
         case NUMBER_CONSTANT:
             n->expr->lvalue = FALSE;
@@ -154,16 +289,13 @@ void compute_ir(Node *n, IrList *irl) {
             irn1 = irn_load(LOAD_CONSTANT,
                     n->expr->location, n->data.num, NULL);
             append_ir_node(irn1, irl);
-            if (is_function_argument) {
-                irn1 = irn_param(PARAM, 0, n->expr->location);
-                append_ir_node(irn1, irl);
-            }
             break;
         case RETURN_STATEMENT:
             compute_ir(n->children.child1, irl);
             if (n->children.child1 != NULL) {
                 if (n->children.child1->expr->lvalue) {
-                    irn1 = irn_load(LOAD_WORD_INDIRECT,
+                    irn1 = irn_load(
+                            load_instruction(lvalue_type(n->children.child1)),
                             reg_idx, n->children.child1->expr->location, NULL);
                     append_ir_node(irn1, irl);
                     irn2 = irn_statement(RETURN_FROM_PROC,
@@ -181,20 +313,13 @@ void compute_ir(Node *n, IrList *irl) {
 
             break;
         case FUNCTION_CALL:
-            is_function_call = TRUE;
-            /* get func symbol to get name and parameters */
-            /* will append BEGIN_CALL node */
-            compute_ir(n->children.child1, irl);
-            function_symbol = ir_list->tail->s;
-            /* arguments */
-            is_function_argument = TRUE;
-            compute_ir(n->children.child2, irl);
-            is_function_argument = FALSE;
-            irn2 = irn_function(CALL, function_symbol);
-            irn3 = irn_function(END_CALL, function_symbol);
-            append_ir_node(irn2, irl);
-            append_ir_node(irn3, irl);
-            is_function_call = FALSE;
+            compute_ir_call(n, irl);
+            break;
+        case SUBSCRIPT_EXPR:
+            compute_ir_subscript(n, irl);
+            break;
+        case CAST_EXPR:
+            compute_ir_cast(n, irl);
             break;
         default:
             compute_ir_pass_through(n, irl);
@@ -207,42 +332,19 @@ void compute_ir_pass_through(Node *n, IrList *irl) {
         return;
     }
     switch (n->n_type) {
-        case FOR_STATEMENT:
-            compute_ir(n->children.child1, irl);
-            compute_ir(n->children.child2, irl);
-            compute_ir(n->children.child3, irl);
-            compute_ir(n->children.child4, irl);
-            break;
-        case CONDITIONAL_EXPR:
-        case IF_THEN_ELSE:
-            compute_ir(n->children.child1, irl);
-            compute_ir(n->children.child2, irl);
-            compute_ir(n->children.child3, irl);
-            break;
         case TRANSLATION_UNIT:
         case DECL:
         case PTR_ABS_DECL:
         case DECL_OR_STMT_LIST:
-        case WHILE_STATEMENT:
-        case DO_STATEMENT:
-        case IF_THEN:
-        case CAST_EXPR:
         case TYPE_NAME:
-        case SUBSCRIPT_EXPR:
-        case POSTFIX_EXPR:
             compute_ir(n->children.child1, irl);
             compute_ir(n->children.child2, irl);
             break;
         case COMPOUND_STATEMENT:
         case EXPRESSION_STATEMENT:
         case RETURN_STATEMENT:
-        case GOTO_STATEMENT:
-        case UNARY_EXPR:
-        case PREFIX_EXPR:
             compute_ir(n->children.child1, irl);
             break;
-        case BREAK_STATEMENT:
-        case CONTINUE_STATEMENT:
         case NULL_STATEMENT:
         case CHAR_CONSTANT:
         case STRING_CONSTANT:
@@ -253,6 +355,742 @@ void compute_ir_pass_through(Node *n, IrList *irl) {
     }
 }
 
+/*
+ * compute_ir_conditional
+ * Purpose: compute IR for an if statement, with or without an else branch
+ * Parameters:
+ *  n - Node * - IF_THEN or IF_THEN_ELSE node
+ *  irl - IrList * - list to append to
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Appends the condition as jumps past the then branch when it is false,
+ *  and the branches with the labels separating them.
+ */
+void compute_ir_conditional(Node *n, IrList *irl) {
+    IrNode *else_label = new_label(), *end_label;
+
+    compute_ir_branch(n->children.child1, irl, FALSE, else_label);
+    compute_ir(n->children.child2, irl);
+    if (n->n_type == IF_THEN_ELSE) {
+        end_label = new_label();
+        append_ir_node(irn_jump(JUMP, NO_ARG, end_label), irl);
+        append_ir_node(else_label, irl);
+        compute_ir(n->children.child3, irl);
+        append_ir_node(end_label, irl);
+    } else {
+        append_ir_node(else_label, irl);
+    }
+}
+
+/*
+ * compute_ir_loop
+ * Purpose: compute IR for a while, do or for loop
+ * Parameters:
+ *  n - Node * - WHILE_STATEMENT, DO_STATEMENT or FOR_STATEMENT node
+ *  irl - IrList * - list to append to
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Appends the loop with its condition tested at the top (at the bottom
+ *  for do loops). break and continue inside the body jump to the labels
+ *  after the loop and before the next iteration respectively.
+ */
+void compute_ir_loop(Node *n, IrList *irl) {
+    IrNode *saved_break = break_label, *saved_continue = continue_label;
+    IrNode *top_label = new_label();
+    Node *init = NULL, *cond, *step = NULL, *body;
+
+    switch (n->n_type) {
+        case WHILE_STATEMENT:
+            cond = n->children.child1;
+            body = n->children.child2;
+            break;
+        case DO_STATEMENT:
+            body = n->children.child1;
+            cond = n->children.child2;
+            break;
+        default:
+            init = n->children.child1;
+            cond = n->children.child2;
+            step = n->children.child3;
+            body = n->children.child4;
+            break;
+    }
+    break_label = new_label();
+    continue_label = new_label();
+
+    compute_ir(init, irl);
+    append_ir_node(top_label, irl);
+    if (n->n_type != DO_STATEMENT && cond != NULL) {
+        compute_ir_branch(cond, irl, FALSE, break_label);
+    }
+    compute_ir(body, irl);
+    append_ir_node(continue_label, irl);
+    compute_ir(step, irl);
+    if (n->n_type == DO_STATEMENT) {
+        compute_ir_branch(cond, irl, TRUE, top_label);
+    } else {
+        append_ir_node(irn_jump(JUMP, NO_ARG, top_label), irl);
+    }
+    append_ir_node(break_label, irl);
+
+    break_label = saved_break;
+    continue_label = saved_continue;
+}
+
+/*
+ * compute_ir_branch
+ * Purpose: compute IR for a condition deciding where control goes rather
+ *          than a value
+ * Parameters:
+ *  n - Node * - the condition
+ *  irl - IrList * - list to append to
+ *  jump_if - Boolean - the truth value of n that takes the jump
+ *  target - IrNode * - label to jump to
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Appends code jumping to target when n is jump_if and falling through
+ *  otherwise. The right operand of && and || is skipped once the left one
+ *  decides the result, ! swaps the sense of the jump, a comparison jumps
+ *  on its operands where a jump tests it directly, and a constant
+ *  condition jumps always or never.
+ */
+void compute_ir_branch(Node *n, IrList *irl, Boolean jump_if, IrNode *target) {
+    IrNode *skip;
+    int op;
+
+    switch (n->n_type) {
+        case BINARY_EXPR:
+            op = n->data.attributes[OPERATOR];
+            if (op == LOGICAL_AND || op == LOGICAL_OR) {
+                if (jump_if == (op == LOGICAL_OR)) {
+                    /* either operand alone takes the jump */
+                    compute_ir_branch(n->children.child1, irl, jump_if, target);
+                    compute_ir_branch(n->children.child2, irl, jump_if, target);
+                } else {
+                    /* the left operand alone decides not to jump */
+                    skip = new_label();
+                    compute_ir_branch(n->children.child1, irl, !jump_if, skip);
+                    compute_ir_branch(n->children.child2, irl, jump_if, target);
+                    append_ir_node(skip, irl);
+                }
+                return;
+            }
+            if (compute_ir_compare_branch(n, irl, jump_if, target)) {
+                return;
+            }
+            break;
+        case UNARY_EXPR:
+            if (n->data.attributes[OPERATOR] == LOGICAL_NOT) {
+                compute_ir_branch(n->children.child1, irl, !jump_if, target);
+                return;
+            }
+            break;
+        case NUMBER_CONSTANT:
+            if ((n->data.num != 0) == jump_if) {
+                append_ir_node(irn_jump(JUMP, NO_ARG, target), irl);
+            }
+            return;
+        default:
+            break;
+    }
+    compute_ir(n, irl);
+    append_ir_node(irn_jump(jump_if ? JUMP_NEZ : JUMP_EQZ,
+                            rvalue_location(n, irl), target), irl);
+}
+
+/*
+ * a comparison with zero as the jump testing it, if there is one, and
+ * == and != as a jump on the exclusive or of the operands. FALSE, having
+ * appended nothing, for any other comparison.
+ */
+Boolean compute_ir_compare_branch(Node *n, IrList *irl, Boolean jump_if,
+                                    IrNode *target) {
+    Node *left = n->children.child1, *right = n->children.child2;
+    int op = n->data.attributes[OPERATOR], instr, r1, r2;
+    IrNode *irn;
+
+    if (is_zero_constant(left) && !is_zero_constant(right)) {
+        left = n->children.child2;
+        right = n->children.child1;
+        op = mirrored_comparison(op);
+    }
+    if (is_zero_constant(right)) {
+        instr = typed_ir_instruction(SET_LT, expression_data_type(left),
+                        expression_data_type(right)) == SET_LTU ?
+                    unsigned_zero_compare_jump(op, jump_if) :
+                    zero_compare_jump(op, jump_if);
+        if (instr == NO_IR_INSTRUCTION) {
+            return FALSE;
+        }
+        compute_ir(left, irl);
+        append_ir_node(irn_jump(instr, rvalue_location(left, irl), target),
+                        irl);
+        return TRUE;
+    }
+    if (op != EQUAL && op != NOT_EQUAL) {
+        return FALSE;
+    }
+    compute_ir(left, irl);
+    compute_ir(right, irl);
+    r1 = rvalue_location(left, irl);
+    r2 = rvalue_location(right, irl);
+    irn = irn_binary_expr(BIT_XOR, reg_idx++, r1, r2);
+    append_ir_node(irn, irl);
+    append_ir_node(irn_jump((op == EQUAL) == jump_if ? JUMP_EQZ : JUMP_NEZ,
+                            irn->RDEST, target), irl);
+    return TRUE;
+}
+
+/* the jump taken when x op 0 is jump_if, NO_IR_INSTRUCTION if none is */
+int zero_compare_jump(int op, Boolean jump_if) {
+    switch (op) {
+        case EQUAL: return jump_if ? JUMP_EQZ : JUMP_NEZ;
+        case NOT_EQUAL: return jump_if ? JUMP_NEZ : JUMP_EQZ;
+        case LESS_THAN_EQUAL: return jump_if ? JUMP_LEZ : NO_IR_INSTRUCTION;
+        case GREATER_THAN: return jump_if ? NO_IR_INSTRUCTION : JUMP_LEZ;
+        case GREATER_THAN_EQUAL: return jump_if ? JUMP_GEZ : NO_IR_INSTRUCTION;
+        case LESS_THAN: return jump_if ? NO_IR_INSTRUCTION : JUMP_GEZ;
+        default: return NO_IR_INSTRUCTION;
+    }
+}
+
+/*
+ * the jump taken when unsigned x op 0 is jump_if. nothing is below zero, so
+ * x > 0 is x != 0 and x <= 0 is x == 0
+ */
+int unsigned_zero_compare_jump(int op, Boolean jump_if) {
+    switch (op) {
+        case GREATER_THAN: return zero_compare_jump(NOT_EQUAL, jump_if);
+        case LESS_THAN_EQUAL: return zero_compare_jump(EQUAL, jump_if);
+        case LESS_THAN:
+        case GREATER_THAN_EQUAL:
+            return NO_IR_INSTRUCTION;
+        default: return zero_compare_jump(op, jump_if);
+    }
+}
+
+/* the comparison op with its operands swapped: a < b is b > a */
+int mirrored_comparison(int op) {
+    switch (op) {
+        case LESS_THAN: return GREATER_THAN;
+        case LESS_THAN_EQUAL: return GREATER_THAN_EQUAL;
+        case GREATER_THAN: return LESS_THAN;
+        case GREATER_THAN_EQUAL: return LESS_THAN_EQUAL;
+        default: return op;
+    }
+}
+
+Boolean is_zero_constant(Node *n) {
+    return n->n_type == NUMBER_CONSTANT && n->data.num == 0 ? TRUE : FALSE;
+}
+
+/*
+ * the value of && or ||: the condition jumps to where 0 is loaded into the
+ * result, or falls through to where 1 is. The result register is defined on
+ * both paths.
+ */
+void compute_ir_logical_value(Node *n, IrList *irl) {
+    IrNode *false_label = new_label(), *end_label = new_label();
+    int result = reg_idx++;
+
+    compute_ir_branch(n, irl, FALSE, false_label);
+    append_ir_node(irn_load(LOAD_CONSTANT, result, 1, NULL), irl);
+    append_ir_node(irn_jump(JUMP, NO_ARG, end_label), irl);
+    append_ir_node(false_label, irl);
+    append_ir_node(irn_load(LOAD_CONSTANT, result, 0, NULL), irl);
+    append_ir_node(end_label, irl);
+    n->expr->lvalue = FALSE;
+    n->expr->location = result;
+}
+
+/*
+ * compute_ir_conditional_expr
+ * Purpose: compute IR for c ? x : y
+ * Parameters:
+ *  n - Node * - CONDITIONAL_EXPR node
+ *  irl - IrList * - list to append to
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Only the operand c selects is evaluated, and copied into the result
+ *  register, which is defined on both paths.
+ */
+void compute_ir_conditional_expr(Node *n, IrList *irl) {
+    IrNode *else_label = new_label(), *end_label = new_label();
+    int result = reg_idx++;
+
+    compute_ir_branch(n->children.child1, irl, FALSE, else_label);
+    compute_ir_join_value(n->children.child2, irl, result);
+    append_ir_node(irn_jump(JUMP, NO_ARG, end_label), irl);
+    append_ir_node(else_label, irl);
+    compute_ir_join_value(n->children.child3, irl, result);
+    append_ir_node(end_label, irl);
+    n->expr->lvalue = FALSE;
+    n->expr->location = result;
+}
+
+/* evaluate n and copy its value, unless it is void, into dest */
+void compute_ir_join_value(Node *n, IrList *irl, int dest) {
+    int value;
+    compute_ir(n, irl);
+    value = rvalue_location(n, irl);
+    if (value != NO_ARG) {
+        append_ir_node(irn_move(dest, value), irl);
+    }
+}
+
+
+/*
+ * compute_ir_call
+ * Purpose: compute the IR for a function call
+ * Parameters:
+ *  n - Node * - the FUNCTION_CALL node, whose first child names the callee
+ *  irl - IrList * - the list to append to
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Every argument is evaluated, left to right, before any is passed, so a
+ *  call made computing an argument cannot overwrite another argument.
+ *  Argument i is passed by PARAM i. The result of a non-void function is
+ *  read into a register by RETURNED_WORD.
+ */
+void compute_ir_call(Node *n, IrList *irl) {
+    Symbol *callee = n->children.child1->st_entry;
+    int *args = NULL, num_args = 0, i;
+    IrNode *irn;
+
+    append_ir_node(irn_function(BEGIN_CALL, callee), irl);
+    compute_ir_arguments(n->children.child2, irl, &args, &num_args);
+    for (i = 0; i < num_args; i++) {
+        append_ir_node(irn_param(PARAM, i, args[i]), irl);
+    }
+    free(args);
+    append_ir_node(irn_function(CALL, callee), irl);
+    append_ir_node(irn_function(END_CALL, callee), irl);
+    n->expr->lvalue = FALSE;
+    if (callee->type_tree->next->type != VOID) {
+        /* the result, read from the return value register */
+        irn = construct_ir_node(RETURNED_WORD);
+        n->expr->location = irn->RDEST = reg_idx++;
+        append_ir_node(irn, irl);
+    }
+}
+
+/* evaluate the comma separated arguments, appending their registers */
+void compute_ir_arguments(Node *n, IrList *irl, int **args, int *num_args) {
+    if (n == NULL) {
+        return;
+    }
+    if (n->n_type == BINARY_EXPR && n->data.attributes[OPERATOR] == COMMA) {
+        compute_ir_arguments(n->children.child1, irl, args, num_args);
+        compute_ir_arguments(n->children.child2, irl, args, num_args);
+        return;
+    }
+    compute_ir(n, irl);
+    util_erealloc((void **) args, (*num_args + 1) * sizeof(int));
+    (*args)[(*num_args)++] = rvalue_location(n, irl);
+}
+
+/*
+ * compute_ir_parameters
+ * Purpose: store the arguments a function is called with to its parameters
+ * Parameters:
+ *  n - Node * - the FUNCTION_DEF_SPEC of the function
+ *  irl - IrList * - the list to append to, ending in the BEGIN_PROC
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Argument i is read into a register by RECEIVED_PARAM i. Those come
+ *  first, then the stores, so a procedure may jump back past the reads to
+ *  start over with new arguments.
+ */
+void compute_ir_parameters(Node *n, IrList *irl) {
+    Node *decl = function_declarator(n->children.child2);
+    Symbol **params = NULL;
+    int num_params = 0, i, first_reg = reg_idx;
+
+    if (decl == NULL) {
+        return;
+    }
+    receive_parameters(decl->children.child2, irl, &params, &num_params);
+    for (i = 0; i < num_params; i++) {
+        if (params[i] == NULL) {
+            continue;
+        }
+        append_ir_node(irn_load(LOAD_ADDRESS, reg_idx, NO_ARG, params[i]),
+                        irl);
+        append_ir_node(irn_store(store_instruction(params[i]->type_tree->type),
+                        first_reg + i, reg_idx++), irl);
+    }
+    free(params);
+}
+
+/* read each named parameter of a parameter list, appending its symbol */
+void receive_parameters(Node *n, IrList *irl, Symbol ***params,
+                        int *num_params) {
+    IrNode *irn;
+    if (n == NULL) {
+        return;
+    }
+    if (n->n_type == PARAMETER_LIST) {
+        receive_parameters(n->children.child1, irl, params, num_params);
+        receive_parameters(n->children.child2, irl, params, num_params);
+        return;
+    }
+    /* (void) declares no parameters */
+    if (n->children.child2 == NULL &&
+            n->children.child1->data.attributes[TYPE_SPEC] == VOID) {
+        return;
+    }
+    util_erealloc((void **) params, (*num_params + 1) * sizeof(Symbol *));
+    (*params)[*num_params] = declarator_symbol(n->children.child2);
+    irn = construct_ir_node(RECEIVED_PARAM);
+    irn->RDEST = reg_idx++;
+    irn->IMMVAL = (*num_params)++;
+    append_ir_node(irn, irl);
+}
+
+/*
+ * compute_ir_subscript
+ * Purpose: compute IR for a[i], the address of element i of a
+ * Parameters:
+ *  n - Node * - SUBSCRIPT_EXPR node, its array or pointer then its index
+ *  irl - IrList * - list to append the IR to
+ * Returns: None
+ * Side Effects: Appends the index times the element size plus the base,
+ *  and marks n an lvalue located at that address
+ */
+void compute_ir_subscript(Node *n, IrList *irl) {
+    IrNode *irn;
+    TypeNode *tn;
+    int base, index, size;
+    compute_ir(n->children.child1, irl);
+    base = rvalue_location(n->children.child1, irl);
+    compute_ir(n->children.child2, irl);
+    index = rvalue_location(n->children.child2, irl);
+    tn = expression_type(n);
+    size = tn == NULL ? INT_BYTES : type_bytes(tn);
+    if (size != CHAR_BYTES) {
+        irn = irn_load(LOAD_CONSTANT, reg_idx++, size, NULL);
+        append_ir_node(irn, irl);
+        irn = irn_binary_expr(MULT, reg_idx++, index, irn->RDEST);
+        append_ir_node(irn, irl);
+        index = irn->RDEST;
+    }
+    irn = irn_binary_expr(ADD, reg_idx++, base, index);
+    append_ir_node(irn, irl);
+    n->expr->lvalue = TRUE;
+    n->expr->location = irn->RDEST;
+}
+
+/*
+ * compute_ir_cast
+ * Purpose: compute IR for (type) x
+ * Parameters:
+ *  n - Node * - CAST_EXPR node, its TYPE_NAME then its operand
+ *  irl - IrList * - list to append the IR to
+ * Returns: None
+ * Side Effects: Appends the conversion of x to a register of its own: a
+ *  copy for a word wide target, the low bits masked off for an unsigned
+ *  char or short, and shifted up then arithmetically back down for a
+ *  signed one. A void operand leaves n without a value.
+ */
+void compute_ir_cast(Node *n, IrList *irl) {
+    enum data_type type;
+    IrNode *irn;
+    int value, shift;
+
+    compute_ir(n->children.child2, irl);
+    value = rvalue_location(n->children.child2, irl);
+    n->expr->lvalue = FALSE;
+    n->expr->location = value;
+    if (value == NO_ARG) {
+        return;
+    }
+    if (!cast_target_type(n->children.child1, &type)) {
+        type = SIGNED_INT;
+    }
+    switch (type) {
+        case UNSIGNED_CHAR:
+        case UNSIGNED_SHORT:
+            irn = irn_load(LOAD_CONSTANT, reg_idx++,
+                            type == UNSIGNED_CHAR ? 0xff : 0xffff, NULL);
+            append_ir_node(irn, irl);
+            irn = irn_binary_expr(BIT_AND, reg_idx++, value, irn->RDEST);
+            break;
+        case SIGNED_CHAR:
+        case SIGNED_SHORT:
+            shift = (INT_BYTES - (type == SIGNED_CHAR ?
+                                    CHAR_BYTES : SHORT_BYTES)) * 8;
+            irn = irn_load(LOAD_CONSTANT, reg_idx++, shift, NULL);
+            append_ir_node(irn, irl);
+            shift = irn->RDEST;
+            irn = irn_binary_expr(SHIFT_LEFT, reg_idx++, value, shift);
+            append_ir_node(irn, irl);
+            irn = irn_binary_expr(SHIFT_RIGHT, reg_idx++, irn->RDEST, shift);
+            break;
+        default:
+            irn = irn_move(reg_idx++, value);
+            break;
+    }
+    append_ir_node(irn, irl);
+    n->expr->location = irn->RDEST;
+}
+
+/* the IR label of statement label s, made the first time s is seen */
+IrNode *statement_label(Symbol *s) {
+    int i;
+    for (i = 0; i < num_statement_labels; i++) {
+        if (statement_symbols[i] == s) {
+            return statement_labels[i];
+        }
+    }
+    util_erealloc((void **) &statement_symbols,
+                    (num_statement_labels + 1) * sizeof(Symbol *));
+    util_erealloc((void **) &statement_labels,
+                    (num_statement_labels + 1) * sizeof(IrNode *));
+    statement_symbols[num_statement_labels] = s;
+    statement_labels[num_statement_labels] = new_label();
+    return statement_labels[num_statement_labels++];
+}
+
+/* the FUNCTION_DECLARATOR of a function's declarator */
+Node *function_declarator(Node *n) {
+    while (n != NULL && n->n_type == POINTER_DECLARATOR) {
+        n = n->children.child2;
+    }
+    if (n == NULL || n->n_type != FUNCTION_DECLARATOR) {
+        return NULL;
+    }
+    return n;
+}
+
+/* the symbol a declarator declares, NULL if it is abstract */
+Symbol *declarator_symbol(Node *n) {
+    while (n != NULL) {
+        switch (n->n_type) {
+            case SIMPLE_DECLARATOR:
+                return n->st_entry;
+            case POINTER_DECLARATOR:
+                n = n->children.child2;
+                break;
+            case ARRAY_DECLARATOR:
+                n = n->children.child1;
+                break;
+            default:
+                return NULL;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * register holding the value of expression n, loading it if n is an lvalue.
+ * an array used as a value is the address of its first element
+ */
+int rvalue_location(Node *n, IrList *irl) {
+    IrNode *irn;
+    TypeNode *tn;
+    if (!n->expr->lvalue) {
+        return n->expr->location;
+    }
+    tn = expression_type(n);
+    if (tn != NULL && tn->type == ARRAY) {
+        return n->expr->location;
+    }
+    irn = irn_load(load_instruction(lvalue_type(n)),
+                    reg_idx++, n->expr->location, NULL);
+    append_ir_node(irn, irl);
+    return irn->RDEST;
+}
+
+/*
+ * the type tree of expression n: that of a variable, or the element or
+ * target of an array or pointer it subscripts or dereferences. the parse
+ * tree records no other expression types, so for anything else it is NULL
+ */
+TypeNode *expression_type(Node *n) {
+    TypeNode *tn;
+    switch (n->n_type) {
+        case IDENTIFIER_EXPR:
+            return n->st_entry == NULL ? NULL : n->st_entry->type_tree;
+        case UNARY_EXPR:
+            if (n->data.attributes[OPERATOR] != ASTERISK) {
+                return NULL;
+            }
+            /* falls through */
+        case SUBSCRIPT_EXPR:
+            tn = expression_type(n->children.child1);
+            if (tn == NULL || (tn->type != ARRAY && tn->type != POINTER)) {
+                return NULL;
+            }
+            return tn->next;
+        default:
+            return NULL;
+    }
+}
+
+/* the integral type of the object lvalue n designates, a word if unknown */
+int lvalue_type(Node *n) {
+    TypeNode *tn = expression_type(n);
+    return tn == NULL ? SIGNED_INT : tn->type;
+}
+
+/*
+ * the type integer expression n has once promoted, as far as the parse tree
+ * tells: int unless an unsigned or long operand, variable, cast or function
+ * result makes it something else
+ */
+enum data_type expression_data_type(Node *n) {
+    enum data_type type;
+    TypeNode *tn;
+    switch (n->n_type) {
+        case NUMBER_CONSTANT:
+            return promoted_type(n->expr->type);
+        case BINARY_EXPR:
+            switch (n->data.attributes[OPERATOR]) {
+                case COMMA:
+                    return expression_data_type(n->children.child2);
+                case BITWISE_LSHIFT:
+                case BITWISE_RSHIFT:
+                    return expression_data_type(n->children.child1);
+                case PLUS:
+                case MINUS:
+                case ASTERISK:
+                case DIVIDE:
+                case REMAINDER:
+                case AMPERSAND:
+                case BITWISE_OR:
+                case BITWISE_XOR:
+                    return arithmetic_type(
+                            expression_data_type(n->children.child1),
+                            expression_data_type(n->children.child2));
+                default:
+                    /* comparisons and logical operators give int */
+                    return SIGNED_INT;
+            }
+        case UNARY_EXPR:
+            switch (n->data.attributes[OPERATOR]) {
+                case ASTERISK:
+                    return promoted_type(lvalue_type(n));
+                case MINUS:
+                case PLUS:
+                case BITWISE_NOT:
+                    return expression_data_type(n->children.child1);
+                default:
+                    return SIGNED_INT;
+            }
+        case ASSIGNMENT_EXPR:
+        case PREFIX_EXPR:
+        case POSTFIX_EXPR:
+            return promoted_type(lvalue_type(n->children.child1));
+        case CONDITIONAL_EXPR:
+            return arithmetic_type(expression_data_type(n->children.child2),
+                                    expression_data_type(n->children.child3));
+        case CAST_EXPR:
+            return cast_target_type(n->children.child1, &type) ?
+                    promoted_type(type) : SIGNED_INT;
+        case FUNCTION_CALL:
+            tn = expression_type(n->children.child1);
+            return tn == NULL || tn->type != FUNCTION || tn->next == NULL ?
+                    SIGNED_INT : promoted_type(tn->next->type);
+        default:
+            return promoted_type(lvalue_type(n));
+    }
+}
+
+/*
+ * the IR instruction computing instr on operands of promoted types t1 and
+ * t2: division, remainder, right shifts and relational comparisons in an
+ * unsigned type have their own. the type of a shift is that of its left
+ * operand
+ */
+int typed_ir_instruction(int instr, enum data_type t1, enum data_type t2) {
+    enum data_type type = instr == SHIFT_LEFT || instr == SHIFT_RIGHT ?
+                            t1 : arithmetic_type(t1, t2);
+    if (type != UNSIGNED_INT && type != UNSIGNED_LONG) {
+        return instr;
+    }
+    switch (instr) {
+        case DIV: return DIVU;
+        case REM: return REMU;
+        case SHIFT_RIGHT: return SHIFT_RIGHT_LOGICAL;
+        case SET_LT: return SET_LTU;
+        case SET_LE: return SET_LEU;
+        case SET_GT: return SET_GTU;
+        case SET_GE: return SET_GEU;
+        default: return instr;
+    }
+}
+
+/* IR instruction loading an object of the given type, extended to a word */
+int load_instruction(int type) {
+    switch (type) {
+        case SIGNED_CHAR: return LOAD_BYTE_INDIRECT;
+        case UNSIGNED_CHAR: return LOAD_UNSIGNED_BYTE_INDIRECT;
+        case SIGNED_SHORT: return LOAD_HALF_WORD_INDIRECT;
+        case UNSIGNED_SHORT: return LOAD_UNSIGNED_HALF_WORD_INDIRECT;
+        default: return LOAD_WORD_INDIRECT;
+    }
+}
+
+/* IR instruction storing the low bytes of a word to an object of type */
+int store_instruction(int type) {
+    switch (type) {
+        case SIGNED_CHAR:
+        case UNSIGNED_CHAR:
+            return STORE_BYTE_INDIRECT;
+        case SIGNED_SHORT:
+        case UNSIGNED_SHORT:
+            return STORE_HALF_WORD_INDIRECT;
+        default:
+            return STORE_WORD_INDIRECT;
+    }
+}
+
+/* IR instruction computing a binary operator token */
+int binary_ir_instruction(int op) {
+    switch (op) {
+        case PLUS: return ADD;
+        case MINUS: return SUB;
+        case ASTERISK: return MULT;
+        case DIVIDE: return DIV;
+        case REMAINDER: return REM;
+        case AMPERSAND: return BIT_AND;
+        case BITWISE_OR: return BIT_OR;
+        case BITWISE_XOR: return BIT_XOR;
+        case BITWISE_LSHIFT: return SHIFT_LEFT;
+        case BITWISE_RSHIFT: return SHIFT_RIGHT;
+        case LESS_THAN: return SET_LT;
+        case LESS_THAN_EQUAL: return SET_LE;
+        case GREATER_THAN: return SET_GT;
+        case GREATER_THAN_EQUAL: return SET_GE;
+        case EQUAL: return SET_EQ;
+        case NOT_EQUAL: return SET_NE;
+        default: return NO_IR_INSTRUCTION;
+    }
+}
+
+/* IR instruction computing the operator of a compound assignment token */
+int assignment_ir_instruction(int op) {
+    switch (op) {
+        case ADD_ASSIGN: return ADD;
+        case SUBTRACT_ASSIGN: return SUB;
+        case MULTIPLY_ASSIGN: return MULT;
+        case DIVIDE_ASSIGN: return DIV;
+        case REMAINDER_ASSIGN: return REM;
+        case BITWISE_LSHIFT_ASSIGN: return SHIFT_LEFT;
+        case BITWISE_RSHIFT_ASSIGN: return SHIFT_RIGHT;
+        case BITWISE_AND_ASSIGN: return BIT_AND;
+        case BITWISE_XOR_ASSSIGN: return BIT_XOR;
+        case BITWISE_OR_ASSIGN: return BIT_OR;
+        default: return NO_IR_INSTRUCTION;
+    }
+}
+
 /* IR Node creation functions */
 IrNode *construct_ir_node(enum ir_instruction instr) {
     IrNode *irn;
@@ -268,6 +1106,9 @@ IrNode *construct_ir_node(enum ir_instruction instr) {
     irn->RSRC =   NO_ARG;
     irn->LABIDX = NO_ARG;
     irn->s = NULL;
+    irn->phi_args = NULL;
+    irn->num_phi_args = 0;
+    irn->bb = NULL;
     return irn;
 }
 
@@ -278,6 +1119,10 @@ IrNode *irn_load(int instr, int dest, int src, Symbol *global) {
         case LOAD_ADDRESS:
             irn->s = global;
             break;
+        case LOAD_BYTE_INDIRECT:
+        case LOAD_UNSIGNED_BYTE_INDIRECT:
+        case LOAD_HALF_WORD_INDIRECT:
+        case LOAD_UNSIGNED_HALF_WORD_INDIRECT:
         case LOAD_WORD_INDIRECT:
             irn->RSRC = src;
             break;
@@ -294,6 +1139,8 @@ IrNode *irn_store(int instr, int src, int dest) {
     IrNode *irn = construct_ir_node(instr);
     irn->RDEST = dest;
     switch (instr) {
+        case STORE_BYTE_INDIRECT:
+        case STORE_HALF_WORD_INDIRECT:
         case STORE_WORD_INDIRECT:
             irn->RSRC = src;
         default:
@@ -336,6 +1183,28 @@ IrNode *irn_label(int instr, int label_idx) {
     return irn;
 }
 
+/* a LABEL with a fresh label index, for passes that create new blocks */
+IrNode *new_label(void) {
+    return irn_label(LABEL, label_idx++);
+}
+
+/* JUMP takes no register; the conditional jumps test src against zero */
+IrNode *irn_jump(int instr, int src, IrNode *label) {
+    IrNode *irn = construct_ir_node(instr);
+    if (instr != JUMP) {
+        irn->RSRC = src;
+    }
+    irn->branch = label;
+    return irn;
+}
+
+IrNode *irn_move(int dest, int src) {
+    IrNode *irn = construct_ir_node(MOVE);
+    irn->RDEST = dest;
+    irn->RSRC = src;
+    return irn;
+}
+
 /* List of IR Node functions */
 IrList *create_ir_list(void) {
     IrList *irl;
@@ -372,6 +1241,201 @@ IrNode *prepend_ir_node(IrNode *irn, IrList *irl) {
     return irl->head;
 }
 
+IrNode *insert_ir_node_before(IrNode *pos, IrNode *irn, IrList *irl) {
+    if (pos->prev == NULL) {
+        return prepend_ir_node(irn, irl);
+    }
+    return insert_ir_node_after(pos->prev, irn, irl);
+}
+
+IrNode *insert_ir_node_after(IrNode *pos, IrNode *irn, IrList *irl) {
+    if (pos->next == NULL) {
+        return append_ir_node(irn, irl);
+    }
+    irn->prev = pos;
+    irn->next = pos->next;
+    pos->next->prev = irn;
+    pos->next = irn;
+    return irn;
+}
+
+/* unlink irn from irl. the node itself is left intact */
+void remove_ir_node(IrNode *irn, IrList *irl) {
+    if (irn->prev == NULL) {
+        irl->head = irn->next;
+    } else {
+        irn->prev->next = irn->next;
+    }
+    if (irn->next == NULL) {
+        irl->tail = irn->prev;
+    } else {
+        irn->next->prev = irn->prev;
+    }
+    if (irl->cur == irn) {
+        irl->cur = irn->next;
+    }
+    irn->prev = NULL;
+    irn->next = NULL;
+}
+
+/*
+ * ir_node_def
+ * Purpose: find the register an IR instruction writes, if any
+ * Parameters:
+ *  irn - IrNode * - the instruction
+ * Returns:
+ *  Pointer to the instruction field holding the destination register,
+ *  or NULL when the instruction defines no register.
+ *  Passes rewrite the register in place through the pointer.
+ */
+int *ir_node_def(IrNode *irn) {
+    switch (irn->instruction) {
+        case LOAD_ADDRESS:
+        case LOAD_CONSTANT:
+        case LOAD_BYTE_INDIRECT:
+        case LOAD_UNSIGNED_BYTE_INDIRECT:
+        case LOAD_HALF_WORD_INDIRECT:
+        case LOAD_UNSIGNED_HALF_WORD_INDIRECT:
+        case LOAD_WORD_INDIRECT:
+        case LOAD_WORD:
+        case RETURNED_WORD:
+        case RECEIVED_PARAM:
+        case ADD_CONST:
+        case MOVE:
+        case PHI:
+        case SELECT:
+            return &irn->RDEST;
+        default:
+            if (is_binary_op(irn) || is_unary_op(irn)) {
+                return &irn->RDEST;
+            }
+            return NULL;
+    }
+}
+
+/*
+ * ir_node_uses
+ * Purpose: find the registers an IR instruction reads
+ * Parameters:
+ *  irn - IrNode * - the instruction. PHI arguments are not included;
+ *        they live in irn->phi_args.
+ *  uses - filled with pointers to the instruction fields read
+ * Returns:
+ *  The number of entries filled in uses
+ */
+int ir_node_uses(IrNode *irn, int *uses[MAX_USES]) {
+    int n = 0;
+    switch (irn->instruction) {
+        case LOAD_BYTE_INDIRECT:
+        case LOAD_UNSIGNED_BYTE_INDIRECT:
+        case LOAD_HALF_WORD_INDIRECT:
+        case LOAD_UNSIGNED_HALF_WORD_INDIRECT:
+        case LOAD_WORD_INDIRECT:
+        case ADD_CONST:
+        case MOVE:
+        case NEGATE:
+        case LOG_NOT:
+        case BIT_NOT:
+        case PARAM:
+        case STORE_WORD:
+        case JUMP_EQZ:
+        case JUMP_NEZ:
+        case JUMP_LEZ:
+        case JUMP_GEZ:
+            uses[n++] = &irn->RSRC;
+            break;
+        case RETURN_FROM_PROC:
+            if (irn->RSRC != NO_ARG) {
+                uses[n++] = &irn->RSRC;
+            }
+            break;
+        case STORE_BYTE_INDIRECT:
+        case STORE_HALF_WORD_INDIRECT:
+        case STORE_WORD_INDIRECT:
+            uses[n++] = &irn->RSRC;
+            uses[n++] = &irn->RDEST;
+            break;
+        case SELECT:
+            uses[n++] = &irn->RSRC;
+            uses[n++] = &irn->OPRND1;
+            uses[n++] = &irn->OPRND2;
+            break;
+        default:
+            if (is_binary_op(irn)) {
+                uses[n++] = &irn->OPRND1;
+                uses[n++] = &irn->OPRND2;
+            }
+            break;
+    }
+    return n;
+}
+
+/* instructions computing RDEST from registers OPRND1 and OPRND2 */
+Boolean is_binary_op(IrNode *irn) {
+    switch (instruction(irn)) {
+        case ADD:
+        case SUB:
+        case MULT:
+        case DIV:
+        case REM:
+        case DIVU:
+        case REMU:
+        case MULT_HIGH:
+        case MULT_HIGH_UNSIGNED:
+        case ADDU:
+        case SUBU:
+        case LOG_OR:
+        case LOG_AND:
+        case BIT_AND:
+        case BIT_OR:
+        case BIT_XOR:
+        case SHIFT_LEFT:
+        case SHIFT_RIGHT:
+        case SHIFT_RIGHT_LOGICAL:
+        case SET_LT:
+        case SET_LE:
+        case SET_GT:
+        case SET_GE:
+        case SET_LTU:
+        case SET_LEU:
+        case SET_GTU:
+        case SET_GEU:
+        case SET_EQ:
+        case SET_NE:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/* instructions computing RDEST from register RSRC */
+Boolean is_unary_op(IrNode *irn) {
+    switch (instruction(irn)) {
+        case NEGATE:
+        case LOG_NOT:
+        case BIT_NOT:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/* instructions that transfer control somewhere other than the next node */
+Boolean is_jump(IrNode *irn) {
+    switch (instruction(irn)) {
+        case JUMP:
+        case JUMP_EQZ:
+        case JUMP_NEZ:
+        case JUMP_LEZ:
+        case JUMP_GEZ:
+        case RETURN_FROM_PROC:
+        case TAIL_CALL:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
 Boolean is_statement(Node *n) {
     if (n == NULL) {
         return FALSE;
@@ -406,6 +1470,52 @@ Boolean node_is_lvalue(Node *n) {
     return n->expr->lvalue;
 }
 
+/*
+ * type_bytes
+ * Purpose: find the storage an object of a type takes
+ * Parameters:
+ *  tn - TypeNode * - the type, outermost first
+ * Returns:
+ *  The size in bytes: that of the integral type, a word for a pointer, or
+ *  the elements of an array times the size of each
+ */
+int type_bytes(TypeNode *tn) {
+    switch (tn->type) {
+        case ARRAY:
+            return get_array_size(tn) * type_bytes(tn->next);
+        case SIGNED_CHAR:
+        case UNSIGNED_CHAR:
+            return CHAR_BYTES;
+        case SIGNED_SHORT:
+        case UNSIGNED_SHORT:
+            return SHORT_BYTES;
+        case SIGNED_LONG:
+        case UNSIGNED_LONG:
+            return LONG_BYTES;
+        default:
+            return INT_BYTES;
+    }
+}
+
+/* the BEGIN_CALL matching call, skipping calls made to compute arguments */
+IrNode *call_begin(IrNode *call) {
+    IrNode *irn;
+    int depth = 0;
+    for (irn = call->prev; irn != NULL; irn = irn->prev) {
+        if (instruction(irn) == CALL) {
+            depth++;
+        } else if (instruction(irn) == BEGIN_CALL) {
+            if (depth == 0) {
+                return irn;
+            }
+            depth--;
+        } else if (instruction(irn) == BEGIN_PROC) {
+            break;
+        }
+    }
+    return NULL;
+}
+
 /* IR printing functions */
 void print_ir_list(FILE *out, IrList *irl) {
     fprintf(out, "\n/*\n");
@@ -420,6 +1530,7 @@ void print_ir_list(FILE *out, IrList *irl) {
 }
 
 void print_ir_node(FILE *out, IrNode *irn) {
+    int i;
     fprintf(out, "(");
     switch(irn->instruction) {
         case BEGIN_PROC:
@@ -448,6 +1559,24 @@ void print_ir_node(FILE *out, IrNode *irn) {
         case END_CALL:
             fprintf(out, "endcall, \"%s\"", get_symbol_name(irn->s));
             break;
+        case TAIL_CALL:
+            fprintf(out, "tailcall, \"%s\", \"LABEL_%d\"",
+                    get_symbol_name(irn->s), irn->branch->LABIDX);
+            break;
+        case RETURNED_WORD:
+            fprintf(out, "returnedword, $r%d", irn->RDEST);
+            break;
+        case RECEIVED_PARAM:
+            fprintf(out, "receivedparam, $r%d, %d", irn->RDEST, irn->IMMVAL);
+            break;
+        case STORE_BYTE_INDIRECT:
+            fprintf(out, "storebyteindirect, $r%d, $r%d",
+                            irn->RSRC, irn->RDEST);
+            break;
+        case STORE_HALF_WORD_INDIRECT:
+            fprintf(out, "storehalfwordindirect, $r%d, $r%d",
+                            irn->RSRC, irn->RDEST);
+            break;
         case STORE_WORD_INDIRECT:
             fprintf(out, "storewordindirect, $r%d, $r%d",
                             irn->RSRC, irn->RDEST);
@@ -456,9 +1585,30 @@ void print_ir_node(FILE *out, IrNode *irn) {
             fprintf(out, "loadaddress, $r%d, %s",
                             irn->RDEST, get_symbol_name(irn->s));
             break;
+        case LOAD_BYTE_INDIRECT:
+            fprintf(out, "loadbyteindirect, $r%d, $r%d", irn->RDEST, irn->RSRC);
+            break;
+        case LOAD_UNSIGNED_BYTE_INDIRECT:
+            fprintf(out, "loadunsignedbyteindirect, $r%d, $r%d",
+                            irn->RDEST, irn->RSRC);
+            break;
+        case LOAD_HALF_WORD_INDIRECT:
+            fprintf(out, "loadhalfwordindirect, $r%d, $r%d",
+                            irn->RDEST, irn->RSRC);
+            break;
+        case LOAD_UNSIGNED_HALF_WORD_INDIRECT:
+            fprintf(out, "loadunsignedhalfwordindirect, $r%d, $r%d",
+                            irn->RDEST, irn->RSRC);
+            break;
         case LOAD_WORD_INDIRECT:
             fprintf(out, "loadwordindirect, $r%d, $r%d", irn->RDEST, irn->RSRC);
             break;
+        case LOAD_WORD:
+            fprintf(out, "loadword, $r%d, %d", irn->RDEST, irn->IMMVAL);
+            break;
+        case STORE_WORD:
+            fprintf(out, "storeword, $r%d, %d", irn->RSRC, irn->IMMVAL);
+            break;
         case LOAD_CONSTANT:
             fprintf(out, "loadconstant, $r%d, %d", irn->RDEST, irn->IMMVAL);
             break;
@@ -466,15 +1616,94 @@ void print_ir_node(FILE *out, IrNode *irn) {
             fprintf(out, "logicalor, $r%d, $r%d, $r%d",
                             irn->RDEST, irn->OPRND1, irn->OPRND2);
             break;
+        case ADD_CONST:
+            fprintf(out, "addconst, $r%d, $r%d, %d",
+                            irn->RDEST, irn->RSRC, irn->IMMVAL);
+            break;
         case LABEL:
             fprintf(out, "label, \"LABEL_%d\"", irn->LABIDX);
             break;
+        case JUMP:
+            fprintf(out, "jump, \"LABEL_%d\"", irn->branch->LABIDX);
+            break;
+        case JUMP_EQZ:
+        case JUMP_NEZ:
+        case JUMP_LEZ:
+        case JUMP_GEZ:
+            fprintf(out, "%s, $r%d, \"LABEL_%d\"",
+                    irn->instruction == JUMP_EQZ ? "jumpeqz" :
+                    irn->instruction == JUMP_NEZ ? "jumpnez" :
+                    irn->instruction == JUMP_LEZ ? "jumplez" : "jumpgez",
+                    irn->RSRC, irn->branch->LABIDX);
+            break;
+        case MOVE:
+            fprintf(out, "move, $r%d, $r%d", irn->RDEST, irn->RSRC);
+            break;
+        case PHI:
+            fprintf(out, "phi, $r%d", irn->RDEST);
+            for (i = 0; i < irn->num_phi_args; i++) {
+                fprintf(out, ", [$r%d, \"LABEL_%d\"]",
+                        irn->phi_args[i].reg, irn->phi_args[i].pred->LABIDX);
+            }
+            break;
+        case SELECT:
+            fprintf(out, "select, $r%d, $r%d, $r%d, $r%d", irn->RDEST,
+                            irn->RSRC, irn->OPRND1, irn->OPRND2);
+            break;
         default:
+            if (is_binary_op(irn)) {
+                fprintf(out, "%s, $r%d, $r%d, $r%d",
+                            get_ir_opname(irn->instruction),
+                            irn->RDEST, irn->OPRND1, irn->OPRND2);
+            } else if (is_unary_op(irn)) {
+                fprintf(out, "%s, $r%d, $r%d",
+                            get_ir_opname(irn->instruction),
+                            irn->RDEST, irn->RSRC);
+            }
             break;
     }
     fprintf(out, ")\n");
 }
 
+/* printed name of an arithmetic, logical or comparison instruction */
+char *get_ir_opname(enum ir_instruction instr) {
+    switch (instr) {
+        case ADD: return "add";
+        case SUB: return "sub";
+        case MULT: return "mult";
+        case DIV: return "div";
+        case REM: return "rem";
+        case DIVU: return "divu";
+        case REMU: return "remu";
+        case MULT_HIGH: return "multhigh";
+        case MULT_HIGH_UNSIGNED: return "multhighu";
+        case ADDU: return "addu";
+        case SUBU: return "subu";
+        case LOG_OR: return "logicalor";
+        case LOG_AND: return "logicaland";
+        case BIT_AND: return "bitwiseand";
+        case BIT_OR: return "bitwiseor";
+        case BIT_XOR: return "bitwisexor";
+        case SHIFT_LEFT: return "shiftleft";
+        case SHIFT_RIGHT: return "shiftright";
+        case SHIFT_RIGHT_LOGICAL: return "shiftrightlogical";
+        case SET_LT: return "setlessthan";
+        case SET_LE: return "setlessthanequal";
+        case SET_GT: return "setgreaterthan";
+        case SET_GE: return "setgreaterthanequal";
+        case SET_LTU: return "setlessthanunsigned";
+        case SET_LEU: return "setlessthanequalunsigned";
+        case SET_GTU: return "setgreaterthanunsigned";
+        case SET_GEU: return "setgreaterthanequalunsigned";
+        case SET_EQ: return "setequal";
+        case SET_NE: return "setnotequal";
+        case NEGATE: return "negate";
+        case LOG_NOT: return "logicalnot";
+        case BIT_NOT: return "bitwisenot";
+        default: return "";
+    }
+}
+
 char *get_ir_name(enum ir_instruction instr) {
     switch (instr) {
     #define CASE_FOR(instr) case instr: return #instr
@@ -485,12 +1714,61 @@ char *get_ir_name(enum ir_instruction instr) {
         CASE_FOR(PARAM);
         CASE_FOR(CALL);
         CASE_FOR(END_CALL);
+        CASE_FOR(TAIL_CALL);
+        CASE_FOR(RETURNED_WORD);
+        CASE_FOR(RECEIVED_PARAM);
+        CASE_FOR(STORE_BYTE_INDIRECT);
+        CASE_FOR(STORE_HALF_WORD_INDIRECT);
         CASE_FOR(STORE_WORD_INDIRECT);
         CASE_FOR(LOAD_ADDRESS);
+        CASE_FOR(LOAD_BYTE_INDIRECT);
+        CASE_FOR(LOAD_UNSIGNED_BYTE_INDIRECT);
+        CASE_FOR(LOAD_HALF_WORD_INDIRECT);
+        CASE_FOR(LOAD_UNSIGNED_HALF_WORD_INDIRECT);
         CASE_FOR(LOAD_WORD_INDIRECT);
+        CASE_FOR(LOAD_WORD);
+        CASE_FOR(STORE_WORD);
         CASE_FOR(LOAD_CONSTANT);
         CASE_FOR(LOG_OR);
         CASE_FOR(LABEL);
+        CASE_FOR(JUMP);
+        CASE_FOR(JUMP_EQZ);
+        CASE_FOR(JUMP_NEZ);
+        CASE_FOR(JUMP_LEZ);
+        CASE_FOR(JUMP_GEZ);
+        CASE_FOR(MOVE);
+        CASE_FOR(PHI);
+        CASE_FOR(SELECT);
+        CASE_FOR(ADD_CONST);
+        CASE_FOR(ADD);
+        CASE_FOR(SUB);
+        CASE_FOR(MULT);
+        CASE_FOR(DIV);
+        CASE_FOR(REM);
+        CASE_FOR(DIVU);
+        CASE_FOR(REMU);
+        CASE_FOR(MULT_HIGH);
+        CASE_FOR(MULT_HIGH_UNSIGNED);
+        CASE_FOR(LOG_AND);
+        CASE_FOR(BIT_AND);
+        CASE_FOR(BIT_OR);
+        CASE_FOR(BIT_XOR);
+        CASE_FOR(SHIFT_LEFT);
+        CASE_FOR(SHIFT_RIGHT);
+        CASE_FOR(SHIFT_RIGHT_LOGICAL);
+        CASE_FOR(SET_LT);
+        CASE_FOR(SET_LE);
+        CASE_FOR(SET_GT);
+        CASE_FOR(SET_GE);
+        CASE_FOR(SET_LTU);
+        CASE_FOR(SET_LEU);
+        CASE_FOR(SET_GTU);
+        CASE_FOR(SET_GEU);
+        CASE_FOR(SET_EQ);
+        CASE_FOR(SET_NE);
+        CASE_FOR(NEGATE);
+        CASE_FOR(LOG_NOT);
+        CASE_FOR(BIT_NOT);
     #undef CASE_FOR
         default: return "";
     }
@@ -0,0 +1,270 @@
+/*
+ * Calls.
+ *
+ * A call whose result, if any, is returned straight away needs nothing of
+ * the caller's frame afterwards, so the caller can tear its frame down
+ * first and jump to the callee, which then returns to the caller's caller.
+ * That is not done when an argument would not fit in $a0-$a3, as it would
+ * be passed in the frame being torn down. A procedure calling itself that
+ * way instead copies the arguments to the registers its parameters were
+ * received in and jumps back to just after receiving them, turning the
+ * recursion into a loop. Neither is done when the procedure hands out the
+ * address of one of its variables, which the callee might still use.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-opt.h"
+#include "../include/ir-dataflow.h"
+#include "../include/mips.h"
+
+/* file helper functions */
+IrNode *tail_call_return(IrNode *call, IrNode *end_label);
+Boolean args_in_registers(IrNode *begin, IrNode *call);
+Boolean frame_escapes(ControlFlowGraph *cfg);
+Boolean is_address_use(IrNode *irn, int reg);
+void loop_tail_call(ControlFlowGraph *cfg, IrNode *begin, IrNode *call);
+IrNode *received_param(ControlFlowGraph *cfg, int n);
+IrNode *loop_start(ControlFlowGraph *cfg);
+void remove_nodes(IrList *irl, IrNode *from, IrNode *to);
+
+
+/*
+ * convert_tail_calls
+ * Purpose: turn calls in return position into jumps
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure before register allocation
+ * Returns:
+ *  The number of calls converted. The CFG is stale if it is not 0.
+ * Side Effects:
+ *  A call to another procedure becomes a TAIL_CALL, which leaves through
+ *  the procedure's return label like RETURN_FROM_PROC. A call to the
+ *  procedure itself becomes copies to its parameters and a JUMP to the
+ *  start of the procedure after its RECEIVED_PARAM nodes.
+ */
+int convert_tail_calls(ControlFlowGraph *cfg) {
+    IrNode *irn, *next, *begin, *ret, *tail;
+    IrNode *end_label = cfg->end_proc->prev;
+    int converted = 0;
+
+    if (frame_escapes(cfg)) {
+        return 0;
+    }
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = next) {
+        next = irn->next;
+        if (instruction(irn) != CALL ||
+                (ret = tail_call_return(irn, end_label)) == NULL ||
+                (begin = call_begin(irn)) == NULL) {
+            continue;
+        }
+        if (irn->s == cfg->begin_proc->s) {
+            loop_tail_call(cfg, begin, irn);
+            tail = irn_jump(JUMP, NO_ARG, loop_start(cfg));
+        } else if (args_in_registers(begin, irn)) {
+            tail = construct_ir_node(TAIL_CALL);
+            tail->s = irn->s;
+            tail->branch = end_label;
+        } else {
+            continue;
+        }
+        next = ret == end_label ? ret : ret->next;
+        remove_nodes(cfg->irl, irn, ret == end_label ? ret->prev : ret);
+        insert_ir_node_before(next, tail, cfg->irl);
+        remove_ir_node(begin, cfg->irl);
+        converted++;
+    }
+    return converted;
+}
+
+/*
+ * the node ending the procedure after call when nothing but returning its
+ * result follows it: a RETURN_FROM_PROC, or end_label if control falls
+ * into it. NULL if call is not in return position.
+ */
+IrNode *tail_call_return(IrNode *call, IrNode *end_label) {
+    IrNode *irn = call->next;
+    int result = NO_ARG;
+
+    if (instruction(irn) != END_CALL) {
+        return NULL;
+    }
+    for (irn = irn->next; irn != end_label; irn = irn->next) {
+        switch (instruction(irn)) {
+            case RETURNED_WORD:
+                result = irn->RDEST;
+                break;
+            case MOVE:
+                if (irn->RSRC != result) {
+                    return NULL;
+                }
+                result = irn->RDEST;
+                break;
+            case RETURN_FROM_PROC:
+                if (irn->RSRC != NO_ARG && irn->RSRC != result) {
+                    return NULL;
+                }
+                return irn;
+            default:
+                return NULL;
+        }
+    }
+    return end_label;
+}
+
+Boolean args_in_registers(IrNode *begin, IrNode *call) {
+    IrNode *irn;
+    for (irn = begin; irn != call; irn = irn->next) {
+        if (instruction(irn) == PARAM && irn->RDEST >= NUM_ARG_REGS) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * does the address of a variable of the procedure get used for anything
+ * but loading from and storing to it within the block computing it?
+ */
+Boolean frame_escapes(ControlFlowGraph *cfg) {
+    Dataflow *lv = compute_liveness(cfg);
+    BasicBlock *b;
+    IrNode *irn, *use;
+    int i, reg, *def;
+    Boolean escapes = FALSE;
+
+    for (i = 0; i < cfg->num_blocks && !escapes; i++) {
+        b = cfg->blocks[i];
+        FOR_EACH_BLOCK_NODE(irn, b) {
+            if (instruction(irn) != LOAD_ADDRESS || is_global_symbol(irn->s)) {
+                continue;
+            }
+            reg = irn->RDEST;
+            for (use = irn->next; use != b->last->next; use = use->next) {
+                if (!is_address_use(use, reg)) {
+                    escapes = TRUE;
+                    break;
+                }
+                def = ir_node_def(use);
+                if (def != NULL && *def == reg) {
+                    break;
+                }
+            }
+            if (use == b->last->next && bitset_contains(lv->out[i], reg)) {
+                escapes = TRUE;
+            }
+            if (escapes) {
+                break;
+            }
+        }
+    }
+    free_dataflow(lv);
+    return escapes;
+}
+
+/* does irn read reg, if at all, only as the address of a load or store? */
+Boolean is_address_use(IrNode *irn, int reg) {
+    int *uses[MAX_USES];
+    int i, n = ir_node_uses(irn, uses);
+
+    for (i = 0; i < n; i++) {
+        if (*uses[i] != reg) {
+            continue;
+        }
+        switch (instruction(irn)) {
+            case LOAD_BYTE_INDIRECT:
+            case LOAD_UNSIGNED_BYTE_INDIRECT:
+            case LOAD_HALF_WORD_INDIRECT:
+            case LOAD_UNSIGNED_HALF_WORD_INDIRECT:
+            case LOAD_WORD_INDIRECT:
+                break;
+            case STORE_BYTE_INDIRECT:
+            case STORE_HALF_WORD_INDIRECT:
+            case STORE_WORD_INDIRECT:
+                if (uses[i] != &irn->RDEST) {
+                    return FALSE;
+                }
+                break;
+            default:
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * loop_tail_call
+ * Purpose: replace the arguments of a call of the procedure to itself by
+ *          copies to the registers its parameters are received in
+ * Parameters:
+ *  cfg - ControlFlowGraph * - the procedure
+ *  begin - IrNode * - the BEGIN_CALL of the call
+ *  call - IrNode * - the CALL
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Each PARAM becomes a copy of the argument to a new register, which is
+ *  copied to the parameter's register just before the call, once every
+ *  argument has been computed. Arguments to parameters the procedure never
+ *  reads are dropped.
+ */
+void loop_tail_call(ControlFlowGraph *cfg, IrNode *begin, IrNode *call) {
+    IrNode *irn, *next, *param;
+    int held;
+
+    for (irn = begin; irn != call; irn = next) {
+        next = irn->next;
+        if (instruction(irn) != PARAM) {
+            continue;
+        }
+        param = received_param(cfg, irn->RDEST);
+        if (param != NULL) {
+            held = new_reg(cfg);
+            insert_ir_node_before(irn, irn_move(held, irn->RSRC), cfg->irl);
+            insert_ir_node_before(call, irn_move(param->RDEST, held),
+                                    cfg->irl);
+        }
+        remove_ir_node(irn, cfg->irl);
+    }
+}
+
+/* the RECEIVED_PARAM of the n-th parameter, NULL if it was removed */
+IrNode *received_param(ControlFlowGraph *cfg, int n) {
+    IrNode *irn;
+    FOR_EACH_BLOCK_NODE(irn, cfg->blocks[0]) {
+        if (instruction(irn) == RECEIVED_PARAM && irn->IMMVAL == n) {
+            return irn;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * the label a loop made of the recursion jumps back to: after the last
+ * RECEIVED_PARAM, inserting one if there is none there yet
+ */
+IrNode *loop_start(ControlFlowGraph *cfg) {
+    IrNode *irn, *last = NULL;
+    FOR_EACH_BLOCK_NODE(irn, cfg->blocks[0]) {
+        if (instruction(irn) == RECEIVED_PARAM) {
+            last = irn;
+        }
+    }
+    if (last == NULL) {
+        return cfg->blocks[0]->first;
+    }
+    if (instruction(last->next) != LABEL) {
+        insert_ir_node_after(last, new_label(), cfg->irl);
+    }
+    return last->next;
+}
+
+/* unlink the nodes from one through another */
+void remove_nodes(IrList *irl, IrNode *from, IrNode *to) {
+    IrNode *irn, *next, *stop = to->next;
+    for (irn = from; irn != stop; irn = next) {
+        next = irn->next;
+        remove_ir_node(irn, irl);
+    }
+}
@@ -0,0 +1,370 @@
+/*
+ * Stack frame layout.
+ *
+ * After register allocation each procedure gets a frame sized to what it
+ * holds, laid out from $fp down:
+ *
+ * Name                 Offset                  Size
+ * parameters           $fp+4 up                4 each, in the caller's frame
+ * old $fp              $fp                     4
+ * $ra                  $fp-4                   4, only if it makes calls
+ * saved $s registers   below $ra               4 each, only those written
+ * local variables      below the saved registers, each a whole number
+ *                      of words
+ * spill slots          below the locals        4 each
+ * outgoing arguments   $sp                     4 per argument, at least 16
+ *
+ * rounded up to a double word multiple. A parameter is kept in its word of
+ * the caller's outgoing argument area, where it was passed if it did not
+ * fit in $a0-$a3, so it takes no room in the frame. The variables of sibling
+ * blocks, which are never in scope at the same time, start at the same
+ * offset, and spill slots that are never live at the same time share a
+ * word. A leaf procedure, making no calls, keeps its return address in $ra;
+ * if it has nothing else to keep either, it gets no frame and leaves $sp
+ * and $fp alone.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-opt.h"
+#include "../include/ir-dataflow.h"
+#include "../include/mips.h"
+#include "../include/scope-fsm.h"
+#include "../include/symbol-utils.h"
+#include "../include/utilities.h"
+
+#define WORD_BYTES 4
+#define FRAME_ALIGN 8
+
+/* file helper functions */
+void find_frame_locals(ControlFlowGraph *cfg, FrameLayout *fl);
+int symbol_size(Symbol *s);
+int scope_bytes(FrameLayout *fl, SymbolTable *st);
+int scope_base(FrameLayout *fl, SymbolTable *st, int top);
+int layout_locals(FrameLayout *fl, int top);
+void share_spill_slots(ControlFlowGraph *cfg, FrameLayout *fl);
+int outgoing_bytes(ControlFlowGraph *cfg);
+Boolean makes_calls(ControlFlowGraph *cfg);
+int parameter_index(Symbol *proc, Symbol *s);
+Boolean in_caller_frame(FrameLayout *fl, int i);
+
+
+/*
+ * layout_frame
+ * Purpose: decide the size of a procedure's stack frame and where in it
+ *          each saved register, local variable and spill slot goes
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure after register allocation
+ *  ra - RegisterAssignment * - what register allocation left for the frame
+ *  fl - FrameLayout * - filled in; free with free_frame_layout
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Allocates heap storage
+ */
+void layout_frame(ControlFlowGraph *cfg, RegisterAssignment *ra,
+                    FrameLayout *fl) {
+    int i, top;
+
+    /* the saved $fp, and $ra */
+    fl->saves_ra = makes_calls(cfg);
+    top = fl->saves_ra ? 2 * WORD_BYTES : WORD_BYTES;
+    for (i = 0; i < NUM_SAVED_REGS; i++) {
+        fl->saved_offset[i] = 0;
+        if (ra->saved_used[i]) {
+            top += WORD_BYTES;
+            fl->saved_offset[i] = WORD_BYTES - top;
+        }
+    }
+
+    find_frame_locals(cfg, fl);
+    top = layout_locals(fl, top);
+
+    fl->num_spill_slots = ra->num_spill_slots;
+    share_spill_slots(cfg, fl);
+    for (i = 0; i < fl->num_spill_slots; i++) {
+        fl->spill_offset[i] = WORD_BYTES - top -
+                                WORD_BYTES * (fl->spill_offset[i] + 1);
+    }
+    top += WORD_BYTES * fl->num_spill_words;
+
+    fl->outgoing_bytes = outgoing_bytes(cfg);
+    fl->size = (top + fl->outgoing_bytes + FRAME_ALIGN - 1) &
+                    ~(FRAME_ALIGN - 1);
+    if (!fl->saves_ra && top == WORD_BYTES && fl->num_locals == 0) {
+        fl->size = 0;
+    }
+    report_pass("frame", cfg, fl->size, "bytes of stack frame");
+}
+
+/* the offset from $fp of a variable kept in the frame, if s is one */
+Boolean local_offset(FrameLayout *fl, Symbol *s, int *offset) {
+    int i;
+    for (i = 0; i < fl->num_locals; i++) {
+        if (fl->locals[i] == s) {
+            *offset = fl->local_offset[i];
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+void free_frame_layout(FrameLayout *fl) {
+    free(fl->locals);
+    free(fl->local_offset);
+    free(fl->spill_offset);
+}
+
+/*
+ * the variables other than globals whose address the procedure takes, with
+ * the offsets of those that are parameters
+ */
+void find_frame_locals(ControlFlowGraph *cfg, FrameLayout *fl) {
+    IrNode *irn;
+    int offset, k;
+
+    fl->locals = NULL;
+    fl->local_offset = NULL;
+    fl->num_locals = 0;
+    for (irn = cfg->begin_proc; irn != cfg->end_proc; irn = irn->next) {
+        if (instruction(irn) != LOAD_ADDRESS || irn->s == NULL ||
+                is_global_symbol(irn->s) || local_offset(fl, irn->s, &offset)) {
+            continue;
+        }
+        util_erealloc((void **) &fl->locals,
+                        (fl->num_locals + 1) * sizeof(Symbol *));
+        util_erealloc((void **) &fl->local_offset,
+                        (fl->num_locals + 1) * sizeof(int));
+        k = parameter_index(cfg->begin_proc->s, irn->s);
+        fl->locals[fl->num_locals] = irn->s;
+        fl->local_offset[fl->num_locals] = k == NO_ARG ? 0 :
+                                            WORD_BYTES * (k + 1);
+        fl->num_locals++;
+    }
+}
+
+/*
+ * bytes of the frame a variable takes, rounded up to a whole number of
+ * words so the locals after it stay word aligned
+ */
+int symbol_size(Symbol *s) {
+    int size = type_bytes(s->type_tree);
+    return (size + WORD_BYTES - 1) / WORD_BYTES * WORD_BYTES;
+}
+
+/* the boundary in bytes an object of the type starts on: its element's */
+int type_alignment(TypeNode *tn) {
+    while (tn->type == ARRAY) {
+        tn = tn->next;
+    }
+    return type_bytes(tn);
+}
+
+/* bytes taken by the frame locals declared directly in scope st */
+int scope_bytes(FrameLayout *fl, SymbolTable *st) {
+    int i, bytes = 0;
+    for (i = 0; i < fl->num_locals; i++) {
+        if (get_symbol_table(fl->locals[i]) == st && !in_caller_frame(fl, i)) {
+            bytes += symbol_size(fl->locals[i]);
+        }
+    }
+    return bytes;
+}
+
+/*
+ * the bytes below the top of the frame taken before the locals of scope st:
+ * those of every enclosing scope, but none of its siblings'
+ */
+int scope_base(FrameLayout *fl, SymbolTable *st, int top) {
+    if (st->enclosing == NULL || st_scope(st) <= FUNCTION_SCOPE) {
+        return top;
+    }
+    return scope_base(fl, st->enclosing, top) + scope_bytes(fl, st->enclosing);
+}
+
+/*
+ * layout_locals
+ * Purpose: give each frame local other than a parameter an offset, those of
+ *          a scope one after another below those of the scopes enclosing it
+ * Parameters:
+ *  fl - FrameLayout * - locals found by find_frame_locals
+ *  top - int - bytes below the top of the frame already taken
+ * Returns:
+ *  The bytes below the top of the frame taken including the locals
+ * Side Effects:
+ *  Sets the offsets of the locals
+ */
+int layout_locals(FrameLayout *fl, int top) {
+    SymbolTable *st;
+    int i, j, end = top, bottom;
+
+    for (i = 0; i < fl->num_locals; i++) {
+        if (in_caller_frame(fl, i)) {
+            continue;
+        }
+        st = get_symbol_table(fl->locals[i]);
+        bottom = scope_base(fl, st, top) + symbol_size(fl->locals[i]);
+        /* after the locals of the same scope placed before it */
+        for (j = 0; j < i; j++) {
+            if (get_symbol_table(fl->locals[j]) == st &&
+                    !in_caller_frame(fl, j)) {
+                bottom += symbol_size(fl->locals[j]);
+            }
+        }
+        /* the lowest byte of the variable is its address */
+        fl->local_offset[i] = WORD_BYTES - bottom;
+        if (bottom > end) {
+            end = bottom;
+        }
+    }
+    return end;
+}
+
+/*
+ * share_spill_slots
+ * Purpose: give each spill slot a word of the frame, shared with the slots
+ *          never live at the same time as it
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure after register allocation, whose
+ *        LOAD_WORD and STORE_WORD nodes access spill slots
+ *  fl - FrameLayout * - with num_spill_slots set
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Sets num_spill_words, and spill_offset to the index of each slot's word
+ */
+void share_spill_slots(ControlFlowGraph *cfg, FrameLayout *fl) {
+    Dataflow *df;
+    BitSet **conflicts, *live;
+    BasicBlock *b;
+    IrNode *irn;
+    Boolean *taken;
+    int i, k, n = fl->num_spill_slots;
+
+    util_emalloc((void **) &fl->spill_offset, (n + 1) * sizeof(int));
+    fl->num_spill_words = 0;
+    if (n == 0) {
+        return;
+    }
+
+    /* a slot is live from a store to it until its last load */
+    df = new_dataflow(cfg, DF_BACKWARD, DF_UNION, n);
+    for (i = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        FOR_EACH_BLOCK_NODE(irn, b) {
+            if (instruction(irn) == STORE_WORD) {
+                bitset_add(df->kill[i], irn->IMMVAL);
+            } else if (instruction(irn) == LOAD_WORD &&
+                        !bitset_contains(df->kill[i], irn->IMMVAL)) {
+                bitset_add(df->gen[i], irn->IMMVAL);
+            }
+        }
+    }
+    solve_dataflow(df);
+
+    /* a store conflicts with every other slot live across it */
+    util_emalloc((void **) &conflicts, n * sizeof(BitSet *));
+    for (k = 0; k < n; k++) {
+        conflicts[k] = new_bitset(n, FALSE);
+    }
+    live = new_bitset(n, FALSE);
+    for (i = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        bitset_copy(live, df->out[i]);
+        for (irn = b->last; irn != b->first->prev; irn = irn->prev) {
+            if (instruction(irn) == STORE_WORD) {
+                bitset_remove(live, irn->IMMVAL);
+                FOR_EACH_BIT(k, live) {
+                    bitset_add(conflicts[irn->IMMVAL], k);
+                    bitset_add(conflicts[k], irn->IMMVAL);
+                }
+            } else if (instruction(irn) == LOAD_WORD) {
+                bitset_add(live, irn->IMMVAL);
+            }
+        }
+    }
+
+    /* the lowest word no conflicting slot has */
+    util_emalloc((void **) &taken, (n + 1) * sizeof(Boolean));
+    for (k = 0; k < n; k++) {
+        for (i = 0; i < n; i++) {
+            taken[i] = FALSE;
+        }
+        for (i = 0; i < k; i++) {
+            if (bitset_contains(conflicts[k], i)) {
+                taken[fl->spill_offset[i]] = TRUE;
+            }
+        }
+        for (i = 0; taken[i]; i++) {
+        }
+        fl->spill_offset[k] = i;
+        if (i + 1 > fl->num_spill_words) {
+            fl->num_spill_words = i + 1;
+        }
+    }
+
+    free(taken);
+    free_bitset(live);
+    for (k = 0; k < n; k++) {
+        free_bitset(conflicts[k]);
+    }
+    free(conflicts);
+    free_dataflow(df);
+}
+
+/*
+ * the bytes at the bottom of the frame for arguments to calls: a word for
+ * each argument of the call passing the most, and at least the four words
+ * a callee may store $a0-$a3 to
+ */
+int outgoing_bytes(ControlFlowGraph *cfg) {
+    IrNode *irn;
+    Boolean calls = FALSE;
+    int args = NUM_ARG_REGS;
+
+    for (irn = cfg->begin_proc; irn != cfg->end_proc; irn = irn->next) {
+        if (instruction(irn) == CALL) {
+            calls = TRUE;
+        } else if (instruction(irn) == PARAM && irn->RDEST + 1 > args) {
+            args = irn->RDEST + 1;
+        }
+    }
+    return calls ? WORD_BYTES * args : 0;
+}
+
+/* does the procedure call anything that will return to it? */
+Boolean makes_calls(ControlFlowGraph *cfg) {
+    IrNode *irn;
+    for (irn = cfg->begin_proc; irn != cfg->end_proc; irn = irn->next) {
+        if (instruction(irn) == CALL || instruction(irn) == SYSCALL) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* the position of s among the parameters of proc, NO_ARG if it is not one */
+int parameter_index(Symbol *proc, Symbol *s) {
+    FunctionParameter *fp;
+    SymbolTable *st = get_symbol_table(s);
+    int k = 0;
+
+    if (st == NULL || st_scope(st) != FUNCTION_SCOPE) {
+        return NO_ARG;
+    }
+    for (fp = first_parameter(proc); fp != NULL; fp = fp->next, k++) {
+        if (get_parameter_name(fp) != NULL &&
+                strcmp(get_parameter_name(fp), get_symbol_name(s)) == 0) {
+            return k;
+        }
+    }
+    return NO_ARG;
+}
+
+/* is local i a parameter, kept above the frame? */
+Boolean in_caller_frame(FrameLayout *fl, int i) {
+    return fl->local_offset[i] > 0;
+}
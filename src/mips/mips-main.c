@@ -1,5 +1,6 @@
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "../include/cmpl.h"
@@ -9,6 +10,8 @@
 #include "../include/parser.h"
 #include "../include/symbol-utils.h"
 #include "../include/ir.h"
+#include "../include/ir-ssa.h"
+#include "../include/ir-opt.h"
 #include "../include/symbol-collection.h"
 #include "../include/symbol.h"
 #include "../include/mips.h"
@@ -19,11 +22,23 @@ extern IrList *ir_list;
 
 FILE *input, *output;
 
+/* -ssa: take the IR through SSA form before generating code */
+Boolean use_ssa = FALSE;
+/* -O<n>: optimization level */
+int opt_level = 0;
+
 int yyparse(void);
 
 int main(int argc, char *argv[]) {
     extern FILE *yyin;
-    int rv;
+    int rv, flags;
+
+    flags = parse_opt_flags(argc, argv, &use_ssa, &opt_level);
+    if (flags == NO_ARG) {
+        return 1;
+    }
+    argc -= flags;
+    argv += flags;
 
     /* Figure out whether we're using stdin/stdout or file in/file out. */
     if (argc < 2 || !strcmp("-", argv[1])) {
@@ -71,10 +86,18 @@ void start_traversal(Node *n) {
         scd->outfile = output;
     }
     collect_symbol_data(n, scd);
+    if (opt_level >= 1) {
+        fold_constant_expressions(n);
+    }
 
     start_ir_computation();
     compute_ir(n, ir_list);
     IrNode *irn = ir_list->head;
+    if (use_ssa) {
+        convert_to_ssa(ir_list);
+        convert_from_ssa(ir_list);
+    }
+    optimize_ir(ir_list, opt_level);
 
     compute_mips_asm(output, scd->stc, ir_list);
 }
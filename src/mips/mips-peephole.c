@@ -0,0 +1,307 @@
+/*
+ * Peephole optimization.
+ *
+ * Once a procedure's instructions are selected, short windows of them are
+ * matched against the rules in the table below, each naming the opcodes of
+ * the one or two instructions it looks at and a function that checks the
+ * rest of the window and rewrites it. The rules are applied over the whole
+ * list again until none of them changes anything, as one rewrite can make
+ * the window of another.
+ *
+ * A rule dropping a register's value needs to know nothing reads it later.
+ * Only the instructions up to the end of the straight-line code are looked
+ * at for that: a label, a branch or a jump ends the search with the value
+ * taken to be live, except that a call ends the life of the registers a
+ * callee may change that are not its arguments.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/ir.h"
+#include "../include/mips.h"
+
+/* rewrites the window starting at mi if the rule applies, saying if so */
+typedef Boolean (*PeepholeRewrite)(MipsInstr *mi, MipsList *ml);
+
+struct PeepholeRule {
+    char *name;                 /* what it did, for -report            */
+    enum mips_opcode first;     /* MIPS_NONE for any instruction       */
+    enum mips_opcode second;    /* MIPS_NONE for a single instruction  */
+    PeepholeRewrite rewrite;
+};
+
+/* file helper functions */
+Boolean remove_self_move(MipsInstr *mi, MipsList *ml);
+Boolean remove_jump_to_next(MipsInstr *mi, MipsList *ml);
+Boolean thread_jump(MipsInstr *mi, MipsList *ml);
+Boolean fold_li_into_or(MipsInstr *mi, MipsList *ml);
+Boolean forward_stored_word(MipsInstr *mi, MipsList *ml);
+Boolean remove_unused_label(MipsInstr *mi, MipsList *ml);
+Boolean remove_unreachable_instr(MipsInstr *mi, MipsList *ml);
+Boolean rule_matches(const struct PeepholeRule *rule, MipsInstr *mi);
+Boolean is_label_jump(MipsInstr *mi);
+MipsInstr *label_instr(MipsList *ml, int label);
+MipsInstr *first_instr_after(MipsInstr *mi);
+Boolean same_memory_operand(MipsInstr *a, MipsInstr *b);
+Boolean reg_dead_after(MipsInstr *mi, int reg);
+Boolean is_call_clobbered(int reg);
+
+/* indexed by the hits counted in optimize_peephole */
+static const struct PeepholeRule rules[NUM_PEEPHOLE_RULES] = {
+    { "moves to self removed", MIPS_MOVE, MIPS_NONE, remove_self_move },
+    { "jumps to the next instruction removed", MIPS_J, MIPS_LABEL,
+        remove_jump_to_next },
+    { "jumps to jumps threaded", MIPS_NONE, MIPS_NONE, thread_jump },
+    { "li and or made ori", MIPS_LI, MIPS_OR, fold_li_into_or },
+    { "loads of stored words made moves", MIPS_SW, MIPS_LW,
+        forward_stored_word },
+    { "unused labels removed", MIPS_LABEL, MIPS_NONE, remove_unused_label },
+    { "unreachable instructions removed", MIPS_NONE, MIPS_NONE,
+        remove_unreachable_instr }
+};
+
+
+/*
+ * optimize_peephole
+ * Purpose: rewrite short sequences of a procedure's instructions into
+ *          fewer or cheaper ones
+ * Parameters:
+ *  ml - MipsList * - the instructions of a procedure
+ *  hits - int[] - NUM_PEEPHOLE_RULES counts, set to the times each rule
+ *                 was applied
+ * Returns:
+ *  The number of rewrites made
+ * Side Effects:
+ *  Changes, removes and frees instructions of ml
+ */
+int optimize_peephole(MipsList *ml, int hits[]) {
+    MipsInstr *mi, *prev, *next;
+    Boolean changed = TRUE;
+    int i, total = 0;
+
+    for (i = 0; i < NUM_PEEPHOLE_RULES; i++) {
+        hits[i] = 0;
+    }
+    while (changed) {
+        changed = FALSE;
+        for (mi = ml->head; mi != NULL; mi = next) {
+            /* a rewrite may free mi or the one after, never the one before */
+            prev = mi->prev;
+            next = mi->next;
+            for (i = 0; i < NUM_PEEPHOLE_RULES; i++) {
+                if (rule_matches(&rules[i], mi) && rules[i].rewrite(mi, ml)) {
+                    hits[i]++;
+                    total++;
+                    changed = TRUE;
+                    /* the window starting before it may match now */
+                    next = prev == NULL ? ml->head : prev;
+                    break;
+                }
+            }
+        }
+    }
+    return total;
+}
+
+/* what the rule-th rule of the table does, as reported */
+char *peephole_rule_name(int rule) {
+    return rules[rule].name;
+}
+
+/* move r, r */
+Boolean remove_self_move(MipsInstr *mi, MipsList *ml) {
+    if (mi->rd != mi->rs) {
+        return FALSE;
+    }
+    remove_mips_instr(mi, ml);
+    return TRUE;
+}
+
+/* j L with nothing but labels, L among them, between it and L */
+Boolean remove_jump_to_next(MipsInstr *mi, MipsList *ml) {
+    MipsInstr *next;
+
+    if (mi->s != NULL) {
+        return FALSE;
+    }
+    for (next = mi->next; next != NULL && next->op == MIPS_LABEL;
+            next = next->next) {
+        if (next->s == NULL && next->label == mi->label) {
+            remove_mips_instr(mi, ml);
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * a branch or jump to L where L: j M goes to M instead, unless M is itself
+ * followed by a jump: chains are threaded from their ends, and cycles of
+ * jumps are left alone
+ */
+Boolean thread_jump(MipsInstr *mi, MipsList *ml) {
+    MipsInstr *target, *after;
+
+    if (!is_label_jump(mi)) {
+        return FALSE;
+    }
+    target = first_instr_after(label_instr(ml, mi->label));
+    if (target == NULL || !is_label_jump(target) || target->op != MIPS_J ||
+            target->label == mi->label) {
+        return FALSE;
+    }
+    after = first_instr_after(label_instr(ml, target->label));
+    if (after != NULL && after->op == MIPS_J) {
+        return FALSE;
+    }
+    mi->label = target->label;
+    return TRUE;
+}
+
+/* li t, c then or d, a, t with c fitting an unsigned immediate: ori d, a, c */
+Boolean fold_li_into_or(MipsInstr *mi, MipsList *ml) {
+    MipsInstr *or_instr = mi->next;
+    int t = mi->rd, other;
+
+    if (mi->imm < 0 || mi->imm > 0xFFFF) {
+        return FALSE;
+    }
+    if (or_instr->rt == t && or_instr->rs != t) {
+        other = or_instr->rs;
+    } else if (or_instr->rs == t && or_instr->rt != t) {
+        other = or_instr->rt;
+    } else {
+        return FALSE;
+    }
+    if (or_instr->rd != t && !reg_dead_after(or_instr, t)) {
+        return FALSE;
+    }
+    or_instr->op = MIPS_ORI;
+    or_instr->rs = other;
+    or_instr->rt = NO_ARG;
+    or_instr->imm = mi->imm;
+    remove_mips_instr(mi, ml);
+    return TRUE;
+}
+
+/* sw r, m then lw d, m: the load is move d, r, or nothing if d is r */
+Boolean forward_stored_word(MipsInstr *mi, MipsList *ml) {
+    MipsInstr *lw = mi->next;
+
+    if (!same_memory_operand(mi, lw)) {
+        return FALSE;
+    }
+    if (lw->rd == mi->rt) {
+        remove_mips_instr(lw, ml);
+        return TRUE;
+    }
+    lw->op = MIPS_MOVE;
+    lw->rs = mi->rt;
+    lw->s = NULL;
+    lw->imm = 0;
+    lw->comment = NULL;
+    return TRUE;
+}
+
+/*
+ * a label of the procedure nothing jumps to, which would only split the
+ * code around it for the rules above and for scheduling
+ */
+Boolean remove_unused_label(MipsInstr *mi, MipsList *ml) {
+    MipsInstr *jump;
+
+    if (mi->s != NULL) {
+        return FALSE;
+    }
+    for (jump = ml->head; jump != NULL; jump = jump->next) {
+        if (is_label_jump(jump) && jump->label == mi->label) {
+            return FALSE;
+        }
+    }
+    remove_mips_instr(mi, ml);
+    return TRUE;
+}
+
+/*
+ * an instruction after a j or jr with no label between them, left when the
+ * jumps to the label that was there are threaded elsewhere
+ */
+Boolean remove_unreachable_instr(MipsInstr *mi, MipsList *ml) {
+    if ((mi->op != MIPS_J && mi->op != MIPS_JR) || mi->next == NULL ||
+            mi->next->op == MIPS_LABEL) {
+        return FALSE;
+    }
+    remove_mips_instr(mi->next, ml);
+    return TRUE;
+}
+
+Boolean rule_matches(const struct PeepholeRule *rule, MipsInstr *mi) {
+    if (rule->first != MIPS_NONE && mi->op != rule->first) {
+        return FALSE;
+    }
+    if (rule->second == MIPS_NONE) {
+        return TRUE;
+    }
+    return mi->next != NULL && mi->next->op == rule->second ? TRUE : FALSE;
+}
+
+/* a branch or a jump to a label of the procedure rather than a call */
+Boolean is_label_jump(MipsInstr *mi) {
+    return mi->op >= MIPS_BEQ && mi->op <= MIPS_J && mi->s == NULL ?
+            TRUE : FALSE;
+}
+
+/* the label LABEL_label, NULL if the procedure has none */
+MipsInstr *label_instr(MipsList *ml, int label) {
+    MipsInstr *mi;
+    for (mi = ml->head; mi != NULL; mi = mi->next) {
+        if (mi->op == MIPS_LABEL && mi->s == NULL && mi->label == label) {
+            return mi;
+        }
+    }
+    return NULL;
+}
+
+/* the first instruction from mi on that is not a label */
+MipsInstr *first_instr_after(MipsInstr *mi) {
+    while (mi != NULL && mi->op == MIPS_LABEL) {
+        mi = mi->next;
+    }
+    return mi;
+}
+
+Boolean same_memory_operand(MipsInstr *a, MipsInstr *b) {
+    return a->rs == b->rs && a->imm == b->imm && a->s == b->s ? TRUE : FALSE;
+}
+
+/* is the value of reg after mi certainly not read again? */
+Boolean reg_dead_after(MipsInstr *mi, int reg) {
+    int uses[MAX_MIPS_USES];
+    int i, n;
+
+    for (mi = mi->next; mi != NULL; mi = mi->next) {
+        n = mips_instr_uses(mi, uses);
+        for (i = 0; i < n; i++) {
+            if (uses[i] == reg) {
+                return FALSE;
+            }
+        }
+        if (mi->op == MIPS_JAL) {
+            return is_call_clobbered(reg);
+        }
+        if (mi->op == MIPS_LABEL || mi->op >= MIPS_BEQ) {
+            return FALSE;
+        }
+        if (mips_instr_def(mi) == reg) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* a register a callee may change that does not carry an argument */
+Boolean is_call_clobbered(int reg) {
+    return reg == REG_V0 || reg == REG_V1 ||
+            (reg >= REG_T0 && reg < REG_S0) ||
+            reg == REG_T8 || reg == REG_T8 + 1 ? TRUE : FALSE;
+}
@@ -0,0 +1,654 @@
+/*
+ * Linear scan register allocation onto the MIPS registers.
+ *
+ * The registers of a procedure are first split into webs, so values that
+ * the IR happens to give the same number get registers of their own. Each
+ * register then gets a live interval: the IR positions from its first
+ * definition or use to its last, stretched over every block it is live
+ * into or out of. Intervals are visited in order of their starts and given
+ * a free machine register; when none is free, the interval reaching
+ * furthest is spilled to a slot in the stack frame. Spilling rewrites each
+ * definition and use of the register to go through a short lived register
+ * of its own, and allocation starts over until everything fits.
+ *
+ * Values live across a call get callee-saved $s registers, the rest prefer
+ * the caller-saved $t registers. The source and destination of a copy that
+ * are never live at the same time become one register before allocation,
+ * and a value whose only use is to be passed to a call or returned is
+ * computed straight into its $a or $v0 register, so those moves disappear.
+ * Likewise a parameter not live across a call stays in the $a register it
+ * is passed in.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-opt.h"
+#include "../include/ir-dataflow.h"
+#include "../include/mips.h"
+#include "../include/utilities.h"
+
+/*
+ * the live interval of a register: IR node i reads its operands at
+ * position 2i and writes its result at 2i + 1
+ */
+struct Interval {
+    int reg;
+    int start;
+    int end;
+    int phys;                   /* machine register, NO_ARG if none    */
+    int fixed;                  /* $a or $v0 register its use wants    */
+    int arrives;                /* $a register it is passed in         */
+    int hint;                   /* register it is copied from          */
+    int num_uses;
+    Boolean crosses_call;
+};
+typedef struct Interval Interval;
+
+/*
+ * a span during which an argument register holds an argument, to a call or
+ * passed in to the procedure
+ */
+struct ArgRange {
+    int phys;
+    int start;
+    int end;                    /* NO_ARG until the call is seen       */
+};
+typedef struct ArgRange ArgRange;
+
+struct Allocator {
+    ControlFlowGraph *cfg;
+    RegisterAssignment *ra;
+    Interval *intervals;        /* indexed by register                 */
+    int *calls;                 /* positions of calls, ascending       */
+    int num_calls;
+    ArgRange *args;
+    int num_args;
+    Interval *holder[NUM_MIPS_REGS];
+    Boolean *spilled;           /* indexed by register                 */
+    int first_temp;             /* registers from here reload spills   */
+};
+typedef struct Allocator Allocator;
+
+/* allocatable registers in order of preference */
+static const int caller_saved[] = {8, 9, 10, 11, 12, 13, 14, 15, 24, 25};
+static const int callee_saved[] = {16, 17, 18, 19, 20, 21, 22, 23};
+
+static char *reg_names[NUM_MIPS_REGS] = {
+    "$0", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
+    "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+    "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+    "$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra"
+};
+
+/* file helper functions */
+int coalesce_moves(ControlFlowGraph *cfg);
+Boolean registers_interfere(Dataflow *lv, int a, int b);
+void rename_register(ControlFlowGraph *cfg, int from, int to);
+Boolean scan_intervals(Allocator *al);
+void build_intervals(Allocator *al);
+void extend_interval(Interval *iv, int pos);
+int compare_starts(const void *a, const void *b);
+Boolean assign_register(Allocator *al, Interval *cur);
+Boolean try_register(Allocator *al, Interval *cur, int phys);
+Boolean may_hold(Interval *cur, int phys);
+Boolean arg_register_busy(Allocator *al, Interval *cur, int phys);
+void add_arg_range(Allocator *al, int phys, int start, int end);
+Boolean is_call(IrNode *irn);
+Boolean reads_late(IrNode *irn, int reg);
+void insert_spill_code(Allocator *al);
+void assign_machine_registers(Allocator *al);
+
+
+/*
+ * allocate_registers
+ * Purpose: map the registers of a procedure onto machine registers
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure not in SSA form
+ *  ra - RegisterAssignment * - filled in with what the stack frame of the
+ *       procedure must provide
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Every register in the procedure's IR is replaced by a MIPS register
+ *  number. Loads and stores of frame slots, LOAD_WORD and STORE_WORD with
+ *  the slot number in IMMVAL, are inserted around spilled values. Moves
+ *  left with the same source and destination are removed. cfg->num_regs
+ *  becomes NUM_MIPS_REGS, so dataflow over the procedure sees machine
+ *  registers.
+ */
+void allocate_registers(ControlFlowGraph *cfg, RegisterAssignment *ra) {
+    Allocator al;
+    int i;
+
+    for (i = 0; i < NUM_SAVED_REGS; i++) {
+        ra->saved_used[i] = FALSE;
+    }
+    ra->num_spill_slots = 0;
+
+    split_webs(cfg);
+    ra->num_coalesced = coalesce_moves(cfg);
+    al.cfg = cfg;
+    al.ra = ra;
+    al.first_temp = cfg->num_regs;
+    al.spilled = NULL;
+    while (!scan_intervals(&al)) {
+        insert_spill_code(&al);
+        free(al.intervals);
+        free(al.calls);
+        free(al.args);
+        free(al.spilled);
+    }
+    assign_machine_registers(&al);
+    cfg->num_regs = NUM_MIPS_REGS;
+    free(al.intervals);
+    free(al.calls);
+    free(al.args);
+    free(al.spilled);
+    report_pass("ra", cfg, ra->num_spill_slots, "values spilled");
+}
+
+/* the assembler name of a MIPS register */
+char *mips_reg_name(int reg) {
+    if (reg < 0 || reg >= NUM_MIPS_REGS) {
+        return "$?";
+    }
+    return reg_names[reg];
+}
+
+/*
+ * coalesce_moves
+ * Purpose: give the source and destination of each copy one register
+ *          when they are never live at the same time
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure not in SSA form
+ * Returns:
+ *  The number of copies whose registers were merged
+ * Side Effects:
+ *  Renames registers and removes the merged copies
+ */
+int coalesce_moves(ControlFlowGraph *cfg) {
+    Dataflow *lv = compute_liveness(cfg);
+    IrNode *irn, *next;
+    int i, d, s, merged = 0;
+
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = next) {
+        next = irn->next;
+        if (instruction(irn) != MOVE || irn->RDEST == NO_ARG ||
+                irn->RSRC == NO_ARG || irn->RDEST == irn->RSRC) {
+            continue;
+        }
+        d = irn->RDEST;
+        s = irn->RSRC;
+        if (registers_interfere(lv, d, s)) {
+            continue;
+        }
+        remove_block_node(irn, cfg);
+        rename_register(cfg, d, s);
+        for (i = 0; i < cfg->num_blocks; i++) {
+            if (bitset_contains(lv->in[i], d)) {
+                bitset_remove(lv->in[i], d);
+                bitset_add(lv->in[i], s);
+            }
+            if (bitset_contains(lv->out[i], d)) {
+                bitset_remove(lv->out[i], d);
+                bitset_add(lv->out[i], s);
+            }
+        }
+        merged++;
+    }
+    free_dataflow(lv);
+    return merged;
+}
+
+/*
+ * is either of registers a and b defined where the other is live, other
+ * than by a copy of one to the other?
+ */
+Boolean registers_interfere(Dataflow *lv, int a, int b) {
+    int *uses[MAX_USES], *def;
+    Boolean live_a, live_b, is_copy;
+    BasicBlock *bb;
+    IrNode *irn;
+    int i, j, n;
+
+    for (i = 0; i < lv->cfg->num_blocks; i++) {
+        bb = lv->cfg->blocks[i];
+        live_a = bitset_contains(lv->out[i], a);
+        live_b = bitset_contains(lv->out[i], b);
+        for (irn = bb->last; irn != bb->first->prev; irn = irn->prev) {
+            def = ir_node_def(irn);
+            is_copy = instruction(irn) == MOVE &&
+                        (irn->RSRC == a || irn->RSRC == b);
+            if (def != NULL && *def == a) {
+                if ((live_b || reads_late(irn, b)) && !is_copy) {
+                    return TRUE;
+                }
+                live_a = FALSE;
+            } else if (def != NULL && *def == b) {
+                if ((live_a || reads_late(irn, a)) && !is_copy) {
+                    return TRUE;
+                }
+                live_b = FALSE;
+            }
+            n = ir_node_uses(irn, uses);
+            for (j = 0; j < n; j++) {
+                live_a = live_a || *uses[j] == a;
+                live_b = live_b || *uses[j] == b;
+            }
+        }
+    }
+    return FALSE;
+}
+
+/* replace every definition and use of register from by register to */
+void rename_register(ControlFlowGraph *cfg, int from, int to) {
+    int *regs[MAX_USES + 1], *def;
+    int i, n;
+    IrNode *irn;
+
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = irn->next) {
+        n = ir_node_uses(irn, regs);
+        def = ir_node_def(irn);
+        if (def != NULL) {
+            regs[n++] = def;
+        }
+        for (i = 0; i < n; i++) {
+            if (*regs[i] == from) {
+                *regs[i] = to;
+            }
+        }
+    }
+}
+
+/*
+ * scan_intervals
+ * Purpose: assign a machine register to the interval of every register
+ * Parameters:
+ *  al - Allocator * - the allocator, whose intervals, calls, argument
+ *       ranges and spill flags are (re)built here
+ * Returns:
+ *  TRUE if every interval got a register, FALSE if some were spilled
+ */
+Boolean scan_intervals(Allocator *al) {
+    Interval **order;
+    int i, r, num_order = 0;
+    Boolean fits = TRUE;
+
+    build_intervals(al);
+    util_emalloc((void **) &al->spilled,
+                    (al->cfg->num_regs + 1) * sizeof(Boolean));
+    util_emalloc((void **) &order,
+                    (al->cfg->num_regs + 1) * sizeof(Interval *));
+    for (r = 0; r < al->cfg->num_regs; r++) {
+        al->spilled[r] = FALSE;
+        /* registers merged away by coalescing are never read or written */
+        if (al->intervals[r].start != NO_ARG) {
+            order[num_order++] = &al->intervals[r];
+        }
+    }
+    qsort(order, num_order, sizeof(Interval *), compare_starts);
+    for (i = 0; i < NUM_MIPS_REGS; i++) {
+        al->holder[i] = NULL;
+    }
+
+    for (i = 0; i < num_order; i++) {
+        /* expire the intervals ending before this one starts */
+        for (r = 0; r < NUM_MIPS_REGS; r++) {
+            if (al->holder[r] != NULL && al->holder[r]->end < order[i]->start) {
+                al->holder[r] = NULL;
+            }
+        }
+        if (!assign_register(al, order[i])) {
+            fits = FALSE;
+        }
+    }
+    free(order);
+    return fits;
+}
+
+/* find the live interval of each register, the calls and argument ranges */
+void build_intervals(Allocator *al) {
+    ControlFlowGraph *cfg = al->cfg;
+    Dataflow *lv = compute_liveness(cfg);
+    Interval *iv;
+    BasicBlock *b;
+    IrNode *irn;
+    int *uses[MAX_USES], *def;
+    int i, j, r, n, pos = 0, first;
+
+    util_emalloc((void **) &al->intervals,
+                    (cfg->num_regs + 1) * sizeof(Interval));
+    for (r = 0; r < cfg->num_regs; r++) {
+        iv = &al->intervals[r];
+        iv->reg = r;
+        iv->start = NO_ARG;
+        iv->end = NO_ARG;
+        iv->phys = NO_ARG;
+        iv->fixed = NO_ARG;
+        iv->arrives = NO_ARG;
+        iv->hint = NO_ARG;
+        iv->num_uses = 0;
+        iv->crosses_call = FALSE;
+    }
+    al->calls = NULL;
+    al->num_calls = 0;
+    al->args = NULL;
+    al->num_args = 0;
+
+    for (i = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        first = pos;
+        FOR_EACH_BLOCK_NODE(irn, b) {
+            n = ir_node_uses(irn, uses);
+            for (j = 0; j < n; j++) {
+                if (*uses[j] == NO_ARG) {
+                    continue;
+                }
+                iv = &al->intervals[*uses[j]];
+                extend_interval(iv, reads_late(irn, *uses[j]) ?
+                                    2 * pos + 1 : 2 * pos);
+                iv->num_uses++;
+                if (instruction(irn) == RETURN_FROM_PROC) {
+                    iv->fixed = REG_V0;
+                } else if (instruction(irn) == PARAM &&
+                            irn->RDEST < NUM_ARG_REGS) {
+                    iv->fixed = REG_A0 + irn->RDEST;
+                }
+            }
+            def = ir_node_def(irn);
+            if (def != NULL && *def != NO_ARG) {
+                extend_interval(&al->intervals[*def], 2 * pos + 1);
+                if (instruction(irn) == MOVE && irn->RSRC != NO_ARG) {
+                    al->intervals[*def].hint = irn->RSRC;
+                }
+            }
+            if (instruction(irn) == PARAM && irn->RDEST < NUM_ARG_REGS) {
+                add_arg_range(al, REG_A0 + irn->RDEST, 2 * pos, NO_ARG);
+            } else if (instruction(irn) == RECEIVED_PARAM &&
+                        irn->IMMVAL < NUM_ARG_REGS) {
+                /* held since the procedure was entered */
+                add_arg_range(al, REG_A0 + irn->IMMVAL, 0, 2 * pos);
+                al->intervals[irn->RDEST].arrives = REG_A0 + irn->IMMVAL;
+            }
+            if (is_call(irn)) {
+                util_erealloc((void **) &al->calls,
+                                (al->num_calls + 1) * sizeof(int));
+                al->calls[al->num_calls++] = 2 * pos;
+                for (j = 0; j < al->num_args; j++) {
+                    if (al->args[j].end == NO_ARG) {
+                        al->args[j].end = 2 * pos;
+                    }
+                }
+            }
+            pos++;
+        }
+        /* a value live out of the block stays live just past its end */
+        FOR_EACH_BIT(r, lv->in[b->id]) {
+            extend_interval(&al->intervals[r], 2 * first);
+        }
+        FOR_EACH_BIT(r, lv->out[b->id]) {
+            extend_interval(&al->intervals[r], 2 * pos);
+        }
+    }
+    free_dataflow(lv);
+
+    for (r = 0; r < cfg->num_regs; r++) {
+        iv = &al->intervals[r];
+        if (iv->num_uses != 1) {
+            iv->fixed = NO_ARG;
+        }
+        for (j = 0; j < al->num_calls && al->calls[j] < iv->end; j++) {
+            if (iv->start < al->calls[j] && iv->end > al->calls[j] + 1) {
+                iv->crosses_call = TRUE;
+            }
+        }
+    }
+}
+
+void extend_interval(Interval *iv, int pos) {
+    if (iv->start == NO_ARG || pos < iv->start) {
+        iv->start = pos;
+    }
+    if (pos > iv->end) {
+        iv->end = pos;
+    }
+}
+
+int compare_starts(const void *a, const void *b) {
+    const Interval *x = *(Interval * const *) a;
+    const Interval *y = *(Interval * const *) b;
+    if (x->start != y->start) {
+        return x->start - y->start;
+    }
+    return x->reg - y->reg;
+}
+
+/*
+ * assign_register
+ * Purpose: give an interval a machine register, spilling if none is free
+ * Parameters:
+ *  al - Allocator * - the allocator, holding the intervals now active
+ *  cur - Interval * - the interval, starting at or after every active one
+ * Returns:
+ *  FALSE if an interval was spilled
+ */
+Boolean assign_register(Allocator *al, Interval *cur) {
+    Interval *victim = NULL, *iv;
+    int i, phys;
+    Boolean is_temp = cur->reg >= al->first_temp;
+
+    if (cur->fixed != NO_ARG && !cur->crosses_call &&
+            !arg_register_busy(al, cur, cur->fixed) &&
+            try_register(al, cur, cur->fixed)) {
+        return TRUE;
+    }
+    if (cur->arrives != NO_ARG && !cur->crosses_call &&
+            !arg_register_busy(al, cur, cur->arrives) &&
+            try_register(al, cur, cur->arrives)) {
+        return TRUE;
+    }
+    if (cur->hint != NO_ARG && may_hold(cur, al->intervals[cur->hint].phys) &&
+            try_register(al, cur, al->intervals[cur->hint].phys)) {
+        return TRUE;
+    }
+    for (i = 0; i < (int) (sizeof(caller_saved) / sizeof(int)); i++) {
+        if (may_hold(cur, caller_saved[i]) &&
+                try_register(al, cur, caller_saved[i])) {
+            return TRUE;
+        }
+    }
+    for (i = 0; i < NUM_SAVED_REGS; i++) {
+        if (try_register(al, cur, callee_saved[i])) {
+            return TRUE;
+        }
+    }
+
+    /* spill whichever reaches furthest; reloads themselves never spill */
+    for (phys = 0; phys < NUM_MIPS_REGS; phys++) {
+        iv = al->holder[phys];
+        if (iv == NULL || iv->reg >= al->first_temp || !may_hold(cur, phys)) {
+            continue;
+        }
+        if (victim == NULL || iv->end > victim->end) {
+            victim = iv;
+        }
+    }
+    if (victim != NULL && (is_temp || victim->end > cur->end)) {
+        cur->phys = victim->phys;
+        al->holder[cur->phys] = cur;
+        victim->phys = NO_ARG;
+        al->spilled[victim->reg] = TRUE;
+    } else if (!is_temp) {
+        al->spilled[cur->reg] = TRUE;
+    } else {
+        fprintf(stderr, "register allocation: no register for a reload\n");
+        exit(EXIT_FAILURE);
+    }
+    return FALSE;
+}
+
+/* give cur the machine register phys if no active interval holds it */
+Boolean try_register(Allocator *al, Interval *cur, int phys) {
+    if (al->holder[phys] != NULL) {
+        return FALSE;
+    }
+    cur->phys = phys;
+    al->holder[phys] = cur;
+    return TRUE;
+}
+
+/*
+ * may cur be allocated phys? only values dying before any call may use the
+ * caller-saved registers; the argument and result registers are reserved
+ * for the values passed in them
+ */
+Boolean may_hold(Interval *cur, int phys) {
+    if (phys >= REG_S0 && phys < REG_S0 + NUM_SAVED_REGS) {
+        return TRUE;
+    }
+    return !cur->crosses_call && ((phys >= REG_T0 && phys < REG_S0) ||
+                                    phys == REG_T8 || phys == REG_T8 + 1);
+}
+
+/*
+ * is the argument register phys that cur wants carrying another argument
+ * while cur is live?
+ */
+Boolean arg_register_busy(Allocator *al, Interval *cur, int phys) {
+    ArgRange *a;
+    int i;
+    for (i = 0; i < al->num_args; i++) {
+        a = &al->args[i];
+        if (a->phys == phys && a->start != cur->end &&
+                a->start <= cur->end && cur->start <= a->end) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+void add_arg_range(Allocator *al, int phys, int start, int end) {
+    util_erealloc((void **) &al->args, (al->num_args + 1) * sizeof(ArgRange));
+    al->args[al->num_args].phys = phys;
+    al->args[al->num_args].start = start;
+    al->args[al->num_args].end = end;
+    al->num_args++;
+}
+
+/* instructions that clobber the caller-saved registers */
+Boolean is_call(IrNode *irn) {
+    return instruction(irn) == CALL || instruction(irn) == SYSCALL ||
+            instruction(irn) == TAIL_CALL;
+}
+
+/*
+ * is reg read by irn after irn writes its result? The condition of a
+ * SELECT is, by the movn or movz after the move into the result, so the
+ * two need registers of their own
+ */
+Boolean reads_late(IrNode *irn, int reg) {
+    return instruction(irn) == SELECT && irn->RSRC == reg ? TRUE : FALSE;
+}
+
+/*
+ * give each spilled register a frame slot, storing it there after each
+ * definition and reloading it before each use into new registers
+ */
+void insert_spill_code(Allocator *al) {
+    ControlFlowGraph *cfg = al->cfg;
+    int *slot, *uses[MAX_USES], *def;
+    int i, j, r, n, num_regs = cfg->num_regs;
+    BasicBlock *b;
+    IrNode *irn, *spill;
+
+    util_emalloc((void **) &slot, (num_regs + 1) * sizeof(int));
+    for (r = 0; r < num_regs; r++) {
+        slot[r] = al->spilled[r] ? al->ra->num_spill_slots++ : NO_ARG;
+    }
+    for (i = 0; i < cfg->num_blocks; i++) {
+        b = cfg->blocks[i];
+        FOR_EACH_BLOCK_NODE(irn, b) {
+            n = ir_node_uses(irn, uses);
+            for (j = 0; j < n; j++) {
+                if (*uses[j] == NO_ARG || *uses[j] >= num_regs ||
+                        slot[*uses[j]] == NO_ARG) {
+                    continue;
+                }
+                spill = construct_ir_node(LOAD_WORD);
+                spill->RDEST = new_reg(cfg);
+                spill->IMMVAL = slot[*uses[j]];
+                spill->bb = b;
+                insert_ir_node_before(irn, spill, cfg->irl);
+                /* both operands may read the same register */
+                if (j == 0 && n > 1 && *uses[1] == *uses[0]) {
+                    *uses[1] = spill->RDEST;
+                }
+                *uses[j] = spill->RDEST;
+            }
+            def = ir_node_def(irn);
+            if (def == NULL || *def == NO_ARG || *def >= num_regs ||
+                    slot[*def] == NO_ARG) {
+                continue;
+            }
+            spill = construct_ir_node(STORE_WORD);
+            spill->RSRC = new_reg(cfg);
+            spill->IMMVAL = slot[*def];
+            spill->bb = b;
+            *def = spill->RSRC;
+            insert_ir_node_after(irn, spill, cfg->irl);
+            if (irn == b->last) {
+                b->last = spill;
+            }
+            irn = spill;
+        }
+    }
+    free(slot);
+}
+
+/* rewrite registers to the machine registers of their intervals */
+void assign_machine_registers(Allocator *al) {
+    ControlFlowGraph *cfg = al->cfg;
+    int *regs[MAX_USES + 1], *def;
+    int i, n;
+    IrNode *irn, *next;
+
+    for (irn = cfg->begin_proc->next; irn != cfg->end_proc; irn = next) {
+        next = irn->next;
+        n = ir_node_uses(irn, regs);
+        def = ir_node_def(irn);
+        if (def != NULL) {
+            regs[n++] = def;
+        }
+        for (i = 0; i < n; i++) {
+            if (*regs[i] == NO_ARG) {
+                continue;
+            }
+            *regs[i] = al->intervals[*regs[i]].phys;
+            if (*regs[i] >= REG_S0 && *regs[i] < REG_S0 + NUM_SAVED_REGS) {
+                al->ra->saved_used[*regs[i] - REG_S0] = TRUE;
+            }
+        }
+        switch (instruction(irn)) {
+            case MOVE:
+                if (irn->RDEST == irn->RSRC) {
+                    remove_block_node(irn, cfg);
+                    al->ra->num_coalesced++;
+                }
+                break;
+            case PARAM:
+                if (irn->RSRC == REG_A0 + irn->RDEST) {
+                    al->ra->num_coalesced++;
+                }
+                break;
+            case RETURN_FROM_PROC:
+                if (irn->RSRC == REG_V0) {
+                    al->ra->num_coalesced++;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
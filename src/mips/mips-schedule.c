@@ -0,0 +1,594 @@
+/*
+ * Instruction scheduling.
+ *
+ * The instructions between two labels or jumps are reordered by list
+ * scheduling so that an instruction does not come right after the one
+ * computing its operand when that takes more than a cycle: a load, whose
+ * value is a cycle late, or a divide or multiply into HI and LO, whose
+ * results take as long as on the R3000. Each instruction depends on those
+ * it reads the results of, those reading or writing what it writes, and
+ * the memory accesses it might overlap; each cycle the instruction issued
+ * is the one whose chain of dependent instructions takes longest to
+ * finish, among those whose operands are ready. An order estimated to take
+ * no fewer cycles than the original is not used.
+ *
+ * Then the instruction in the delay slot after each branch and jump is
+ * filled: an instruction before it that nothing between them depends on
+ * is moved into it, or a nop is put there. The assembler is told not to
+ * fill the slots itself with .set noreorder. Pseudo instructions that the
+ * assembler might expand into several, such as those naming a global, are
+ * not put in delay slots.
+ *
+ * Under .set noreorder the assembler does not keep the MIPS I hazards
+ * either, so the last pass does: a nop goes after a load whose value the
+ * next instruction reads, since that reads the register as it was, and
+ * for MIPS I, before a multiply or divide less than two instructions after
+ * the mfhi or mflo reading the results it would overwrite. Such a load,
+ * mfhi or mflo is only moved into a delay slot if the instructions at the
+ * jump's target are known not to be affected. On a processor that waits
+ * for a loaded value instead, the nop takes the cycle that waiting would.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/ir.h"
+#include "../include/ir-opt.h"
+#include "../include/mips.h"
+#include "../include/utilities.h"
+
+#define LOAD_LATENCY 2
+#define DIVIDE_LATENCY 35
+#define MULTIPLY_LATENCY 12
+#define NO_DEPENDENCE (-1)
+
+/* the instructions of a region being scheduled */
+struct Schedule {
+    MipsInstr **instrs;         /* in their original order          */
+    int n;                      /* the last is the region's jump,
+                                   if it has one                    */
+    Boolean ends_in_jump;
+    int *latency;               /* n * n, from one to another       */
+    int *priority;              /* cycles to the end of the region  */
+    int *order;                 /* indices in the order chosen      */
+};
+typedef struct Schedule Schedule;
+
+/* file helper functions */
+Boolean is_jump_instr(MipsInstr *mi);
+Boolean is_branch_instr(MipsInstr *mi);
+Boolean schedule_region(MipsList *ml, MipsInstr *first, MipsInstr *stop,
+                        int *saved);
+void compute_priorities(Schedule *sch);
+void list_schedule(Schedule *sch);
+int schedule_cycles(Schedule *sch, int *order);
+int dependence_latency(MipsInstr *a, MipsInstr *b);
+int result_latency(MipsInstr *mi);
+Boolean reads_reg(MipsInstr *mi, int reg);
+Boolean is_memory_access(MipsInstr *mi);
+Boolean may_overlap(MipsInstr *a, MipsInstr *b);
+int access_bytes(MipsInstr *mi);
+Boolean uses_hi_lo(MipsInstr *mi);
+int hi_lo_latency(MipsInstr *mi);
+MipsInstr *delay_slot_candidate(MipsInstr *jump);
+Boolean fits_delay_slot(MipsInstr *mi, MipsInstr *jump);
+Boolean hazard_at_target(MipsInstr *mi, MipsInstr *jump);
+int hazard_gap(MipsInstr *mi, MipsInstr *later);
+Boolean writes_hi_lo(MipsInstr *mi);
+MipsInstr *next_executed(MipsInstr *mi);
+MipsInstr *branch_target(MipsInstr *jump);
+
+
+/*
+ * schedule_instructions
+ * Purpose: reorder the instructions of a procedure to hide the latency of
+ *          loads and divides
+ * Parameters:
+ *  ml - MipsList * - the instructions of a procedure, without delay slots
+ * Returns:
+ *  The number of stall cycles estimated to be saved
+ * Side Effects:
+ *  Reorders instructions between labels and jumps, leaving each jump last
+ */
+int schedule_instructions(MipsList *ml) {
+    MipsInstr *mi, *next, *first = NULL;
+    int saved = 0;
+
+    for (mi = ml->head; mi != NULL; mi = next) {
+        next = mi->next;
+        if (mi->op == MIPS_LABEL) {
+            if (first != NULL) {
+                schedule_region(ml, first, mi, &saved);
+            }
+            first = NULL;
+            continue;
+        }
+        if (first == NULL) {
+            first = mi;
+        }
+        if (is_jump_instr(mi)) {
+            /* the jump stays last, so next still follows it */
+            schedule_region(ml, first, next, &saved);
+            first = NULL;
+        }
+    }
+    if (first != NULL) {
+        schedule_region(ml, first, NULL, &saved);
+    }
+    return saved;
+}
+
+/*
+ * fill_delay_slots
+ * Purpose: put an instruction in the delay slot after each branch and jump
+ * Parameters:
+ *  ml - MipsList * - the instructions of a procedure
+ * Returns:
+ *  The number of delay slots filled with an instruction moved from before
+ *  the jump, rather than a nop
+ * Side Effects:
+ *  Moves instructions and inserts nops, after which the instructions are
+ *  to be assembled with .set noreorder
+ */
+int fill_delay_slots(MipsList *ml) {
+    MipsInstr *mi, *slot;
+    int filled = 0;
+
+    for (mi = ml->head; mi != NULL; mi = mi->next) {
+        if (!is_jump_instr(mi)) {
+            continue;
+        }
+        slot = delay_slot_candidate(mi);
+        if (slot == NULL) {
+            slot = construct_mips_instr(MIPS_NOP, NO_ARG, NO_ARG, NO_ARG, 0);
+        } else {
+            unlink_mips_instr(slot, ml);
+            filled++;
+        }
+        insert_mips_instr_after(mi, slot, ml);
+        mi = slot;
+    }
+    return filled;
+}
+
+/*
+ * insert_hazard_nops
+ * Purpose: keep the MIPS I load delay, and for MIPS I the HI and LO
+ *          hazards, which the assembler does not under .set noreorder
+ * Parameters:
+ *  ml - MipsList * - the instructions of a procedure, delay slots filled
+ * Returns:
+ *  The number of nops inserted
+ * Side Effects:
+ *  Inserts nops after loads whose value the next instruction reads, and
+ *  after mfhi and mflo followed too soon by a multiply or divide
+ */
+int insert_hazard_nops(MipsList *ml) {
+    MipsInstr *mi, *later, *nop;
+    int inserted = 0, distance, gap;
+
+    for (mi = ml->head; mi != NULL; mi = mi->next) {
+        if (mi->op == MIPS_LABEL || (mi->prev != NULL &&
+                is_jump_instr(mi->prev) && !is_branch_instr(mi->prev))) {
+            /* after a jump's delay slot the target runs, checked already */
+            continue;
+        }
+        later = next_executed(mi);
+        for (distance = 0; later != NULL && distance < 2; distance++) {
+            gap = hazard_gap(mi, later) - distance;
+            if (gap > 0) {
+                for (; gap > 0; gap--) {
+                    nop = construct_mips_instr(MIPS_NOP, NO_ARG, NO_ARG,
+                                                NO_ARG, 0);
+                    insert_mips_instr_after(mi, nop, ml);
+                    inserted++;
+                }
+                break;
+            }
+            later = next_executed(later);
+        }
+    }
+    return inserted;
+}
+
+/* a branch or jump, which has a delay slot */
+Boolean is_jump_instr(MipsInstr *mi) {
+    return mi->op >= MIPS_BEQ && mi->op <= MIPS_JR ? TRUE : FALSE;
+}
+
+/* a conditional branch, which may fall through past its delay slot */
+Boolean is_branch_instr(MipsInstr *mi) {
+    return mi->op >= MIPS_BEQ && mi->op <= MIPS_BGTZ ? TRUE : FALSE;
+}
+
+/*
+ * schedule the instructions from first up to stop, relinking them in the
+ * order chosen if it is estimated to be faster and adding the cycles saved
+ * to saved; says if the order changed
+ */
+Boolean schedule_region(MipsList *ml, MipsInstr *first, MipsInstr *stop,
+                        int *saved) {
+    Schedule sch;
+    MipsInstr *mi, *prev = first->prev;
+    int i, j, lat, before, after;
+
+    sch.n = 0;
+    for (mi = first; mi != stop; mi = mi->next) {
+        sch.n++;
+    }
+    if (sch.n < 2) {
+        return FALSE;
+    }
+    util_emalloc((void **) &sch.instrs, sch.n * sizeof(MipsInstr *));
+    util_emalloc((void **) &sch.latency, sch.n * sch.n * sizeof(int));
+    util_emalloc((void **) &sch.priority, sch.n * sizeof(int));
+    util_emalloc((void **) &sch.order, sch.n * sizeof(int));
+    for (i = 0, mi = first; mi != stop; i++, mi = mi->next) {
+        sch.instrs[i] = mi;
+    }
+    sch.ends_in_jump = is_jump_instr(sch.instrs[sch.n - 1]);
+    for (i = 0; i < sch.n; i++) {
+        for (j = 0; j < sch.n; j++) {
+            lat = NO_DEPENDENCE;
+            if (i < j) {
+                lat = dependence_latency(sch.instrs[i], sch.instrs[j]);
+                if (lat == NO_DEPENDENCE && j == sch.n - 1 &&
+                        sch.ends_in_jump) {
+                    lat = 0;
+                }
+            }
+            sch.latency[i * sch.n + j] = lat;
+        }
+        sch.order[i] = i;
+    }
+    before = schedule_cycles(&sch, sch.order);
+    compute_priorities(&sch);
+    list_schedule(&sch);
+    after = schedule_cycles(&sch, sch.order);
+    if (after < before) {
+        *saved += before - after;
+        for (i = 0; i < sch.n; i++) {
+            mi = sch.instrs[sch.order[i]];
+            mi->prev = i == 0 ? prev : sch.instrs[sch.order[i - 1]];
+            mi->next = i == sch.n - 1 ? stop : sch.instrs[sch.order[i + 1]];
+        }
+        if (prev == NULL) {
+            ml->head = sch.instrs[sch.order[0]];
+        } else {
+            prev->next = sch.instrs[sch.order[0]];
+        }
+        if (stop == NULL) {
+            ml->tail = sch.instrs[sch.order[sch.n - 1]];
+        } else {
+            stop->prev = sch.instrs[sch.order[sch.n - 1]];
+        }
+    }
+    free(sch.instrs);
+    free(sch.latency);
+    free(sch.priority);
+    free(sch.order);
+    return after < before ? TRUE : FALSE;
+}
+
+/* the longest path of latencies from each instruction to the region's end */
+void compute_priorities(Schedule *sch) {
+    int i, j, lat;
+    for (i = sch->n - 1; i >= 0; i--) {
+        sch->priority[i] = result_latency(sch->instrs[i]);
+        for (j = i + 1; j < sch->n; j++) {
+            lat = sch->latency[i * sch->n + j];
+            if (lat != NO_DEPENDENCE &&
+                    lat + sch->priority[j] > sch->priority[i]) {
+                sch->priority[i] = lat + sch->priority[j];
+            }
+        }
+    }
+}
+
+/*
+ * choose an order for the instructions, one issued a cycle: of those whose
+ * predecessors have all been issued, the one with the highest priority that
+ * can issue without stalling, or else the one that can issue soonest
+ */
+void list_schedule(Schedule *sch) {
+    int *ready, *issued;
+    int i, j, k, best, cycle = 0, lat;
+
+    util_emalloc((void **) &ready, sch->n * sizeof(int));
+    util_emalloc((void **) &issued, sch->n * sizeof(int));
+    for (i = 0; i < sch->n; i++) {
+        issued[i] = NO_ARG;
+    }
+    for (k = 0; k < sch->n; k++) {
+        best = NO_ARG;
+        for (i = 0; i < sch->n; i++) {
+            if (issued[i] != NO_ARG) {
+                continue;
+            }
+            ready[i] = cycle;
+            for (j = 0; j < i; j++) {
+                lat = sch->latency[j * sch->n + i];
+                if (lat == NO_DEPENDENCE) {
+                    continue;
+                }
+                if (issued[j] == NO_ARG) {
+                    break;
+                }
+                if (issued[j] + lat > ready[i]) {
+                    ready[i] = issued[j] + lat;
+                }
+            }
+            if (j < i) {
+                continue;
+            }
+            if (best == NO_ARG || ready[i] < ready[best] ||
+                    (ready[i] == ready[best] &&
+                     sch->priority[i] > sch->priority[best])) {
+                best = i;
+            }
+        }
+        issued[best] = ready[best];
+        cycle = ready[best] + 1;
+        sch->order[k] = best;
+    }
+    free(ready);
+    free(issued);
+}
+
+/* the cycles the region is estimated to take issued in order */
+int schedule_cycles(Schedule *sch, int *order) {
+    int *issued;
+    int i, j, cycle = 0, lat;
+
+    util_emalloc((void **) &issued, sch->n * sizeof(int));
+    for (i = 0; i < sch->n; i++) {
+        for (j = 0; j < i; j++) {
+            lat = order[j] < order[i] ?
+                    sch->latency[order[j] * sch->n + order[i]] :
+                    NO_DEPENDENCE;
+            if (lat != NO_DEPENDENCE && issued[order[j]] + lat > cycle) {
+                cycle = issued[order[j]] + lat;
+            }
+        }
+        issued[order[i]] = cycle;
+        cycle++;
+    }
+    free(issued);
+    return cycle;
+}
+
+/*
+ * the cycles after a issues that b, coming after it, can issue, or
+ * NO_DEPENDENCE if they can go in either order
+ */
+int dependence_latency(MipsInstr *a, MipsInstr *b) {
+    int def_a = mips_instr_def(a), def_b = mips_instr_def(b);
+
+    if (def_a != NO_ARG && def_a != REG_ZERO && reads_reg(b, def_a)) {
+        return result_latency(a);
+    }
+    if (def_b != NO_ARG && (def_b == def_a || reads_reg(a, def_b))) {
+        return 0;
+    }
+    if (uses_hi_lo(a) && uses_hi_lo(b)) {
+        return hi_lo_latency(a);
+    }
+    /* the stack pointer is not moved past the frame's loads and stores */
+    if ((def_a == REG_SP && is_memory_access(b)) ||
+            (def_b == REG_SP && is_memory_access(a))) {
+        return 0;
+    }
+    if ((is_mips_store(a) && is_memory_access(b)) ||
+            (is_mips_store(b) && is_memory_access(a))) {
+        return may_overlap(a, b) ? 0 : NO_DEPENDENCE;
+    }
+    return NO_DEPENDENCE;
+}
+
+/* the cycles until what mi computes can be read */
+int result_latency(MipsInstr *mi) {
+    return is_mips_load(mi) ? LOAD_LATENCY : 1;
+}
+
+Boolean reads_reg(MipsInstr *mi, int reg) {
+    int uses[MAX_MIPS_USES];
+    int i, n = mips_instr_uses(mi, uses);
+    for (i = 0; i < n; i++) {
+        if (uses[i] == reg) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+Boolean is_memory_access(MipsInstr *mi) {
+    return is_mips_load(mi) || is_mips_store(mi) ? TRUE : FALSE;
+}
+
+/*
+ * could the bytes two memory accesses address be the same? They are not
+ * when they are disjoint ranges from the same register or global, or in
+ * different globals; a register may point anywhere
+ */
+Boolean may_overlap(MipsInstr *a, MipsInstr *b) {
+    if (a->s != NULL && b->s != NULL && a->s != b->s) {
+        return FALSE;
+    }
+    if (a->s == b->s && (a->s != NULL || a->rs == b->rs)) {
+        return a->imm < b->imm + access_bytes(b) &&
+                b->imm < a->imm + access_bytes(a) ? TRUE : FALSE;
+    }
+    return TRUE;
+}
+
+int access_bytes(MipsInstr *mi) {
+    switch (mi->op) {
+        case MIPS_LB:
+        case MIPS_LBU:
+        case MIPS_SB:
+            return CHAR_BYTES;
+        case MIPS_LH:
+        case MIPS_LHU:
+        case MIPS_SH:
+            return SHORT_BYTES;
+        default:
+            return INT_BYTES;
+    }
+}
+
+/* does mi write or read the HI and LO registers a divide leaves results in */
+Boolean uses_hi_lo(MipsInstr *mi) {
+    switch (mi->op) {
+        case MIPS_DIV:
+        case MIPS_DIVU:
+        case MIPS_MULT:
+        case MIPS_MULTU:
+        case MIPS_MFLO:
+        case MIPS_MFHI:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/* the cycles until HI and LO hold what mi puts there */
+int hi_lo_latency(MipsInstr *mi) {
+    switch (mi->op) {
+        case MIPS_DIV:
+        case MIPS_DIVU:
+            return DIVIDE_LATENCY;
+        case MIPS_MULT:
+        case MIPS_MULTU:
+            return MULTIPLY_LATENCY;
+        default:
+            return 0;
+    }
+}
+
+/*
+ * the last instruction before jump, and after any label or jump and its
+ * delay slot, that can be moved into jump's delay slot, NULL if there is
+ * none
+ */
+MipsInstr *delay_slot_candidate(MipsInstr *jump) {
+    MipsInstr *mi, *after;
+
+    for (mi = jump->prev; mi != NULL && mi->op != MIPS_LABEL &&
+            !is_jump_instr(mi); mi = mi->prev) {
+        if (mi->prev != NULL && is_jump_instr(mi->prev)) {
+            /* the delay slot of the jump before */
+            break;
+        }
+        if (!fits_delay_slot(mi, jump)) {
+            continue;
+        }
+        for (after = mi->next; after != jump; after = after->next) {
+            if (dependence_latency(mi, after) != NO_DEPENDENCE) {
+                break;
+            }
+        }
+        if (after == jump) {
+            return mi;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * can mi go in the delay slot of jump? It is one machine instruction and
+ * writes nothing jump reads; the return address a call writes is not
+ * touched
+ */
+Boolean fits_delay_slot(MipsInstr *mi, MipsInstr *jump) {
+    int def = mips_instr_def(mi);
+
+    switch (mi->op) {
+        case MIPS_LA:
+        case MIPS_DIV:
+        case MIPS_DIVU:
+        case MIPS_MUL:
+            return FALSE;
+        case MIPS_LI:
+            if (mi->imm < -32768 || mi->imm > 0xFFFF) {
+                return FALSE;
+            }
+            break;
+        default:
+            if (is_memory_access(mi) && mi->s != NULL) {
+                return FALSE;
+            }
+            break;
+    }
+    if (def != NO_ARG && reads_reg(jump, def)) {
+        return FALSE;
+    }
+    if (jump->op == MIPS_JAL && (def == REG_RA || reads_reg(mi, REG_RA))) {
+        return FALSE;
+    }
+    return !hazard_at_target(mi, jump);
+}
+
+/*
+ * could mi in the delay slot of jump be too close to what runs at jump's
+ * target? Where a call, a return or a jump to another procedure goes is
+ * not known here, so any mi with a hazard is
+ */
+Boolean hazard_at_target(MipsInstr *mi, MipsInstr *jump) {
+    MipsInstr *target = branch_target(jump), *later;
+
+    if (!is_mips_load(mi) &&
+            (!mips1 || (mi->op != MIPS_MFHI && mi->op != MIPS_MFLO))) {
+        return FALSE;
+    }
+    if (target == NULL) {
+        return TRUE;
+    }
+    later = next_executed(target);
+    if (later == NULL || hazard_gap(mi, later) > 0) {
+        return TRUE;
+    }
+    later = is_jump_instr(later) ? NULL : next_executed(later);
+    return later != NULL && hazard_gap(mi, later) > 1 ? TRUE : FALSE;
+}
+
+/*
+ * how many instructions must come between mi and later, which runs after
+ * it: one after a load that later reads the value of, and for MIPS I two
+ * after mfhi or mflo before a multiply or divide
+ */
+int hazard_gap(MipsInstr *mi, MipsInstr *later) {
+    int def = mips_instr_def(mi);
+
+    if (mi->op == MIPS_MFHI || mi->op == MIPS_MFLO) {
+        return mips1 && writes_hi_lo(later) ? 2 : 0;
+    }
+    return is_mips_load(mi) && def != NO_ARG && def != REG_ZERO &&
+            reads_reg(later, def) ? 1 : 0;
+}
+
+Boolean writes_hi_lo(MipsInstr *mi) {
+    return uses_hi_lo(mi) && hi_lo_latency(mi) > 0 ? TRUE : FALSE;
+}
+
+/* the instruction after mi in the list, past any labels; NULL at the end */
+MipsInstr *next_executed(MipsInstr *mi) {
+    for (mi = mi->next; mi != NULL && mi->op == MIPS_LABEL; mi = mi->next) {
+    }
+    return mi;
+}
+
+/* the label of the procedure that jump goes to, NULL if it is elsewhere */
+MipsInstr *branch_target(MipsInstr *jump) {
+    MipsInstr *mi;
+
+    if (jump->op == MIPS_JAL || jump->op == MIPS_JR || jump->s != NULL) {
+        return NULL;
+    }
+    for (mi = jump; mi->prev != NULL; mi = mi->prev) {
+    }
+    for (; mi != NULL; mi = mi->next) {
+        if (mi->op == MIPS_LABEL && mi->s == NULL && mi->label == jump->label) {
+            return mi;
+        }
+    }
+    return NULL;
+}
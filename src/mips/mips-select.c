@@ -0,0 +1,1221 @@
+/*
+ * Instruction selection.
+ *
+ * After register allocation each IR node is covered by a tree pattern from
+ * the table below and emitted as the pattern's MIPS instructions. The tree
+ * of a node is the node with, as children, the nodes of its block that
+ * compute its operands and that nothing else reads: constants, addresses,
+ * a register plus a constant, comparisons. A pattern can fold such a child
+ * into its instructions, as an immediate operand, a memory operand or the
+ * comparison of a branch, and the child is then not emitted on its own.
+ *
+ * Blocks are covered from their last node up, maximal munch: every node not
+ * yet folded into a later one takes the pattern with the lowest cost, less
+ * what the children it folds would have cost by themselves, and folds them.
+ * Each IR instruction has a pattern taking its operands from registers, so
+ * there is always a match. A constant shared by several nodes is read as
+ * an immediate by each pattern that can, and is not loaded at all when no
+ * instruction is left reading its register.
+ *
+ * Variables in the frame are addressed from $fp. Globals are addressed by
+ * name, which the assembler makes a $gp-relative access when the global is
+ * in the small data area. Calls, parameters, returns, selects and spill
+ * code leave nothing to choose and are emitted directly, as are the
+ * prologue setting up the frame and the epilogue taking it down. A return
+ * that does not fall into the epilogue gets its own copy of it when it is
+ * short, rather than a jump to it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-dataflow.h"
+#include "../include/ir-opt.h"
+#include "../include/mips.h"
+#include "../include/utilities.h"
+
+#define MAX_TEMPLATES 3
+#define MAX_FOLDS 4
+#define MAX_COPIED_EPILOGUE 4
+#define NUM_PATTERNS ((int) (sizeof(patterns) / sizeof(patterns[0])))
+
+/* what an operand of a pattern must be; constants come first */
+enum operand_shape {
+    SHAPE_NONE,
+    SHAPE_REG,                  /* any register                              */
+    SHAPE_ZERO,                 /* the constant 0, read from $0              */
+    SHAPE_SIMM,                 /* a constant fitting a signed immediate     */
+    SHAPE_UIMM,                 /* one fitting an unsigned immediate         */
+    SHAPE_NEG_SIMM,             /* one whose negation fits a signed one      */
+    SHAPE_SIMM_PLUS_1,          /* one whose successor fits a signed one     */
+    SHAPE_SHAMT,                /* a shift amount                            */
+    SHAPE_HI16,                 /* a constant whose low half is 0            */
+    SHAPE_CONST,                /* any constant                              */
+    SHAPE_FRAME,                /* the address of a variable in the frame    */
+    SHAPE_GLOBAL,               /* the address of a global                   */
+    SHAPE_ADDR,                 /* either of those, a register plus a
+                                   constant, or a register                   */
+    SHAPE_DIFF,                 /* a ^ b, 0 when a == b                      */
+    SHAPE_EQ,                   /* a == b                                    */
+    SHAPE_NE,                   /* a != b                                    */
+    SHAPE_NOT,                  /* !a                                        */
+    SHAPE_LTZ,                  /* a < 0                                     */
+    SHAPE_GTZ,                  /* a > 0                                     */
+    SHAPE_LEZ,                  /* a <= 0                                    */
+    SHAPE_GEZ                   /* a >= 0                                    */
+};
+
+/* where an instruction of a pattern takes a register from */
+enum reg_source {
+    R_NONE,
+    R_DEST,                     /* the result of the IR node                 */
+    R_A,                        /* operand A                                 */
+    R_A2,                       /* the second register compared by A         */
+    R_B,                        /* operand B                                 */
+    R_ZERO,
+    R_V1                        /* $v1 is free outside of calls              */
+};
+
+/* where it takes its immediate from */
+enum imm_source {
+    I_NONE,
+    I_A,
+    I_B,
+    I_B_PLUS_1,
+    I_B_NEG,
+    I_ONE,
+    I_HI_A,                     /* the high half of constant A               */
+    I_LO_A,                     /* its low half                              */
+    I_IMMVAL                    /* the IR node's own constant                */
+};
+
+struct MipsTemplate {
+    enum mips_opcode op;
+    enum reg_source rd;
+    enum reg_source rs;
+    enum reg_source rt;
+    enum imm_source imm;
+};
+typedef struct MipsTemplate MipsTemplate;
+
+/*
+ * a tree pattern: an IR node whose operands A and B have the given shapes,
+ * emitted as the instructions of emit. For LOAD_CONSTANT and LOAD_ADDRESS,
+ * which read no registers, A is the node's own constant or address.
+ */
+struct MipsPattern {
+    enum ir_instruction root;
+    enum operand_shape a;
+    enum operand_shape b;
+    int cost;
+    MipsTemplate emit[MAX_TEMPLATES];
+};
+typedef struct MipsPattern MipsPattern;
+
+/* an operand as matched: what the pattern's instructions read for it */
+struct MatchedOperand {
+    int reg;                    /* $fp for the frame, NO_ARG for a global    */
+    int reg2;                   /* the second register of a comparison       */
+    int imm;
+    Symbol *s;                  /* the global addressed                      */
+};
+typedef struct MatchedOperand MatchedOperand;
+
+/*
+ * a pattern matched at a node, the nodes of the block it folds and the
+ * registers whose constants it reads as immediates instead
+ */
+struct Match {
+    const MipsPattern *p;
+    MatchedOperand ops[2];
+    int folds[MAX_FOLDS];
+    int num_folds;
+    int consts[2];
+    int num_consts;
+};
+typedef struct Match Match;
+
+struct Selector {
+    ControlFlowGraph *cfg;
+    RegisterAssignment *ra;
+    FrameLayout *fl;
+    MipsList *ml;
+    Dataflow *lv;
+    BasicBlock *b;
+    IrNode **nodes;             /* of the block being covered                */
+    int num_nodes;
+    Match *matches;
+    Boolean *folded;
+    int num_folded;
+};
+typedef struct Selector Selector;
+
+static const MipsPattern patterns[] = {
+    /* constants: one instruction when a half is enough, else lui and ori */
+    { LOAD_CONSTANT, SHAPE_SIMM, SHAPE_NONE, 1,
+        { { MIPS_LI, R_DEST, R_NONE, R_NONE, I_A } } },
+    { LOAD_CONSTANT, SHAPE_UIMM, SHAPE_NONE, 1,
+        { { MIPS_ORI, R_DEST, R_ZERO, R_NONE, I_A } } },
+    { LOAD_CONSTANT, SHAPE_HI16, SHAPE_NONE, 1,
+        { { MIPS_LUI, R_DEST, R_NONE, R_NONE, I_HI_A } } },
+    { LOAD_CONSTANT, SHAPE_CONST, SHAPE_NONE, 2,
+        { { MIPS_LUI, R_DEST, R_NONE, R_NONE, I_HI_A },
+          { MIPS_ORI, R_DEST, R_DEST, R_NONE, I_LO_A } } },
+
+    /* addresses */
+    { LOAD_ADDRESS, SHAPE_FRAME, SHAPE_NONE, 1,
+        { { MIPS_ADDIU, R_DEST, R_A, R_NONE, I_A } } },
+    { LOAD_ADDRESS, SHAPE_GLOBAL, SHAPE_NONE, 1,
+        { { MIPS_LA, R_DEST, R_NONE, R_NONE, I_NONE } } },
+    { ADD_CONST, SHAPE_REG, SHAPE_NONE, 1,
+        { { MIPS_ADDIU, R_DEST, R_A, R_NONE, I_IMMVAL } } },
+
+    /* memory, at an offset from $fp, a global or a register */
+    { LOAD_BYTE_INDIRECT, SHAPE_ADDR, SHAPE_NONE, 1,
+        { { MIPS_LB, R_DEST, R_A, R_NONE, I_A } } },
+    { LOAD_UNSIGNED_BYTE_INDIRECT, SHAPE_ADDR, SHAPE_NONE, 1,
+        { { MIPS_LBU, R_DEST, R_A, R_NONE, I_A } } },
+    { LOAD_HALF_WORD_INDIRECT, SHAPE_ADDR, SHAPE_NONE, 1,
+        { { MIPS_LH, R_DEST, R_A, R_NONE, I_A } } },
+    { LOAD_UNSIGNED_HALF_WORD_INDIRECT, SHAPE_ADDR, SHAPE_NONE, 1,
+        { { MIPS_LHU, R_DEST, R_A, R_NONE, I_A } } },
+    { LOAD_WORD_INDIRECT, SHAPE_ADDR, SHAPE_NONE, 1,
+        { { MIPS_LW, R_DEST, R_A, R_NONE, I_A } } },
+    { STORE_BYTE_INDIRECT, SHAPE_ADDR, SHAPE_ZERO, 1,
+        { { MIPS_SB, R_NONE, R_A, R_B, I_A } } },
+    { STORE_BYTE_INDIRECT, SHAPE_ADDR, SHAPE_REG, 1,
+        { { MIPS_SB, R_NONE, R_A, R_B, I_A } } },
+    { STORE_HALF_WORD_INDIRECT, SHAPE_ADDR, SHAPE_ZERO, 1,
+        { { MIPS_SH, R_NONE, R_A, R_B, I_A } } },
+    { STORE_HALF_WORD_INDIRECT, SHAPE_ADDR, SHAPE_REG, 1,
+        { { MIPS_SH, R_NONE, R_A, R_B, I_A } } },
+    { STORE_WORD_INDIRECT, SHAPE_ADDR, SHAPE_ZERO, 1,
+        { { MIPS_SW, R_NONE, R_A, R_B, I_A } } },
+    { STORE_WORD_INDIRECT, SHAPE_ADDR, SHAPE_REG, 1,
+        { { MIPS_SW, R_NONE, R_A, R_B, I_A } } },
+
+    /* arithmetic */
+    { ADD, SHAPE_REG, SHAPE_SIMM, 1,
+        { { MIPS_ADDIU, R_DEST, R_A, R_NONE, I_B } } },
+    { ADD, SHAPE_SIMM, SHAPE_REG, 1,
+        { { MIPS_ADDIU, R_DEST, R_B, R_NONE, I_A } } },
+    { ADD, SHAPE_REG, SHAPE_REG, 1,
+        { { MIPS_ADDU, R_DEST, R_A, R_B, I_NONE } } },
+    { ADDU, SHAPE_REG, SHAPE_REG, 1,
+        { { MIPS_ADDU, R_DEST, R_A, R_B, I_NONE } } },
+    { SUB, SHAPE_REG, SHAPE_NEG_SIMM, 1,
+        { { MIPS_ADDIU, R_DEST, R_A, R_NONE, I_B_NEG } } },
+    { SUB, SHAPE_ZERO, SHAPE_REG, 1,
+        { { MIPS_SUBU, R_DEST, R_A, R_B, I_NONE } } },
+    { SUB, SHAPE_REG, SHAPE_REG, 1,
+        { { MIPS_SUBU, R_DEST, R_A, R_B, I_NONE } } },
+    { SUBU, SHAPE_REG, SHAPE_REG, 1,
+        { { MIPS_SUBU, R_DEST, R_A, R_B, I_NONE } } },
+    { MULT, SHAPE_REG, SHAPE_REG, 1,
+        { { MIPS_MUL, R_DEST, R_A, R_B, I_NONE } } },
+    { MULT, SHAPE_REG, SHAPE_REG, 2,
+        { { MIPS_MULT, R_NONE, R_A, R_B, I_NONE },
+          { MIPS_MFLO, R_DEST, R_NONE, R_NONE, I_NONE } } },
+    { DIV, SHAPE_REG, SHAPE_REG, 2,
+        { { MIPS_DIV, R_NONE, R_A, R_B, I_NONE },
+          { MIPS_MFLO, R_DEST, R_NONE, R_NONE, I_NONE } } },
+    { REM, SHAPE_REG, SHAPE_REG, 2,
+        { { MIPS_DIV, R_NONE, R_A, R_B, I_NONE },
+          { MIPS_MFHI, R_DEST, R_NONE, R_NONE, I_NONE } } },
+    { DIVU, SHAPE_REG, SHAPE_REG, 2,
+        { { MIPS_DIVU, R_NONE, R_A, R_B, I_NONE },
+          { MIPS_MFLO, R_DEST, R_NONE, R_NONE, I_NONE } } },
+    { REMU, SHAPE_REG, SHAPE_REG, 2,
+        { { MIPS_DIVU, R_NONE, R_A, R_B, I_NONE },
+          { MIPS_MFHI, R_DEST, R_NONE, R_NONE, I_NONE } } },
+    { MULT_HIGH, SHAPE_REG, SHAPE_REG, 2,
+        { { MIPS_MULT, R_NONE, R_A, R_B, I_NONE },
+          { MIPS_MFHI, R_DEST, R_NONE, R_NONE, I_NONE } } },
+    { MULT_HIGH_UNSIGNED, SHAPE_REG, SHAPE_REG, 2,
+        { { MIPS_MULTU, R_NONE, R_A, R_B, I_NONE },
+          { MIPS_MFHI, R_DEST, R_NONE, R_NONE, I_NONE } } },
+    { NEGATE, SHAPE_REG, SHAPE_NONE, 1,
+        { { MIPS_SUBU, R_DEST, R_ZERO, R_A, I_NONE } } },
+    { MOVE, SHAPE_REG, SHAPE_NONE, 1,
+        { { MIPS_MOVE, R_DEST, R_A, R_NONE, I_NONE } } },
+
+    /* bitwise operations and shifts */
+    { BIT_AND, SHAPE_REG, SHAPE_UIMM, 1,
+        { { MIPS_ANDI, R_DEST, R_A, R_NONE, I_B } } },
+    { BIT_AND, SHAPE_UIMM, SHAPE_REG, 1,
+        { { MIPS_ANDI, R_DEST, R_B, R_NONE, I_A } } },
+    { BIT_AND, SHAPE_REG, SHAPE_REG, 1,
+        { { MIPS_AND, R_DEST, R_A, R_B, I_NONE } } },
+    { BIT_OR, SHAPE_REG, SHAPE_UIMM, 1,
+        { { MIPS_ORI, R_DEST, R_A, R_NONE, I_B } } },
+    { BIT_OR, SHAPE_UIMM, SHAPE_REG, 1,
+        { { MIPS_ORI, R_DEST, R_B, R_NONE, I_A } } },
+    { BIT_OR, SHAPE_REG, SHAPE_REG, 1,
+        { { MIPS_OR, R_DEST, R_A, R_B, I_NONE } } },
+    { BIT_XOR, SHAPE_REG, SHAPE_UIMM, 1,
+        { { MIPS_XORI, R_DEST, R_A, R_NONE, I_B } } },
+    { BIT_XOR, SHAPE_UIMM, SHAPE_REG, 1,
+        { { MIPS_XORI, R_DEST, R_B, R_NONE, I_A } } },
+    { BIT_XOR, SHAPE_REG, SHAPE_REG, 1,
+        { { MIPS_XOR, R_DEST, R_A, R_B, I_NONE } } },
+    { BIT_NOT, SHAPE_REG, SHAPE_NONE, 1,
+        { { MIPS_NOR, R_DEST, R_A, R_ZERO, I_NONE } } },
+    { SHIFT_LEFT, SHAPE_REG, SHAPE_SHAMT, 1,
+        { { MIPS_SLL, R_DEST, R_A, R_NONE, I_B } } },
+    { SHIFT_LEFT, SHAPE_REG, SHAPE_REG, 1,
+        { { MIPS_SLLV, R_DEST, R_A, R_B, I_NONE } } },
+    { SHIFT_RIGHT, SHAPE_REG, SHAPE_SHAMT, 1,
+        { { MIPS_SRA, R_DEST, R_A, R_NONE, I_B } } },
+    { SHIFT_RIGHT, SHAPE_REG, SHAPE_REG, 1,
+        { { MIPS_SRAV, R_DEST, R_A, R_B, I_NONE } } },
+    { SHIFT_RIGHT_LOGICAL, SHAPE_REG, SHAPE_SHAMT, 1,
+        { { MIPS_SRL, R_DEST, R_A, R_NONE, I_B } } },
+    { SHIFT_RIGHT_LOGICAL, SHAPE_REG, SHAPE_REG, 1,
+        { { MIPS_SRLV, R_DEST, R_A, R_B, I_NONE } } },
+
+    /* comparisons and logical operations, giving 0 or 1 */
+    { SET_LT, SHAPE_REG, SHAPE_SIMM, 1,
+        { { MIPS_SLTI, R_DEST, R_A, R_NONE, I_B } } },
+    { SET_LT, SHAPE_REG, SHAPE_REG, 1,
+        { { MIPS_SLT, R_DEST, R_A, R_B, I_NONE } } },
+    { SET_LE, SHAPE_REG, SHAPE_SIMM_PLUS_1, 1,
+        { { MIPS_SLTI, R_DEST, R_A, R_NONE, I_B_PLUS_1 } } },
+    { SET_LE, SHAPE_REG, SHAPE_REG, 2,
+        { { MIPS_SLT, R_DEST, R_B, R_A, I_NONE },
+          { MIPS_XORI, R_DEST, R_DEST, R_NONE, I_ONE } } },
+    { SET_GT, SHAPE_REG, SHAPE_SIMM_PLUS_1, 2,
+        { { MIPS_SLTI, R_DEST, R_A, R_NONE, I_B_PLUS_1 },
+          { MIPS_XORI, R_DEST, R_DEST, R_NONE, I_ONE } } },
+    { SET_GT, SHAPE_REG, SHAPE_REG, 1,
+        { { MIPS_SLT, R_DEST, R_B, R_A, I_NONE } } },
+    { SET_GE, SHAPE_REG, SHAPE_SIMM, 2,
+        { { MIPS_SLTI, R_DEST, R_A, R_NONE, I_B },
+          { MIPS_XORI, R_DEST, R_DEST, R_NONE, I_ONE } } },
+    { SET_GE, SHAPE_REG, SHAPE_REG, 2,
+        { { MIPS_SLT, R_DEST, R_A, R_B, I_NONE },
+          { MIPS_XORI, R_DEST, R_DEST, R_NONE, I_ONE } } },
+    /* sltiu compares with its sign-extended immediate, so b + 1 of a <= b
+     * could wrap to 0; those two keep b in a register */
+    { SET_LTU, SHAPE_REG, SHAPE_SIMM, 1,
+        { { MIPS_SLTIU, R_DEST, R_A, R_NONE, I_B } } },
+    { SET_LTU, SHAPE_REG, SHAPE_REG, 1,
+        { { MIPS_SLTU, R_DEST, R_A, R_B, I_NONE } } },
+    { SET_LEU, SHAPE_REG, SHAPE_REG, 2,
+        { { MIPS_SLTU, R_DEST, R_B, R_A, I_NONE },
+          { MIPS_XORI, R_DEST, R_DEST, R_NONE, I_ONE } } },
+    { SET_GTU, SHAPE_REG, SHAPE_REG, 1,
+        { { MIPS_SLTU, R_DEST, R_B, R_A, I_NONE } } },
+    { SET_GEU, SHAPE_REG, SHAPE_SIMM, 2,
+        { { MIPS_SLTIU, R_DEST, R_A, R_NONE, I_B },
+          { MIPS_XORI, R_DEST, R_DEST, R_NONE, I_ONE } } },
+    { SET_GEU, SHAPE_REG, SHAPE_REG, 2,
+        { { MIPS_SLTU, R_DEST, R_A, R_B, I_NONE },
+          { MIPS_XORI, R_DEST, R_DEST, R_NONE, I_ONE } } },
+    { SET_EQ, SHAPE_REG, SHAPE_ZERO, 1,
+        { { MIPS_SLTIU, R_DEST, R_A, R_NONE, I_ONE } } },
+    { SET_EQ, SHAPE_ZERO, SHAPE_REG, 1,
+        { { MIPS_SLTIU, R_DEST, R_B, R_NONE, I_ONE } } },
+    { SET_EQ, SHAPE_REG, SHAPE_UIMM, 2,
+        { { MIPS_XORI, R_DEST, R_A, R_NONE, I_B },
+          { MIPS_SLTIU, R_DEST, R_DEST, R_NONE, I_ONE } } },
+    { SET_EQ, SHAPE_REG, SHAPE_REG, 2,
+        { { MIPS_XOR, R_DEST, R_A, R_B, I_NONE },
+          { MIPS_SLTIU, R_DEST, R_DEST, R_NONE, I_ONE } } },
+    { SET_NE, SHAPE_REG, SHAPE_ZERO, 1,
+        { { MIPS_SLTU, R_DEST, R_ZERO, R_A, I_NONE } } },
+    { SET_NE, SHAPE_ZERO, SHAPE_REG, 1,
+        { { MIPS_SLTU, R_DEST, R_ZERO, R_B, I_NONE } } },
+    { SET_NE, SHAPE_REG, SHAPE_UIMM, 2,
+        { { MIPS_XORI, R_DEST, R_A, R_NONE, I_B },
+          { MIPS_SLTU, R_DEST, R_ZERO, R_DEST, I_NONE } } },
+    { SET_NE, SHAPE_REG, SHAPE_REG, 2,
+        { { MIPS_XOR, R_DEST, R_A, R_B, I_NONE },
+          { MIPS_SLTU, R_DEST, R_ZERO, R_DEST, I_NONE } } },
+    { LOG_NOT, SHAPE_REG, SHAPE_NONE, 1,
+        { { MIPS_SLTIU, R_DEST, R_A, R_NONE, I_ONE } } },
+    { LOG_OR, SHAPE_REG, SHAPE_REG, 2,
+        { { MIPS_OR, R_DEST, R_A, R_B, I_NONE },
+          { MIPS_SLTU, R_DEST, R_ZERO, R_DEST, I_NONE } } },
+    { LOG_AND, SHAPE_REG, SHAPE_REG, 3,
+        { { MIPS_SLTU, R_V1, R_ZERO, R_A, I_NONE },
+          { MIPS_SLTU, R_DEST, R_ZERO, R_B, I_NONE },
+          { MIPS_AND, R_DEST, R_DEST, R_V1, I_NONE } } },
+
+    /* branches, comparing in the branch where they can */
+    { JUMP_EQZ, SHAPE_DIFF, SHAPE_NONE, 1,
+        { { MIPS_BEQ, R_NONE, R_A, R_A2, I_NONE } } },
+    { JUMP_EQZ, SHAPE_EQ, SHAPE_NONE, 1,
+        { { MIPS_BNE, R_NONE, R_A, R_A2, I_NONE } } },
+    { JUMP_EQZ, SHAPE_NE, SHAPE_NONE, 1,
+        { { MIPS_BEQ, R_NONE, R_A, R_A2, I_NONE } } },
+    { JUMP_EQZ, SHAPE_NOT, SHAPE_NONE, 1,
+        { { MIPS_BNEZ, R_NONE, R_A, R_NONE, I_NONE } } },
+    { JUMP_EQZ, SHAPE_LTZ, SHAPE_NONE, 1,
+        { { MIPS_BGEZ, R_NONE, R_A, R_NONE, I_NONE } } },
+    { JUMP_EQZ, SHAPE_GTZ, SHAPE_NONE, 1,
+        { { MIPS_BLEZ, R_NONE, R_A, R_NONE, I_NONE } } },
+    { JUMP_EQZ, SHAPE_LEZ, SHAPE_NONE, 1,
+        { { MIPS_BGTZ, R_NONE, R_A, R_NONE, I_NONE } } },
+    { JUMP_EQZ, SHAPE_GEZ, SHAPE_NONE, 1,
+        { { MIPS_BLTZ, R_NONE, R_A, R_NONE, I_NONE } } },
+    { JUMP_EQZ, SHAPE_REG, SHAPE_NONE, 1,
+        { { MIPS_BEQZ, R_NONE, R_A, R_NONE, I_NONE } } },
+    { JUMP_NEZ, SHAPE_DIFF, SHAPE_NONE, 1,
+        { { MIPS_BNE, R_NONE, R_A, R_A2, I_NONE } } },
+    { JUMP_NEZ, SHAPE_EQ, SHAPE_NONE, 1,
+        { { MIPS_BEQ, R_NONE, R_A, R_A2, I_NONE } } },
+    { JUMP_NEZ, SHAPE_NE, SHAPE_NONE, 1,
+        { { MIPS_BNE, R_NONE, R_A, R_A2, I_NONE } } },
+    { JUMP_NEZ, SHAPE_NOT, SHAPE_NONE, 1,
+        { { MIPS_BEQZ, R_NONE, R_A, R_NONE, I_NONE } } },
+    { JUMP_NEZ, SHAPE_LTZ, SHAPE_NONE, 1,
+        { { MIPS_BLTZ, R_NONE, R_A, R_NONE, I_NONE } } },
+    { JUMP_NEZ, SHAPE_GTZ, SHAPE_NONE, 1,
+        { { MIPS_BGTZ, R_NONE, R_A, R_NONE, I_NONE } } },
+    { JUMP_NEZ, SHAPE_LEZ, SHAPE_NONE, 1,
+        { { MIPS_BLEZ, R_NONE, R_A, R_NONE, I_NONE } } },
+    { JUMP_NEZ, SHAPE_GEZ, SHAPE_NONE, 1,
+        { { MIPS_BGEZ, R_NONE, R_A, R_NONE, I_NONE } } },
+    { JUMP_NEZ, SHAPE_REG, SHAPE_NONE, 1,
+        { { MIPS_BNEZ, R_NONE, R_A, R_NONE, I_NONE } } },
+    { JUMP_LEZ, SHAPE_REG, SHAPE_NONE, 1,
+        { { MIPS_BLEZ, R_NONE, R_A, R_NONE, I_NONE } } },
+    { JUMP_GEZ, SHAPE_REG, SHAPE_NONE, 1,
+        { { MIPS_BGEZ, R_NONE, R_A, R_NONE, I_NONE } } }
+};
+
+/* file helper functions */
+void select_block(Selector *sel, BasicBlock *b);
+void drop_unread_constants(Selector *sel);
+Boolean reads_as_immediate(Selector *sel, int k, int reg);
+Boolean best_match(Selector *sel, int i, Match *best);
+int standalone_cost(Selector *sel, int j);
+Boolean match_pattern(Selector *sel, int i, const MipsPattern *p, Match *m);
+Boolean match_operand(Selector *sel, int i, int reg,
+                        enum operand_shape shape, MatchedOperand *op,
+                        Match *m);
+Boolean match_leaf(Selector *sel, IrNode *irn, enum operand_shape shape,
+                    MatchedOperand *op);
+Boolean match_address(Selector *sel, IrNode *irn, enum operand_shape shape,
+                        MatchedOperand *op);
+Boolean constant_fits(enum operand_shape shape, int value);
+enum ir_instruction zero_comparison(enum operand_shape shape);
+Boolean known_zero(Selector *sel, int j, int reg, Match *m);
+int foldable_def(Selector *sel, int i, int reg);
+int block_def(Selector *sel, int i, int reg);
+Boolean is_foldable(IrNode *irn);
+Boolean is_call_part(IrNode *irn);
+Boolean live_after(Selector *sel, int i, int reg);
+int count_reads(IrNode *irn, int reg);
+int *pattern_operand(IrNode *irn, int k);
+void add_fold(Match *m, int j);
+void emit_match(Selector *sel, IrNode *irn, Match *m);
+int template_reg(IrNode *irn, Match *m, enum reg_source src);
+int template_imm(IrNode *irn, Match *m, enum imm_source src);
+void emit_special(Selector *sel, IrNode *irn);
+void emit_select(Selector *sel, IrNode *irn);
+Boolean falls_into_epilogue(IrNode *irn);
+int epilogue_length(Selector *sel);
+void emit_prologue(Selector *sel);
+void emit_epilogue(Selector *sel);
+MipsInstr *emit_instr(Selector *sel, enum mips_opcode op, int rd, int rs,
+                        int rt, int imm);
+
+
+/*
+ * select_instructions
+ * Purpose: choose the MIPS instructions of a procedure
+ * Parameters:
+ *  cfg - ControlFlowGraph * - a procedure after register allocation
+ *  ra - RegisterAssignment * - the registers the procedure saves
+ *  fl - FrameLayout * - its stack frame
+ *  ml - MipsList * - the list to append the instructions to
+ * Returns:
+ *  The number of IR nodes folded into the instructions of other nodes
+ * Side Effects:
+ *  Appends the procedure's label, prologue, instructions and epilogue to
+ *  ml. The IR is left as it is.
+ */
+int select_instructions(ControlFlowGraph *cfg, RegisterAssignment *ra,
+                        FrameLayout *fl, MipsList *ml) {
+    Selector sel;
+    IrNode *irn;
+    MipsInstr *mi;
+    int i, num_nodes = 0;
+
+    for (irn = cfg->begin_proc; irn != cfg->end_proc; irn = irn->next) {
+        num_nodes++;
+    }
+    sel.cfg = cfg;
+    sel.ra = ra;
+    sel.fl = fl;
+    sel.ml = ml;
+    sel.lv = compute_liveness(cfg);
+    sel.num_folded = 0;
+    util_emalloc((void **) &sel.nodes, num_nodes * sizeof(IrNode *));
+    util_emalloc((void **) &sel.matches, num_nodes * sizeof(Match));
+    util_emalloc((void **) &sel.folded, num_nodes * sizeof(Boolean));
+
+    mi = emit_instr(&sel, MIPS_LABEL, NO_ARG, NO_ARG, NO_ARG, 0);
+    mi->s = cfg->begin_proc->s;
+    emit_prologue(&sel);
+    for (i = 0; i < cfg->num_blocks; i++) {
+        select_block(&sel, cfg->blocks[i]);
+    }
+    emit_epilogue(&sel);
+    emit_instr(&sel, MIPS_JR, NO_ARG, REG_RA, NO_ARG, 0);
+
+    free(sel.nodes);
+    free(sel.matches);
+    free(sel.folded);
+    free_dataflow(sel.lv);
+    return sel.num_folded;
+}
+
+/*
+ * cover the nodes of a block from the last up, then emit the patterns of
+ * those not folded in order
+ */
+void select_block(Selector *sel, BasicBlock *b) {
+    IrNode *irn;
+    Match *m;
+    int i, f;
+
+    sel->b = b;
+    sel->num_nodes = 0;
+    FOR_EACH_BLOCK_NODE(irn, b) {
+        sel->folded[sel->num_nodes] = FALSE;
+        sel->nodes[sel->num_nodes++] = irn;
+    }
+    for (i = sel->num_nodes - 1; i >= 0; i--) {
+        m = &sel->matches[i];
+        m->p = NULL;
+        if (sel->folded[i] || !best_match(sel, i, m)) {
+            continue;
+        }
+        for (f = 0; f < m->num_folds; f++) {
+            sel->folded[m->folds[f]] = TRUE;
+            sel->num_folded++;
+        }
+    }
+    drop_unread_constants(sel);
+    for (i = 0; i < sel->num_nodes; i++) {
+        if (sel->folded[i]) {
+            continue;
+        }
+        if (sel->matches[i].p != NULL) {
+            emit_match(sel, sel->nodes[i], &sel->matches[i]);
+        } else {
+            emit_special(sel, sel->nodes[i]);
+        }
+    }
+}
+
+/*
+ * fold the constants every reader of which takes as an immediate, unless
+ * the constant is live out of the block
+ */
+void drop_unread_constants(Selector *sel) {
+    IrNode *irn;
+    int j, k, *def;
+    Boolean read;
+
+    for (j = 0; j < sel->num_nodes; j++) {
+        irn = sel->nodes[j];
+        if (sel->folded[j] || instruction(irn) != LOAD_CONSTANT) {
+            continue;
+        }
+        read = FALSE;
+        for (k = j + 1; k < sel->num_nodes && !read; k++) {
+            if (count_reads(sel->nodes[k], irn->RDEST) > 0 &&
+                    !reads_as_immediate(sel, k, irn->RDEST)) {
+                read = TRUE;
+            }
+            def = ir_node_def(sel->nodes[k]);
+            if (def != NULL && *def == irn->RDEST) {
+                break;
+            }
+        }
+        if (!read && (k < sel->num_nodes ||
+                    !bitset_contains(sel->lv->out[sel->b->id], irn->RDEST))) {
+            sel->folded[j] = TRUE;
+            sel->num_folded++;
+        }
+    }
+}
+
+/* does the pattern covering node k read reg only as immediates? */
+Boolean reads_as_immediate(Selector *sel, int k, int reg) {
+    Match *m = &sel->matches[k];
+    int c, n = 0;
+
+    if (sel->folded[k] || m->p == NULL) {
+        return FALSE;
+    }
+    for (c = 0; c < m->num_consts; c++) {
+        if (m->consts[c] == reg) {
+            n++;
+        }
+    }
+    return n == count_reads(sel->nodes[k], reg) ? TRUE : FALSE;
+}
+
+/*
+ * the cheapest pattern matching node i, counting each child it folds as
+ * saving what the child costs by itself. FALSE if no pattern has the node's
+ * instruction at its root.
+ */
+Boolean best_match(Selector *sel, int i, Match *best) {
+    Match m;
+    int k, f, net, best_net = 0;
+
+    best->p = NULL;
+    for (k = 0; k < NUM_PATTERNS; k++) {
+        if ((int) patterns[k].root != instruction(sel->nodes[i]) ||
+                !match_pattern(sel, i, &patterns[k], &m)) {
+            continue;
+        }
+        net = patterns[k].cost;
+        for (f = 0; f < m.num_folds; f++) {
+            net -= standalone_cost(sel, m.folds[f]);
+        }
+        if (best->p == NULL || net < best_net) {
+            *best = m;
+            best_net = net;
+        }
+    }
+    return best->p != NULL;
+}
+
+/* what node j costs emitted by itself, folding nothing */
+int standalone_cost(Selector *sel, int j) {
+    const MipsPattern *p;
+    Match m;
+    int k, cost = NO_ARG;
+
+    for (k = 0; k < NUM_PATTERNS; k++) {
+        p = &patterns[k];
+        if ((int) p->root != instruction(sel->nodes[j])) {
+            continue;
+        }
+        if (pattern_operand(sel->nodes[j], 0) != NULL &&
+                (p->a > SHAPE_REG || p->b > SHAPE_REG)) {
+            continue;
+        }
+        if (match_pattern(sel, j, p, &m) && (cost == NO_ARG || p->cost < cost)) {
+            cost = p->cost;
+        }
+    }
+    return cost == NO_ARG ? 1 : cost;
+}
+
+/* does p match node i? m gets the operands and the nodes p would fold */
+Boolean match_pattern(Selector *sel, int i, const MipsPattern *p, Match *m) {
+    IrNode *irn = sel->nodes[i];
+    enum operand_shape shape;
+    int *field, k;
+
+    m->p = p;
+    m->num_folds = 0;
+    m->num_consts = 0;
+    if (mips1 && p->emit[0].op == MIPS_MUL) {
+        /* mul is MIPS32 */
+        return FALSE;
+    }
+    if (pattern_operand(irn, 0) == NULL) {
+        return match_leaf(sel, irn, p->a, &m->ops[0]);
+    }
+    for (k = 0; k < 2; k++) {
+        shape = k == 0 ? p->a : p->b;
+        field = pattern_operand(irn, k);
+        if (shape == SHAPE_NONE) {
+            continue;
+        }
+        if (field == NULL ||
+                !match_operand(sel, i, *field, shape, &m->ops[k], m)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * does the value of reg, read by node i, have the given shape? A constant
+ * need only be loaded earlier in the block; other shapes need the node
+ * computing reg to be foldable into node i.
+ */
+Boolean match_operand(Selector *sel, int i, int reg,
+                        enum operand_shape shape, MatchedOperand *op,
+                        Match *m) {
+    MatchedOperand base;
+    IrNode *def;
+    int j, k;
+
+    op->reg = reg;
+    op->reg2 = NO_ARG;
+    op->imm = 0;
+    op->s = NULL;
+    if (shape == SHAPE_REG) {
+        return TRUE;
+    }
+    j = foldable_def(sel, i, reg);
+    if (shape <= SHAPE_SHAMT) {
+        /* the constant is still loaded unless nothing else reads it */
+        k = block_def(sel, i, reg);
+        if (k == NO_ARG || instruction(sel->nodes[k]) != LOAD_CONSTANT ||
+                !constant_fits(shape, sel->nodes[k]->IMMVAL)) {
+            return FALSE;
+        }
+        op->reg = shape == SHAPE_ZERO ? REG_ZERO : NO_ARG;
+        op->imm = sel->nodes[k]->IMMVAL;
+        m->consts[m->num_consts++] = reg;
+        if (j == k) {
+            add_fold(m, j);
+        }
+        return TRUE;
+    }
+    if (j == NO_ARG) {
+        /* a memory operand can always be 0(reg) */
+        return shape == SHAPE_ADDR ? TRUE : FALSE;
+    }
+    def = sel->nodes[j];
+    switch (shape) {
+        case SHAPE_ADDR:
+            if (match_address(sel, def, SHAPE_FRAME, op) ||
+                    match_address(sel, def, SHAPE_GLOBAL, op)) {
+                break;
+            }
+            if (instruction(def) != ADD_CONST ||
+                    !constant_fits(SHAPE_SIMM, def->IMMVAL)) {
+                /* not folded */
+                return TRUE;
+            }
+            op->reg = def->RSRC;
+            op->imm = def->IMMVAL;
+            k = foldable_def(sel, j, def->RSRC);
+            if (k != NO_ARG &&
+                    (match_address(sel, sel->nodes[k], SHAPE_FRAME, &base) ||
+                    match_address(sel, sel->nodes[k], SHAPE_GLOBAL, &base)) &&
+                    constant_fits(SHAPE_SIMM, base.imm + op->imm)) {
+                op->reg = base.reg;
+                op->imm += base.imm;
+                op->s = base.s;
+                add_fold(m, k);
+            }
+            break;
+        case SHAPE_DIFF:
+        case SHAPE_EQ:
+        case SHAPE_NE:
+            if (instruction(def) != (shape == SHAPE_DIFF ? BIT_XOR :
+                                    shape == SHAPE_EQ ? SET_EQ : SET_NE)) {
+                return FALSE;
+            }
+            op->reg = def->OPRND1;
+            op->reg2 = def->OPRND2;
+            break;
+        case SHAPE_NOT:
+            if (instruction(def) != LOG_NOT) {
+                return FALSE;
+            }
+            op->reg = def->RSRC;
+            break;
+        case SHAPE_LTZ:
+        case SHAPE_GTZ:
+        case SHAPE_LEZ:
+        case SHAPE_GEZ:
+            if (instruction(def) != (int) zero_comparison(shape) ||
+                    !known_zero(sel, j, def->OPRND2, m)) {
+                return FALSE;
+            }
+            op->reg = def->OPRND1;
+            break;
+        default:
+            return FALSE;
+    }
+    add_fold(m, j);
+    return TRUE;
+}
+
+/* does the constant or address a node computes have the given shape? */
+Boolean match_leaf(Selector *sel, IrNode *irn, enum operand_shape shape,
+                    MatchedOperand *op) {
+    op->reg = NO_ARG;
+    op->reg2 = NO_ARG;
+    op->imm = 0;
+    op->s = NULL;
+    if (instruction(irn) == LOAD_CONSTANT) {
+        op->imm = irn->IMMVAL;
+        return constant_fits(shape, irn->IMMVAL);
+    }
+    return match_address(sel, irn, shape, op);
+}
+
+/* is irn the LOAD_ADDRESS of a variable in the frame, or of a global? */
+Boolean match_address(Selector *sel, IrNode *irn, enum operand_shape shape,
+                        MatchedOperand *op) {
+    int offset;
+
+    if (instruction(irn) != LOAD_ADDRESS) {
+        return FALSE;
+    }
+    op->reg2 = NO_ARG;
+    if (local_offset(sel->fl, irn->s, &offset)) {
+        op->reg = REG_FP;
+        op->imm = offset;
+        op->s = NULL;
+        return shape == SHAPE_FRAME ? TRUE : FALSE;
+    }
+    op->reg = NO_ARG;
+    op->imm = 0;
+    op->s = irn->s;
+    return shape == SHAPE_GLOBAL ? TRUE : FALSE;
+}
+
+Boolean constant_fits(enum operand_shape shape, int value) {
+    switch (shape) {
+        case SHAPE_ZERO:
+            return value == 0 ? TRUE : FALSE;
+        case SHAPE_SIMM:
+            return value >= -32768 && value <= 32767 ? TRUE : FALSE;
+        case SHAPE_UIMM:
+            return value >= 0 && value <= 65535 ? TRUE : FALSE;
+        case SHAPE_NEG_SIMM:
+            return value >= -32767 && value <= 32768 ? TRUE : FALSE;
+        case SHAPE_SIMM_PLUS_1:
+            return value >= -32769 && value <= 32766 ? TRUE : FALSE;
+        case SHAPE_SHAMT:
+            return value >= 0 && value <= 31 ? TRUE : FALSE;
+        case SHAPE_HI16:
+            return (value & 0xffff) == 0 ? TRUE : FALSE;
+        case SHAPE_CONST:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/* the comparison a shape comparing with zero stands for */
+enum ir_instruction zero_comparison(enum operand_shape shape) {
+    switch (shape) {
+        case SHAPE_LTZ:
+            return SET_LT;
+        case SHAPE_GTZ:
+            return SET_GT;
+        case SHAPE_LEZ:
+            return SET_LE;
+        case SHAPE_GEZ:
+            return SET_GE;
+        default:
+            return NO_IR_INSTRUCTION;
+    }
+}
+
+/*
+ * is reg 0 where node j reads it? The constant is folded along with node j
+ * if nothing else reads it.
+ */
+Boolean known_zero(Selector *sel, int j, int reg, Match *m) {
+    int k;
+
+    if (reg == REG_ZERO) {
+        return TRUE;
+    }
+    k = block_def(sel, j, reg);
+    if (k == NO_ARG || instruction(sel->nodes[k]) != LOAD_CONSTANT ||
+            sel->nodes[k]->IMMVAL != 0) {
+        return FALSE;
+    }
+    if (foldable_def(sel, j, reg) == k) {
+        add_fold(m, k);
+    }
+    return TRUE;
+}
+
+/*
+ * the node of the block computing reg for node i, if it can be folded into
+ * node i: node i is the only one to read the value, and nothing between
+ * the two changes what the node reads. NO_ARG otherwise.
+ */
+int foldable_def(Selector *sel, int i, int reg) {
+    IrNode *def = NULL;
+    int *uses[MAX_USES], *d;
+    int j, k, u, n;
+
+    if (reg == NO_ARG || reg == REG_ZERO ||
+            count_reads(sel->nodes[i], reg) != 1 || live_after(sel, i, reg)) {
+        return NO_ARG;
+    }
+    for (j = i - 1; j >= 0; j--) {
+        def = sel->nodes[j];
+        d = ir_node_def(def);
+        if (d != NULL && *d == reg) {
+            break;
+        }
+        if (count_reads(def, reg) > 0 || is_call_part(def)) {
+            return NO_ARG;
+        }
+    }
+    if (j < 0 || sel->folded[j] || !is_foldable(def)) {
+        return NO_ARG;
+    }
+    n = ir_node_uses(def, uses);
+    for (k = j + 1; k < i; k++) {
+        d = ir_node_def(sel->nodes[k]);
+        for (u = 0; u < n && d != NULL; u++) {
+            if (*d == *uses[u]) {
+                return NO_ARG;
+            }
+        }
+    }
+    return j;
+}
+
+/* the last node of the block before node i to write reg, NO_ARG if none */
+int block_def(Selector *sel, int i, int reg) {
+    int *def, j;
+    for (j = i - 1; j >= 0; j--) {
+        def = ir_node_def(sel->nodes[j]);
+        if (def != NULL && *def == reg) {
+            return j;
+        }
+    }
+    return NO_ARG;
+}
+
+/* instructions some pattern can fold into another */
+Boolean is_foldable(IrNode *irn) {
+    switch (instruction(irn)) {
+        case LOAD_CONSTANT:
+        case LOAD_ADDRESS:
+        case ADD_CONST:
+        case BIT_XOR:
+        case SET_LT:
+        case SET_LE:
+        case SET_GT:
+        case SET_GE:
+        case SET_EQ:
+        case SET_NE:
+        case LOG_NOT:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/* a call changes registers its IR does not name, so nothing folds across */
+Boolean is_call_part(IrNode *irn) {
+    switch (instruction(irn)) {
+        case BEGIN_CALL:
+        case PARAM:
+        case CALL:
+        case END_CALL:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/* is the value reg holds when node i reads it needed after node i? */
+Boolean live_after(Selector *sel, int i, int reg) {
+    int *def = ir_node_def(sel->nodes[i]);
+    int k;
+
+    if (def != NULL && *def == reg) {
+        return FALSE;
+    }
+    for (k = i + 1; k < sel->num_nodes; k++) {
+        if (count_reads(sel->nodes[k], reg) > 0) {
+            return TRUE;
+        }
+        def = ir_node_def(sel->nodes[k]);
+        if (def != NULL && *def == reg) {
+            return FALSE;
+        }
+    }
+    return bitset_contains(sel->lv->out[sel->b->id], reg);
+}
+
+int count_reads(IrNode *irn, int reg) {
+    int *uses[MAX_USES];
+    int i, n = ir_node_uses(irn, uses), count = 0;
+    for (i = 0; i < n; i++) {
+        if (*uses[i] == reg) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/*
+ * the register field of irn that patterns read as operand k, A or B. NULL
+ * if there is none; for LOAD_CONSTANT and LOAD_ADDRESS, A is the node.
+ */
+int *pattern_operand(IrNode *irn, int k) {
+    switch (instruction(irn)) {
+        case LOAD_CONSTANT:
+        case LOAD_ADDRESS:
+            return NULL;
+        case STORE_BYTE_INDIRECT:
+        case STORE_HALF_WORD_INDIRECT:
+        case STORE_WORD_INDIRECT:
+            return k == 0 ? &irn->RDEST : &irn->RSRC;
+        default:
+            if (is_binary_op(irn)) {
+                return k == 0 ? &irn->OPRND1 : &irn->OPRND2;
+            }
+            return k == 0 ? &irn->RSRC : NULL;
+    }
+}
+
+void add_fold(Match *m, int j) {
+    m->folds[m->num_folds++] = j;
+}
+
+/* append the instructions of the pattern matched at irn */
+void emit_match(Selector *sel, IrNode *irn, Match *m) {
+    const MipsTemplate *t;
+    MipsInstr *mi;
+    int k;
+
+    for (k = 0; k < MAX_TEMPLATES && m->p->emit[k].op != MIPS_NONE; k++) {
+        t = &m->p->emit[k];
+        mi = emit_instr(sel, t->op, template_reg(irn, m, t->rd),
+                        template_reg(irn, m, t->rs),
+                        template_reg(irn, m, t->rt),
+                        template_imm(irn, m, t->imm));
+        if (is_mips_load(mi) || is_mips_store(mi) || t->op == MIPS_LA) {
+            mi->s = m->ops[0].s;
+        } else if (t->op >= MIPS_BEQ && t->op <= MIPS_BGTZ) {
+            mi->label = irn->branch->LABIDX;
+        }
+    }
+}
+
+int template_reg(IrNode *irn, Match *m, enum reg_source src) {
+    switch (src) {
+        case R_DEST:
+            return irn->RDEST;
+        case R_A:
+            return m->ops[0].reg;
+        case R_A2:
+            return m->ops[0].reg2;
+        case R_B:
+            return m->ops[1].reg;
+        case R_ZERO:
+            return REG_ZERO;
+        case R_V1:
+            return REG_V1;
+        default:
+            return NO_ARG;
+    }
+}
+
+int template_imm(IrNode *irn, Match *m, enum imm_source src) {
+    switch (src) {
+        case I_A:
+            return m->ops[0].imm;
+        case I_B:
+            return m->ops[1].imm;
+        case I_B_PLUS_1:
+            return m->ops[1].imm + 1;
+        case I_B_NEG:
+            return -m->ops[1].imm;
+        case I_ONE:
+            return 1;
+        case I_HI_A:
+            return (int) (((unsigned) m->ops[0].imm >> 16) & 0xffff);
+        case I_LO_A:
+            return m->ops[0].imm & 0xffff;
+        case I_IMMVAL:
+            return irn->IMMVAL;
+        default:
+            return 0;
+    }
+}
+
+/* append the instructions of a node no pattern covers */
+void emit_special(Selector *sel, IrNode *irn) {
+    MipsInstr *mi;
+
+    switch (instruction(irn)) {
+        case LABEL:
+            mi = emit_instr(sel, MIPS_LABEL, NO_ARG, NO_ARG, NO_ARG, 0);
+            mi->label = irn->LABIDX;
+            break;
+        case JUMP:
+            mi = emit_instr(sel, MIPS_J, NO_ARG, NO_ARG, NO_ARG, 0);
+            mi->label = irn->branch->LABIDX;
+            break;
+        case RETURN_FROM_PROC:
+            if (irn->RSRC != NO_ARG && irn->RSRC != REG_V0) {
+                emit_instr(sel, MIPS_MOVE, REG_V0, irn->RSRC, NO_ARG, 0);
+            }
+            if (!falls_into_epilogue(irn) &&
+                    epilogue_length(sel) <= MAX_COPIED_EPILOGUE) {
+                emit_epilogue(sel);
+                emit_instr(sel, MIPS_JR, NO_ARG, REG_RA, NO_ARG, 0);
+                break;
+            }
+            mi = emit_instr(sel, MIPS_J, NO_ARG, NO_ARG, NO_ARG, 0);
+            mi->label = irn->branch->LABIDX;
+            break;
+        case SELECT:
+            emit_select(sel, irn);
+            break;
+        case TAIL_CALL:
+            emit_epilogue(sel);
+            mi = emit_instr(sel, MIPS_J, NO_ARG, NO_ARG, NO_ARG, 0);
+            mi->s = irn->s;
+            break;
+        case CALL:
+            mi = emit_instr(sel, MIPS_JAL, NO_ARG, NO_ARG, NO_ARG, 0);
+            mi->s = irn->s;
+            break;
+        case PARAM:
+            if (irn->RDEST >= NUM_ARG_REGS) {
+                emit_instr(sel, MIPS_SW, NO_ARG, REG_SP, irn->RSRC,
+                            4 * irn->RDEST);
+            } else if (irn->RSRC != REG_A0 + irn->RDEST) {
+                emit_instr(sel, MIPS_OR, REG_A0 + irn->RDEST, irn->RSRC,
+                            REG_ZERO, 0);
+            }
+            break;
+        case RECEIVED_PARAM:
+            if (irn->IMMVAL >= NUM_ARG_REGS) {
+                /* in the caller's outgoing argument area */
+                emit_instr(sel, MIPS_LW, irn->RDEST, REG_SP, NO_ARG,
+                            sel->fl->size + 4 * irn->IMMVAL);
+            } else if (irn->RDEST != REG_A0 + irn->IMMVAL) {
+                emit_instr(sel, MIPS_MOVE, irn->RDEST, REG_A0 + irn->IMMVAL,
+                            NO_ARG, 0);
+            }
+            break;
+        case RETURNED_WORD:
+            if (irn->RDEST != REG_V0) {
+                emit_instr(sel, MIPS_MOVE, irn->RDEST, REG_V0, NO_ARG, 0);
+            }
+            break;
+        case LOAD_WORD:
+            emit_instr(sel, MIPS_LW, irn->RDEST, REG_FP, NO_ARG,
+                        sel->fl->spill_offset[irn->IMMVAL]);
+            break;
+        case STORE_WORD:
+            emit_instr(sel, MIPS_SW, NO_ARG, REG_FP, irn->RSRC,
+                        sel->fl->spill_offset[irn->IMMVAL]);
+            break;
+        default:
+            /* BEGIN_CALL and END_CALL: the frame has room for arguments */
+            break;
+    }
+}
+
+/*
+ * d = c ? a : b as movn d, a, c when d already holds b, movz d, b, c when
+ * it holds a, and a move of b into d then movn otherwise. Register
+ * allocation keeps c out of d
+ */
+void emit_select(Selector *sel, IrNode *irn) {
+    int d = irn->RDEST, c = irn->RSRC, a = irn->OPRND1, b = irn->OPRND2;
+
+    if (a == b) {
+        if (d != a) {
+            emit_instr(sel, MIPS_MOVE, d, a, NO_ARG, 0);
+        }
+    } else if (d == a) {
+        emit_instr(sel, MIPS_MOVZ, d, b, c, 0);
+    } else {
+        if (d != b) {
+            emit_instr(sel, MIPS_MOVE, d, b, NO_ARG, 0);
+        }
+        emit_instr(sel, MIPS_MOVN, d, a, c, 0);
+    }
+}
+
+/* a return with only labels, its own among them, before the epilogue */
+Boolean falls_into_epilogue(IrNode *irn) {
+    IrNode *next;
+
+    for (next = irn->next; next != NULL && instruction(next) == LABEL;
+            next = next->next) {
+        if (next == irn->branch) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* the number of instructions emit_epilogue emits */
+int epilogue_length(Selector *sel) {
+    int i, length = 2;
+
+    if (sel->fl->size == 0) {
+        return 0;
+    }
+    if (sel->fl->saves_ra) {
+        length++;
+    }
+    for (i = 0; i < NUM_SAVED_REGS; i++) {
+        if (sel->ra->saved_used[i]) {
+            length++;
+        }
+    }
+    return length;
+}
+
+/* set up the stack frame and save the registers the procedure must keep */
+void emit_prologue(Selector *sel) {
+    FrameLayout *fl = sel->fl;
+    int i;
+
+    if (fl->size == 0) {
+        return;
+    }
+    emit_instr(sel, MIPS_ADDIU, REG_SP, REG_SP, NO_ARG, -fl->size)->comment =
+        "push space for our stack frame onto the stack";
+    emit_instr(sel, MIPS_SW, NO_ARG, REG_SP, REG_FP, fl->size - 4)->comment =
+        "save the old $fp";
+    emit_instr(sel, MIPS_ADDIU, REG_FP, REG_SP, NO_ARG, fl->size - 4)->comment =
+        "$fp -> stack frame";
+    if (fl->saves_ra) {
+        emit_instr(sel, MIPS_SW, NO_ARG, REG_FP, REG_RA, -4)->comment =
+            "save the return address";
+    }
+    for (i = 0; i < NUM_SAVED_REGS; i++) {
+        if (sel->ra->saved_used[i]) {
+            emit_instr(sel, MIPS_SW, NO_ARG, REG_FP, REG_S0 + i,
+                        fl->saved_offset[i]);
+        }
+    }
+}
+
+/* restore the saved registers and pop the stack frame */
+void emit_epilogue(Selector *sel) {
+    FrameLayout *fl = sel->fl;
+    int i;
+
+    if (fl->size == 0) {
+        return;
+    }
+    for (i = 0; i < NUM_SAVED_REGS; i++) {
+        if (sel->ra->saved_used[i]) {
+            emit_instr(sel, MIPS_LW, REG_S0 + i, REG_FP, NO_ARG,
+                        fl->saved_offset[i]);
+        }
+    }
+    if (fl->saves_ra) {
+        emit_instr(sel, MIPS_LW, REG_RA, REG_FP, NO_ARG, -4)->comment =
+            "restore $ra";
+    }
+    emit_instr(sel, MIPS_LW, REG_FP, REG_FP, NO_ARG, 0)->comment =
+        "restore old $fp";
+    emit_instr(sel, MIPS_ADDIU, REG_SP, REG_SP, NO_ARG, fl->size)->comment =
+        "pop off our stack frame";
+}
+
+MipsInstr *emit_instr(Selector *sel, enum mips_opcode op, int rd, int rs,
+                        int rt, int imm) {
+    MipsInstr *mi = construct_mips_instr(op, rd, rs, rt, imm);
+    append_mips_instr(mi, sel->ml);
+    return mi;
+}
@@ -1,36 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+
 #include "../include/ir.h"
+#include "../include/ir-cfg.h"
+#include "../include/ir-opt.h"
 #include "../include/scope-fsm.h"
 #include "../include/mips.h"
 #include "../include/symbol-utils.h"
+#include "../include/utilities.h"
 
-/*
-# Layout of stack frame for "main" of size 48 bytes
-# Stack frame rounded up to 48 bytes (double word multiple)
-# Name Offset Size
-# (unused) $fp-44 4 (for alignment purposes)
-# $s7 $fp-36 4
-# $s6 $fp-32 4
-# $s5 $fp-28 4
-# $s4 $fp-24 4
-# $s3 $fp-20 4
-# $s2 $fp-16 4
-# $s1 $fp-12 4
-# $s0 $fp-8 4
-# $ra $fp-4 4
-# old $fp $fp 4
-*/
-
-static const char *main_intro ="    addiu $sp, $sp, -48"
-"  # push space for our stack frame onto the stack\n"
-"    sw    $fp, 44($sp)        # save the old $fp\n"
-"    addiu $fp, $sp, 44     # $fp -> stack frame\n"
-"    sw    $ra, -4($fp)        # save the return address";
-
-static const char *main_outro = "    lw    $ra, -4($fp)       # restore $ra\n"
-"    lw    $fp, ($fp)         # restore old $fp\n"
-"    addiu $sp, $sp, 48   # pop off our stack frame\n"
-"    jr    $ra\n";
+/* where the comments of instructions start */
+#define COMMENT_COLUMN 30
+
+/* how the operands of an instruction are written */
+enum mips_format {
+    FMT_NONE,
+    FMT_LABEL,
+    FMT_RRR,                    /* rd, rs, rt       */
+    FMT_MOVC,                   /* rd, rs, rt       */
+    FMT_RRI,                    /* rd, rs, imm      */
+    FMT_RI,                     /* rd, imm          */
+    FMT_RR,                     /* rd, rs           */
+    FMT_D,                      /* rd               */
+    FMT_S,                      /* rs               */
+    FMT_ST,                     /* rs, rt           */
+    FMT_LOAD,                   /* rd, memory       */
+    FMT_STORE,                  /* rt, memory       */
+    FMT_LA,                     /* rd, symbol       */
+    FMT_BRANCH2,                /* rs, rt, target   */
+    FMT_BRANCH1,                /* rs, target       */
+    FMT_JUMP                    /* target           */
+};
+
+struct MipsOpcodeInfo {
+    const char *name;
+    enum mips_format format;
+};
 
+/* indexed by enum mips_opcode */
+static const struct MipsOpcodeInfo mips_opcodes[] = {
+    { "", FMT_NONE },
+    { "", FMT_LABEL },
+    { "addu", FMT_RRR },
+    { "subu", FMT_RRR },
+    { "mul", FMT_RRR },
+    { "and", FMT_RRR },
+    { "or", FMT_RRR },
+    { "xor", FMT_RRR },
+    { "nor", FMT_RRR },
+    { "slt", FMT_RRR },
+    { "sltu", FMT_RRR },
+    { "sllv", FMT_RRR },
+    { "srav", FMT_RRR },
+    { "srlv", FMT_RRR },
+    { "addiu", FMT_RRI },
+    { "andi", FMT_RRI },
+    { "ori", FMT_RRI },
+    { "xori", FMT_RRI },
+    { "slti", FMT_RRI },
+    { "sltiu", FMT_RRI },
+    { "sll", FMT_RRI },
+    { "sra", FMT_RRI },
+    { "srl", FMT_RRI },
+    { "lui", FMT_RI },
+    { "li", FMT_RI },
+    { "la", FMT_LA },
+    { "move", FMT_RR },
+    { "movn", FMT_MOVC },
+    { "movz", FMT_MOVC },
+    { "div", FMT_ST },
+    { "divu", FMT_ST },
+    { "mult", FMT_ST },
+    { "multu", FMT_ST },
+    { "mflo", FMT_D },
+    { "mfhi", FMT_D },
+    { "nop", FMT_NONE },
+    { "lb", FMT_LOAD },
+    { "lbu", FMT_LOAD },
+    { "lh", FMT_LOAD },
+    { "lhu", FMT_LOAD },
+    { "lw", FMT_LOAD },
+    { "sb", FMT_STORE },
+    { "sh", FMT_STORE },
+    { "sw", FMT_STORE },
+    { "beq", FMT_BRANCH2 },
+    { "bne", FMT_BRANCH2 },
+    { "beqz", FMT_BRANCH1 },
+    { "bnez", FMT_BRANCH1 },
+    { "blez", FMT_BRANCH1 },
+    { "bgez", FMT_BRANCH1 },
+    { "bltz", FMT_BRANCH1 },
+    { "bgtz", FMT_BRANCH1 },
+    { "j", FMT_JUMP },
+    { "jal", FMT_JUMP },
+    { "jr", FMT_S }
+};
 
 static const char *syscall_print_int = "syscall_print_int:\n"
 "    li    $v0, 1         # v0 <- syscall code for print_int\n"
@@ -39,7 +103,8 @@ static const char *syscall_print_int = "syscall_print_int:\n"
 
 void print_global_variables(FILE *out, SymbolTable *st);
 void print_functions(FILE *out, SymbolTableContainer *stc, IrList *irl);
-void ir_to_mips(FILE *out, IrNode *irn);
+int print_memory_operand(FILE *out, MipsInstr *mi);
+int print_target(FILE *out, MipsInstr *mi);
 
 void compute_mips_asm(FILE *output, SymbolTableContainer *stc, IrList *irl) {
     /* write each file scope non-function symbol */
@@ -51,89 +116,322 @@ void compute_mips_asm(FILE *output, SymbolTableContainer *stc, IrList *irl) {
     /* print each function defintion */
     fprintf(output, "\n");
     fprintf(output, "    .text\n");
+    /* the delay slots after jumps are filled, and hazards kept, already */
+    fprintf(output, "    .set noreorder\n");
     print_functions(output, stc, irl);
+    fprintf(output, "    .set reorder\n");
 
     /* provide syscall code */
     fprintf(output, "%s", syscall_print_int);
 }
 
+/*
+ * print_global_variables
+ * Purpose: reserve zeroed storage for each file scope variable, sized and
+ *          aligned by its type
+ * Parameters:
+ *  out - FILE * - the assembly being written
+ *  st - SymbolTable * - the file scope symbols
+ * Returns:
+ *  None
+ * Side Effects:
+ *  Writes to out. Words come first, then halves, then bytes: each size is
+ *  a multiple of its alignment, so every variable starts aligned without
+ *  padding. Arrays take .space, which SPIM has no .bss section for.
+ */
 void print_global_variables(FILE *out, SymbolTable *st) {
-    Symbol *s = st->symbols;
-    while (s != NULL) {
-        if (symbol_outer_type(s) != FUNCTION) {
-            /* TODO: do not assume every symbol is a word */
-            fprintf(output, "%s: .word 0\n", get_symbol_name(s));
+    Symbol *s;
+    int align;
+
+    for (align = INT_BYTES; align >= CHAR_BYTES; align /= 2) {
+        for (s = st->symbols; s != NULL; s = s->next) {
+            if (symbol_outer_type(s) == FUNCTION ||
+                    type_alignment(s->type_tree) != align) {
+                continue;
+            }
+            fprintf(out, "%s: ", get_symbol_name(s));
+            if (symbol_outer_type(s) == ARRAY) {
+                fprintf(out, ".space %d\n", type_bytes(s->type_tree));
+            } else {
+                fprintf(out, "%s 0\n", align == INT_BYTES ? ".word" :
+                                align == SHORT_BYTES ? ".half" : ".byte");
+            }
         }
-        s = s->next;
     }
 }
 
+/*
+ * allocate the registers of each procedure and lay out its stack frame,
+ * then select its instructions, improve them through a peephole, schedule
+ * them and print them
+ */
 void print_functions(FILE *out, SymbolTableContainer *stc, IrList *irl) {
-    IrNode *cur = irl->head;
-    while (cur != NULL) {
-        ir_to_mips(out, cur);
-        cur = cur->next;
-    }
-}
-
-void ir_to_mips(FILE *out, IrNode *irn) {
-    switch(irn->instruction) {
-        case BEGIN_PROC:
-            fprintf(out, "%s:", get_symbol_name(irn->s));
-            #ifdef PROCEDURE_CALLS_SUPPORTED
-                /* procedure entry steps */
-            #else
-            fprintf(out, "\n%s", main_intro);
-            #endif
-            break;
-        case RETURN_FROM_PROC:
-            if (irn->RSRC != NO_ARG) {
-                fprintf(out, "    move  $v0, $t%d", irn->RSRC);
+    ControlFlowGraph *cfg;
+    IrNode *proc;
+    RegisterAssignment regs;
+    FrameLayout frame;
+    MipsList ml;
+    MipsInstr *mi;
+    int converted, folded, saved, filled, nops, i;
+    int hits[NUM_PEEPHOLE_RULES];
+
+    proc = next_proc(irl->head);
+    while (proc != NULL) {
+        cfg = create_cfg(irl, proc);
+        converted = convert_tail_calls(cfg);
+        report_pass("tail", cfg, converted, "calls made jumps");
+        if (converted > 0) {
+            free_cfg(cfg);
+            cfg = create_cfg(irl, proc);
+        }
+        allocate_registers(cfg, &regs);
+        layout_frame(cfg, &regs, &frame);
+        ml.head = ml.tail = NULL;
+        folded = select_instructions(cfg, &regs, &frame, &ml);
+        report_pass("isel", cfg, folded, "IR instructions folded");
+        optimize_peephole(&ml, hits);
+        for (i = 0; i < NUM_PEEPHOLE_RULES; i++) {
+            report_pass("peep", cfg, hits[i], peephole_rule_name(i));
+        }
+        saved = schedule_instructions(&ml);
+        report_pass("sched", cfg, saved, "stall cycles saved");
+        filled = fill_delay_slots(&ml);
+        report_pass("delay", cfg, filled, "delay slots filled");
+        nops = insert_hazard_nops(&ml);
+        report_pass("delay", cfg, nops, "hazard nops inserted");
+        for (mi = ml.head; mi != NULL; mi = mi->next) {
+            print_mips_instr(out, mi);
+        }
+        fprintf(out, "\n");
+        proc = next_proc(cfg->end_proc);
+        free_mips_list(&ml);
+        free_frame_layout(&frame);
+        free_cfg(cfg);
+    }
+}
+
+MipsInstr *construct_mips_instr(enum mips_opcode op, int rd, int rs, int rt,
+                                int imm) {
+    MipsInstr *mi;
+    util_emalloc((void **) &mi, sizeof(MipsInstr));
+    mi->op = op;
+    mi->rd = rd;
+    mi->rs = rs;
+    mi->rt = rt;
+    mi->imm = imm;
+    mi->s = NULL;
+    mi->label = NO_ARG;
+    mi->comment = NULL;
+    mi->prev = NULL;
+    mi->next = NULL;
+    return mi;
+}
+
+void append_mips_instr(MipsInstr *mi, MipsList *ml) {
+    mi->prev = ml->tail;
+    mi->next = NULL;
+    if (ml->tail == NULL) {
+        ml->head = mi;
+    } else {
+        ml->tail->next = mi;
+    }
+    ml->tail = mi;
+}
+
+void insert_mips_instr_after(MipsInstr *pos, MipsInstr *mi, MipsList *ml) {
+    mi->prev = pos;
+    mi->next = pos->next;
+    if (pos->next == NULL) {
+        ml->tail = mi;
+    } else {
+        pos->next->prev = mi;
+    }
+    pos->next = mi;
+}
+
+void unlink_mips_instr(MipsInstr *mi, MipsList *ml) {
+    if (mi->prev == NULL) {
+        ml->head = mi->next;
+    } else {
+        mi->prev->next = mi->next;
+    }
+    if (mi->next == NULL) {
+        ml->tail = mi->prev;
+    } else {
+        mi->next->prev = mi->prev;
+    }
+    mi->prev = mi->next = NULL;
+}
+
+/* unlink mi from ml and free it */
+void remove_mips_instr(MipsInstr *mi, MipsList *ml) {
+    unlink_mips_instr(mi, ml);
+    free(mi);
+}
+
+/* the register mi writes, NO_ARG if none; jal's writes are not counted */
+int mips_instr_def(MipsInstr *mi) {
+    switch (mips_opcodes[mi->op].format) {
+        case FMT_RRR:
+        case FMT_MOVC:
+        case FMT_RRI:
+        case FMT_RI:
+        case FMT_RR:
+        case FMT_D:
+        case FMT_LOAD:
+        case FMT_LA:
+            return mi->rd;
+        default:
+            return NO_ARG;
+    }
+}
+
+/*
+ * the registers mi reads, at most MAX_MIPS_USES, put in uses; returns how
+ * many. What jal and jr read by convention is not counted.
+ */
+int mips_instr_uses(MipsInstr *mi, int uses[]) {
+    int n = 0;
+    switch (mips_opcodes[mi->op].format) {
+        case FMT_MOVC:
+            /* rd keeps its value when the move is not made */
+            uses[n++] = mi->rd;
+            /* falls through */
+        case FMT_RRR:
+        case FMT_ST:
+        case FMT_BRANCH2:
+        case FMT_STORE:
+            uses[n++] = mi->rt;
+            /* falls through */
+        case FMT_RRI:
+        case FMT_RR:
+        case FMT_S:
+        case FMT_LOAD:
+        case FMT_BRANCH1:
+            if (mi->rs != NO_ARG) {
+                uses[n++] = mi->rs;
             }
-            fprintf(out, "\n    j     LABEL_%d", irn->branch->LABIDX);
             break;
-        case END_PROC:
-            #ifdef PROCEDURE_CALLS_SUPPORTED
-                /* procedure completion steps */
-            #else
-            fprintf(out, "%s", main_outro);
-            #endif
+        default:
+            break;
+    }
+    return n;
+}
+
+/* lb, lbu, lh, lhu or lw */
+Boolean is_mips_load(MipsInstr *mi) {
+    return mips_opcodes[mi->op].format == FMT_LOAD ? TRUE : FALSE;
+}
+
+/* sb, sh or sw */
+Boolean is_mips_store(MipsInstr *mi) {
+    return mips_opcodes[mi->op].format == FMT_STORE ? TRUE : FALSE;
+}
+
+void free_mips_list(MipsList *ml) {
+    MipsInstr *mi, *next;
+    for (mi = ml->head; mi != NULL; mi = next) {
+        next = mi->next;
+        free(mi);
+    }
+    ml->head = ml->tail = NULL;
+}
+
+/* write one instruction or label as a line of assembly */
+void print_mips_instr(FILE *out, MipsInstr *mi) {
+    const struct MipsOpcodeInfo *info = &mips_opcodes[mi->op];
+    int len;
+
+    if (info->format == FMT_LABEL) {
+        print_target(out, mi);
+        fprintf(out, ":\n");
+        return;
+    }
+    if (info->format == FMT_NONE) {
+        fprintf(out, "    %s\n", info->name);
+        return;
+    }
+    len = fprintf(out, "    %-5s ", info->name);
+    switch (info->format) {
+        case FMT_RRR:
+        case FMT_MOVC:
+            len += fprintf(out, "%s, %s, %s", mips_reg_name(mi->rd),
+                    mips_reg_name(mi->rs), mips_reg_name(mi->rt));
+            break;
+        case FMT_RRI:
+            len += fprintf(out, "%s, %s, %d", mips_reg_name(mi->rd),
+                    mips_reg_name(mi->rs), mi->imm);
+            break;
+        case FMT_RI:
+            len += fprintf(out, "%s, %d", mips_reg_name(mi->rd), mi->imm);
             break;
-        case LOAD_ADDRESS:
-            fprintf(out, "    la    $t%d, %s",
-                        irn->RDEST, get_symbol_name(irn->s));
+        case FMT_RR:
+            len += fprintf(out, "%s, %s", mips_reg_name(mi->rd),
+                    mips_reg_name(mi->rs));
             break;
-        case LOAD_WORD_INDIRECT:
-            fprintf(out, "    lw    $t%d, ($t%d)", irn->RDEST, irn->RSRC);
+        case FMT_D:
+            len += fprintf(out, "%s", mips_reg_name(mi->rd));
             break;
-        case LOAD_CONSTANT:
-            fprintf(out, "    li    $t%d, %d", irn->RDEST, irn->IMMVAL);
+        case FMT_S:
+            len += fprintf(out, "%s", mips_reg_name(mi->rs));
             break;
-        case STORE_WORD_INDIRECT:
-            fprintf(out, "    sw    $t%d, ($t%d)", irn->RSRC, irn->RDEST);
+        case FMT_ST:
+            len += fprintf(out, "%s, %s", mips_reg_name(mi->rs),
+                    mips_reg_name(mi->rt));
             break;
-        case LABEL:
-            fprintf(out, "LABEL_%d:", irn->LABIDX);
+        case FMT_LOAD:
+            len += fprintf(out, "%s, ", mips_reg_name(mi->rd));
+            len += print_memory_operand(out, mi);
             break;
-        case BEGIN_CALL:
-            fprintf(out, "    addiu $sp, $sp, -4 # push space for argument");
+        case FMT_STORE:
+            len += fprintf(out, "%s, ", mips_reg_name(mi->rt));
+            len += print_memory_operand(out, mi);
             break;
-        case PARAM:
-            fprintf(out, "    or    $a%d, $t%d, $0", irn->RDEST, irn->RSRC);
+        case FMT_LA:
+            len += fprintf(out, "%s, %s", mips_reg_name(mi->rd),
+                    get_symbol_name(mi->s));
             break;
-        case CALL:
-            fprintf(out, "    jal   %s", get_symbol_name(irn->s));
+        case FMT_BRANCH2:
+            len += fprintf(out, "%s, %s, ", mips_reg_name(mi->rs),
+                    mips_reg_name(mi->rt));
+            len += print_target(out, mi);
             break;
-        case END_CALL:
-            fprintf(out, "    addiu $sp, $sp, 4 # pop off space for argument");
+        case FMT_BRANCH1:
+            len += fprintf(out, "%s, ", mips_reg_name(mi->rs));
+            len += print_target(out, mi);
             break;
-        case LOG_OR:
-            fprintf(out, "    or    $t%d,  $t%d, $t%d",
-                    irn->RDEST, irn->OPRND1, irn->OPRND2);
+        case FMT_JUMP:
+            len += print_target(out, mi);
             break;
         default:
-            fprintf(out, "unknown instruction");
             break;
     }
+    if (mi->comment != NULL) {
+        fprintf(out, "%*s# %s", len < COMMENT_COLUMN ? COMMENT_COLUMN - len : 1,
+                "", mi->comment);
+    }
     fprintf(out, "\n");
 }
+
+/*
+ * imm(rs), or a global by name, which the assembler addresses from $gp.
+ * Returns the number of characters written.
+ */
+int print_memory_operand(FILE *out, MipsInstr *mi) {
+    if (mi->s == NULL) {
+        return mi->imm == 0 ? fprintf(out, "(%s)", mips_reg_name(mi->rs)) :
+                fprintf(out, "%d(%s)", mi->imm, mips_reg_name(mi->rs));
+    }
+    if (mi->imm == 0) {
+        return fprintf(out, "%s", get_symbol_name(mi->s));
+    }
+    return fprintf(out, "%s%+d", get_symbol_name(mi->s), mi->imm);
+}
+
+/* a label of the procedure, or a procedure; returns the characters written */
+int print_target(FILE *out, MipsInstr *mi) {
+    if (mi->s != NULL) {
+        return fprintf(out, "%s", get_symbol_name(mi->s));
+    }
+    return fprintf(out, "LABEL_%d", mi->label);
+}
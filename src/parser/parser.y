@@ -705,6 +705,7 @@ void set_literal_data(Node *n, YYSTYPE data) {
             break;
         case NUMBER_CONSTANT:
             n->data.num = ((struct Number *) data)->value;
+            n->expr->type = ((struct Number *) data)->type;
             break;
         case CHAR_CONSTANT:
             n->data.ch = ((struct Character *) data)->c;
@@ -871,6 +872,7 @@ void *construct_node(enum data_type nt) {
         util_emalloc((void **) &e, sizeof(Expression));
         e->lvalue = FALSE;
         e->location = NO_ARG;
+        e->type = NO_DATA_TYPE;
     }
     n->expr = e;
     n->st_entry = NULL;
@@ -20,6 +20,19 @@ SymbolCreationData *scd = NULL;
 long resolve_array_size(SymbolCreationData *scd, Node *n);
 Boolean array_bound_optional(SymbolCreationData *scd);
 Boolean invalid_operand(long operand);
+IntegerConstant make_integer_constant(unsigned long bits, enum data_type type);
+IntegerConstant operand_constant(unsigned long operand);
+unsigned long operand_value(IntegerConstant c);
+Boolean is_integral_type(enum data_type type);
+Boolean is_signed_type(enum data_type type);
+int integer_width(enum data_type type);
+Boolean signed_overflow(int op, long x, long y);
+Boolean node_constant(Node *n, IntegerConstant *c);
+Boolean fold_binary_expr(Node *n, IntegerConstant *c);
+Boolean fold_unary_expr(Node *n, IntegerConstant *c);
+Boolean fold_conditional_expr(Node *n, IntegerConstant *c);
+Boolean fold_cast_expr(Node *n, IntegerConstant *c);
+void replace_with_constant(Node *n, IntegerConstant c);
 
 
 void initialize_symbol_creation_data(SymbolCreationData *scd) {
@@ -442,6 +455,9 @@ Boolean invalid_operand(long operand) {
 
 unsigned long resolve_conditional_expr(Node *n) {
     unsigned long child1, child2, child3;
+    child1 = resolve_constant_expr(n->children.child1);
+    child2 = resolve_constant_expr(n->children.child2);
+    child3 = resolve_constant_expr(n->children.child3);
     if (invalid_operand(child1)) {
         return child1;
     }
@@ -451,14 +467,12 @@ unsigned long resolve_conditional_expr(Node *n) {
     if (invalid_operand(child3)) {
         return child3;
     }
-    child1 = resolve_constant_expr(n->children.child1);
-    child2 = resolve_constant_expr(n->children.child2);
-    child3 = resolve_constant_expr(n->children.child3);
     return child1 ? child2 : child3;
 }
 
 unsigned long resolve_binary_expr(Node *n) {
     unsigned long child1, child2;
+    IntegerConstant result;
     child1 = resolve_constant_expr(n->children.child1);
     child2 = resolve_constant_expr(n->children.child2);
     if (invalid_operand(child1)) {
@@ -467,47 +481,12 @@ unsigned long resolve_binary_expr(Node *n) {
     if (invalid_operand(child2)) {
         return child2;
     }
-    switch (n->data.attributes[OPERATOR]) {
-        case LOGICAL_OR:
-            return child1 || child2;
-        case LOGICAL_AND:
-            return child1 && child2;
-        case BITWISE_OR:
-            return child1 | child2;
-        case BITWISE_XOR:
-            return child1 ^ child2;
-        case AMPERSAND:
-            return child1 & child2;
-        case EQUAL:
-            return child1 == child2;
-        case NOT_EQUAL:
-            return child1 != child2;
-        case LESS_THAN:
-            return child1 < child2;
-        case LESS_THAN_EQUAL:
-            return child1 <= child2;
-        case GREATER_THAN:
-            return child1 > child2;
-        case GREATER_THAN_EQUAL:
-            return child1 >= child2;
-        case BITWISE_LSHIFT:
-            return child1 << child2;
-        case BITWISE_RSHIFT:
-            return child1 >> child2;
-        case PLUS:
-            return child1 + child2;
-        case MINUS:
-            return child1 - child2;
-        case ASTERISK:
-            return child1 * child2;
-        case DIVIDE:
-            return child1 / child2;
-        case REMAINDER:
-            return child1 % child2;
-        default:
-            /* error */
-            return VARIABLE_VALUE;
+    if (!apply_binary_operator(n->data.attributes[OPERATOR],
+                operand_constant(child1), operand_constant(child2), &result)) {
+        /* division by zero, overflow or not a constant operator */
+        return UNSPECIFIED_VALUE;
     }
+    return operand_value(result);
 }
 
 unsigned long resolve_assignment_expr(Node *n) {
@@ -551,19 +530,21 @@ unsigned long resolve_cast_expr(Node *n) {
 
 unsigned long resolve_unary_expr(Node *n) {
     unsigned long child1;
+    IntegerConstant result;
     child1 = resolve_constant_expr(n->children.child1);
     if (invalid_operand(child1)) {
         return child1;
     }
     switch (n->data.attributes[OPERATOR]) {
         case MINUS:
-            return -child1;
         case PLUS:
-            return +child1;
         case LOGICAL_NOT:
-            return !child1;
         case BITWISE_NOT:
-            return ~child1;
+            if (!apply_unary_operator(n->data.attributes[OPERATOR],
+                        operand_constant(child1), &result)) {
+                return UNSPECIFIED_VALUE;
+            }
+            return operand_value(result);
         case AMPERSAND:
             return NON_INTEGRAL_VALUE;
         case ASTERISK:
@@ -599,7 +580,7 @@ unsigned long resolve_postfix_expr(Node *n) {
         case INCREMENT:
             return child1++;
         case DECREMENT:
-            return child1++;
+            return child1--;
         default:
             return VARIABLE_VALUE;
     }
@@ -631,6 +612,559 @@ unsigned long resolve_function_call(Node *n) {
     return VARIABLE_VALUE;
 }
 
+/*
+ * Constant folding.
+ * Integer constant expressions are evaluated with the widths of the target:
+ * char is 8 bits, short 16, int and long 32. Values are carried as 32-bit
+ * patterns in an IntegerConstant so the result does not depend on the width
+ * of the host's long.
+ */
+
+#define INT_BITS_MASK   0xFFFFFFFFul
+#define TARGET_INT_MAX  2147483647L
+#define TARGET_INT_MIN  (-TARGET_INT_MAX - 1)
+
+/* helpers for the resolve_* functions, which carry values as unsigned long */
+IntegerConstant operand_constant(unsigned long operand) {
+    if ((long) operand < 0) {
+        return make_integer_constant(operand, SIGNED_INT);
+    } else if (operand > (unsigned long) TARGET_INT_MAX) {
+        return make_integer_constant(operand, UNSIGNED_LONG);
+    }
+    return make_integer_constant(operand, SIGNED_INT);
+}
+
+unsigned long operand_value(IntegerConstant c) {
+    if (is_signed_type(c.type)) {
+        return (unsigned long) integer_constant_value(c);
+    }
+    return c.bits;
+}
+
+IntegerConstant make_integer_constant(unsigned long bits, enum data_type type) {
+    IntegerConstant c;
+    c.bits = bits;
+    c.type = type;
+    return convert_integer_constant(c, type);
+}
+
+Boolean is_integral_type(enum data_type type) {
+    switch (type) {
+        case SIGNED_CHAR:
+        case UNSIGNED_CHAR:
+        case SIGNED_SHORT:
+        case UNSIGNED_SHORT:
+        case SIGNED_INT:
+        case UNSIGNED_INT:
+        case SIGNED_LONG:
+        case UNSIGNED_LONG:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+Boolean is_signed_type(enum data_type type) {
+    switch (type) {
+        case SIGNED_CHAR:
+        case SIGNED_SHORT:
+        case SIGNED_INT:
+        case SIGNED_LONG:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+int integer_width(enum data_type type) {
+    switch (type) {
+        case SIGNED_CHAR:
+        case UNSIGNED_CHAR:
+            return 8;
+        case SIGNED_SHORT:
+        case UNSIGNED_SHORT:
+            return 16;
+        default:
+            return 32;
+    }
+}
+
+/*
+ * promoted_type
+ * Purpose: the type an operand of an integral type is promoted to
+ * Parameters:
+ *  type - enum data_type - the operand's type
+ * Returns:
+ *  SIGNED_INT for char and short types, since int holds all their values,
+ *  and for anything not integral; type itself otherwise
+ * Side Effects:
+ *  None
+ */
+enum data_type promoted_type(enum data_type type) {
+    switch (type) {
+        case UNSIGNED_INT:
+        case SIGNED_LONG:
+        case UNSIGNED_LONG:
+            return type;
+        default:
+            return SIGNED_INT;
+    }
+}
+
+/*
+ * arithmetic_type
+ * Purpose: the usual arithmetic conversions for two promoted operands
+ * Parameters:
+ *  t1, t2 - enum data_type - the operands' promoted types
+ * Returns:
+ *  The type both are converted to. long is 32 bits, so long and
+ *  unsigned int meet at unsigned long
+ * Side Effects:
+ *  None
+ */
+enum data_type arithmetic_type(enum data_type t1, enum data_type t2) {
+    if (t1 == UNSIGNED_LONG || t2 == UNSIGNED_LONG) {
+        return UNSIGNED_LONG;
+    }
+    if (t1 == SIGNED_LONG || t2 == SIGNED_LONG) {
+        if (t1 == UNSIGNED_INT || t2 == UNSIGNED_INT) {
+            return UNSIGNED_LONG;
+        }
+        return SIGNED_LONG;
+    }
+    if (t1 == UNSIGNED_INT || t2 == UNSIGNED_INT) {
+        return UNSIGNED_INT;
+    }
+    return SIGNED_INT;
+}
+
+/* does x op y leave the range of a 32-bit signed integer? */
+Boolean signed_overflow(int op, long x, long y) {
+    switch (op) {
+        case PLUS:
+            return (y > 0 && x > TARGET_INT_MAX - y) ||
+                    (y < 0 && x < TARGET_INT_MIN - y);
+        case MINUS:
+            return (y < 0 && x > TARGET_INT_MAX + y) ||
+                    (y > 0 && x < TARGET_INT_MIN + y);
+        case ASTERISK:
+            if (x > 0) {
+                return y > 0 ? x > TARGET_INT_MAX / y : y < TARGET_INT_MIN / x;
+            } else if (x < 0) {
+                return y > 0 ? x < TARGET_INT_MIN / y :
+                                (y != 0 && y < TARGET_INT_MAX / x);
+            }
+            return FALSE;
+        case DIVIDE:
+        case REMAINDER:
+            return x == TARGET_INT_MIN && y == -1;
+        default:
+            return FALSE;
+    }
+}
+
+/*
+ * convert_integer_constant
+ * Purpose: convert an integer constant to another integral type
+ * Parameters:
+ *  c - IntegerConstant - the value to convert
+ *  type - enum data_type - the integral type to convert to
+ * Returns:
+ *  The value truncated to the width of type, sign extended if type is signed
+ * Side Effects:
+ *  None
+ */
+IntegerConstant convert_integer_constant(IntegerConstant c,
+                                            enum data_type type) {
+    IntegerConstant result;
+    int width = integer_width(type);
+    unsigned long mask = INT_BITS_MASK >> (32 - width);
+    unsigned long sign_bit = 1ul << (width - 1);
+
+    result.type = type;
+    result.bits = c.bits & mask;
+    if (is_signed_type(type) && (result.bits & sign_bit)) {
+        result.bits |= INT_BITS_MASK & ~mask;
+    }
+    return result;
+}
+
+/*
+ * integer_constant_value
+ * Purpose: the value of an integer constant as a host long
+ * Parameters:
+ *  c - IntegerConstant - the constant
+ * Returns:
+ *  The value, negative for negative signed constants
+ * Side Effects:
+ *  None
+ */
+long integer_constant_value(IntegerConstant c) {
+    if (is_signed_type(c.type) && (c.bits & 0x80000000ul)) {
+        return -(long) (~c.bits & 0x7FFFFFFFul) - 1;
+    }
+    return (long) c.bits;
+}
+
+/*
+ * apply_binary_operator
+ * Purpose: evaluate a binary operator on two integer constants with C
+ *          semantics for the target
+ * Parameters:
+ *  op - int - the operator token, as in a BINARY_EXPR
+ *  c1, c2 - IntegerConstant - the left and right operands
+ *  result - IntegerConstant * - receives the value
+ * Returns:
+ *  FALSE if the expression may not be folded: the operator is unknown or the
+ *  result is undefined (division by zero, signed overflow, a shift count out
+ *  of range or a left shift of a negative value)
+ * Side Effects:
+ *  None
+ */
+Boolean apply_binary_operator(int op, IntegerConstant c1, IntegerConstant c2,
+                                IntegerConstant *result) {
+    enum data_type type;
+    IntegerConstant a, b;
+    long x, y, count;
+
+    switch (op) {
+        case LOGICAL_OR:
+            *result = make_integer_constant(c1.bits != 0 || c2.bits != 0,
+                                            SIGNED_INT);
+            return TRUE;
+        case LOGICAL_AND:
+            *result = make_integer_constant(c1.bits != 0 && c2.bits != 0,
+                                            SIGNED_INT);
+            return TRUE;
+        case BITWISE_LSHIFT:
+        case BITWISE_RSHIFT:
+            /* the result has the promoted type of the left operand */
+            a = convert_integer_constant(c1, promoted_type(c1.type));
+            b = convert_integer_constant(c2, promoted_type(c2.type));
+            count = integer_constant_value(b);
+            if (count < 0 || count >= 32) {
+                return FALSE;
+            }
+            x = integer_constant_value(a);
+            if (op == BITWISE_LSHIFT) {
+                if (is_signed_type(a.type) &&
+                        (x < 0 || x > (TARGET_INT_MAX >> count))) {
+                    return FALSE;
+                }
+                *result = make_integer_constant(a.bits << count, a.type);
+            } else if (is_signed_type(a.type) && x < 0) {
+                /* arithmetic shift, as srav does */
+                *result = make_integer_constant(
+                        ~((~a.bits & INT_BITS_MASK) >> count), a.type);
+            } else {
+                *result = make_integer_constant(a.bits >> count, a.type);
+            }
+            return TRUE;
+        default:
+            break;
+    }
+
+    type = arithmetic_type(promoted_type(c1.type), promoted_type(c2.type));
+    a = convert_integer_constant(c1, type);
+    b = convert_integer_constant(c2, type);
+    x = integer_constant_value(a);
+    y = integer_constant_value(b);
+
+    switch (op) {
+        case EQUAL:
+            *result = make_integer_constant(a.bits == b.bits, SIGNED_INT);
+            return TRUE;
+        case NOT_EQUAL:
+            *result = make_integer_constant(a.bits != b.bits, SIGNED_INT);
+            return TRUE;
+        case LESS_THAN:
+            *result = make_integer_constant(is_signed_type(type) ?
+                                    x < y : a.bits < b.bits, SIGNED_INT);
+            return TRUE;
+        case LESS_THAN_EQUAL:
+            *result = make_integer_constant(is_signed_type(type) ?
+                                    x <= y : a.bits <= b.bits, SIGNED_INT);
+            return TRUE;
+        case GREATER_THAN:
+            *result = make_integer_constant(is_signed_type(type) ?
+                                    x > y : a.bits > b.bits, SIGNED_INT);
+            return TRUE;
+        case GREATER_THAN_EQUAL:
+            *result = make_integer_constant(is_signed_type(type) ?
+                                    x >= y : a.bits >= b.bits, SIGNED_INT);
+            return TRUE;
+        case BITWISE_OR:
+            *result = make_integer_constant(a.bits | b.bits, type);
+            return TRUE;
+        case BITWISE_XOR:
+            *result = make_integer_constant(a.bits ^ b.bits, type);
+            return TRUE;
+        case AMPERSAND:
+            *result = make_integer_constant(a.bits & b.bits, type);
+            return TRUE;
+        case DIVIDE:
+        case REMAINDER:
+            if (b.bits == 0) {
+                return FALSE;
+            }
+            break;
+        case PLUS:
+        case MINUS:
+        case ASTERISK:
+            break;
+        default:
+            return FALSE;
+    }
+
+    if (is_signed_type(type)) {
+        if (signed_overflow(op, x, y)) {
+            return FALSE;
+        }
+        switch (op) {
+            case PLUS:
+                x = x + y;
+                break;
+            case MINUS:
+                x = x - y;
+                break;
+            case ASTERISK:
+                x = x * y;
+                break;
+            case DIVIDE:
+                x = x / y;
+                break;
+            default:
+                x = x % y;
+                break;
+        }
+        *result = make_integer_constant((unsigned long) x, type);
+    } else {
+        switch (op) {
+            case PLUS:
+                *result = make_integer_constant(a.bits + b.bits, type);
+                break;
+            case MINUS:
+                *result = make_integer_constant(a.bits - b.bits, type);
+                break;
+            case ASTERISK:
+                *result = make_integer_constant(a.bits * b.bits, type);
+                break;
+            case DIVIDE:
+                *result = make_integer_constant(a.bits / b.bits, type);
+                break;
+            default:
+                *result = make_integer_constant(a.bits % b.bits, type);
+                break;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * apply_unary_operator
+ * Purpose: evaluate a unary arithmetic operator on an integer constant
+ * Parameters:
+ *  op - int - MINUS, PLUS, LOGICAL_NOT or BITWISE_NOT
+ *  c - IntegerConstant - the operand
+ *  result - IntegerConstant * - receives the value
+ * Returns:
+ *  FALSE for any other operator, or when negation overflows
+ * Side Effects:
+ *  None
+ */
+Boolean apply_unary_operator(int op, IntegerConstant c,
+                                IntegerConstant *result) {
+    IntegerConstant a = convert_integer_constant(c, promoted_type(c.type));
+
+    switch (op) {
+        case MINUS:
+            if (is_signed_type(a.type) &&
+                    integer_constant_value(a) == TARGET_INT_MIN) {
+                return FALSE;
+            }
+            *result = make_integer_constant(~a.bits + 1, a.type);
+            return TRUE;
+        case PLUS:
+            *result = a;
+            return TRUE;
+        case LOGICAL_NOT:
+            *result = make_integer_constant(a.bits == 0, SIGNED_INT);
+            return TRUE;
+        case BITWISE_NOT:
+            *result = make_integer_constant(~a.bits, a.type);
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/*
+ * fold_constant_expressions
+ * Purpose:
+ *      Replace each BINARY_EXPR, UNARY_EXPR, CONDITIONAL_EXPR and CAST_EXPR
+ *      whose operands are constant by a NUMBER_CONSTANT holding its value,
+ *      so IR generation emits one LOAD_CONSTANT instead of the whole tree.
+ * Parameters:
+ *      n: the root of the parse tree or of any subtree
+ * Returns:
+ *      None
+ * Side Effects:
+ *      Rewrites folded nodes in place and detaches their children.
+ *      Expressions with undefined results are left alone.
+ */
+void fold_constant_expressions(Node *n) {
+    IntegerConstant c;
+    Boolean folded;
+
+    if (n == NULL) {
+        return;
+    }
+    fold_constant_expressions(n->children.child1);
+    fold_constant_expressions(n->children.child2);
+    fold_constant_expressions(n->children.child3);
+    fold_constant_expressions(n->children.child4);
+
+    switch (n->n_type) {
+        case BINARY_EXPR:
+            folded = fold_binary_expr(n, &c);
+            break;
+        case UNARY_EXPR:
+            folded = fold_unary_expr(n, &c);
+            break;
+        case CONDITIONAL_EXPR:
+            folded = fold_conditional_expr(n, &c);
+            break;
+        case CAST_EXPR:
+            folded = fold_cast_expr(n, &c);
+            break;
+        default:
+            folded = FALSE;
+            break;
+    }
+    if (folded) {
+        replace_with_constant(n, c);
+    }
+}
+
+/* helpers for fold_constant_expressions */
+Boolean node_constant(Node *n, IntegerConstant *c) {
+    enum data_type type;
+    if (n == NULL) {
+        return FALSE;
+    }
+    switch (n->n_type) {
+        case NUMBER_CONSTANT:
+            type = n->expr != NULL ? n->expr->type : NO_DATA_TYPE;
+            if (type == NO_DATA_TYPE) {
+                type = SIGNED_INT;
+            } else if (!is_integral_type(type)) {
+                return FALSE;
+            }
+            *c = make_integer_constant(n->data.num, type);
+            return TRUE;
+        case CHAR_CONSTANT:
+            /* a character constant has type int */
+            *c = convert_integer_constant(
+                    make_integer_constant((unsigned char) n->data.ch,
+                                            SIGNED_CHAR), SIGNED_INT);
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+Boolean fold_binary_expr(Node *n, IntegerConstant *c) {
+    IntegerConstant c1, c2;
+    int op = n->data.attributes[OPERATOR];
+
+    if (!node_constant(n->children.child1, &c1)) {
+        return FALSE;
+    }
+    /* the right operand is not evaluated when the left decides the result */
+    if (op == LOGICAL_AND && c1.bits == 0) {
+        *c = make_integer_constant(0, SIGNED_INT);
+        return TRUE;
+    }
+    if (op == LOGICAL_OR && c1.bits != 0) {
+        *c = make_integer_constant(1, SIGNED_INT);
+        return TRUE;
+    }
+    if (!node_constant(n->children.child2, &c2)) {
+        return FALSE;
+    }
+    return apply_binary_operator(op, c1, c2, c);
+}
+
+Boolean fold_unary_expr(Node *n, IntegerConstant *c) {
+    IntegerConstant c1;
+    if (!node_constant(n->children.child1, &c1)) {
+        return FALSE;
+    }
+    return apply_unary_operator(n->data.attributes[OPERATOR], c1, c);
+}
+
+Boolean fold_conditional_expr(Node *n, IntegerConstant *c) {
+    IntegerConstant c1, c2, c3;
+    enum data_type type;
+    if (!node_constant(n->children.child1, &c1) ||
+            !node_constant(n->children.child2, &c2) ||
+            !node_constant(n->children.child3, &c3)) {
+        return FALSE;
+    }
+    type = arithmetic_type(promoted_type(c2.type), promoted_type(c3.type));
+    *c = convert_integer_constant(c1.bits != 0 ? c2 : c3, type);
+    return TRUE;
+}
+
+/* the integral type named by a cast without pointer or array declarators */
+/*
+ * cast_target_type
+ * Purpose: the integral type a cast converts to
+ * Parameters:
+ *  type_name - Node * - the TYPE_NAME of a CAST_EXPR
+ *  type - enum data_type * - set to the type
+ * Returns:
+ *  FALSE when the cast is not to a plain integral type, e.g. to a pointer
+ * Side Effects:
+ *  None
+ */
+Boolean cast_target_type(Node *type_name, enum data_type *type) {
+    Node *spec;
+    if (type_name == NULL || type_name->n_type != TYPE_NAME ||
+            type_name->children.child2 != NULL) {
+        return FALSE;
+    }
+    spec = type_name->children.child1;
+    if (spec == NULL || spec->n_type != TYPE_SPECIFIER ||
+            !is_integral_type(spec->data.attributes[TYPE_SPEC])) {
+        return FALSE;
+    }
+    *type = spec->data.attributes[TYPE_SPEC];
+    return TRUE;
+}
+
+Boolean fold_cast_expr(Node *n, IntegerConstant *c) {
+    IntegerConstant c2;
+    enum data_type type;
+    if (!cast_target_type(n->children.child1, &type) ||
+            !node_constant(n->children.child2, &c2)) {
+        return FALSE;
+    }
+    *c = convert_integer_constant(c2, type);
+    return TRUE;
+}
+
+void replace_with_constant(Node *n, IntegerConstant c) {
+    n->n_type = NUMBER_CONSTANT;
+    n->data.num = operand_value(c);
+    n->expr->lvalue = FALSE;
+    n->expr->type = c.type;
+    n->children.child1 = NULL;
+    n->children.child2 = NULL;
+    n->children.child3 = NULL;
+    n->children.child4 = NULL;
+}
+
 /*
  * create_symbol_if_necessary
  * Purpose:
@@ -142,6 +142,18 @@ void attach_symbol(SymbolTable *st, Symbol *s, Symbol *prev) {
     s->symbol_table = st;
 }
 
+/* unlink s from the symbols of st, if it is there */
+void detach_symbol(SymbolTable *st, Symbol *s) {
+    Symbol **link;
+    for (link = &st->symbols; *link != NULL; link = &(*link)->next) {
+        if (*link == s) {
+            *link = s->next;
+            s->next = NULL;
+            return;
+        }
+    }
+}
+
 Symbol *st_symbols(SymbolTable *st) {
     return st->symbols;
 }
@@ -318,6 +330,8 @@ FunctionParameter *create_function_parameter() {
     FunctionParameter *fp;
     util_emalloc((void **) &fp, sizeof(FunctionParameter));
     fp->name = "";
+    fp->type_tree = NULL;
+    fp->next = NULL;
     return fp;
 }
 
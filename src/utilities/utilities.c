@@ -27,6 +27,27 @@ void util_emalloc(void **ptr, size_t n) {
     }
 }
 
+/*
+ * util_erealloc
+ * Purpose:
+ *      Resize heap memory previously obtained from util_emalloc.
+ * Parameters:
+ *      ptr - pointer to pointer to the memory. May point to NULL.
+ *      n - the new number of bytes.
+ * Returns:
+ *      None
+ * Side effects:
+ *      Sets the value of ptr.
+ *      Terminates program if realloc errors.
+ */
+void util_erealloc(void **ptr, size_t n) {
+    void *p;
+    if ( (p = realloc(*ptr, n)) == NULL ) {
+        util_handle_error(UE_MALLOC, "util_erealloc");
+    }
+    *ptr = p;
+}
+
 
 /*
  * util_handle_error
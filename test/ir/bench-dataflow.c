@@ -0,0 +1,152 @@
+/*
+ * Microbenchmark of the dataflow framework on synthetic procedures.
+ *
+ * Builds a procedure of straight line blocks ending in branches back to
+ * earlier blocks, so values stay live around loops, and times liveness,
+ * reaching definitions and available expressions over it with dense and
+ * with sparse sets. One procedure reuses a few hundred registers, as
+ * compute_ir's output does; the other defines a new register at every
+ * instruction, as SSA form does. There every definition reaches, and every
+ * expression is available in, all the code after it, so those two
+ * problems are only solved for the first procedure.
+ *
+ * Usage: ./bench-dataflow [instructions]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../../src/include/ir.h"
+#include "../../src/include/ir-cfg.h"
+#include "../../src/include/ir-dataflow.h"
+#include "../../src/include/symbol-utils.h"
+#include "../../src/include/utilities.h"
+
+#define BLOCK_SIZE 8
+#define LOOP_EVERY 4
+#define POOL_REGS 256
+/* how far back the older operand of an instruction may be defined */
+#define WINDOW 1024
+/* dense runs needing more memory than this are skipped */
+#define DENSE_MAX_BYTES (1024.0 * 1024 * 1024)
+
+IrList *synthetic_procedure(int num_instrs, Boolean unique);
+void time_clients(IrList *irl, enum df_representation rep, char *name,
+                    Boolean all_clients);
+
+
+int main(int argc, char *argv[]) {
+    int num_instrs = argc > 1 ? atoi(argv[1]) : 100000;
+    IrList *reuse = synthetic_procedure(num_instrs, FALSE);
+    IrList *unique = synthetic_procedure(num_instrs, TRUE);
+
+    printf("%d instruction procedures, %d registers reused / one per "
+            "definition\n", num_instrs, POOL_REGS);
+    time_clients(reuse, DF_DENSE, "reused registers, dense", TRUE);
+    time_clients(reuse, DF_SPARSE, "reused registers, sparse", TRUE);
+    time_clients(unique, DF_DENSE, "unique registers, dense", FALSE);
+    time_clients(unique, DF_SPARSE, "unique registers, sparse", FALSE);
+    return 0;
+}
+
+/*
+ * a procedure of blocks of BLOCK_SIZE instructions, every LOOP_EVERY-th
+ * ending in a branch back a few blocks. Each instruction adds two earlier
+ * values, the last one defined and one from up to WINDOW definitions back.
+ */
+IrList *synthetic_procedure(int num_instrs, Boolean unique) {
+    IrList *irl = create_ir_list();
+    IrNode **labels, *irn, *ret;
+    Symbol *proc = create_symbol();
+    int num_blocks = num_instrs / BLOCK_SIZE, b, i, reg = 0, dest;
+    char name[] = "synthetic";
+
+    set_symbol_name(proc, name);
+    srand(1);
+    util_emalloc((void **) &labels, (num_blocks + 1) * sizeof(IrNode *));
+    for (b = 0; b < num_blocks; b++) {
+        labels[b] = new_label();
+    }
+    ret = new_label();
+
+    irn = construct_ir_node(BEGIN_PROC);
+    irn->s = proc;
+    append_ir_node(irn, irl);
+    for (b = 0; b < num_blocks; b++) {
+        append_ir_node(labels[b], irl);
+        for (i = 0; i < BLOCK_SIZE - 1; i++) {
+            dest = unique ? reg++ : rand() % POOL_REGS;
+            if (reg < 2 && unique) {
+                irn = construct_ir_node(LOAD_CONSTANT);
+                irn->IMMVAL = i;
+            } else {
+                irn = construct_ir_node(ADD);
+                irn->OPRND1 = unique ? reg - 2 : rand() % POOL_REGS;
+                irn->OPRND2 = unique ? reg - 2 - rand() % (reg - 1 < WINDOW ?
+                                                reg - 1 : WINDOW) :
+                                        rand() % POOL_REGS;
+            }
+            irn->RDEST = dest;
+            append_ir_node(irn, irl);
+        }
+        if (b % LOOP_EVERY == LOOP_EVERY - 1) {
+            append_ir_node(irn_jump(JUMP_NEZ, irn->RDEST,
+                            labels[b - rand() % LOOP_EVERY]), irl);
+        } else {
+            irn = construct_ir_node(STORE_WORD_INDIRECT);
+            irn->RDEST = irl->tail->RDEST;
+            irn->RSRC = irl->tail->RDEST;
+            append_ir_node(irn, irl);
+        }
+    }
+    irn = construct_ir_node(RETURN_FROM_PROC);
+    irn->RSRC = irl->tail->RDEST;
+    irn->branch = ret;
+    append_ir_node(irn, irl);
+    append_ir_node(ret, irl);
+    irn = construct_ir_node(END_PROC);
+    irn->s = proc;
+    append_ir_node(irn, irl);
+    free(labels);
+    return irl;
+}
+
+/* solve each client problem over the procedure and print the times */
+void time_clients(IrList *irl, enum df_representation rep, char *name,
+                    Boolean all_clients) {
+    ControlFlowGraph *cfg = create_cfg(irl, irl->head);
+    Dataflow *lv;
+    ReachingDefs *rd;
+    AvailableExprs *ae;
+    clock_t start;
+
+    dataflow_representation = rep;
+    printf("%s:\n", name);
+    if (rep == DF_DENSE &&
+            4.0 * cfg->num_blocks * cfg->num_regs / 8 > DENSE_MAX_BYTES) {
+        printf("    skipped, dense sets would take %.0f MB\n",
+                4.0 * cfg->num_blocks * cfg->num_regs / 8 / (1024 * 1024));
+        free_cfg(cfg);
+        return;
+    }
+
+    start = clock();
+    lv = compute_liveness(cfg);
+    printf("    liveness              %8.3f s  %7d block visits\n",
+            (double) (clock() - start) / CLOCKS_PER_SEC, lv->visits);
+    free_dataflow(lv);
+    if (all_clients) {
+        start = clock();
+        rd = compute_reaching_defs(cfg);
+        printf("    reaching definitions  %8.3f s  %7d block visits\n",
+                (double) (clock() - start) / CLOCKS_PER_SEC, rd->df->visits);
+        free_reaching_defs(rd);
+
+        start = clock();
+        ae = compute_available_exprs(cfg);
+        printf("    available expressions %8.3f s  %7d block visits\n",
+                (double) (clock() - start) / CLOCKS_PER_SEC, ae->df->visits);
+        free_available_exprs(ae);
+    }
+    free_cfg(cfg);
+}
@@ -6,6 +6,12 @@
 
 extern "C" {
 #include "../../src/include/ir.h"
+#include "../../src/include/ir-cfg.h"
+#include "../../src/include/ir-dataflow.h"
+#include "../../src/include/ir-ssa.h"
+#include "../../src/include/ir-opt.h"
+#include "../../src/include/scope-fsm.h"
+#include "../../src/include/mips.h"
 
 #include "../../src/include/cmpl.h"
 #include "../../src/include/lexer.h"
@@ -95,10 +101,101 @@ class IrTest : public ::testing::Test {
         set_int_symbol(id_expr);
         char t[] = "1";
         create_num_constant(t);
-        root = create_node(BINARY_EXPR, LOGICAL_OR, id_expr, num_const);
+        root = create_node(BINARY_EXPR, BITWISE_OR, id_expr, num_const);
         compute_ir(root, ir_list);
     }
 
+    IrNode *emit(enum ir_instruction instr, int dest, int src, Symbol *s) {
+        IrNode *irn = construct_ir_node(instr);
+        irn->RDEST = dest;
+        irn->RSRC = src;
+        irn->s = s;
+        return append_ir_node(irn, ir_list);
+    }
+
+    Symbol *local_int(char name[]) {
+        SymbolTable *st = create_symbol_table(FUNCTION_SCOPE, OTHER_NAMES);
+        Symbol *s = create_symbol();
+        set_symbol_name(s, name);
+        push_symbol_type(s, SIGNED_INT);
+        append_symbol(st, s);
+        return s;
+    }
+
+    /*
+     * int f(void) { int x; if (1) x = 1; else x = 2; return x; }
+     * with compute_ir's memory accesses for x
+     */
+    IrNode *diamond_ir(Symbol *x) {
+        char f[] = "f";
+        Symbol *fs = create_symbol();
+        set_symbol_name(fs, f);
+        IrNode *begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, fs);
+        IrNode *els = new_label(), *join = new_label(), *ret = new_label();
+        append_ir_node(new_label(), ir_list);
+        emit(LOAD_CONSTANT, 0, NO_ARG, NULL)->IMMVAL = 1;
+        append_ir_node(irn_jump(JUMP_EQZ, 0, els), ir_list);
+        emit(LOAD_ADDRESS, 1, NO_ARG, x);
+        emit(LOAD_CONSTANT, 2, NO_ARG, NULL)->IMMVAL = 1;
+        emit(STORE_WORD_INDIRECT, 1, 2, NULL);
+        append_ir_node(irn_jump(JUMP, NO_ARG, join), ir_list);
+        append_ir_node(els, ir_list);
+        emit(LOAD_ADDRESS, 3, NO_ARG, x);
+        emit(LOAD_CONSTANT, 4, NO_ARG, NULL)->IMMVAL = 2;
+        emit(STORE_WORD_INDIRECT, 3, 4, NULL);
+        append_ir_node(join, ir_list);
+        emit(LOAD_ADDRESS, 5, NO_ARG, x);
+        emit(LOAD_WORD_INDIRECT, 6, 5, NULL);
+        emit(RETURN_FROM_PROC, NO_ARG, 6, NULL)->branch = ret;
+        append_ir_node(ret, ir_list);
+        emit(END_PROC, NO_ARG, NO_ARG, fs);
+        return begin;
+    }
+
+    /*
+     * int f(int n) { int i, s; s = 0; for (i = 0; i < n; i++) s = s + i;
+     * return s; } with n the constant bound unless that is NO_ARG
+     */
+    IrNode *counted_loop_ir(int bound) {
+        char f[] = "f";
+        Symbol *fs = create_symbol();
+        set_symbol_name(fs, f);
+        IrNode *begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, fs);
+        IrNode *top = new_label(), *done = new_label(), *ret = new_label();
+        append_ir_node(new_label(), ir_list);
+        if (bound == NO_ARG) {
+            emit(RECEIVED_PARAM, 2, NO_ARG, NULL)->IMMVAL = 0;
+        }
+        emit(LOAD_CONSTANT, 0, NO_ARG, NULL)->IMMVAL = 0;
+        emit(LOAD_CONSTANT, 1, NO_ARG, NULL)->IMMVAL = 0;
+        append_ir_node(top, ir_list);
+        if (bound != NO_ARG) {
+            emit(LOAD_CONSTANT, 2, NO_ARG, NULL)->IMMVAL = bound;
+        }
+        IrNode *test = emit(SET_LT, 3, NO_ARG, NULL);
+        test->OPRND1 = 0;
+        test->OPRND2 = 2;
+        append_ir_node(irn_jump(JUMP_EQZ, 3, done), ir_list);
+        IrNode *sum = emit(ADD, 1, NO_ARG, NULL);
+        sum->OPRND1 = 1;
+        sum->OPRND2 = 0;
+        emit(ADD_CONST, 0, 0, NULL)->IMMVAL = 1;
+        append_ir_node(irn_jump(JUMP, NO_ARG, top), ir_list);
+        append_ir_node(done, ir_list);
+        emit(RETURN_FROM_PROC, NO_ARG, 1, NULL)->branch = ret;
+        append_ir_node(ret, ir_list);
+        emit(END_PROC, NO_ARG, NO_ARG, fs);
+        return begin;
+    }
+
+    int count_instructions(enum ir_instruction instr) {
+        int n = 0;
+        for (IrNode *irn = ir_list->head; irn != NULL; irn = irn->next) {
+            n += instruction(irn) == instr;
+        }
+        return n;
+    }
+
     void ExpectIRNode(void) {
         IrNode *ir_node = construct_ir_node(LOAD_ADDR);
         EXPECT_EQ(LOAD_ADDR, instruction(ir_node));
@@ -154,7 +251,7 @@ TEST_F(IrTest, IrListBinaryExpression) {
     this->compute_ir_binary_expression();
     EXPECT_EQ(LOAD_ADDRESS, instruction(ir_list->head));
     EXPECT_EQ(LOAD_CONSTANT, instruction(ir_list->head->next));
-    EXPECT_EQ(LOG_OR, instruction(ir_list->tail));
+    EXPECT_EQ(BIT_OR, instruction(ir_list->tail));
 }
 
 TEST_F(IrTest, LValue) {
@@ -169,6 +266,1788 @@ TEST_F(IrTest, Return) {
     EXPECT_EQ(0, 0);
 }
 
+TEST_F(IrTest, ControlFlowGraph) {
+    char x[] = "x";
+    ControlFlowGraph *cfg = create_cfg(ir_list, diamond_ir(local_int(x)));
+    ASSERT_EQ(5, cfg->num_blocks);
+    BasicBlock *entry = cfg->blocks[0], *join = cfg->blocks[3];
+    EXPECT_EQ(2, entry->num_succs);
+    EXPECT_EQ(2, join->num_preds);
+    EXPECT_EQ(entry, join->idom);
+    EXPECT_EQ(1, cfg->blocks[1]->num_dom_frontier);
+    EXPECT_EQ(join, cfg->blocks[1]->dom_frontier[0]);
+    EXPECT_TRUE(dominates(entry, cfg->blocks[4]));
+    EXPECT_FALSE(dominates(cfg->blocks[1], join));
+    free_cfg(cfg);
+
+    /* top: a = 1; goto top; jumps back to the label's own IR label */
+    char top[] = "top", a[] = "a", one[] = "1";
+    Symbol *ls = create_symbol();
+    ir_list = create_ir_list();
+    set_data_string(top);
+    Node *label = create_node(NAMED_LABEL, data);
+    set_symbol_table_entry(label, ls);
+    set_data_string(top);
+    Node *target = create_node(NAMED_LABEL, data);
+    set_symbol_table_entry(target, ls);
+    create_id_expr(a);
+    set_int_symbol(id_expr);
+    create_num_constant(one);
+    assign_expr = create_node(ASSIGNMENT_EXPR, ASSIGN, id_expr, num_const);
+    compute_ir(create_node(LABELED_STATEMENT, label,
+                create_node(EXPRESSION_STATEMENT, assign_expr)), ir_list);
+    compute_ir(create_node(GOTO_STATEMENT, target), ir_list);
+    ASSERT_EQ(JUMP, instruction(ir_list->tail));
+    EXPECT_EQ(ir_list->head, ir_list->tail->branch);
+    EXPECT_EQ(LABEL, instruction(ir_list->head));
+    EXPECT_EQ(1, count_instructions(STORE_WORD_INDIRECT));
+}
+
+TEST_F(IrTest, ShortCircuit) {
+    char f[] = "f", a[] = "a", b[] = "b", zero[] = "0";
+    Symbol *fs = create_symbol();
+    set_symbol_name(fs, f);
+    IrNode *begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, fs), *ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    /* a || b > 0 */
+    create_id_expr(a);
+    set_int_symbol(id_expr);
+    Node *lhs = id_expr;
+    create_id_expr(b);
+    set_int_symbol(id_expr);
+    create_num_constant(zero);
+    root = create_node(BINARY_EXPR, LOGICAL_OR, lhs,
+                    create_node(BINARY_EXPR, GREATER_THAN, id_expr, num_const));
+    compute_ir(root, ir_list);
+    emit(RETURN_FROM_PROC, NO_ARG, root->expr->location, NULL)->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, fs);
+    EXPECT_EQ(0, count_instructions(LOG_OR));
+    EXPECT_EQ(0, count_instructions(SET_GT));
+
+    /* a true skips b: the result is 1 */
+    IrNode *irn = begin->next->next->next->next;
+    ASSERT_EQ(JUMP_NEZ, instruction(irn));
+    IrNode *one = irn->branch->next;
+    ASSERT_EQ(LOAD_CONSTANT, instruction(one));
+    EXPECT_EQ(1, one->IMMVAL);
+    /* b > 0 false is b <= 0: the result is 0 */
+    irn = irn->next->next->next;
+    ASSERT_EQ(JUMP_LEZ, instruction(irn));
+    IrNode *zero_load = irn->branch->next;
+    ASSERT_EQ(LOAD_CONSTANT, instruction(zero_load));
+    EXPECT_EQ(0, zero_load->IMMVAL);
+    EXPECT_EQ(root->expr->location, one->RDEST);
+    EXPECT_EQ(root->expr->location, zero_load->RDEST);
+
+    /* the result, defined on both paths, is joined by a PHI */
+    ControlFlowGraph *cfg = create_cfg(ir_list, begin);
+    construct_ssa(cfg);
+    ASSERT_EQ(1, count_instructions(PHI));
+    EXPECT_NE(one->RDEST, zero_load->RDEST);
+    DefUse *du = compute_def_use(cfg);
+    EXPECT_EQ(one, du[one->RDEST].def);
+    EXPECT_EQ(zero_load, du[zero_load->RDEST].def);
+    free_def_use(du, cfg->num_regs);
+    free_cfg(cfg);
+}
+
+TEST_F(IrTest, SsaConstruction) {
+    char x[] = "x";
+    ControlFlowGraph *cfg = create_cfg(ir_list, diamond_ir(local_int(x)));
+    construct_ssa(cfg);
+    EXPECT_EQ(0, count_instructions(LOAD_ADDRESS));
+    EXPECT_EQ(0, count_instructions(LOAD_WORD_INDIRECT));
+    EXPECT_EQ(0, count_instructions(STORE_WORD_INDIRECT));
+    ASSERT_EQ(1, count_instructions(PHI));
+
+    IrNode *phi = cfg->blocks[3]->first->next;
+    ASSERT_EQ(PHI, instruction(phi));
+    ASSERT_EQ(2, phi->num_phi_args);
+    EXPECT_NE(phi->phi_args[0].reg, phi->phi_args[1].reg);
+    EXPECT_EQ(phi->RDEST, phi->next->RSRC);
+
+    DefUse *du = compute_def_use(cfg);
+    EXPECT_EQ(phi, du[phi->RDEST].def);
+    EXPECT_EQ(1, du[phi->RDEST].num_uses);
+    free_def_use(du, cfg->num_regs);
+
+    destruct_ssa(cfg);
+    EXPECT_EQ(0, count_instructions(PHI));
+    EXPECT_EQ(3, count_instructions(MOVE));
+    free_cfg(cfg);
+}
+
+TEST_F(IrTest, IrListArithmetic) {
+    char a[] = "a", b[] = "b", one[] = "1";
+    create_id_expr(a);
+    set_int_symbol(id_expr);
+    Node *lhs = id_expr;
+    create_id_expr(b);
+    set_int_symbol(id_expr);
+    create_num_constant(one);
+    root = create_node(ASSIGNMENT_EXPR, ASSIGN, lhs,
+                    create_node(BINARY_EXPR, MINUS, id_expr, num_const));
+    compute_ir(root, ir_list);
+    IrNode *sub = ir_list->tail->prev;
+    ASSERT_EQ(SUB, instruction(sub));
+    /* the identifier's value is loaded, not its address used */
+    EXPECT_EQ(LOAD_WORD_INDIRECT, instruction(sub->prev));
+    EXPECT_EQ(sub->prev->RDEST, sub->OPRND1);
+    EXPECT_EQ(sub->RDEST, ir_list->tail->RSRC);
+}
+
+TEST_F(IrTest, ParseTreeConstantFolding) {
+    char three[] = "3", four[] = "4", big[] = "300", x[] = "x";
+    create_num_constant(three);
+    Node *lhs = num_const;
+    create_num_constant(four);
+    /* -(3 * 4) + (char) 300 */
+    Node *type_name = create_node(TYPE_NAME,
+                        create_node(TYPE_SPECIFIER, SIGNED_CHAR), NULL);
+    Node *product = create_node(BINARY_EXPR, ASTERISK, lhs, num_const);
+    create_num_constant(big);
+    root = create_node(BINARY_EXPR, PLUS,
+                    create_node(UNARY_EXPR, MINUS, product),
+                    create_node(CAST_EXPR, type_name, num_const));
+    fold_constant_expressions(root);
+    ASSERT_EQ(NUMBER_CONSTANT, root->n_type);
+    EXPECT_EQ(32, (long) root->data.num);
+    EXPECT_EQ(SIGNED_INT, root->expr->type);
+
+    /* division by zero is left for run time */
+    create_num_constant(three);
+    lhs = num_const;
+    create_num_constant(four);
+    root = create_node(BINARY_EXPR, DIVIDE, lhs,
+                    create_node(BINARY_EXPR, MINUS, num_const, num_const));
+    fold_constant_expressions(root);
+    EXPECT_EQ(BINARY_EXPR, root->n_type);
+    EXPECT_EQ(NUMBER_CONSTANT, root->children.child2->n_type);
+
+    /* 0 && x does not evaluate x */
+    create_id_expr(x);
+    set_int_symbol(id_expr);
+    create_num_constant(three);
+    root = create_node(BINARY_EXPR, LOGICAL_AND,
+                    create_node(BINARY_EXPR, MINUS, num_const, num_const),
+                    id_expr);
+    fold_constant_expressions(root);
+    ASSERT_EQ(NUMBER_CONSTANT, root->n_type);
+    EXPECT_EQ(0, (long) root->data.num);
+
+    /* the folder compares unsigned operands as sltu does at run time */
+    char umax[] = "4294967295", one[] = "1", sign[] = "2147483648";
+    char *values[] = { umax, one, sign };
+    int compares[] = { LESS_THAN, LESS_THAN_EQUAL, GREATER_THAN,
+                        GREATER_THAN_EQUAL };
+    int v;
+    for (int op = 0; op < 4; op++) {
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                Node *operands[2];
+                for (int k = 0; k < 2; k++) {
+                    create_num_constant(values[k == 0 ? i : j]);
+                    operands[k] = create_node(CAST_EXPR,
+                        create_node(TYPE_NAME,
+                            create_node(TYPE_SPECIFIER, UNSIGNED_INT), NULL),
+                        num_const);
+                }
+                root = create_node(BINARY_EXPR, compares[op], operands[0],
+                                    operands[1]);
+                compute_ir(root, ir_list);
+                IrNode *compare = ir_list->tail;
+                fold_constant_expressions(root);
+                ASSERT_EQ(NUMBER_CONSTANT, root->n_type);
+                ASSERT_TRUE(fold_binary_op(instruction(compare),
+                        (int) strtoul(values[i], NULL, 10),
+                        (int) strtoul(values[j], NULL, 10), &v));
+                EXPECT_EQ(v, (long) root->data.num);
+            }
+        }
+    }
+}
+
+TEST_F(IrTest, IntegerConstantSemantics) {
+    IntegerConstant minus_one = { 0xFFFFFFFFul, SIGNED_INT };
+    IntegerConstant one = { 1, UNSIGNED_INT };
+    IntegerConstant int_max = { 0x7FFFFFFFul, SIGNED_INT };
+    IntegerConstant r;
+    /* -1 converts to UINT_MAX, so it is not less than 1u */
+    ASSERT_TRUE(apply_binary_operator(LESS_THAN, minus_one, one, &r));
+    EXPECT_EQ(0, integer_constant_value(r));
+    ASSERT_TRUE(apply_binary_operator(BITWISE_RSHIFT, minus_one, one, &r));
+    EXPECT_EQ(-1, integer_constant_value(r));
+    EXPECT_FALSE(apply_binary_operator(PLUS, int_max, int_max, &r));
+    EXPECT_FALSE(apply_binary_operator(BITWISE_LSHIFT, one,
+                    convert_integer_constant(int_max, UNSIGNED_CHAR), &r));
+    ASSERT_TRUE(apply_binary_operator(PLUS,
+                    convert_integer_constant(int_max, UNSIGNED_INT), one, &r));
+    EXPECT_EQ(0x80000000ul, r.bits);
+    EXPECT_EQ(-1, integer_constant_value(
+                    convert_integer_constant(int_max, SIGNED_SHORT)));
+    EXPECT_EQ(255, integer_constant_value(
+                    convert_integer_constant(minus_one, UNSIGNED_CHAR)));
+}
+
+TEST_F(IrTest, ConstantFolding) {
+    int v;
+    EXPECT_TRUE(fold_binary_op(SUB, 3, 5, &v));
+    EXPECT_EQ(-2, v);
+    EXPECT_TRUE(fold_binary_op(SHIFT_RIGHT, -8, 1, &v));
+    EXPECT_EQ(-4, v);
+    EXPECT_TRUE(fold_binary_op(SET_LE, 4, 4, &v));
+    EXPECT_EQ(1, v);
+    EXPECT_FALSE(fold_binary_op(DIV, 1, 0, &v));
+    EXPECT_TRUE(fold_unary_op(LOG_NOT, 7, &v));
+    EXPECT_EQ(0, v);
+    EXPECT_TRUE(fold_jump(JUMP_LEZ, 0));
+    EXPECT_FALSE(fold_jump(JUMP_NEZ, 0));
+    /* -1 is the largest unsigned int */
+    EXPECT_TRUE(fold_binary_op(SET_GTU, -1, 5, &v));
+    EXPECT_EQ(1, v);
+    EXPECT_TRUE(fold_binary_op(SET_LTU, -1, 5, &v));
+    EXPECT_EQ(0, v);
+    EXPECT_TRUE(fold_binary_op(SET_GEU, 0, -1, &v));
+    EXPECT_EQ(0, v);
+
+    /* u > 5 on an unsigned u compares unsigned */
+    char u[] = "u", five[] = "5", zero[] = "0";
+    Symbol *us = create_symbol();
+    push_symbol_type(us, UNSIGNED_INT);
+    create_id_expr(u);
+    set_symbol_table_entry(id_expr, us);
+    create_num_constant(five);
+    compute_ir(create_node(BINARY_EXPR, GREATER_THAN, id_expr, num_const),
+                ir_list);
+    EXPECT_EQ(SET_GTU, instruction(ir_list->tail));
+
+    /* u > 0 && u <= 0 tests u != 0 and u == 0, not its sign */
+    create_id_expr(u);
+    set_symbol_table_entry(id_expr, us);
+    create_num_constant(zero);
+    Node *positive = create_node(BINARY_EXPR, GREATER_THAN, id_expr,
+                                    num_const);
+    create_id_expr(u);
+    set_symbol_table_entry(id_expr, us);
+    create_num_constant(zero);
+    compute_ir(create_node(BINARY_EXPR, LOGICAL_AND, positive,
+                create_node(BINARY_EXPR, LESS_THAN_EQUAL, id_expr, num_const)),
+                ir_list);
+    EXPECT_EQ(1, count_instructions(JUMP_EQZ));
+    EXPECT_EQ(1, count_instructions(JUMP_NEZ));
+    EXPECT_EQ(0, count_instructions(JUMP_LEZ));
+    EXPECT_EQ(0, count_instructions(JUMP_GEZ));
+}
+
+TEST_F(IrTest, SparseConditionalConstantPropagation) {
+    char x[] = "x";
+    ControlFlowGraph *cfg = create_cfg(ir_list, diamond_ir(local_int(x)));
+    construct_ssa(cfg);
+    /* the condition is the constant 1, so only the then branch is taken */
+    EXPECT_LT(0, propagate_constants(cfg));
+    EXPECT_EQ(0, count_instructions(JUMP_EQZ));
+    EXPECT_EQ(0, count_instructions(PHI));
+    EXPECT_EQ(4, cfg->num_blocks);
+
+    IrNode *ret = cfg->end_proc->prev->prev;
+    ASSERT_EQ(RETURN_FROM_PROC, instruction(ret));
+    DefUse *du = compute_def_use(cfg);
+    IrNode *def = du[ret->RSRC].def;
+    ASSERT_EQ(LOAD_CONSTANT, instruction(def));
+    EXPECT_EQ(1, def->IMMVAL);
+    free_def_use(du, cfg->num_regs);
+    free_cfg(cfg);
+
+    /*
+     * a loop test nothing defines may be anything: the loop may go round,
+     * so its PHIs are not the constants they start as
+     */
+    ir_list = create_ir_list();
+    IrNode *begin = counted_loop_ir(NO_ARG);
+    IrNode *test = begin;
+    while (instruction(test) != SET_LT) {
+        test = test->next;
+    }
+    test->prev->next = test->next;
+    test->next->prev = test->prev;
+    cfg = create_cfg(ir_list, begin);
+    construct_ssa(cfg);
+    EXPECT_EQ(0, propagate_constants(cfg));
+    EXPECT_EQ(2, count_instructions(PHI));
+    EXPECT_EQ(1, count_instructions(JUMP_EQZ));
+    free_cfg(cfg);
+}
+
+TEST_F(IrTest, SsaEscapingVariable) {
+    char x[] = "x";
+    Symbol *xs = local_int(x);
+    IrNode *begin = diamond_ir(xs);
+    /* passing &x to a call keeps x in memory */
+    IrNode *param = construct_ir_node(PARAM);
+    param->RSRC = 5;
+    insert_ir_node_after(ir_list->tail->prev->prev->prev->prev, param,
+                            ir_list);
+    ControlFlowGraph *cfg = create_cfg(ir_list, begin);
+    construct_ssa(cfg);
+    EXPECT_EQ(0, count_instructions(PHI));
+    EXPECT_EQ(2, count_instructions(STORE_WORD_INDIRECT));
+    free_cfg(cfg);
+}
+
+TEST_F(IrTest, BitSets) {
+    /* the same operations on a dense and a sparse set agree */
+    BitSet *dense = new_bitset(200, FALSE), *sparse = new_bitset(200, TRUE);
+    BitSet *dense_other = new_bitset(200, FALSE);
+    BitSet *sparse_other = new_bitset(200, TRUE);
+    int members[] = {0, 63, 64, 130, 199}, i, n;
+    for (i = 0; i < 5; i++) {
+        bitset_add(dense, members[i]);
+        bitset_add(sparse, members[i]);
+    }
+    bitset_add(dense_other, 64);
+    bitset_add(sparse_other, 64);
+    bitset_add(dense_other, 100);
+    bitset_add(sparse_other, 100);
+    for (i = 0, n = bitset_next(sparse, 0); i < 5; i++) {
+        EXPECT_EQ(members[i], bitset_next(dense, n));
+        EXPECT_EQ(members[i], n);
+        n = bitset_next(sparse, n + 1);
+    }
+    EXPECT_EQ(NO_ARG, n);
+    EXPECT_TRUE(bitset_union(dense, dense_other));
+    EXPECT_TRUE(bitset_union(sparse, sparse_other));
+    EXPECT_FALSE(bitset_union(sparse, sparse_other));
+    EXPECT_EQ(6, bitset_count(dense));
+    EXPECT_EQ(6, bitset_count(sparse));
+    EXPECT_TRUE(bitset_intersect(dense, dense_other));
+    EXPECT_TRUE(bitset_intersect(sparse, sparse_other));
+    EXPECT_TRUE(bitset_equal(dense, dense_other));
+    EXPECT_TRUE(bitset_equal(sparse, sparse_other));
+    /* out = gen | (in - kill) */
+    bitset_clear(dense_other);
+    bitset_clear(sparse_other);
+    bitset_add(dense_other, 5);
+    bitset_add(sparse_other, 5);
+    bitset_remove(dense, 100);
+    bitset_remove(sparse, 100);
+    bitset_fill(dense);
+    bitset_fill(sparse);
+    BitSet *dense_out = new_bitset(200, FALSE);
+    BitSet *sparse_out = new_bitset(200, TRUE);
+    EXPECT_TRUE(bitset_transfer(dense_out, dense, dense_other, dense_other));
+    EXPECT_TRUE(bitset_transfer(sparse_out, sparse, sparse_other,
+                                sparse_other));
+    EXPECT_EQ(200, bitset_count(dense_out));
+    EXPECT_EQ(200, bitset_count(sparse_out));
+    EXPECT_FALSE(bitset_contains(sparse_out, 200));
+    EXPECT_FALSE(bitset_transfer(dense_out, dense, dense_other, dense_other));
+    free_bitset(dense);
+    free_bitset(sparse);
+    free_bitset(dense_other);
+    free_bitset(sparse_other);
+    free_bitset(dense_out);
+    free_bitset(sparse_out);
+}
+
+TEST_F(IrTest, DataflowClients) {
+    char f[] = "f";
+    Symbol *fs = create_symbol();
+    set_symbol_name(fs, f);
+    IrNode *begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, fs);
+    IrNode *els = new_label(), *join = new_label(), *ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    /* r0 + r0 is computed on both paths, r1 + r0 only before r1 changes */
+    emit(LOAD_CONSTANT, 0, NO_ARG, NULL)->IMMVAL = 1;
+    IrNode *sum = emit(ADD, 1, NO_ARG, NULL);
+    sum->OPRND1 = 0;
+    sum->OPRND2 = 0;
+    IrNode *killed = emit(ADD, 2, NO_ARG, NULL);
+    killed->OPRND1 = 1;
+    killed->OPRND2 = 0;
+    append_ir_node(irn_jump(JUMP_EQZ, 0, els), ir_list);
+    emit(LOAD_CONSTANT, 1, NO_ARG, NULL)->IMMVAL = 3;
+    append_ir_node(irn_jump(JUMP, NO_ARG, join), ir_list);
+    append_ir_node(els, ir_list);
+    emit(LOAD_CONSTANT, 3, NO_ARG, NULL)->IMMVAL = 2;
+    append_ir_node(join, ir_list);
+    IrNode *again = emit(ADD, 4, NO_ARG, NULL);
+    again->OPRND1 = 0;
+    again->OPRND2 = 0;
+    emit(RETURN_FROM_PROC, NO_ARG, 1, NULL)->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, fs);
+
+    ControlFlowGraph *cfg = create_cfg(ir_list, begin);
+    ASSERT_EQ(5, cfg->num_blocks);
+    enum df_representation reps[] = {DF_DENSE, DF_SPARSE};
+    for (int r = 0; r < 2; r++) {
+        dataflow_representation = reps[r];
+        Dataflow *lv = compute_liveness(cfg);
+        EXPECT_EQ(1, bitset_count(lv->in[1]));
+        EXPECT_TRUE(bitset_contains(lv->in[1], 0));
+        EXPECT_EQ(2, bitset_count(lv->out[0]));
+        EXPECT_TRUE(bitset_contains(lv->in[3], 1));
+        EXPECT_EQ(0, bitset_count(lv->out[3]));
+        free_dataflow(lv);
+
+        /* both definitions of r1 reach the join */
+        ReachingDefs *rd = compute_reaching_defs(cfg);
+        int i, r1_defs = 0;
+        FOR_EACH_BIT(i, rd->df->in[3]) {
+            r1_defs += rd->defs[i]->RDEST == 1;
+        }
+        EXPECT_EQ(2, r1_defs);
+        EXPECT_EQ(5, bitset_count(rd->df->in[3]));
+        free_reaching_defs(rd);
+
+        AvailableExprs *ae = compute_available_exprs(cfg);
+        EXPECT_EQ(find_expr(ae, sum), find_expr(ae, again));
+        EXPECT_TRUE(bitset_contains(ae->df->in[3], find_expr(ae, again)));
+        EXPECT_TRUE(bitset_contains(ae->df->in[2], find_expr(ae, killed)));
+        EXPECT_FALSE(bitset_contains(ae->df->in[3], find_expr(ae, killed)));
+        free_available_exprs(ae);
+    }
+    dataflow_representation = DF_AUTO;
+    free_cfg(cfg);
+}
+
+TEST_F(IrTest, DeadCodeElimination) {
+    char x[] = "x";
+    IrNode *begin = diamond_ir(local_int(x));
+    IrNode *ret = ir_list->tail->prev->prev;
+    /* an unused sum before the return and a store after it */
+    IrNode *seven = construct_ir_node(LOAD_CONSTANT);
+    seven->RDEST = 7;
+    seven->IMMVAL = 7;
+    IrNode *sum = construct_ir_node(ADD);
+    sum->RDEST = 8;
+    sum->OPRND1 = 6;
+    sum->OPRND2 = 7;
+    insert_ir_node_before(ret, seven, ir_list);
+    insert_ir_node_before(ret, sum, ir_list);
+    IrNode *after = construct_ir_node(STORE_WORD_INDIRECT);
+    after->RDEST = 5;
+    after->RSRC = 6;
+    insert_ir_node_after(ret, after, ir_list);
+
+    ControlFlowGraph *cfg = create_cfg(ir_list, begin);
+    /* the sum and its operand, the unreachable store and its label */
+    EXPECT_EQ(4, eliminate_dead_code(cfg));
+    EXPECT_EQ(0, count_instructions(ADD));
+    EXPECT_EQ(2, count_instructions(STORE_WORD_INDIRECT));
+    EXPECT_EQ(1, count_instructions(LOAD_WORD_INDIRECT));
+    EXPECT_EQ(0, eliminate_dead_code(cfg));
+    free_cfg(cfg);
+}
+
+TEST_F(IrTest, ValueNumbering) {
+    char f[] = "f", g[] = "g";
+    Symbol *fs = create_symbol(), *gs = create_symbol();
+    set_symbol_name(fs, f);
+    set_symbol_name(gs, g);
+    IrNode *begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, fs);
+    IrNode *ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    /* g + g, then g again after a store to it */
+    emit(LOAD_ADDRESS, 0, NO_ARG, gs);
+    emit(LOAD_ADDRESS, 1, NO_ARG, gs);
+    emit(LOAD_WORD_INDIRECT, 2, 1, NULL);
+    emit(LOAD_WORD_INDIRECT, 3, 0, NULL);
+    IrNode *sum = emit(ADD, 4, NO_ARG, NULL);
+    sum->OPRND1 = 2;
+    sum->OPRND2 = 3;
+    emit(STORE_WORD_INDIRECT, 0, 4, NULL);
+    IrNode *reload = emit(LOAD_WORD_INDIRECT, 5, 1, NULL);
+    emit(RETURN_FROM_PROC, NO_ARG, 5, NULL)->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, fs);
+
+    ControlFlowGraph *cfg = create_cfg(ir_list, begin);
+    EXPECT_EQ(2, number_values(cfg));
+    EXPECT_EQ(1, count_instructions(LOAD_ADDRESS));
+    EXPECT_EQ(2, count_instructions(LOAD_WORD_INDIRECT));
+    EXPECT_EQ(sum->OPRND1, sum->OPRND2);
+    EXPECT_EQ(0, reload->RSRC);
+    free_cfg(cfg);
+}
+
+TEST_F(IrTest, RedundantLoadStoreElimination) {
+    char f[] = "f", g[] = "g", x[] = "x";
+    Symbol *fs = create_symbol(), *gs = create_symbol(), *xs = local_int(x);
+    set_symbol_name(fs, f);
+    set_symbol_name(gs, g);
+    push_symbol_type(gs, SIGNED_INT);
+    IrNode *begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, fs);
+    IrNode *ret_label = new_label();
+    append_ir_node(new_label(), ir_list);
+    /* g = 1; g = 2; x = g; return g; with x a local never read */
+    emit(LOAD_ADDRESS, 0, NO_ARG, gs);
+    emit(LOAD_CONSTANT, 1, NO_ARG, NULL)->IMMVAL = 1;
+    emit(STORE_WORD_INDIRECT, 0, 1, NULL);
+    emit(LOAD_CONSTANT, 2, NO_ARG, NULL)->IMMVAL = 2;
+    emit(STORE_WORD_INDIRECT, 0, 2, NULL);
+    emit(LOAD_WORD_INDIRECT, 3, 0, NULL);
+    emit(LOAD_ADDRESS, 4, NO_ARG, xs);
+    emit(STORE_WORD_INDIRECT, 4, 3, NULL);
+    emit(LOAD_WORD_INDIRECT, 5, 0, NULL);
+    IrNode *ret = emit(RETURN_FROM_PROC, NO_ARG, 5, NULL);
+    ret->branch = ret_label;
+    append_ir_node(ret_label, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, fs);
+
+    ControlFlowGraph *cfg = create_cfg(ir_list, begin);
+    /* both loads, the overwritten store to g and the store to x */
+    EXPECT_EQ(4, optimize_memory(cfg));
+    EXPECT_EQ(0, count_instructions(LOAD_WORD_INDIRECT));
+    ASSERT_EQ(1, count_instructions(STORE_WORD_INDIRECT));
+    EXPECT_EQ(2, ret->RSRC);
+    free_cfg(cfg);
+}
+
+TEST_F(IrTest, RegisterAllocation) {
+    char f[] = "f", p[] = "p";
+    Symbol *fs = create_symbol(), *ps = create_symbol();
+    set_symbol_name(fs, f);
+    set_symbol_name(ps, p);
+    IrNode *begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, fs);
+    IrNode *ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    /* twenty constants live at once, more than there are registers */
+    for (int i = 0; i < 20; i++) {
+        emit(LOAD_CONSTANT, i, NO_ARG, NULL)->IMMVAL = i;
+    }
+    /* r0 is live across the call, r20 only passed to it */
+    emit(LOAD_CONSTANT, 20, NO_ARG, NULL)->IMMVAL = 20;
+    emit(BEGIN_CALL, NO_ARG, NO_ARG, ps);
+    IrNode *param = emit(PARAM, 0, 20, NULL);
+    emit(CALL, NO_ARG, NO_ARG, ps);
+    emit(END_CALL, NO_ARG, NO_ARG, ps);
+    for (int i = 1; i < 20; i++) {
+        IrNode *sum = emit(ADD, 20 + i, NO_ARG, NULL);
+        sum->OPRND1 = i == 1 ? 0 : 19 + i;
+        sum->OPRND2 = i;
+    }
+    emit(MOVE, 40, 39, NULL);
+    IrNode *r = emit(RETURN_FROM_PROC, NO_ARG, 40, NULL);
+    r->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, fs);
+
+    RegisterAssignment ra;
+    ControlFlowGraph *cfg = create_cfg(ir_list, begin);
+    allocate_registers(cfg, &ra);
+    EXPECT_LT(0, ra.num_spill_slots);
+    EXPECT_EQ(ra.num_spill_slots, count_instructions(STORE_WORD));
+    EXPECT_LE(ra.num_spill_slots, count_instructions(LOAD_WORD));
+    EXPECT_TRUE(ra.saved_used[0]);
+    /* the argument and result are computed in place, the copy is gone */
+    EXPECT_EQ(REG_A0, param->RSRC);
+    EXPECT_EQ(REG_V0, r->RSRC);
+    EXPECT_EQ(0, count_instructions(MOVE));
+    for (IrNode *irn = begin; irn != NULL; irn = irn->next) {
+        int *regs[MAX_USES + 1], n = ir_node_uses(irn, regs);
+        int *def = ir_node_def(irn);
+        if (def != NULL) {
+            regs[n++] = def;
+        }
+        for (int i = 0; i < n; i++) {
+            EXPECT_STRNE("$?", mips_reg_name(*regs[i]));
+            EXPECT_NE(REG_SP, *regs[i]);
+            EXPECT_NE(REG_FP, *regs[i]);
+        }
+    }
+    free_cfg(cfg);
+}
+
+TEST_F(IrTest, StackFrameLayout) {
+    char f[] = "f", x[] = "x", b[] = "b", c[] = "c";
+    Symbol *fs = create_symbol(), *xs = local_int(x);
+    Symbol *bs = create_symbol(), *cs = create_symbol();
+    set_symbol_name(fs, f);
+    /* int b[3] and int c in sibling blocks within x's scope */
+    SymbolTable *then_st = create_symbol_table(FUNCTION_SCOPE + 1, OTHER_NAMES);
+    SymbolTable *else_st = create_symbol_table(FUNCTION_SCOPE + 1, OTHER_NAMES);
+    then_st->enclosing = else_st->enclosing = get_symbol_table(xs);
+    set_symbol_name(bs, b);
+    push_symbol_type(bs, SIGNED_INT);
+    push_symbol_type(bs, ARRAY);
+    set_symbol_array_size(bs, 3);
+    append_symbol(then_st, bs);
+    set_symbol_name(cs, c);
+    push_symbol_type(cs, SIGNED_INT);
+    append_symbol(else_st, cs);
+
+    IrNode *begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, fs);
+    IrNode *ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    emit(LOAD_ADDRESS, REG_T0, NO_ARG, bs);
+    emit(LOAD_ADDRESS, REG_T0, NO_ARG, xs);
+    emit(LOAD_ADDRESS, REG_T0, NO_ARG, cs);
+    /* slots 0 and 1 are never live at once, slot 2 overlaps both */
+    emit(STORE_WORD, NO_ARG, REG_T0, NULL)->IMMVAL = 2;
+    emit(STORE_WORD, NO_ARG, REG_T0, NULL)->IMMVAL = 0;
+    emit(LOAD_WORD, REG_T0 + 1, NO_ARG, NULL)->IMMVAL = 0;
+    emit(STORE_WORD, NO_ARG, REG_T0, NULL)->IMMVAL = 1;
+    emit(LOAD_WORD, REG_T0 + 1, NO_ARG, NULL)->IMMVAL = 1;
+    emit(LOAD_WORD, REG_T0 + 1, NO_ARG, NULL)->IMMVAL = 2;
+    emit(RETURN_FROM_PROC, NO_ARG, NO_ARG, NULL)->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, fs);
+
+    ControlFlowGraph *cfg = create_cfg(ir_list, begin);
+    RegisterAssignment ra;
+    FrameLayout fl;
+    int offset;
+    for (int i = 0; i < NUM_SAVED_REGS; i++) {
+        ra.saved_used[i] = i == 3 ? TRUE : FALSE;
+    }
+    ra.num_spill_slots = 3;
+    layout_frame(cfg, &ra, &fl);
+    /* a leaf: $fp, $s3, x, b or c, two spill words and no outgoing area */
+    EXPECT_FALSE(fl.saves_ra);
+    EXPECT_EQ(-4, fl.saved_offset[3]);
+    ASSERT_TRUE(local_offset(&fl, xs, &offset));
+    EXPECT_EQ(-8, offset);
+    ASSERT_TRUE(local_offset(&fl, bs, &offset));
+    EXPECT_EQ(-20, offset);
+    ASSERT_TRUE(local_offset(&fl, cs, &offset));
+    EXPECT_EQ(-12, offset);
+    EXPECT_EQ(2, fl.num_spill_words);
+    EXPECT_EQ(fl.spill_offset[0], fl.spill_offset[1]);
+    EXPECT_NE(fl.spill_offset[0], fl.spill_offset[2]);
+    EXPECT_EQ(0, fl.outgoing_bytes);
+    EXPECT_EQ(32, fl.size);
+    EXPECT_GE(fl.spill_offset[2], 4 - fl.size);
+    free_frame_layout(&fl);
+    free_cfg(cfg);
+}
+
+TEST_F(IrTest, TailCalls) {
+    char f[] = "f", g[] = "g", x[] = "x";
+    Symbol *fs = create_symbol(), *gs = create_symbol(), *xs = local_int(x);
+    set_symbol_name(fs, f);
+    set_symbol_name(gs, g);
+    /* return g(10); then return g(&x); then return f(); */
+    Symbol *callees[] = {gs, gs, fs};
+    int expected[] = {1, 0, 1};
+    for (int k = 0; k < 3; k++) {
+        IrNode *begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, fs);
+        IrNode *ret = new_label(), *entry = new_label();
+        append_ir_node(entry, ir_list);
+        emit(BEGIN_CALL, NO_ARG, NO_ARG, callees[k]);
+        if (k == 0) {
+            emit(LOAD_CONSTANT, 1, NO_ARG, NULL)->IMMVAL = 10;
+            emit(PARAM, 0, 1, NULL);
+        } else if (k == 1) {
+            emit(LOAD_ADDRESS, 1, NO_ARG, xs);
+            emit(PARAM, 0, 1, NULL);
+        }
+        emit(CALL, NO_ARG, NO_ARG, callees[k]);
+        emit(END_CALL, NO_ARG, NO_ARG, callees[k]);
+        emit(RETURNED_WORD, 2, NO_ARG, NULL);
+        emit(RETURN_FROM_PROC, NO_ARG, 2, NULL)->branch = ret;
+        append_ir_node(ret, ir_list);
+        emit(END_PROC, NO_ARG, NO_ARG, fs);
+
+        ControlFlowGraph *cfg = create_cfg(ir_list, begin);
+        EXPECT_EQ(expected[k], convert_tail_calls(cfg));
+        free_cfg(cfg);
+        int calls = 0, tail_calls = 0, jumps = 0;
+        for (IrNode *irn = begin; irn != ret; irn = irn->next) {
+            calls += instruction(irn) == CALL || instruction(irn) == BEGIN_CALL;
+            if (instruction(irn) == TAIL_CALL) {
+                tail_calls++;
+                EXPECT_EQ(gs, irn->s);
+                EXPECT_EQ(ret, irn->branch);
+            } else if (instruction(irn) == JUMP) {
+                jumps++;
+                /* the recursion becomes a loop back to the start */
+                EXPECT_EQ(entry, irn->branch);
+            }
+        }
+        EXPECT_EQ(k == 1 ? 2 : 0, calls);
+        EXPECT_EQ(k == 0 ? 1 : 0, tail_calls);
+        EXPECT_EQ(k == 2 ? 1 : 0, jumps);
+    }
+}
+
+TEST_F(IrTest, CallingConvention) {
+    char f[] = "f", g[] = "g", a[] = "a", b[] = "b", two[] = "2";
+    Symbol *fs = create_symbol(), *gs = create_symbol();
+    Symbol *as = local_int(a), *bs = create_symbol();
+    set_symbol_name(fs, f);
+    push_symbol_type(fs, SIGNED_INT);
+    push_symbol_type(fs, FUNCTION);
+    set_symbol_name(gs, g);
+    push_symbol_type(gs, SIGNED_INT);
+    push_symbol_type(gs, FUNCTION);
+    set_symbol_name(bs, b);
+    push_symbol_type(bs, SIGNED_INT);
+    append_symbol(get_symbol_table(as), bs);
+
+    /* f(a, 2, g(a)): every argument is computed before any is passed */
+    create_id_expr(g);
+    set_symbol_table_entry(id_expr, gs);
+    Node *callee = id_expr;
+    create_id_expr(a);
+    set_symbol_table_entry(id_expr, as);
+    Node *inner = create_node(FUNCTION_CALL, callee, id_expr);
+    create_id_expr(f);
+    set_symbol_table_entry(id_expr, fs);
+    callee = id_expr;
+    create_id_expr(a);
+    set_symbol_table_entry(id_expr, as);
+    create_num_constant(two);
+    Node *args = create_node(BINARY_EXPR, COMMA,
+                    create_node(BINARY_EXPR, COMMA, id_expr, num_const), inner);
+    compute_ir(create_node(FUNCTION_CALL, callee, args), ir_list);
+    EXPECT_EQ(4, count_instructions(PARAM));
+    IrNode *call = ir_list->tail->prev->prev;
+    ASSERT_EQ(CALL, instruction(call));
+    EXPECT_EQ(fs, call->s);
+    IrNode *irn = call->prev;
+    for (int i = 2; i >= 0; i--, irn = irn->prev) {
+        ASSERT_EQ(PARAM, instruction(irn));
+        EXPECT_EQ(i, irn->RDEST);
+    }
+    EXPECT_EQ(RETURNED_WORD, instruction(irn));
+    EXPECT_EQ(irn->RDEST, call->prev->RSRC);
+    EXPECT_EQ(RETURNED_WORD, instruction(ir_list->tail));
+
+    /* int f(int a, int b): a is live across a call, b is not */
+    FunctionParameter *fp = create_function_parameter();
+    set_parameter_name(fp, b);
+    fp->next = NULL;
+    fp = push_function_parameter(fp);
+    set_parameter_name(fp, a);
+    set_symbol_func_params(fs, fp);
+    IrNode *begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, fs);
+    IrNode *ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    IrNode *pa = emit(RECEIVED_PARAM, 0, NO_ARG, NULL);
+    IrNode *pb = emit(RECEIVED_PARAM, 1, NO_ARG, NULL);
+    pa->IMMVAL = 0;
+    pb->IMMVAL = 1;
+    emit(LOAD_ADDRESS, 2, NO_ARG, bs);
+    emit(STORE_WORD_INDIRECT, 2, 1, NULL);
+    emit(BEGIN_CALL, NO_ARG, NO_ARG, gs);
+    emit(CALL, NO_ARG, NO_ARG, gs);
+    emit(END_CALL, NO_ARG, NO_ARG, gs);
+    emit(RETURN_FROM_PROC, NO_ARG, 0, NULL)->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, fs);
+
+    RegisterAssignment ra;
+    FrameLayout fl;
+    int offset;
+    ControlFlowGraph *cfg = create_cfg(ir_list, begin);
+    allocate_registers(cfg, &ra);
+    EXPECT_EQ(REG_S0, pa->RDEST);
+    EXPECT_EQ(REG_A0 + 1, pb->RDEST);
+    /* b is kept in its word of the caller's argument area */
+    layout_frame(cfg, &ra, &fl);
+    ASSERT_TRUE(local_offset(&fl, bs, &offset));
+    EXPECT_EQ(8, offset);
+    EXPECT_EQ(16, fl.outgoing_bytes);
+    free_frame_layout(&fl);
+    free_cfg(cfg);
+}
+
+TEST_F(IrTest, InstructionSelection) {
+    char f[] = "f", a[] = "a", g[] = "g";
+    Symbol *fs = create_symbol(), *gs = create_symbol();
+    set_symbol_name(fs, f);
+    push_symbol_type(fs, SIGNED_INT);
+    push_symbol_type(fs, FUNCTION);
+    FunctionParameter *fp = create_function_parameter();
+    set_parameter_name(fp, a);
+    fp->next = NULL;
+    set_symbol_func_params(fs, fp);
+    set_symbol_name(gs, g);
+    push_symbol_type(gs, SIGNED_INT);
+
+    /* int f(int a) { g = a + 5; if (a != g) return 70000; return 0; } */
+    IrNode *begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, fs);
+    IrNode *ret = new_label(), *zero = new_label();
+    append_ir_node(new_label(), ir_list);
+    emit(RECEIVED_PARAM, 0, NO_ARG, NULL)->IMMVAL = 0;
+    emit(LOAD_CONSTANT, 1, NO_ARG, NULL)->IMMVAL = 5;
+    IrNode *sum = emit(ADD, 2, NO_ARG, NULL);
+    sum->OPRND1 = 0;
+    sum->OPRND2 = 1;
+    emit(LOAD_ADDRESS, 3, NO_ARG, gs);
+    emit(STORE_WORD_INDIRECT, 3, 2, NULL);
+    IrNode *diff = emit(BIT_XOR, 4, NO_ARG, NULL);
+    diff->OPRND1 = 0;
+    diff->OPRND2 = 2;
+    append_ir_node(irn_jump(JUMP_EQZ, 4, zero), ir_list);
+    append_ir_node(new_label(), ir_list);
+    emit(LOAD_CONSTANT, 5, NO_ARG, NULL)->IMMVAL = 70000;
+    emit(RETURN_FROM_PROC, NO_ARG, 5, NULL)->branch = ret;
+    append_ir_node(zero, ir_list);
+    emit(LOAD_CONSTANT, 6, NO_ARG, NULL)->IMMVAL = 0;
+    emit(RETURN_FROM_PROC, NO_ARG, 6, NULL)->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, fs);
+
+    RegisterAssignment ra;
+    FrameLayout fl;
+    MipsList ml;
+    ControlFlowGraph *cfg = create_cfg(ir_list, begin);
+    allocate_registers(cfg, &ra);
+    layout_frame(cfg, &ra, &fl);
+    ml.head = ml.tail = NULL;
+    /* 5, the address of g and the comparison become operands */
+    EXPECT_EQ(3, select_instructions(cfg, &ra, &fl, &ml));
+    int addiu = 0, sw = 0, beq = 0, lui = 0, ori = 0, xor_ = 0;
+    for (MipsInstr *mi = ml.head; mi != NULL; mi = mi->next) {
+        if (mi->op == MIPS_ADDIU && mi->imm == 5) {
+            addiu++;
+        } else if (mi->op == MIPS_SW && mi->s == gs) {
+            sw++;
+        } else if (mi->op == MIPS_BEQ) {
+            beq++;
+        } else if (mi->op == MIPS_LUI) {
+            EXPECT_EQ(1, mi->imm);
+            lui++;
+        } else if (mi->op == MIPS_ORI && mi->imm == 70000 - 65536) {
+            ori++;
+        } else if (mi->op == MIPS_XOR || mi->op == MIPS_LA) {
+            xor_++;
+        }
+    }
+    EXPECT_EQ(1, addiu);
+    EXPECT_EQ(1, sw);
+    EXPECT_EQ(1, beq);
+    EXPECT_EQ(1, lui);
+    EXPECT_EQ(1, ori);
+    EXPECT_EQ(0, xor_);
+    free_mips_list(&ml);
+    free_frame_layout(&fl);
+    free_cfg(cfg);
+}
+
+TEST_F(IrTest, PeepholeOptimization) {
+    MipsList ml;
+    MipsInstr *mi;
+    int hits[NUM_PEEPHOLE_RULES];
+    ml.head = ml.tail = NULL;
+    /* move $t0, $t0 */
+    append_mips_instr(construct_mips_instr(MIPS_MOVE, REG_T0, REG_T0, NO_ARG,
+                        0), &ml);
+    /* li $t1, 7; or $a0, $t0, $t1, with $t1 dead after the call */
+    append_mips_instr(construct_mips_instr(MIPS_LI, REG_T0 + 1, NO_ARG, NO_ARG,
+                        7), &ml);
+    MipsInstr *ori = construct_mips_instr(MIPS_OR, REG_A0, REG_T0, REG_T0 + 1,
+                        0);
+    append_mips_instr(ori, &ml);
+    mi = construct_mips_instr(MIPS_JAL, NO_ARG, NO_ARG, NO_ARG, 0);
+    mi->label = 9;
+    append_mips_instr(mi, &ml);
+    /* sw $v0, 8($fp); lw $t2, 8($fp) */
+    append_mips_instr(construct_mips_instr(MIPS_SW, NO_ARG, REG_FP, REG_V0,
+                        8), &ml);
+    MipsInstr *lw = construct_mips_instr(MIPS_LW, REG_T0 + 2, REG_FP, NO_ARG,
+                        8);
+    append_mips_instr(lw, &ml);
+    /* beqz $t2, LABEL_1; j LABEL_2; LABEL_1: j LABEL_3; LABEL_2: LABEL_3: */
+    MipsInstr *beqz = construct_mips_instr(MIPS_BEQZ, NO_ARG, REG_T0 + 2,
+                        NO_ARG, 0);
+    beqz->label = 1;
+    append_mips_instr(beqz, &ml);
+    int labels[] = {2, 1, 3, 2, 3};
+    for (int i = 0; i < 5; i++) {
+        mi = construct_mips_instr(i == 0 || i == 2 ? MIPS_J : MIPS_LABEL,
+                        NO_ARG, NO_ARG, NO_ARG, 0);
+        mi->label = labels[i];
+        append_mips_instr(mi, &ml);
+    }
+    append_mips_instr(construct_mips_instr(MIPS_JR, NO_ARG, REG_RA, NO_ARG,
+                        0), &ml);
+
+    EXPECT_EQ(8, optimize_peephole(&ml, hits));
+    EXPECT_EQ(1, hits[0]);
+    /* j LABEL_3 is unreachable once LABEL_1 goes */
+    EXPECT_EQ(1, hits[1]);
+    EXPECT_EQ(1, hits[2]);
+    EXPECT_EQ(1, hits[3]);
+    EXPECT_EQ(1, hits[4]);
+    EXPECT_EQ(2, hits[5]);
+    EXPECT_EQ(1, hits[6]);
+    ASSERT_EQ(ori, ml.head);
+    EXPECT_EQ(MIPS_ORI, ori->op);
+    EXPECT_EQ(REG_T0, ori->rs);
+    EXPECT_EQ(7, ori->imm);
+    EXPECT_EQ(MIPS_MOVE, lw->op);
+    EXPECT_EQ(REG_V0, lw->rs);
+    EXPECT_EQ(3, beqz->label);
+    int n = 0;
+    for (mi = ml.head; mi != NULL; mi = mi->next) {
+        n++;
+    }
+    /* ori, jal, sw, move, beqz, LABEL_3 and jr */
+    EXPECT_EQ(7, n);
+    free_mips_list(&ml);
+}
+
+TEST_F(IrTest, InstructionScheduling) {
+    MipsList ml;
+    ml.head = ml.tail = NULL;
+    /* lw $t0, -8($fp); addu $t1, $t0, $t0; li $t2, 5; beqz $t1; jr $ra */
+    MipsInstr *lw = construct_mips_instr(MIPS_LW, REG_T0, REG_FP, NO_ARG, -8);
+    MipsInstr *addu = construct_mips_instr(MIPS_ADDU, REG_T0 + 1, REG_T0,
+                        REG_T0, 0);
+    MipsInstr *li = construct_mips_instr(MIPS_LI, REG_T0 + 2, NO_ARG, NO_ARG,
+                        5);
+    MipsInstr *beqz = construct_mips_instr(MIPS_BEQZ, NO_ARG, REG_T0 + 1,
+                        NO_ARG, 0);
+    MipsInstr *jr = construct_mips_instr(MIPS_JR, NO_ARG, REG_RA, NO_ARG, 0);
+    beqz->label = 1;
+    append_mips_instr(lw, &ml);
+    append_mips_instr(addu, &ml);
+    append_mips_instr(li, &ml);
+    append_mips_instr(beqz, &ml);
+    append_mips_instr(jr, &ml);
+
+    /* li goes between the load and its use */
+    EXPECT_EQ(1, schedule_instructions(&ml));
+    EXPECT_EQ(lw, ml.head);
+    EXPECT_EQ(li, lw->next);
+    EXPECT_EQ(addu, li->next);
+    EXPECT_EQ(beqz, addu->next);
+    /* beqz reads what addu writes, so li is moved after it instead */
+    EXPECT_EQ(1, fill_delay_slots(&ml));
+    EXPECT_EQ(addu, lw->next);
+    EXPECT_EQ(li, beqz->next);
+    EXPECT_EQ(jr, li->next);
+    ASSERT_TRUE(jr->next != NULL);
+    EXPECT_EQ(MIPS_NOP, jr->next->op);
+    EXPECT_EQ(ml.tail, jr->next);
+    free_mips_list(&ml);
+
+    /* lw $t0, -8($fp); addu $t1, $t0, $t0; mflo $t2; mult $t1, $t1 */
+    ml.head = ml.tail = NULL;
+    lw = construct_mips_instr(MIPS_LW, REG_T0, REG_FP, NO_ARG, -8);
+    addu = construct_mips_instr(MIPS_ADDU, REG_T0 + 1, REG_T0, REG_T0, 0);
+    MipsInstr *mflo = construct_mips_instr(MIPS_MFLO, REG_T0 + 2, NO_ARG,
+                        NO_ARG, 0);
+    MipsInstr *mult = construct_mips_instr(MIPS_MULT, NO_ARG, REG_T0 + 1,
+                        REG_T0 + 1, 0);
+    append_mips_instr(lw, &ml);
+    append_mips_instr(addu, &ml);
+    append_mips_instr(mflo, &ml);
+    append_mips_instr(mult, &ml);
+
+    /* addu would read $t0 before the load writes it */
+    EXPECT_EQ(1, insert_hazard_nops(&ml));
+    EXPECT_EQ(MIPS_NOP, lw->next->op);
+    EXPECT_EQ(addu, lw->next->next);
+    EXPECT_EQ(mult, mflo->next);
+    free_mips_list(&ml);
+
+    /* for MIPS I, mult would change LO before mflo has read it */
+    ml.head = ml.tail = NULL;
+    mflo = construct_mips_instr(MIPS_MFLO, REG_T0 + 2, NO_ARG, NO_ARG, 0);
+    mult = construct_mips_instr(MIPS_MULT, NO_ARG, REG_T0 + 1, REG_T0 + 1, 0);
+    append_mips_instr(mflo, &ml);
+    append_mips_instr(mult, &ml);
+    mips1 = TRUE;
+    EXPECT_EQ(2, insert_hazard_nops(&ml));
+    mips1 = FALSE;
+    EXPECT_EQ(MIPS_NOP, mflo->next->op);
+    EXPECT_EQ(MIPS_NOP, mflo->next->next->op);
+    EXPECT_EQ(mult, mflo->next->next->next);
+    free_mips_list(&ml);
+}
+
+TEST_F(IrTest, NarrowMemoryAccess) {
+    char c[] = "c", us[] = "us", one[] = "1";
+    Symbol *cs = create_symbol(), *uss = create_symbol();
+    push_symbol_type(cs, SIGNED_CHAR);
+    push_symbol_type(uss, UNSIGNED_SHORT);
+
+    /* c = 1 stores a byte */
+    create_id_expr(c);
+    set_symbol_table_entry(id_expr, cs);
+    create_num_constant(one);
+    assign_expr = create_node(ASSIGNMENT_EXPR, ASSIGN, id_expr, num_const);
+    compute_ir(assign_expr, ir_list);
+    EXPECT_EQ(STORE_BYTE_INDIRECT, instruction(ir_list->tail));
+
+    /* us | 1 loads a half word without extending its sign */
+    create_id_expr(us);
+    set_symbol_table_entry(id_expr, uss);
+    create_num_constant(one);
+    root = create_node(BINARY_EXPR, BITWISE_OR, id_expr, num_const);
+    compute_ir(root, ir_list);
+    EXPECT_EQ(BIT_OR, instruction(ir_list->tail));
+    EXPECT_EQ(LOAD_UNSIGNED_HALF_WORD_INDIRECT,
+                instruction(ir_list->tail->prev));
+
+    /* short m[3][5] */
+    Symbol *m = create_symbol();
+    push_symbol_type(m, SIGNED_SHORT);
+    push_symbol_type(m, ARRAY);
+    set_array_size(m->type_tree, 5);
+    push_symbol_type(m, ARRAY);
+    set_array_size(m->type_tree, 3);
+    EXPECT_EQ(30, type_bytes(m->type_tree));
+    EXPECT_EQ(SHORT_BYTES, type_alignment(m->type_tree));
+    EXPECT_EQ(CHAR_BYTES, type_bytes(cs->type_tree));
+}
+
+TEST_F(IrTest, InterproceduralOptimization) {
+    char sq[] = "sq", dead[] = "dead", mn[] = "main", unused[] = "unused";
+    SymbolTable *file_st = create_symbol_table(TOP_LEVEL_SCOPE, OTHER_NAMES);
+    Symbol *sqs = create_symbol(), *deads = create_symbol();
+    Symbol *mains = create_symbol(), *unuseds = create_symbol();
+    set_symbol_name(sqs, sq);
+    set_symbol_name(deads, dead);
+    set_symbol_name(mains, mn);
+    set_symbol_name(unuseds, unused);
+    push_symbol_type(sqs, FUNCTION);
+    push_symbol_type(deads, FUNCTION);
+    push_symbol_type(mains, FUNCTION);
+    push_symbol_type(unuseds, SIGNED_INT);
+    append_symbol(file_st, unuseds);
+    append_symbol(file_st, sqs);
+    append_symbol(file_st, deads);
+    append_symbol(file_st, mains);
+
+    /* int sq(int x) { return x * x; } */
+    emit(BEGIN_PROC, NO_ARG, NO_ARG, sqs);
+    IrNode *ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    IrNode *param = emit(RECEIVED_PARAM, 0, NO_ARG, NULL);
+    param->IMMVAL = 0;
+    IrNode *product = emit(MULT, 1, NO_ARG, NULL);
+    product->OPRND1 = 0;
+    product->OPRND2 = 0;
+    emit(RETURN_FROM_PROC, NO_ARG, 1, NULL)->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, sqs);
+
+    /* int dead(void) { return unused; } */
+    emit(BEGIN_PROC, NO_ARG, NO_ARG, deads);
+    ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    emit(LOAD_ADDRESS, 0, NO_ARG, unuseds);
+    emit(LOAD_WORD_INDIRECT, 1, 0, NULL);
+    emit(RETURN_FROM_PROC, NO_ARG, 1, NULL)->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, deads);
+
+    /* int main(void) { return sq(5) + sq(5); } */
+    IrNode *begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, mains);
+    ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    emit(LOAD_CONSTANT, 0, NO_ARG, NULL)->IMMVAL = 5;
+    for (int i = 1; i <= 2; i++) {
+        emit(BEGIN_CALL, NO_ARG, NO_ARG, sqs);
+        emit(PARAM, 0, 0, NULL);
+        emit(CALL, NO_ARG, NO_ARG, sqs);
+        emit(END_CALL, NO_ARG, NO_ARG, sqs);
+        emit(RETURNED_WORD, i, NO_ARG, NULL);
+    }
+    IrNode *sum = emit(ADD, 3, NO_ARG, NULL);
+    sum->OPRND1 = 1;
+    sum->OPRND2 = 2;
+    emit(RETURN_FROM_PROC, NO_ARG, 3, NULL)->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, mains);
+
+    CallGraph *cg = build_call_graph(ir_list);
+    ASSERT_EQ(3, cg->num_procs);
+    /* dead and the global only it uses */
+    EXPECT_EQ(2, remove_unreachable(cg, ir_list));
+    EXPECT_EQ(2, count_instructions(BEGIN_PROC));
+    EXPECT_EQ(sqs, st_symbols(file_st));
+
+    /* every call passes 5 */
+    EXPECT_EQ(1, propagate_interprocedural_constants(cg));
+    EXPECT_EQ(LOAD_CONSTANT, instruction(param));
+    EXPECT_EQ(5, param->IMMVAL);
+
+    /* sq reads no memory, main makes no calls to anything else */
+    EXPECT_EQ(2, tag_call_effects(cg));
+    for (IrNode *irn = begin; irn != NULL; irn = irn->next) {
+        if (instruction(irn) == CALL) {
+            EXPECT_EQ(CALL_CONST, irn->IMMVAL);
+        }
+    }
+    free_call_graph(cg);
+
+    /* the second sq(5) is the first */
+    ControlFlowGraph *cfg = create_cfg(ir_list, begin);
+    EXPECT_EQ(1, reuse_pure_calls(cfg));
+    EXPECT_EQ(1, count_instructions(CALL));
+    EXPECT_EQ(1, count_instructions(MOVE));
+    free_cfg(cfg);
+
+    /*
+     * int odd(int n); int even(int n);
+     * int main(void) { return odd(7); }
+     * int odd(int n) { return even(n); } int even(int n) { return odd(n); }
+     * where main and odd call through the prototypes' symbols
+     */
+    char odd[] = "odd", even[] = "even";
+    Symbol *odd_proto = create_symbol(), *even_proto = create_symbol();
+    Symbol *odds = create_symbol(), *evens = create_symbol();
+    set_symbol_name(odd_proto, odd);
+    set_symbol_name(odds, odd);
+    set_symbol_name(even_proto, even);
+    set_symbol_name(evens, even);
+    push_symbol_type(odd_proto, FUNCTION);
+    push_symbol_type(odds, FUNCTION);
+    push_symbol_type(even_proto, FUNCTION);
+    push_symbol_type(evens, FUNCTION);
+    Symbol *procs[] = {mains, odds, evens};
+    Symbol *callees[] = {odd_proto, even_proto, odds};
+    ir_list = create_ir_list();
+    for (int i = 0; i < 3; i++) {
+        emit(BEGIN_PROC, NO_ARG, NO_ARG, procs[i]);
+        ret = new_label();
+        append_ir_node(new_label(), ir_list);
+        if (i == 0) {
+            emit(LOAD_CONSTANT, 0, NO_ARG, NULL)->IMMVAL = 7;
+        } else {
+            emit(RECEIVED_PARAM, 0, NO_ARG, NULL)->IMMVAL = 0;
+        }
+        emit(BEGIN_CALL, NO_ARG, NO_ARG, callees[i]);
+        emit(PARAM, 0, 0, NULL);
+        emit(CALL, NO_ARG, NO_ARG, callees[i]);
+        emit(END_CALL, NO_ARG, NO_ARG, callees[i]);
+        emit(RETURNED_WORD, 1, NO_ARG, NULL);
+        emit(RETURN_FROM_PROC, NO_ARG, 1, NULL)->branch = ret;
+        append_ir_node(ret, ir_list);
+        emit(END_PROC, NO_ARG, NO_ARG, procs[i]);
+    }
+    cg = build_call_graph(ir_list);
+    ASSERT_EQ(3, cg->num_procs);
+    /* the calls name the definitions, which main reaches */
+    EXPECT_TRUE(cg->calls[0 * 3 + 1]);
+    EXPECT_TRUE(cg->calls[1 * 3 + 2]);
+    EXPECT_TRUE(cg->calls[2 * 3 + 1]);
+    EXPECT_EQ(0, remove_unreachable(cg, ir_list));
+    EXPECT_EQ(3, count_instructions(BEGIN_PROC));
+    for (IrNode *irn = ir_list->head; irn != NULL; irn = irn->next) {
+        if (instruction(irn) == CALL) {
+            EXPECT_TRUE(irn->s == odds || irn->s == evens);
+        }
+    }
+    free_call_graph(cg);
+}
+
+TEST_F(IrTest, Inlining) {
+    char inc[] = "inc", mn[] = "main";
+    Symbol *incs = create_symbol(), *mains = create_symbol();
+    set_symbol_name(incs, inc);
+    set_symbol_name(mains, mn);
+
+    /* int inc(int x) { return x + 1; } */
+    emit(BEGIN_PROC, NO_ARG, NO_ARG, incs);
+    IrNode *ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    emit(RECEIVED_PARAM, 0, NO_ARG, NULL)->IMMVAL = 0;
+    emit(LOAD_CONSTANT, 1, NO_ARG, NULL)->IMMVAL = 1;
+    IrNode *sum = emit(ADD, 2, NO_ARG, NULL);
+    sum->OPRND1 = 0;
+    sum->OPRND2 = 1;
+    emit(RETURN_FROM_PROC, NO_ARG, 2, NULL)->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, incs);
+
+    /* int main(void) { return inc(inc(5)); } */
+    emit(BEGIN_PROC, NO_ARG, NO_ARG, mains);
+    ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    emit(BEGIN_CALL, NO_ARG, NO_ARG, incs);
+    emit(BEGIN_CALL, NO_ARG, NO_ARG, incs);
+    emit(LOAD_CONSTANT, 0, NO_ARG, NULL)->IMMVAL = 5;
+    emit(PARAM, 0, 0, NULL);
+    emit(CALL, NO_ARG, NO_ARG, incs);
+    emit(END_CALL, NO_ARG, NO_ARG, incs);
+    emit(RETURNED_WORD, 1, NO_ARG, NULL);
+    emit(PARAM, 0, 1, NULL);
+    emit(CALL, NO_ARG, NO_ARG, incs);
+    emit(END_CALL, NO_ARG, NO_ARG, incs);
+    emit(RETURNED_WORD, 2, NO_ARG, NULL);
+    IrNode *result = emit(RETURN_FROM_PROC, NO_ARG, 2, NULL);
+    result->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, mains);
+
+    CallGraph *cg = build_call_graph(ir_list);
+    int limit = inline_limit;
+    /* each call saves 5 instructions and its copy adds 4 */
+    inline_limit = -2;
+    EXPECT_EQ(0, inline_calls(cg, ir_list));
+    inline_limit = -1;
+    EXPECT_EQ(2, inline_calls(cg, ir_list));
+    inline_limit = limit;
+    EXPECT_TRUE(cg->changed[procedure_index(cg, mains)]);
+    EXPECT_FALSE(cg->calls[procedure_index(cg, mains) * cg->num_procs +
+                            procedure_index(cg, incs)]);
+    free_call_graph(cg);
+
+    /* inc itself is left for other callers */
+    EXPECT_EQ(0, count_instructions(CALL));
+    EXPECT_EQ(1, count_instructions(RECEIVED_PARAM));
+    EXPECT_EQ(3, count_instructions(ADD));
+    /* an argument and a result moved per call */
+    EXPECT_EQ(4, count_instructions(MOVE));
+    ASSERT_EQ(MOVE, instruction(result->prev->prev));
+    EXPECT_EQ(2, result->prev->prev->RDEST);
+
+    /* the limit is read from the command line and must be positive */
+    char prog[] = "mips-main", set[] = "-inline-limit=7", o1[] = "-O1";
+    char zero[] = "-inline-limit=0", file[] = "f.c";
+    char *args[] = { prog, set, o1, file };
+    char *bad[] = { prog, zero, file };
+    Boolean ssa = FALSE;
+    int level = 0;
+    EXPECT_EQ(2, parse_opt_flags(4, args, &ssa, &level));
+    EXPECT_EQ(7, inline_limit);
+    EXPECT_EQ(1, level);
+    EXPECT_FALSE(ssa);
+    EXPECT_EQ(NO_ARG, parse_opt_flags(3, bad, &ssa, &level));
+    inline_limit = limit;
+}
+
+TEST_F(IrTest, Specialization) {
+    char f[] = "f", mn[] = "main", g[] = "g";
+    SymbolTable *file_st = create_symbol_table(TOP_LEVEL_SCOPE, OTHER_NAMES);
+    Symbol *fs = create_symbol(), *mains = create_symbol();
+    Symbol *gs = create_symbol();
+    set_symbol_name(fs, f);
+    set_symbol_name(mains, mn);
+    set_symbol_name(gs, g);
+    push_symbol_type(fs, FUNCTION);
+    push_symbol_type(mains, FUNCTION);
+    push_symbol_type(gs, SIGNED_INT);
+    append_symbol(file_st, gs);
+    append_symbol(file_st, fs);
+    append_symbol(file_st, mains);
+
+    /* int f(int x, int mode) { return x + mode; } */
+    emit(BEGIN_PROC, NO_ARG, NO_ARG, fs);
+    IrNode *ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    emit(RECEIVED_PARAM, 0, NO_ARG, NULL)->IMMVAL = 0;
+    emit(RECEIVED_PARAM, 1, NO_ARG, NULL)->IMMVAL = 1;
+    IrNode *sum = emit(ADD, 2, NO_ARG, NULL);
+    sum->OPRND1 = 0;
+    sum->OPRND2 = 1;
+    emit(RETURN_FROM_PROC, NO_ARG, 2, NULL)->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, fs);
+
+    /* int main(void) { f(g, 1); f(g, 1); return f(g, 2); } */
+    emit(BEGIN_PROC, NO_ARG, NO_ARG, mains);
+    ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    emit(LOAD_ADDRESS, 0, NO_ARG, gs);
+    emit(LOAD_WORD_INDIRECT, 1, 0, NULL);
+    emit(LOAD_CONSTANT, 2, NO_ARG, NULL)->IMMVAL = 1;
+    emit(LOAD_CONSTANT, 3, NO_ARG, NULL)->IMMVAL = 2;
+    IrNode *calls[3];
+    for (int i = 0; i < 3; i++) {
+        emit(BEGIN_CALL, NO_ARG, NO_ARG, fs);
+        emit(PARAM, 0, 1, NULL);
+        emit(PARAM, 1, i < 2 ? 2 : 3, NULL);
+        calls[i] = emit(CALL, NO_ARG, NO_ARG, fs);
+        emit(END_CALL, NO_ARG, NO_ARG, fs);
+        emit(RETURNED_WORD, 4 + i, NO_ARG, NULL);
+    }
+    emit(RETURN_FROM_PROC, NO_ARG, 6, NULL)->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, mains);
+
+    /* a copy for mode 1; the call passing 2 is left for ipcp */
+    CallGraph *cg = build_call_graph(ir_list);
+    EXPECT_EQ(1, specialize_procedures(cg, ir_list));
+    ASSERT_EQ(3, cg->num_procs);
+    EXPECT_TRUE(cg->changed[2]);
+    Symbol *copy = cg->procs[2]->s;
+    EXPECT_STREQ("f_1", get_symbol_name(copy));
+    EXPECT_EQ(copy, calls[0]->s);
+    EXPECT_EQ(copy, calls[1]->s);
+    EXPECT_EQ(fs, calls[2]->s);
+    EXPECT_EQ(copy, call_begin(calls[0])->s);
+    EXPECT_TRUE(cg->calls[procedure_index(cg, mains) * cg->num_procs + 2]);
+    free_call_graph(cg);
+
+    /* the copy receives x and loads the mode */
+    EXPECT_EQ(3, count_instructions(BEGIN_PROC));
+    EXPECT_EQ(3, count_instructions(RECEIVED_PARAM));
+    int modes = 0;
+    for (IrNode *irn = ir_list->head; irn != NULL; irn = irn->next) {
+        if (instruction(irn) == LOAD_CONSTANT && irn->RDEST == 1) {
+            EXPECT_EQ(1, irn->IMMVAL);
+            modes++;
+        }
+    }
+    EXPECT_EQ(1, modes);
+}
+
+TEST_F(IrTest, LoopInvariantCodeMotion) {
+    char f[] = "f", g[] = "g", s[] = "s";
+    Symbol *fs = create_symbol(), *gs = create_symbol(), *ss = create_symbol();
+    set_symbol_name(fs, f);
+    set_symbol_name(gs, g);
+    set_symbol_name(ss, s);
+    push_symbol_type(gs, SIGNED_INT);
+    push_symbol_type(ss, SIGNED_INT);
+
+    /* void f(void) { int i; for (i = 0; i < 10; i++) g = g + s * 4; } */
+    IrNode *begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, fs);
+    IrNode *top = new_label(), *done = new_label(), *ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    emit(LOAD_CONSTANT, 0, NO_ARG, NULL)->IMMVAL = 0;
+    emit(LOAD_CONSTANT, 1, NO_ARG, NULL)->IMMVAL = 10;
+    append_ir_node(top, ir_list);
+    IrNode *test = emit(SET_LT, 2, NO_ARG, NULL);
+    test->OPRND1 = 0;
+    test->OPRND2 = 1;
+    append_ir_node(irn_jump(JUMP_EQZ, 2, done), ir_list);
+    emit(LOAD_ADDRESS, 3, NO_ARG, gs);
+    emit(LOAD_WORD_INDIRECT, 4, 3, NULL);
+    emit(LOAD_ADDRESS, 5, NO_ARG, ss);
+    emit(LOAD_WORD_INDIRECT, 6, 5, NULL);
+    emit(LOAD_CONSTANT, 7, NO_ARG, NULL)->IMMVAL = 4;
+    IrNode *scaled = emit(MULT, 8, NO_ARG, NULL);
+    scaled->OPRND1 = 6;
+    scaled->OPRND2 = 7;
+    IrNode *sum = emit(ADD, 9, NO_ARG, NULL);
+    sum->OPRND1 = 4;
+    sum->OPRND2 = 8;
+    emit(STORE_WORD_INDIRECT, 3, 9, NULL);
+    emit(ADD_CONST, 0, 0, NULL)->IMMVAL = 1;
+    append_ir_node(irn_jump(JUMP, NO_ARG, top), ir_list);
+    append_ir_node(done, ir_list);
+    emit(RETURN_FROM_PROC, NO_ARG, NO_ARG, NULL)->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, fs);
+
+    ControlFlowGraph *cfg = create_cfg(ir_list, begin);
+    /* both addresses, the load of s, which the loop does not write, and
+     * the product, with the constant it reads loaded again */
+    EXPECT_EQ(4, hoist_loop_invariants(cfg));
+    ASSERT_EQ(top, scaled->next);
+    ASSERT_EQ(LOAD_CONSTANT, instruction(scaled->prev));
+    EXPECT_EQ(4, scaled->prev->IMMVAL);
+    EXPECT_NE(scaled->OPRND2, 7);
+
+    /* g is loaded before the loop and stored once after it */
+    EXPECT_EQ(1, promote_globals(cfg));
+    EXPECT_EQ(2, count_instructions(MOVE));
+    EXPECT_EQ(MOVE, instruction(sum->next));
+    EXPECT_EQ(2, count_instructions(LOAD_WORD_INDIRECT));
+    ASSERT_EQ(1, count_instructions(STORE_WORD_INDIRECT));
+    EXPECT_EQ(STORE_WORD_INDIRECT, instruction(done->next));
+    EXPECT_EQ(sum->next->RDEST, done->next->RSRC);
+    free_cfg(cfg);
+
+    /*
+     * int f(int p, int n) { int i, j, s; s = 0; for (i = 0; i < n; i++)
+     * for (j = 0; j < n; j++) s = s + (p & 7); return s; }: p & 7 leaves
+     * the inner loop with the constant copied to its preheader, and stays
+     * there rather than leave the outer loop without it
+     */
+    ir_list = create_ir_list();
+    begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, fs);
+    IrNode *inner = new_label(), *next = new_label();
+    top = new_label();
+    done = new_label();
+    ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    emit(RECEIVED_PARAM, 0, NO_ARG, NULL)->IMMVAL = 0;
+    emit(RECEIVED_PARAM, 1, NO_ARG, NULL)->IMMVAL = 1;
+    emit(LOAD_CONSTANT, 2, NO_ARG, NULL)->IMMVAL = 0;
+    emit(LOAD_CONSTANT, 3, NO_ARG, NULL)->IMMVAL = 0;
+    append_ir_node(top, ir_list);
+    test = emit(SET_LT, 4, NO_ARG, NULL);
+    test->OPRND1 = 2;
+    test->OPRND2 = 1;
+    append_ir_node(irn_jump(JUMP_EQZ, 4, done), ir_list);
+    emit(LOAD_CONSTANT, 5, NO_ARG, NULL)->IMMVAL = 0;
+    append_ir_node(inner, ir_list);
+    test = emit(SET_LT, 6, NO_ARG, NULL);
+    test->OPRND1 = 5;
+    test->OPRND2 = 1;
+    append_ir_node(irn_jump(JUMP_EQZ, 6, next), ir_list);
+    emit(LOAD_CONSTANT, 7, NO_ARG, NULL)->IMMVAL = 7;
+    IrNode *masked = emit(BIT_AND, 8, NO_ARG, NULL);
+    masked->OPRND1 = 0;
+    masked->OPRND2 = 7;
+    sum = emit(ADD, 3, NO_ARG, NULL);
+    sum->OPRND1 = 3;
+    sum->OPRND2 = 8;
+    emit(ADD_CONST, 5, 5, NULL)->IMMVAL = 1;
+    append_ir_node(irn_jump(JUMP, NO_ARG, inner), ir_list);
+    append_ir_node(next, ir_list);
+    emit(ADD_CONST, 2, 2, NULL)->IMMVAL = 1;
+    append_ir_node(irn_jump(JUMP, NO_ARG, top), ir_list);
+    append_ir_node(done, ir_list);
+    emit(RETURN_FROM_PROC, NO_ARG, 3, NULL)->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, fs);
+
+    cfg = create_cfg(ir_list, begin);
+    EXPECT_EQ(1, hoist_loop_invariants(cfg));
+    ASSERT_EQ(LOAD_CONSTANT, instruction(masked->prev));
+    EXPECT_EQ(7, masked->prev->IMMVAL);
+    EXPECT_EQ(masked->prev->RDEST, masked->OPRND2);
+    EXPECT_EQ(masked->bb, masked->prev->bb);
+    free_cfg(cfg);
+}
+
+TEST_F(IrTest, InductionVariableStrengthReduction) {
+    char f[] = "f", a[] = "a", h[] = "h", two[] = "2", one[] = "1";
+    Symbol *fs = create_symbol(), *as = create_symbol(), *hs = create_symbol();
+    set_symbol_name(fs, f);
+    set_symbol_name(as, a);
+    push_symbol_type(as, SIGNED_INT);
+    push_symbol_type(as, ARRAY);
+    set_array_size(as->type_tree, 10);
+    push_symbol_type(hs, SIGNED_SHORT);
+    push_symbol_type(hs, ARRAY);
+    set_array_size(hs->type_tree, 6);
+
+    /* h[2] + 1 scales the index by the size of a short and loads one */
+    create_id_expr(h);
+    set_symbol_table_entry(id_expr, hs);
+    create_num_constant(two);
+    Node *subscript = create_node(SUBSCRIPT_EXPR, id_expr, num_const);
+    create_num_constant(one);
+    root = create_node(BINARY_EXPR, PLUS, subscript, num_const);
+    compute_ir(root, ir_list);
+    IrNode *load = ir_list->tail->prev, *element = load->prev->prev;
+    ASSERT_EQ(LOAD_HALF_WORD_INDIRECT, instruction(load));
+    ASSERT_EQ(ADD, instruction(element));
+    EXPECT_EQ(load->RSRC, element->RDEST);
+    ASSERT_EQ(MULT, instruction(element->prev));
+    EXPECT_EQ(SHORT_BYTES, element->prev->prev->IMMVAL);
+    ir_list = create_ir_list();
+
+    /* void f(void) { int i; for (i = 0; i < 10; i++) a[i] = 0; } in SSA */
+    IrNode *begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, fs);
+    IrNode *top = new_label(), *done = new_label(), *ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    emit(LOAD_CONSTANT, 0, NO_ARG, NULL)->IMMVAL = 0;
+    emit(LOAD_ADDRESS, 1, NO_ARG, as);
+    append_ir_node(top, ir_list);
+    IrNode *phi = emit(PHI, 2, NO_ARG, NULL);
+    emit(LOAD_CONSTANT, 3, NO_ARG, NULL)->IMMVAL = 10;
+    IrNode *test = emit(SET_LT, 4, NO_ARG, NULL);
+    test->OPRND1 = 2;
+    test->OPRND2 = 3;
+    append_ir_node(irn_jump(JUMP_EQZ, 4, done), ir_list);
+    emit(LOAD_CONSTANT, 5, NO_ARG, NULL)->IMMVAL = 4;
+    IrNode *scaled = emit(MULT, 6, NO_ARG, NULL);
+    scaled->OPRND1 = 2;
+    scaled->OPRND2 = 5;
+    IrNode *addr = emit(ADD, 7, NO_ARG, NULL);
+    addr->OPRND1 = 1;
+    addr->OPRND2 = 6;
+    emit(STORE_WORD_INDIRECT, 7, 0, NULL);
+    emit(ADD_CONST, 8, 2, NULL)->IMMVAL = 1;
+    append_ir_node(irn_jump(JUMP, NO_ARG, top), ir_list);
+    append_ir_node(done, ir_list);
+    emit(RETURN_FROM_PROC, NO_ARG, NO_ARG, NULL)->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, fs);
+
+    ControlFlowGraph *cfg = create_cfg(ir_list, begin);
+    BasicBlock *header = top->bb;
+    ASSERT_EQ(2, header->num_preds);
+    phi->num_phi_args = 2;
+    phi->phi_args = (PhiArg *) malloc(2 * sizeof(PhiArg));
+    for (int i = 0; i < 2; i++) {
+        phi->phi_args[i].pred = header->preds[i]->first;
+        phi->phi_args[i].reg = header->preds[i] == begin->next->bb ? 0 : 8;
+    }
+
+    /* the product and the address, then the test */
+    EXPECT_EQ(3, reduce_induction_variables(cfg));
+    /* the address steps by 4 from a and the loop ends 40 bytes on */
+    EXPECT_EQ(0, count_instructions(MULT));
+    ASSERT_EQ(1, count_instructions(PHI));
+    IrNode *pointer = top->next;
+    ASSERT_EQ(PHI, instruction(pointer));
+    EXPECT_EQ(MOVE, instruction(addr));
+    EXPECT_EQ(pointer->RDEST, addr->RSRC);
+    EXPECT_EQ(pointer->RDEST, test->OPRND1);
+    EXPECT_EQ(ADD, instruction(top->prev));
+    EXPECT_EQ(top->prev->RDEST, test->OPRND2);
+    EXPECT_EQ(1, top->prev->OPRND1);
+    EXPECT_EQ(40, top->prev->prev->IMMVAL);
+    /* the counter is gone */
+    EXPECT_EQ(0, count_instructions(ADD_CONST));
+    free_cfg(cfg);
+}
+
+TEST_F(IrTest, ConstantMultiplyDivide) {
+    char x[] = "x", seven[] = "7", f[] = "f";
+    Symbol *xs = create_symbol(), *fs = create_symbol();
+    push_symbol_type(xs, UNSIGNED_INT);
+    set_symbol_name(fs, f);
+
+    /* x / 7 and x >> 7 on an unsigned int divide and shift unsigned */
+    create_id_expr(x);
+    set_symbol_table_entry(id_expr, xs);
+    create_num_constant(seven);
+    compute_ir(create_node(BINARY_EXPR, DIVIDE, id_expr, num_const), ir_list);
+    EXPECT_EQ(DIVU, instruction(ir_list->tail));
+    compute_ir(create_node(BINARY_EXPR, BITWISE_RSHIFT, id_expr, num_const),
+                ir_list);
+    EXPECT_EQ(SHIFT_RIGHT_LOGICAL, instruction(ir_list->tail));
+
+    /* (unsigned) y / 7 divides the copy the cast makes of y */
+    char y[] = "y";
+    Symbol *ys = create_symbol();
+    push_symbol_type(ys, SIGNED_INT);
+    create_id_expr(y);
+    set_symbol_table_entry(id_expr, ys);
+    create_num_constant(seven);
+    Node *cast = create_node(CAST_EXPR, create_node(TYPE_NAME,
+                    create_node(TYPE_SPECIFIER, UNSIGNED_INT), NULL), id_expr);
+    compute_ir(create_node(BINARY_EXPR, DIVIDE, cast, num_const), ir_list);
+    EXPECT_EQ(DIVU, instruction(ir_list->tail));
+    EXPECT_EQ(MOVE, instruction(ir_list->tail->prev->prev));
+    EXPECT_EQ(ir_list->tail->prev->prev->RDEST, ir_list->tail->OPRND1);
+    EXPECT_EQ(cast->expr->location, ir_list->tail->OPRND1);
+
+    /* (signed char) y shifts y up and its sign back down */
+    create_id_expr(y);
+    set_symbol_table_entry(id_expr, ys);
+    cast = create_node(CAST_EXPR, create_node(TYPE_NAME,
+                    create_node(TYPE_SPECIFIER, SIGNED_CHAR), NULL), id_expr);
+    compute_ir(cast, ir_list);
+    EXPECT_EQ(SHIFT_RIGHT, instruction(ir_list->tail));
+    EXPECT_EQ(SHIFT_LEFT, instruction(ir_list->tail->prev));
+    EXPECT_EQ(ir_list->tail->prev->RDEST, ir_list->tail->OPRND1);
+    EXPECT_EQ(ir_list->tail->RDEST, cast->expr->location);
+    int v;
+    EXPECT_TRUE(fold_binary_op(DIVU, -1, 2, &v));
+    EXPECT_EQ(0x7fffffff, v);
+    EXPECT_TRUE(fold_binary_op(MULT_HIGH, -3, 0x40000000, &v));
+    EXPECT_EQ(-1, v);
+    EXPECT_TRUE(fold_binary_op(MULT_HIGH_UNSIGNED, -3, 0x40000000, &v));
+    EXPECT_EQ(0x3fffffff, v);
+    ir_list = create_ir_list();
+
+    /* x * 10, x / 7, x % 16u and x * 1000 on an x loaded from memory */
+    IrNode *begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, fs);
+    IrNode *ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    emit(LOAD_ADDRESS, 0, NO_ARG, local_int(x));
+    emit(LOAD_WORD_INDIRECT, 1, 0, NULL);
+    int ops[4] = { MULT, DIV, REMU, MULT }, c[4] = { 10, 7, 16, 1000 };
+    IrNode *results[4];
+    for (int i = 0; i < 4; i++) {
+        emit(LOAD_CONSTANT, 2 + 2 * i, NO_ARG, NULL)->IMMVAL = c[i];
+        results[i] = emit((enum ir_instruction) ops[i], 3 + 2 * i, NO_ARG,
+                            NULL);
+        results[i]->OPRND1 = 1;
+        results[i]->OPRND2 = 2 + 2 * i;
+    }
+    emit(RETURN_FROM_PROC, NO_ARG, 9, NULL)->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, fs);
+
+    ControlFlowGraph *cfg = create_cfg(ir_list, begin);
+    EXPECT_EQ(3, lower_constant_arithmetic(cfg));
+    EXPECT_EQ(1, count_instructions(MULT));
+    EXPECT_EQ(1, count_instructions(MULT_HIGH));
+    EXPECT_EQ(1, count_instructions(BIT_AND));
+    EXPECT_EQ(0, count_instructions(DIV));
+    EXPECT_EQ(0, count_instructions(REMU));
+
+    /* running the lowered code gives the products and quotients */
+    int samples[5] = { 0, 13, -13, 0x7fffffff, (int) 0x80000000u };
+    int *regs = (int *) malloc(cfg->num_regs * sizeof(int));
+    for (int s = 0; s < 5; s++) {
+        regs[1] = samples[s];
+        for (IrNode *irn = begin->next->next->next->next;
+                instruction(irn) != RETURN_FROM_PROC; irn = irn->next) {
+            if (instruction(irn) == LOAD_CONSTANT) {
+                regs[irn->RDEST] = irn->IMMVAL;
+            } else if (instruction(irn) == MOVE) {
+                regs[irn->RDEST] = regs[irn->RSRC];
+            } else if (is_unary_op(irn)) {
+                ASSERT_TRUE(fold_unary_op(instruction(irn), regs[irn->RSRC],
+                                            &regs[irn->RDEST]));
+            } else {
+                ASSERT_TRUE(fold_binary_op(instruction(irn),
+                                regs[irn->OPRND1], regs[irn->OPRND2],
+                                &regs[irn->RDEST]));
+            }
+        }
+        EXPECT_EQ((int) ((unsigned int) samples[s] * 10u), regs[3]);
+        EXPECT_EQ(samples[s] / 7, regs[5]);
+        EXPECT_EQ((int) ((unsigned int) samples[s] % 16u), regs[7]);
+    }
+    free(regs);
+    free_cfg(cfg);
+}
+
+TEST_F(IrTest, LoopUnrolling) {
+    /* three iterations unroll completely and leave nothing to test */
+    ControlFlowGraph *cfg = create_cfg(ir_list, counted_loop_ir(3));
+    construct_ssa(cfg);
+    propagate_constants(cfg);
+    number_values(cfg);
+    EXPECT_EQ(1, unroll_loops(cfg));
+    EXPECT_EQ(0, count_instructions(PHI));
+    EXPECT_EQ(3, count_instructions(ADD));
+    construct_ssa(cfg);
+    propagate_constants(cfg);
+    EXPECT_EQ(0, count_instructions(JUMP_EQZ));
+    IrNode *ret = cfg->end_proc->prev->prev;
+    ASSERT_EQ(RETURN_FROM_PROC, instruction(ret));
+    DefUse *du = compute_def_use(cfg);
+    IrNode *def = du[ret->RSRC].def;
+    ASSERT_EQ(LOAD_CONSTANT, instruction(def));
+    EXPECT_EQ(3, def->IMMVAL);
+    free_def_use(du, cfg->num_regs);
+    free_cfg(cfg);
+    ir_list = create_ir_list();
+
+    /* up to a parameter, four iterations run at a time once the bound is
+     * checked not to wrap, and the loop finishes the rest */
+    cfg = create_cfg(ir_list, counted_loop_ir(NO_ARG));
+    construct_ssa(cfg);
+    propagate_constants(cfg);
+    number_values(cfg);
+    EXPECT_EQ(1, unroll_loops(cfg));
+    EXPECT_EQ(0, count_instructions(PHI));
+    EXPECT_EQ(1, count_instructions(SET_GE));
+    /* four copies and the loop add to s, and one pulls in the bound */
+    EXPECT_EQ(6, count_instructions(ADD));
+    EXPECT_EQ(5, count_instructions(ADD_CONST));
+    EXPECT_EQ(3, count_instructions(JUMP_EQZ));
+
+    /* with a factor below 2 loops are only taken out of SSA */
+    unroll_factor = 1;
+    ir_list = create_ir_list();
+    ControlFlowGraph *plain = create_cfg(ir_list, counted_loop_ir(NO_ARG));
+    construct_ssa(plain);
+    EXPECT_EQ(0, unroll_loops(plain));
+    EXPECT_EQ(0, count_instructions(PHI));
+    EXPECT_EQ(1, count_instructions(ADD_CONST));
+    unroll_factor = 4;
+    free_cfg(plain);
+    free_cfg(cfg);
+}
+
+TEST_F(IrTest, LoopRotationAndLayout) {
+    /* the test at the top of the loop is copied to its bottom */
+    ControlFlowGraph *cfg = create_cfg(ir_list, counted_loop_ir(NO_ARG));
+    EXPECT_EQ(1, rotate_loops(cfg));
+    EXPECT_EQ(2, count_instructions(SET_LT));
+    EXPECT_EQ(1, count_instructions(JUMP_EQZ));
+    EXPECT_EQ(1, count_instructions(JUMP_NEZ));
+    EXPECT_EQ(0, count_instructions(JUMP));
+    free_cfg(cfg);
+
+    /*
+     * int f(int n) { if (!n) return -1; return n + 1; }: the early return
+     * goes last and the branch to the rest is turned around
+     */
+    char f[] = "f";
+    Symbol *fs = create_symbol();
+    set_symbol_name(fs, f);
+    ir_list = create_ir_list();
+    IrNode *begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, fs);
+    IrNode *rest = new_label(), *ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    emit(RECEIVED_PARAM, 0, NO_ARG, NULL)->IMMVAL = 0;
+    append_ir_node(irn_jump(JUMP_NEZ, 0, rest), ir_list);
+    emit(LOAD_CONSTANT, 1, NO_ARG, NULL)->IMMVAL = -1;
+    emit(RETURN_FROM_PROC, NO_ARG, 1, NULL)->branch = ret;
+    append_ir_node(rest, ir_list);
+    emit(ADD_CONST, 2, 0, NULL)->IMMVAL = 1;
+    append_ir_node(new_label(), ir_list);
+    emit(RETURN_FROM_PROC, NO_ARG, 2, NULL)->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, fs);
+    cfg = create_cfg(ir_list, begin);
+    EXPECT_LT(0, layout_blocks(cfg));
+    EXPECT_EQ(0, count_instructions(JUMP_NEZ));
+    EXPECT_EQ(1, count_instructions(JUMP_EQZ));
+    IrNode *last = cfg->end_proc->prev->prev;
+    ASSERT_EQ(RETURN_FROM_PROC, instruction(last));
+    EXPECT_EQ(1, last->RSRC);
+    free_cfg(cfg);
+
+    /* a jump to a block that only returns returns itself */
+    ir_list = create_ir_list();
+    begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, fs);
+    IrNode *els = new_label(), *join = new_label();
+    ret = new_label();
+    append_ir_node(new_label(), ir_list);
+    emit(RECEIVED_PARAM, 0, NO_ARG, NULL)->IMMVAL = 0;
+    append_ir_node(irn_jump(JUMP_EQZ, 0, els), ir_list);
+    emit(LOAD_CONSTANT, 1, NO_ARG, NULL)->IMMVAL = 5;
+    append_ir_node(irn_jump(JUMP, NO_ARG, join), ir_list);
+    append_ir_node(els, ir_list);
+    emit(LOAD_CONSTANT, 1, NO_ARG, NULL)->IMMVAL = 7;
+    append_ir_node(join, ir_list);
+    emit(RETURN_FROM_PROC, NO_ARG, 1, NULL)->branch = ret;
+    append_ir_node(ret, ir_list);
+    emit(END_PROC, NO_ARG, NO_ARG, fs);
+    cfg = create_cfg(ir_list, begin);
+    EXPECT_EQ(1, thread_jumps(cfg));
+    EXPECT_EQ(0, count_instructions(JUMP));
+    EXPECT_EQ(2, count_instructions(RETURN_FROM_PROC));
+    free_cfg(cfg);
+}
+
+TEST_F(IrTest, IfConversion) {
+    /*
+     * int f(int a, int b) { int m; if (a < b) m = b; else m = a; return m; }:
+     * the branch becomes a select, or without conditional moves a mask
+     * from the comparison choosing between a and b
+     */
+    char f[] = "f";
+    Symbol *fs = create_symbol();
+    set_symbol_name(fs, f);
+    for (int moves = 1; moves >= 0; moves--) {
+        ir_list = create_ir_list();
+        IrNode *begin = emit(BEGIN_PROC, NO_ARG, NO_ARG, fs);
+        IrNode *els = new_label(), *join = new_label(), *ret = new_label();
+        append_ir_node(new_label(), ir_list);
+        emit(RECEIVED_PARAM, 0, NO_ARG, NULL)->IMMVAL = 0;
+        emit(RECEIVED_PARAM, 1, NO_ARG, NULL)->IMMVAL = 1;
+        IrNode *test = emit(SET_LT, 2, NO_ARG, NULL);
+        test->OPRND1 = 0;
+        test->OPRND2 = 1;
+        append_ir_node(irn_jump(JUMP_EQZ, 2, els), ir_list);
+        emit(MOVE, 3, 1, NULL);
+        append_ir_node(irn_jump(JUMP, NO_ARG, join), ir_list);
+        append_ir_node(els, ir_list);
+        emit(MOVE, 3, 0, NULL);
+        append_ir_node(join, ir_list);
+        emit(RETURN_FROM_PROC, NO_ARG, 3, NULL)->branch = ret;
+        append_ir_node(ret, ir_list);
+        emit(END_PROC, NO_ARG, NO_ARG, fs);
+        ControlFlowGraph *cfg = create_cfg(ir_list, begin);
+        construct_ssa(cfg);
+        number_values(cfg);
+        conditional_moves = moves ? TRUE : FALSE;
+        EXPECT_EQ(1, convert_branches(cfg));
+        EXPECT_EQ(0, count_instructions(JUMP_EQZ));
+        EXPECT_EQ(0, count_instructions(PHI));
+        EXPECT_EQ(moves, count_instructions(SELECT));
+        EXPECT_EQ(moves ? 0 : 2, count_instructions(BIT_XOR));
+        EXPECT_EQ(moves ? 0 : 1, count_instructions(BIT_AND));
+        free_cfg(cfg);
+    }
+    conditional_moves = TRUE;
+}
+
 
 
 /*